@@ -2,241 +2,381 @@
 #define TRIBHASHA_AST_H
 
 #include "Token.h"
-#include <memory>
+#include "ASTContext.h"
+#include <algorithm>
+#include <string_view>
 #include <vector>
-#include <string>
-#include <utility>
 
 namespace tribhasha {
 
-// Forward declarations
-class Expr;
-class Stmt;
+// Node kinds. Every node records its kind so that passes can dispatch with
+// a switch instead of virtual calls, and tests and the parser can check a
+// node's class without RTTI.
+enum class ExprKind : uint8_t {
+    Binary,
+    Logical,
+    Grouping,
+    Literal,
+    Unary,
+    Variable,
+    Assign,
+    Call
+};
 
-// Visitor pattern interfaces
-class ExprVisitor {
-public:
-    virtual ~ExprVisitor() = default;
-    
-    virtual void* visitBinaryExpr(class BinaryExpr* expr) = 0;
-    virtual void* visitGroupingExpr(class GroupingExpr* expr) = 0;
-    virtual void* visitLiteralExpr(class LiteralExpr* expr) = 0;
-    virtual void* visitUnaryExpr(class UnaryExpr* expr) = 0;
-    virtual void* visitVariableExpr(class VariableExpr* expr) = 0;
-    virtual void* visitAssignExpr(class AssignExpr* expr) = 0;
-    virtual void* visitCallExpr(class CallExpr* expr) = 0;
+enum class StmtKind : uint8_t {
+    Expression,
+    Var,
+    Block,
+    If,
+    While,
+    Function,
+    Return
 };
 
-class StmtVisitor {
-public:
-    virtual ~StmtVisitor() = default;
-    
-    virtual void* visitExpressionStmt(class ExpressionStmt* stmt) = 0;
-    virtual void* visitVarStmt(class VarStmt* stmt) = 0;
-    virtual void* visitBlockStmt(class BlockStmt* stmt) = 0;
-    virtual void* visitIfStmt(class IfStmt* stmt) = 0;
-    virtual void* visitWhileStmt(class WhileStmt* stmt) = 0;
-    virtual void* visitFunctionStmt(class FunctionStmt* stmt) = 0;
-    virtual void* visitReturnStmt(class ReturnStmt* stmt) = 0;
+// Static types of values, worked out by TypeInference. Unknown means
+// nothing is known yet and is below every other type; numbers widen from
+// Bool to Int to Float. A String does not mix with the others.
+enum class ValueType : uint8_t {
+    Unknown,
+    Bool,
+    Int,
+    Float,
+    String
 };
 
+// The narrowest type that holds values of both `a` and `b`
+inline ValueType joinTypes(ValueType a, ValueType b) {
+    if (a == ValueType::Unknown) return b;
+    if (b == ValueType::Unknown) return a;
+    if (a == ValueType::String || b == ValueType::String) return ValueType::String;
+    return a > b ? a : b;
+}
+
 // Base classes
+//
+// Nodes live in an ASTContext arena and refer to their children by plain
+// pointers and spans. They are never deleted individually, so they hold no
+// owning members and have no virtual functions at all.
 class Expr {
 public:
-    virtual ~Expr() = default;
-    virtual void* accept(ExprVisitor* visitor) = 0;
+    ExprKind getKind() const { return kind; }
+    
+    // The node as a T, or nullptr if it is some other kind of expression
+    template <typename T>
+    T* as() { return kind == T::Kind ? static_cast<T*>(this) : nullptr; }
+    
+    template <typename T>
+    bool is() const { return kind == T::Kind; }
+    
+    // Type of the expression's value, filled in by TypeInference
+    ValueType valueType = ValueType::Unknown;
+    
+protected:
+    explicit Expr(ExprKind kind) : kind(kind) {}
+    ~Expr() = default;
+    
+private:
+    ExprKind kind;
 };
 
 class Stmt {
 public:
-    virtual ~Stmt() = default;
-    virtual void* accept(StmtVisitor* visitor) = 0;
+    StmtKind getKind() const { return kind; }
+    
+    template <typename T>
+    T* as() { return kind == T::Kind ? static_cast<T*>(this) : nullptr; }
+    
+    template <typename T>
+    bool is() const { return kind == T::Kind; }
+    
+    // Where the offsets of the tokens under a top-level statement count
+    // from: 0 when it was parsed from a whole file, and the start of the
+    // declaration when an IncrementalParser keeps it, so that moving it is
+    // a single store
+    uint32_t base = 0;
+    
+protected:
+    explicit Stmt(StmtKind kind) : kind(kind) {}
+    ~Stmt() = default;
+    
+private:
+    StmtKind kind;
 };
 
 // Expression classes
 class BinaryExpr : public Expr {
 public:
-    BinaryExpr(std::shared_ptr<Expr> left, Token op, std::shared_ptr<Expr> right)
-        : left(std::move(left)), op(std::move(op)), right(std::move(right)) {}
+    static constexpr ExprKind Kind = ExprKind::Binary;
     
-    void* accept(ExprVisitor* visitor) override {
-        return visitor->visitBinaryExpr(this);
-    }
+    BinaryExpr(Expr* left, Token op, Expr* right)
+        : Expr(Kind), left(left), op(op), right(right) {}
+    
+    Expr* left;
+    Token op;
+    Expr* right;
+};
+
+// `and` / `or` in any language; the right operand is only evaluated when
+// the left one does not decide the result
+class LogicalExpr : public Expr {
+public:
+    static constexpr ExprKind Kind = ExprKind::Logical;
+    
+    LogicalExpr(Expr* left, Token op, Expr* right)
+        : Expr(Kind), left(left), op(op), right(right) {}
     
-    std::shared_ptr<Expr> left;
+    Expr* left;
     Token op;
-    std::shared_ptr<Expr> right;
+    Expr* right;
 };
 
 class GroupingExpr : public Expr {
 public:
-    explicit GroupingExpr(std::shared_ptr<Expr> expression)
-        : expression(std::move(expression)) {}
+    static constexpr ExprKind Kind = ExprKind::Grouping;
     
-    void* accept(ExprVisitor* visitor) override {
-        return visitor->visitGroupingExpr(this);
-    }
+    explicit GroupingExpr(Expr* expression)
+        : Expr(Kind), expression(expression) {}
     
-    std::shared_ptr<Expr> expression;
+    Expr* expression;
 };
 
 class LiteralExpr : public Expr {
 public:
-    explicit LiteralExpr(std::string value, TokenType type)
-        : value(std::move(value)), type(type) {}
+    static constexpr ExprKind Kind = ExprKind::Literal;
+    
+    LiteralExpr(std::string_view value, TokenType type)
+        : Expr(Kind), value(value), type(type), intValue(0) {}
     
-    void* accept(ExprVisitor* visitor) override {
-        return visitor->visitLiteralExpr(this);
+    // Numeric literals take the value the lexer already parsed
+    LiteralExpr(const Token& token, std::string_view lexeme)
+        : Expr(Kind), value(lexeme), type(token.type), intValue(token.intValue) {
+        if (type == TokenType::FLOAT_LITERAL) floatValue = token.floatValue;
     }
     
-    std::string value;
+    // Text of the literal; string literals without their quotes. Views
+    // into the source, which outlives the AST.
+    std::string_view value;
     TokenType type;
+    union {
+        int64_t intValue;
+        double floatValue;
+    };
 };
 
 class UnaryExpr : public Expr {
 public:
-    UnaryExpr(Token op, std::shared_ptr<Expr> right)
-        : op(std::move(op)), right(std::move(right)) {}
+    static constexpr ExprKind Kind = ExprKind::Unary;
     
-    void* accept(ExprVisitor* visitor) override {
-        return visitor->visitUnaryExpr(this);
-    }
+    UnaryExpr(Token op, Expr* right)
+        : Expr(Kind), op(op), right(right) {}
     
     Token op;
-    std::shared_ptr<Expr> right;
+    Expr* right;
 };
 
 class VariableExpr : public Expr {
 public:
-    explicit VariableExpr(Token name)
-        : name(std::move(name)) {}
+    static constexpr ExprKind Kind = ExprKind::Variable;
     
-    void* accept(ExprVisitor* visitor) override {
-        return visitor->visitVariableExpr(this);
-    }
+    explicit VariableExpr(Token name)
+        : Expr(Kind), name(name) {}
     
     Token name;
+    
+    // Frame slot of the variable, filled in by the Resolver
+    uint32_t slot = 0;
 };
 
 class AssignExpr : public Expr {
 public:
-    AssignExpr(Token name, std::shared_ptr<Expr> value)
-        : name(std::move(name)), value(std::move(value)) {}
+    static constexpr ExprKind Kind = ExprKind::Assign;
     
-    void* accept(ExprVisitor* visitor) override {
-        return visitor->visitAssignExpr(this);
-    }
+    AssignExpr(Token name, Expr* value)
+        : Expr(Kind), name(name), value(value) {}
     
     Token name;
-    std::shared_ptr<Expr> value;
+    Expr* value;
+    
+    // Frame slot of the variable, filled in by the Resolver
+    uint32_t slot = 0;
 };
 
 class CallExpr : public Expr {
 public:
-    CallExpr(std::shared_ptr<Expr> callee, Token paren, std::vector<std::shared_ptr<Expr>> arguments)
-        : callee(std::move(callee)), paren(std::move(paren)), arguments(std::move(arguments)) {}
+    static constexpr ExprKind Kind = ExprKind::Call;
     
-    void* accept(ExprVisitor* visitor) override {
-        return visitor->visitCallExpr(this);
-    }
+    CallExpr(Expr* callee, Token paren, Span<Expr*> arguments)
+        : Expr(Kind), callee(callee), paren(paren), arguments(arguments) {}
     
-    std::shared_ptr<Expr> callee;
+    Expr* callee;
     Token paren;
-    std::vector<std::shared_ptr<Expr>> arguments;
+    Span<Expr*> arguments;
 };
 
 // Statement classes
 class ExpressionStmt : public Stmt {
 public:
-    explicit ExpressionStmt(std::shared_ptr<Expr> expression)
-        : expression(std::move(expression)) {}
+    static constexpr StmtKind Kind = StmtKind::Expression;
     
-    void* accept(StmtVisitor* visitor) override {
-        return visitor->visitExpressionStmt(this);
-    }
+    explicit ExpressionStmt(Expr* expression)
+        : Stmt(Kind), expression(expression) {}
     
-    std::shared_ptr<Expr> expression;
+    Expr* expression;
 };
 
 class VarStmt : public Stmt {
 public:
-    VarStmt(Token name, std::shared_ptr<Expr> initializer)
-        : name(std::move(name)), initializer(std::move(initializer)) {}
+    static constexpr StmtKind Kind = StmtKind::Var;
     
-    void* accept(StmtVisitor* visitor) override {
-        return visitor->visitVarStmt(this);
-    }
+    VarStmt(Token name, Expr* initializer, ValueType declaredType = ValueType::Unknown)
+        : Stmt(Kind), name(name), initializer(initializer), declaredType(declaredType) {}
     
     Token name;
-    std::shared_ptr<Expr> initializer;
+    Expr* initializer;
+    
+    // The type the declaration names (`int x`), or Unknown for `var x`
+    ValueType declaredType;
+    
+    // Frame slot the variable is stored in, filled in by the Resolver
+    uint32_t slot = 0;
+    
+    // Type of the variable: every value stored in it has to fit. Filled in
+    // by TypeInference.
+    ValueType valueType = ValueType::Unknown;
 };
 
 class BlockStmt : public Stmt {
 public:
-    explicit BlockStmt(std::vector<std::shared_ptr<Stmt>> statements)
-        : statements(std::move(statements)) {}
+    static constexpr StmtKind Kind = StmtKind::Block;
     
-    void* accept(StmtVisitor* visitor) override {
-        return visitor->visitBlockStmt(this);
-    }
+    explicit BlockStmt(Span<Stmt*> statements)
+        : Stmt(Kind), statements(statements) {}
     
-    std::vector<std::shared_ptr<Stmt>> statements;
+    Span<Stmt*> statements;
 };
 
 class IfStmt : public Stmt {
 public:
-    IfStmt(std::shared_ptr<Expr> condition, std::shared_ptr<Stmt> thenBranch, std::shared_ptr<Stmt> elseBranch)
-        : condition(std::move(condition)), thenBranch(std::move(thenBranch)), elseBranch(std::move(elseBranch)) {}
+    static constexpr StmtKind Kind = StmtKind::If;
     
-    void* accept(StmtVisitor* visitor) override {
-        return visitor->visitIfStmt(this);
-    }
+    IfStmt(Expr* condition, Stmt* thenBranch, Stmt* elseBranch)
+        : Stmt(Kind), condition(condition), thenBranch(thenBranch), elseBranch(elseBranch) {}
     
-    std::shared_ptr<Expr> condition;
-    std::shared_ptr<Stmt> thenBranch;
-    std::shared_ptr<Stmt> elseBranch;
+    Expr* condition;
+    Stmt* thenBranch;
+    Stmt* elseBranch;
 };
 
 class WhileStmt : public Stmt {
 public:
-    WhileStmt(std::shared_ptr<Expr> condition, std::shared_ptr<Stmt> body)
-        : condition(std::move(condition)), body(std::move(body)) {}
+    static constexpr StmtKind Kind = StmtKind::While;
     
-    void* accept(StmtVisitor* visitor) override {
-        return visitor->visitWhileStmt(this);
-    }
+    WhileStmt(Expr* condition, Stmt* body)
+        : Stmt(Kind), condition(condition), body(body) {}
     
-    std::shared_ptr<Expr> condition;
-    std::shared_ptr<Stmt> body;
+    Expr* condition;
+    Stmt* body;
 };
 
 class FunctionStmt : public Stmt {
 public:
-    FunctionStmt(Token name, std::vector<Token> params, std::vector<std::shared_ptr<Stmt>> body)
-        : name(std::move(name)), params(std::move(params)), body(std::move(body)) {}
+    static constexpr StmtKind Kind = StmtKind::Function;
     
-    void* accept(StmtVisitor* visitor) override {
-        return visitor->visitFunctionStmt(this);
-    }
+    FunctionStmt(Token name, Span<Token> params, Span<ValueType> declaredParamTypes,
+                 ValueType declaredReturnType, ValueType* paramTypes, Span<Stmt*> body)
+        : Stmt(Kind), name(name), params(params), declaredParamTypes(declaredParamTypes),
+          declaredReturnType(declaredReturnType), paramTypes(paramTypes), body(body) {}
     
     Token name;
-    std::vector<Token> params;
-    std::vector<std::shared_ptr<Stmt>> body;
+    Span<Token> params;
+    
+    // Types written in the declaration (`function int f(int n)`), one per
+    // parameter; Unknown where none is given
+    Span<ValueType> declaredParamTypes;
+    ValueType declaredReturnType;
+    
+    // Type of each parameter, and of the result, filled in by
+    // TypeInference. The array is allocated with the node.
+    ValueType* paramTypes;
+    ValueType returnType = ValueType::Unknown;
+    
+    Span<Stmt*> body;
+    
+    // Slots in the function's frame: the parameters take the first ones,
+    // then every variable declared in the body gets its own. Filled in by
+    // the Resolver.
+    uint32_t slotCount = 0;
+
+    // Whether the function only calls pure functions of the program, and
+    // whether it can end up calling itself. Filled in by PurityAnalysis.
+    bool pure = false;
+    bool recursive = false;
 };
 
 class ReturnStmt : public Stmt {
 public:
-    ReturnStmt(Token keyword, std::shared_ptr<Expr> value)
-        : keyword(std::move(keyword)), value(std::move(value)) {}
+    static constexpr StmtKind Kind = StmtKind::Return;
     
-    void* accept(StmtVisitor* visitor) override {
-        return visitor->visitReturnStmt(this);
-    }
+    ReturnStmt(Token keyword, Expr* value)
+        : Stmt(Kind), keyword(keyword), value(value) {}
     
     Token keyword;
-    std::shared_ptr<Expr> value;
+    Expr* value;
+};
+
+// Statically dispatched visitor. A pass derives from
+// ASTVisitor<Pass, ExprResult, StmtResult> and defines a visitXxx method for
+// every node class; visit() switches on the node kind and calls the right
+// one directly, so there are no virtual calls and no casts on the results.
+// Leaving a visitXxx method out is a compile error.
+template <typename Derived, typename ExprResult = void, typename StmtResult = ExprResult>
+class ASTVisitor {
+public:
+    ExprResult visit(Expr* expr) {
+        Derived& pass = static_cast<Derived&>(*this);
+        switch (expr->getKind()) {
+            case ExprKind::Binary:   return pass.visitBinaryExpr(static_cast<BinaryExpr*>(expr));
+            case ExprKind::Logical:  return pass.visitLogicalExpr(static_cast<LogicalExpr*>(expr));
+            case ExprKind::Grouping: return pass.visitGroupingExpr(static_cast<GroupingExpr*>(expr));
+            case ExprKind::Literal:  return pass.visitLiteralExpr(static_cast<LiteralExpr*>(expr));
+            case ExprKind::Unary:    return pass.visitUnaryExpr(static_cast<UnaryExpr*>(expr));
+            case ExprKind::Variable: return pass.visitVariableExpr(static_cast<VariableExpr*>(expr));
+            case ExprKind::Assign:   return pass.visitAssignExpr(static_cast<AssignExpr*>(expr));
+            case ExprKind::Call:     return pass.visitCallExpr(static_cast<CallExpr*>(expr));
+        }
+        return ExprResult();
+    }
+    
+    StmtResult visit(Stmt* stmt) {
+        Derived& pass = static_cast<Derived&>(*this);
+        switch (stmt->getKind()) {
+            case StmtKind::Expression: return pass.visitExpressionStmt(static_cast<ExpressionStmt*>(stmt));
+            case StmtKind::Var:        return pass.visitVarStmt(static_cast<VarStmt*>(stmt));
+            case StmtKind::Block:      return pass.visitBlockStmt(static_cast<BlockStmt*>(stmt));
+            case StmtKind::If:         return pass.visitIfStmt(static_cast<IfStmt*>(stmt));
+            case StmtKind::While:      return pass.visitWhileStmt(static_cast<WhileStmt*>(stmt));
+            case StmtKind::Function:   return pass.visitFunctionStmt(static_cast<FunctionStmt*>(stmt));
+            case StmtKind::Return:     return pass.visitReturnStmt(static_cast<ReturnStmt*>(stmt));
+        }
+        return StmtResult();
+    }
 };
 
+// A chain such as `a + b + c + ...` nests to the left as deep as it is
+// long, so passes walk it in a loop, as the parser builds it, instead of
+// recursing into each left operand. The links of the chain `expr` ends,
+// innermost first; the first one's left operand is the chain's first
+// operand.
+template <typename Node>
+std::vector<Node*> leftChain(Node* expr) {
+    std::vector<Node*> chain;
+    for (Expr* link = expr; link->is<Node>(); link = chain.back()->left) {
+        chain.push_back(static_cast<Node*>(link));
+    }
+    std::reverse(chain.begin(), chain.end());
+    return chain;
+}
+
 } // namespace tribhasha
 
 #endif // TRIBHASHA_AST_H
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef TRIBHASHA_ASTCACHE_H
+#define TRIBHASHA_ASTCACHE_H
+
+#include "AST.h"
+#include "SourceBuffer.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tribhasha {
+
+// Bumped whenever the encoding or the AST changes; caches written by any
+// other version are ignored
+constexpr uint32_t astCacheVersion = 3;
+
+// 64-bit hash of a script's text, used to tell whether a cache is stale
+uint64_t hashSource(std::string_view source);
+
+// Where the cache for a script lives: next to it, with ".astcache" added
+std::string astCachePath(const std::string& scriptPath);
+
+// Write the tokens and top-level statements parsed from `source` to a
+// cache file. The file is written under a temporary name and renamed into
+// place, so a reader never sees half of it. Returns false on I/O errors.
+bool writeASTCache(const std::string& path, std::string_view source,
+                   const std::vector<Token>& tokens, const std::vector<Stmt*>& statements);
+
+// A mapped cache file for one script.
+//
+// Nothing is decoded up front: each top-level statement is rebuilt into an
+// ASTContext when it is asked for, and the token array only if a caller
+// wants it. Identifiers are stored by name and interned again as they are
+// decoded, since symbols are only meaningful within one process. Decoded
+// nodes and tokens refer into `source`, which must outlive them.
+class ASTCacheReader {
+private:
+    std::unique_ptr<SourceBuffer> file;
+    std::string_view source;
+
+    // Sections of the mapped file
+    const char* symbolTable = nullptr;
+    const char* tokenTable = nullptr;
+    const char* valueTable = nullptr;
+    const char* statementTable = nullptr;
+    const char* nodes = nullptr;
+    const char* end = nullptr;
+    uint32_t symbolCount = 0;
+    uint32_t tokenCount = 0;
+    uint32_t statementCount = 0;
+    uint32_t valueCount = 0;
+
+    // Global symbols of the file's identifiers, interned on first use
+    mutable std::vector<Symbol> symbols;
+
+    ASTCacheReader() = default;
+
+    friend class CacheDecoder;
+    bool decodeToken(uint32_t index, Token& token) const;
+
+public:
+    // Map the cache at `path` if it exists, was written by this version for
+    // exactly this `source` and its sections still hash to what was
+    // written; otherwise nullptr
+    static std::unique_ptr<ASTCacheReader> open(const std::string& path, std::string_view source);
+
+    size_t getStatementCount() const { return statementCount; }
+
+    // Rebuild one top-level statement. Returns nullptr if the file turns
+    // out to be corrupt.
+    Stmt* decodeStatement(size_t index, ASTContext& context) const;
+
+    // Rebuild all of them; false (with `statements` unspecified) if the
+    // file is corrupt
+    bool decodeStatements(ASTContext& context, std::vector<Stmt*>& statements) const;
+
+    // The token stream the statements were parsed from
+    bool decodeTokens(std::vector<Token>& tokens) const;
+};
+
+} // namespace tribhasha
+
+#endif // TRIBHASHA_ASTCACHE_H
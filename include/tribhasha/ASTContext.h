@@ -0,0 +1,110 @@
+#ifndef TRIBHASHA_ASTCONTEXT_H
+#define TRIBHASHA_ASTCONTEXT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tribhasha {
+
+// A read-only run of arena-allocated elements, used for the child lists of
+// AST nodes (statements in a block, call arguments, parameters).
+template <typename T>
+class Span {
+private:
+    const T* elements = nullptr;
+    size_t count = 0;
+
+public:
+    Span() = default;
+    Span(const T* elements, size_t count) : elements(elements), count(count) {}
+
+    const T* begin() const { return elements; }
+    const T* end() const { return elements + count; }
+    const T* data() const { return elements; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const T& operator[](size_t index) const { return elements[index]; }
+    const T& front() const { return elements[0]; }
+    const T& back() const { return elements[count - 1]; }
+};
+
+// Owns the AST of one compilation. Nodes are bump-allocated from large
+// slabs and never destroyed one by one: every node is trivially
+// destructible, so releasing the context (or calling reset()) frees the
+// whole tree by dropping its slabs.
+class ASTContext {
+private:
+    static constexpr size_t firstSlabSize = 64 * 1024;
+    static constexpr size_t maxSlabSize = 4 * 1024 * 1024;
+
+    std::vector<std::unique_ptr<char[]>> slabs;
+    char* cursor = nullptr;
+    char* limit = nullptr;
+    size_t nextSlabSize = firstSlabSize;
+    size_t frontSlabSize = 0;
+    size_t bytesAllocated = 0;
+
+    void* allocateSlow(size_t size, size_t alignment);
+
+public:
+    ASTContext() = default;
+    ASTContext(const ASTContext&) = delete;
+    ASTContext& operator=(const ASTContext&) = delete;
+
+    void* allocate(size_t size, size_t alignment) {
+        uintptr_t address = reinterpret_cast<uintptr_t>(cursor);
+        uintptr_t aligned = (address + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+        if (cursor && aligned + size <= reinterpret_cast<uintptr_t>(limit)) {
+            cursor = reinterpret_cast<char*>(aligned + size);
+            bytesAllocated += size;
+            return reinterpret_cast<void*>(aligned);
+        }
+        return allocateSlow(size, alignment);
+    }
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "AST nodes are never destroyed and must not own resources");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Copy a list built up during parsing into the arena
+    template <typename T>
+    Span<T> copy(const std::vector<T>& elements) {
+        static_assert(std::is_trivially_copyable<T>::value, "arena arrays are copied bytewise");
+        if (elements.empty()) return Span<T>();
+        T* storage = static_cast<T*>(allocate(sizeof(T) * elements.size(), alignof(T)));
+        std::uninitialized_copy(elements.begin(), elements.end(), storage);
+        return Span<T>(storage, elements.size());
+    }
+
+    // An array of `count` copies of `value` that passes may fill in later
+    template <typename T>
+    T* array(size_t count, T value) {
+        static_assert(std::is_trivially_copyable<T>::value, "arena arrays are copied bytewise");
+        if (count == 0) return nullptr;
+        T* storage = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+        std::uninitialized_fill_n(storage, count, value);
+        return storage;
+    }
+
+    // Drop every node at once. The first slab is kept for reuse.
+    void reset();
+    
+    // Take ownership of everything allocated in `other`, which is left
+    // empty. Nodes in it stay where they are and now live as long as this
+    // context does.
+    void absorb(ASTContext& other);
+
+    size_t getBytesAllocated() const { return bytesAllocated; }
+};
+
+} // namespace tribhasha
+
+#endif // TRIBHASHA_ASTCONTEXT_H
@@ -2,65 +2,185 @@
 #define TRIBHASHA_CODEGEN_H
 
 #include "AST.h"
+#include "FunctionShape.h"
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <algorithm>
 #include <string>
 #include <memory>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace tribhasha {
 
-class CodeGen : public ExprVisitor, public StmtVisitor {
+// Functions of one program that are generated into different modules,
+// with their signatures. Every CodeGen sharing a table records the
+// functions it defines in it, and declares any of them it calls, so the
+// modules link up when they are added to the same JIT.
+class FunctionTable {
+public:
+    struct Signature {
+        std::vector<ValueType> params;
+        ValueType result;
+        // The name it is linked by: its own, unless that was already
+        // taken in its module (by main, say) and LLVM gave it another
+        std::string linkName;
+    };
+
+private:
+    std::vector<Signature> signatures;
+    std::vector<bool> defined;
+    FunctionShapes shapes;
+
+public:
+    void define(Symbol name, Signature signature) {
+        if (name >= signatures.size()) {
+            size_t size = std::max<size_t>(name + 1, Interner::global().limit());
+            signatures.resize(size);
+            defined.resize(size, false);
+        }
+        signatures[name] = std::move(signature);
+        defined[name] = true;
+    }
+
+    // The signature of `name`, or nullptr if no module defines it
+    const Signature* find(Symbol name) const {
+        return name < defined.size() && defined[name] ? &signatures[name] : nullptr;
+    }
+    
+    // The functions generated in any of the modules, by shape
+    FunctionShapes& getShapes() { return shapes; }
+};
+
+class CodeGen : public ASTVisitor<CodeGen, llvm::Value*, void> {
 private:
-    llvm::LLVMContext context;
+    // The module's context, owned until takeThreadSafeModule() hands it on
+    std::unique_ptr<llvm::LLVMContext> ownedContext;
+    llvm::LLVMContext& context;
     llvm::IRBuilder<> builder;
     std::unique_ptr<llvm::Module> module;
     
-    // Symbol table for variables
-    std::unordered_map<std::string, llvm::AllocaInst*> namedValues;
+    // Variables of the function being generated, indexed by the slots the
+    // Resolver assigned
+    std::vector<llvm::AllocaInst*> frame;
+    
+    // Symbol table for functions, indexed by Symbol
+    std::vector<llvm::Function*> functions;
     
-    // Symbol table for functions
-    std::unordered_map<std::string, llvm::Function*> functions;
+    // Functions defined in other modules, if the program is split up
+    FunctionTable* sharedFunctions;
+    
+    // Functions generated so far by shape, when there is no shared table,
+    // and the aliases of those defined in other modules
+    FunctionShapes ownShapes;
+    std::vector<std::pair<std::string, std::string>> aliases;
     
     // Current function being code generated
     llvm::Function* currentFunction = nullptr;
     
+    // The program's main function, while it is being generated
+    llvm::Function* mainFunction = nullptr;
+    
+    bool memoize = false;
+    bool parallel = false;
+    
+    // Whether calls in the function being generated are forked, and the
+    // results of those joined so far at the expression being generated
+    bool forking = false;
+    std::vector<std::pair<CallExpr*, llvm::Value*>> joinedCalls;
+    
     // Helper methods
-    llvm::AllocaInst* createEntryBlockAlloca(llvm::Function* function, const std::string& varName);
+    llvm::AllocaInst* createEntryBlockAlloca(llvm::Function* function, llvm::StringRef varName, llvm::Type* type);
     llvm::Value* logErrorV(const std::string& str);
-    llvm::Function* getFunction(const std::string& name);
+    llvm::Value* toCondition(llvm::Value* value, const llvm::Twine& name);
+    llvm::Type* typeOf(ValueType type);
+    llvm::Value* convert(llvm::Value* value, llvm::Type* type);
+    llvm::Function* getFunction(Symbol name);
+    llvm::AllocaInst* lookupVariable(uint32_t slot) const;
+    void bindVariable(uint32_t slot, llvm::AllocaInst* alloca);
+    llvm::Value* toBits(llvm::Value* value);
+    llvm::Value* fromBits(llvm::Value* bits, llvm::Type* type);
+    void generateBody(FunctionStmt* stmt, llvm::Function* function, bool fork);
+    void generateMemoWrapper(llvm::Function* wrapper, llvm::Function* body);
+    void generateForkDispatch(llvm::Function* dispatch, llvm::Function* forking, llvm::Function* serial);
+    llvm::Value* generateBinary(BinaryExpr* expr, llvm::Value* left, llvm::Value* right);
+    llvm::Value* generateLogical(LogicalExpr* expr, llvm::Value* left);
+    bool findForkableCalls(BinaryExpr* expr, std::vector<CallExpr*>& calls);
+    llvm::Value* generateForkJoin(BinaryExpr* expr, const std::vector<CallExpr*>& calls);
+    llvm::Function* getTaskFunction(llvm::Function* callee, llvm::StructType* frameType);
     
 public:
-    CodeGen();
+    // `sharedFunctions`, if given, links this module with others
+    explicit CodeGen(FunctionTable* sharedFunctions = nullptr);
     
     // Initialize a fresh module
     void initialize();
     
+    // Give every pure recursive function (see PurityAnalysis) a table of
+    // results it has already computed, looked up by its arguments before
+    // the body runs. Off by default, since the tables take memory.
+    void setMemoize(bool enabled) { memoize = enabled; }
+    
+    // In every pure recursive function, run the calls an arithmetic
+    // operation or comparison combines, such as the two of
+    // `f(n - 1) + f(n - 2)`, as tasks on the TaskPool: all but the last are
+    // forked, and joined before they are combined. Everything a pure
+    // function calls is pure, so the calls are independent. Once the
+    // recursion is deep enough to keep every thread busy, a serial copy of
+    // the function takes over. Memoized functions are not forked, since
+    // their tables are not safe to share between threads.
+    void setParallel(bool enabled) { parallel = enabled; }
+    
+    // A function with the shape (see FunctionShape) of one already
+    // generated is not generated again but made an alias of it. Those whose
+    // function is in another module of the program are listed here instead,
+    // as (name, function) pairs, for the JIT to alias.
+    std::vector<std::pair<std::string, std::string>> takeAliases() { return std::move(aliases); }
+    
+    // Whether the module already has a global called `name`, such as main
+    bool hasGlobal(llvm::StringRef name) const { return module->getNamedValue(name) != nullptr; }
+    
     // Get the generated module
     std::unique_ptr<llvm::Module> getModule();
     
-    // Generate code for a list of statements (the program)
-    void generate(const std::vector<std::shared_ptr<Stmt>>& statements);
+    // The module together with its context, which can then be compiled on
+    // another thread. Nothing more can be generated afterwards.
+    llvm::orc::ThreadSafeModule takeThreadSafeModule();
+    
+    // Generate code for a list of statements (the program). The statements
+    // must have been through the Resolver without errors, and then
+    // TypeInference.
+    void generate(const std::vector<Stmt*>& statements);
+    
+    // The same in pieces, for a program that is parsed as it is compiled:
+    // beginProgram() opens main, generate(stmt) lowers each top-level
+    // statement into it (the statement is not needed afterwards), and
+    // finishProgram() closes it
+    void beginProgram();
+    void generate(Stmt* statement);
+    void finishProgram();
     
     // Visitor implementations for expressions
-    void* visitBinaryExpr(BinaryExpr* expr) override;
-    void* visitGroupingExpr(GroupingExpr* expr) override;
-    void* visitLiteralExpr(LiteralExpr* expr) override;
-    void* visitUnaryExpr(UnaryExpr* expr) override;
-    void* visitVariableExpr(VariableExpr* expr) override;
-    void* visitAssignExpr(AssignExpr* expr) override;
-    void* visitCallExpr(CallExpr* expr) override;
+    llvm::Value* visitBinaryExpr(BinaryExpr* expr);
+    llvm::Value* visitLogicalExpr(LogicalExpr* expr);
+    llvm::Value* visitGroupingExpr(GroupingExpr* expr);
+    llvm::Value* visitLiteralExpr(LiteralExpr* expr);
+    llvm::Value* visitUnaryExpr(UnaryExpr* expr);
+    llvm::Value* visitVariableExpr(VariableExpr* expr);
+    llvm::Value* visitAssignExpr(AssignExpr* expr);
+    llvm::Value* visitCallExpr(CallExpr* expr);
     
     // Visitor implementations for statements
-    void* visitExpressionStmt(ExpressionStmt* stmt) override;
-    void* visitVarStmt(VarStmt* stmt) override;
-    void* visitBlockStmt(BlockStmt* stmt) override;
-    void* visitIfStmt(IfStmt* stmt) override;
-    void* visitWhileStmt(WhileStmt* stmt) override;
-    void* visitFunctionStmt(FunctionStmt* stmt) override;
-    void* visitReturnStmt(ReturnStmt* stmt) override;
+    void visitExpressionStmt(ExpressionStmt* stmt);
+    void visitVarStmt(VarStmt* stmt);
+    void visitBlockStmt(BlockStmt* stmt);
+    void visitIfStmt(IfStmt* stmt);
+    void visitWhileStmt(WhileStmt* stmt);
+    void visitFunctionStmt(FunctionStmt* stmt);
+    void visitReturnStmt(ReturnStmt* stmt);
 };
 
 } // namespace tribhasha
@@ -0,0 +1,135 @@
+#ifndef TRIBHASHA_CONSTANTEVALUATOR_H
+#define TRIBHASHA_CONSTANTEVALUATOR_H
+
+#include "AST.h"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tribhasha {
+
+// A number or boolean known at compile time, held as the static type it
+// has in the generated code. Unknown if nothing is known.
+struct Constant {
+    ValueType type = ValueType::Unknown;
+    int64_t intValue = 0;  // booleans are 0 and 1
+    double floatValue = 0;
+
+    bool known() const { return type != ValueType::Unknown; }
+
+    // The value of a typed literal, if `expr` is a number or boolean one
+    static Constant of(Expr* expr);
+
+    // As a condition in the generated code: non-zero, and NaN is false
+    bool isTrue() const;
+
+    // Converted to `to` the way CodeGen converts values; Unknown if the
+    // conversion has no defined result
+    Constant as(ValueType to) const;
+};
+
+// `left op right`, worked out in `type` (the type of the result for
+// arithmetic, of the operands for comparisons) exactly as the generated
+// code would: integers wrap and float comparisons are unordered. Unknown
+// for anything that would trap at run time.
+Constant applyBinary(TokenType op, ValueType type, const Constant& left, const Constant& right);
+
+// Runs calls to the program's pure functions at compile time, on the typed
+// AST, so calls with constant arguments can be replaced by their results.
+// Only functions PurityAnalysis found pure are run, and only if they are
+// defined once in the statements given.
+//
+// The interpreter follows the static types TypeInference gave the program,
+// so results are the ones the generated code would compute. It gives up
+// (and the call is left for run time) on strings, on anything that would
+// trap, and when a call takes too many steps, nests too deeply or needs
+// too many slots. Results are remembered by function and arguments for as
+// long as the definitions are, so a table built from constants is worked
+// out once.
+//
+// The results can be stored in a file next to the script and read back on
+// the next run of the same text, so calls worked out once are not run
+// again. Functions are stored by name, which the text of the script makes
+// as definite as their shapes would.
+class ConstantEvaluator : public ASTVisitor<ConstantEvaluator, Constant, bool> {
+private:
+    struct Definition {
+        FunctionStmt* function = nullptr;
+        bool ambiguous = false;  // defined more than once
+    };
+
+    // Indexed by Symbol
+    std::vector<Definition> definitions;
+
+    // Results of earlier calls, keyed by function and argument bits
+    std::map<std::vector<int64_t>, Constant> results;
+
+    // Results read by loadResults(), which define() starts from
+    std::map<std::vector<int64_t>, Constant> loaded;
+
+    // The slots of every active call, innermost last
+    std::vector<Constant> slots;
+    size_t frameBase = 0;
+    FunctionStmt* currentFunction = nullptr;
+    size_t depth = 0;
+
+    size_t steps = 0;
+    size_t totalSteps = 0;
+    bool failed = false;
+    bool returning = false;
+    Constant returnValue;
+
+    Definition* definitionOf(Symbol name);
+    bool step();
+    Constant fail();
+    Constant invoke(FunctionStmt* function, const std::vector<Constant>& arguments);
+
+public:
+    // Take the functions defined anywhere in `statements`, dropping those
+    // known before (and every remembered result but the loaded ones)
+    void define(const std::vector<Stmt*>& statements);
+
+    // Read the results stored at `path` if they were stored for exactly
+    // this `source`, for the programs defined from it. Returns false, and
+    // reads nothing, if there are none or the file is damaged.
+    bool loadResults(const std::string& path, std::string_view source);
+
+    // Store the results worked out for the program defined from `source`,
+    // if any are new since loadResults(). The file is written under a
+    // temporary name and renamed into place. Returns false on I/O errors.
+    bool saveResults(const std::string& path, std::string_view source) const;
+
+    bool isPure(Symbol name);
+
+    // The result of calling `name` with `arguments`, or Unknown if the call
+    // cannot be worked out at compile time
+    Constant call(Symbol name, const std::vector<Constant>& arguments);
+
+    Constant visitBinaryExpr(BinaryExpr* expr);
+    Constant visitLogicalExpr(LogicalExpr* expr);
+    Constant visitGroupingExpr(GroupingExpr* expr);
+    Constant visitLiteralExpr(LiteralExpr* expr);
+    Constant visitUnaryExpr(UnaryExpr* expr);
+    Constant visitVariableExpr(VariableExpr* expr);
+    Constant visitAssignExpr(AssignExpr* expr);
+    Constant visitCallExpr(CallExpr* expr);
+
+    // Statements return false once the call returns or has failed
+    bool visitExpressionStmt(ExpressionStmt* stmt);
+    bool visitVarStmt(VarStmt* stmt);
+    bool visitBlockStmt(BlockStmt* stmt);
+    bool visitIfStmt(IfStmt* stmt);
+    bool visitWhileStmt(WhileStmt* stmt);
+    bool visitFunctionStmt(FunctionStmt* stmt);
+    bool visitReturnStmt(ReturnStmt* stmt);
+};
+
+// Where the stored results of a script live: next to it and its AST
+// cache, with ".evalcache" added
+std::string evalCachePath(const std::string& scriptPath);
+
+} // namespace tribhasha
+
+#endif // TRIBHASHA_CONSTANTEVALUATOR_H
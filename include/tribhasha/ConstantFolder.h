@@ -0,0 +1,87 @@
+#ifndef TRIBHASHA_CONSTANTFOLDER_H
+#define TRIBHASHA_CONSTANTFOLDER_H
+
+#include "AST.h"
+#include "ConstantEvaluator.h"
+#include <cstdint>
+#include <vector>
+
+namespace tribhasha {
+
+// Simplifies a resolved and typed program before code is generated for it.
+// Arithmetic, comparisons and logic on constants are worked out, calls
+// with constant arguments to functions PurityAnalysis found pure are run
+// (by a ConstantEvaluator), a `var` that is never assigned to after its
+// declaration is replaced by its value wherever it is read, and `if` and
+// `while` statements whose conditions are known lose the branches that
+// cannot run.
+//
+// Everything is computed in the static types TypeInference gave the
+// program, exactly as the generated code would, and the literals that
+// replace expressions carry the same types. Anything that would fail or
+// trap at run time is left for run time. Only numbers and booleans are
+// folded.
+//
+// Nodes are never changed in place, since the trees handed in may be kept
+// and reused (the REPL's incremental parser does). A node with a changed
+// child is copied into the given context; the rest is shared.
+//
+// An open program (streaming, pipelined) is folded a declaration at a
+// time, so a top-level variable is a constant only until an assignment to
+// it is seen, and its declaration is kept. Only calls to functions of the
+// same declaration can be run, since earlier trees are gone.
+class ConstantFolder : public ASTVisitor<ConstantFolder, Expr*, Stmt*> {
+private:
+    // Slots of one function, or of main
+    struct Frame {
+        std::vector<bool> assigned;
+        std::vector<Constant> constants;
+    };
+
+    ASTContext* context = nullptr;
+    ConstantEvaluator evaluator;
+    Frame mainFrame;
+    Frame* frame = &mainFrame;
+    bool open;
+
+    void findAssignments(Span<Stmt*> statements);
+    Expr* literal(const Constant& value);
+    
+    // `expr` with its operands folded to `left` and `right`
+    Expr* foldBinary(BinaryExpr* expr, Expr* left, Expr* right);
+    Expr* foldLogical(LogicalExpr* expr, Expr* left, Expr* right);
+    Stmt* orEmpty(Stmt* statement);
+    Span<Stmt*> foldAll(Span<Stmt*> statements, bool& changed);
+
+public:
+    explicit ConstantFolder(bool open = false);
+
+    // Fold top-level statements, in order, replacing the list; new nodes
+    // are allocated in `context`
+    void fold(std::vector<Stmt*>& statements, ASTContext& context);
+
+    // Runs the calls; its results can be stored and loaded
+    ConstantEvaluator& getEvaluator() { return evaluator; }
+
+    Expr* visitBinaryExpr(BinaryExpr* expr);
+    Expr* visitLogicalExpr(LogicalExpr* expr);
+    Expr* visitGroupingExpr(GroupingExpr* expr);
+    Expr* visitLiteralExpr(LiteralExpr* expr);
+    Expr* visitUnaryExpr(UnaryExpr* expr);
+    Expr* visitVariableExpr(VariableExpr* expr);
+    Expr* visitAssignExpr(AssignExpr* expr);
+    Expr* visitCallExpr(CallExpr* expr);
+
+    // A statement folds to nullptr when nothing of it is left
+    Stmt* visitExpressionStmt(ExpressionStmt* stmt);
+    Stmt* visitVarStmt(VarStmt* stmt);
+    Stmt* visitBlockStmt(BlockStmt* stmt);
+    Stmt* visitIfStmt(IfStmt* stmt);
+    Stmt* visitWhileStmt(WhileStmt* stmt);
+    Stmt* visitFunctionStmt(FunctionStmt* stmt);
+    Stmt* visitReturnStmt(ReturnStmt* stmt);
+};
+
+} // namespace tribhasha
+
+#endif // TRIBHASHA_CONSTANTFOLDER_H
@@ -0,0 +1,53 @@
+#ifndef TRIBHASHA_DECLARATIONSTREAM_H
+#define TRIBHASHA_DECLARATIONSTREAM_H
+
+#include "Lexer.h"
+#include "Parser.h"
+#include <functional>
+#include <string_view>
+#include <vector>
+
+namespace tribhasha {
+
+// Parses a script one top-level declaration at a time, pulling tokens from
+// the lexer (or another stage) as it goes. Only the tokens of the declaration being parsed are
+// held, so memory stays bounded by the largest declaration rather than the
+// script.
+//
+// A declaration ends at the same boundaries the parallel parser splits on:
+// a ';' or a '}' closing to bracket depth 0 that is not followed by 'else'.
+// In a well-formed script the statements are exactly what parse() gives.
+// Around a syntax error the diagnostics may differ from a whole-file parse,
+// since recovery cannot look past the declaration.
+class DeclarationStream {
+private:
+    std::function<Token()> nextToken;
+    std::string_view source;
+
+    // Tokens of the declaration being collected. The last one is always the
+    // first token after it, which the parser treats as its end.
+    std::vector<Token> window;
+
+    Diagnostics diagnostics;
+
+public:
+    // `lexer` scans `source`; both must outlive the stream
+    DeclarationStream(Lexer& lexer, std::string_view source);
+    
+    // Tokens of `source` come from `nextToken`, which must keep returning
+    // the end-of-file token once it has
+    DeclarationStream(std::function<Token()> nextToken, std::string_view source);
+
+    // Parse the next declaration into `context` and append its statements
+    // (none if it had an error) to `statements`. Returns false, without
+    // parsing anything, at the end of the script.
+    bool next(ASTContext& context, std::vector<Stmt*>& statements);
+
+    // Everything reported so far
+    const Diagnostics& getDiagnostics() const { return diagnostics; }
+    bool hadError() const { return diagnostics.hasErrors(); }
+};
+
+} // namespace tribhasha
+
+#endif // TRIBHASHA_DECLARATIONSTREAM_H
@@ -0,0 +1,49 @@
+#ifndef TRIBHASHA_DIAGNOSTICS_H
+#define TRIBHASHA_DIAGNOSTICS_H
+
+#include "SourceManager.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace tribhasha {
+
+// One problem found in a script, located by the byte range of the token it
+// was reported at. An empty range at the end of the text means the problem
+// is at the end of the script.
+struct Diagnostic {
+    uint32_t offset;
+    uint32_t length;
+    std::string message;
+};
+
+// Diagnostics collected while compiling a script. Nothing is printed while
+// they are being recorded; the caller decides when (and whether) to format
+// them, which it does in one write.
+class Diagnostics {
+private:
+    std::vector<Diagnostic> entries;
+
+public:
+    void error(uint32_t offset, uint32_t length, std::string message) {
+        entries.push_back({offset, length, std::move(message)});
+    }
+
+    // Take over the diagnostics of another buffer, after this one's
+    void append(Diagnostics&& other);
+
+    bool hasErrors() const { return !entries.empty(); }
+    size_t size() const { return entries.size(); }
+    const std::vector<Diagnostic>& all() const { return entries; }
+    void clear() { entries.clear(); }
+
+    // "[line L, column C] Error at 'x': message", one per line
+    std::string format(const SourceFile& file) const;
+    void print(std::ostream& out, const SourceFile& file) const;
+};
+
+} // namespace tribhasha
+
+#endif // TRIBHASHA_DIAGNOSTICS_H
@@ -0,0 +1,53 @@
+#ifndef TRIBHASHA_FUNCTIONSHAPE_H
+#define TRIBHASHA_FUNCTIONSHAPE_H
+
+#include "AST.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace tribhasha {
+
+// The structure of a resolved, typed function with its names taken out,
+// so two functions that differ only in what they and their variables are
+// called, or in the language of their keywords, have the same shape:
+// `factorial`, `फैक्टोरियल` and `ফেক্টৰিয়েল` written alike are one function.
+//
+// Variables are already numbered by their slots, and keyword kinds are the
+// same in every language; a call of the function itself is recorded as
+// such rather than by name. Calls of other functions keep their names, and
+// the inferred types are part of the shape, since the code depends on
+// them. Equal shapes generate the same code.
+class FunctionShape {
+private:
+    std::vector<uint64_t> words;
+    uint64_t hashValue = 0;
+
+public:
+    explicit FunctionShape(FunctionStmt* function);
+
+    uint64_t hash() const { return hashValue; }
+
+    bool operator==(const FunctionShape& other) const {
+        return hashValue == other.hashValue && words == other.words;
+    }
+};
+
+// Functions generated so far, by shape, each under the name of the first
+// one generated with it
+class FunctionShapes {
+private:
+    std::unordered_map<uint64_t, std::vector<std::pair<FunctionShape, std::string>>> known;
+
+public:
+    // The function with the same shape, or nullptr if there is none
+    const std::string* find(const FunctionShape& shape) const;
+
+    void add(FunctionShape shape, std::string name);
+};
+
+} // namespace tribhasha
+
+#endif // TRIBHASHA_FUNCTIONSHAPE_H
@@ -0,0 +1,81 @@
+#ifndef TRIBHASHA_INCREMENTALPARSER_H
+#define TRIBHASHA_INCREMENTALPARSER_H
+
+#include "Parser.h"
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace tribhasha {
+
+// What an update changed in the list of top-level statements
+struct ParseUpdate {
+    // Indices into the new getStatements() of the statements that were
+    // parsed again; every other statement is the node it was before
+    std::vector<size_t> changed;
+
+    // Indices into the previous getStatements() of the statements that are
+    // no longer used
+    std::vector<size_t> removed;
+};
+
+// Keeps the AST of one script up to date as the script is edited.
+//
+// Every top-level declaration is recorded with a hash of its text. On an
+// update, a declaration is tried where it was before and where it would be
+// if everything after an edit moved by the change in size (which is the
+// case for a single edit), and then right after the last one reused. If the
+// text there hashes the same and lexed to the same tokens, the old subtree
+// is kept; anything else is parsed again. The statements and diagnostics
+// are those a full parse gives, except that the tokens of each statement
+// count their offsets from its Stmt::base, and its literals hold copies of
+// their text. Keeping a declaration that moved only changes its base, so
+// an update costs about as much as what was parsed again.
+//
+// Replaced subtrees stay in the arena until they make up half of it; the
+// next update then parses everything into a fresh one.
+class IncrementalParser {
+private:
+    struct Declaration {
+        uint32_t begin;       // offset of its first token
+        uint32_t length;      // bytes up to the end of its last token
+        uint32_t tokenCount;
+        uint64_t hash;        // of those bytes
+        Stmt* statement;      // nullptr if it was dropped after an error
+        size_t bytes;         // arena bytes of its nodes
+        bool clean;           // parsed without diagnostics
+    };
+
+    std::unique_ptr<ASTContext> context;
+    std::vector<Declaration> declarations;
+    std::vector<Stmt*> statements;
+    Diagnostics diagnostics;
+
+    // Size of the source of the last update
+    size_t sourceSize = 0;
+
+    // Arena bytes of subtrees that were replaced
+    size_t garbageBytes = 0;
+
+    // A declaration not yet `reused` that can be reused at token `first`,
+    // or nullptr
+    const Declaration* findReusable(const std::vector<Token>& tokens, std::string_view source,
+                                    int first, size_t next, const std::vector<bool>& reused) const;
+
+public:
+    IncrementalParser();
+
+    // Parse `source`, the next version of the script, whose tokens are
+    // `tokens`. The first update parses everything. The statements do not
+    // refer to `source` afterwards.
+    ParseUpdate update(std::string_view source, const std::vector<Token>& tokens);
+
+    const std::vector<Stmt*>& getStatements() const { return statements; }
+    const Diagnostics& getDiagnostics() const { return diagnostics; }
+    bool hadError() const { return diagnostics.hasErrors(); }
+};
+
+} // namespace tribhasha
+
+#endif // TRIBHASHA_INCREMENTALPARSER_H
@@ -0,0 +1,73 @@
+#ifndef TRIBHASHA_INTERNER_H
+#define TRIBHASHA_INTERNER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace tribhasha {
+
+// Dense ID of an interned identifier. IDs start at 1 and are never reused,
+// so they can index flat tables; 0 means "no symbol".
+using Symbol = uint32_t;
+constexpr Symbol noSymbol = 0;
+
+// Process-wide identifier table. The lexer interns every identifier once,
+// whatever script it is written in, and everything after it compares and
+// indexes by Symbol instead of hashing strings again.
+//
+// Interning is thread safe (the parallel lexer calls it from several
+// threads); the table is split into shards so those threads rarely contend.
+// Names live as long as the process, so views returned by name() never
+// dangle.
+class Interner {
+public:
+    static Interner& global();
+
+    Symbol intern(std::string_view name);
+
+    // The spelling of a symbol; empty for noSymbol
+    std::string_view name(Symbol symbol) const;
+
+    // One past the largest symbol handed out so far, for sizing tables
+    Symbol limit() const { return nextSymbol.load(std::memory_order_acquire); }
+
+private:
+    Interner() = default;
+    Interner(const Interner&) = delete;
+    Interner& operator=(const Interner&) = delete;
+
+    static constexpr size_t shardCount = 16;
+    static constexpr size_t blockSize = 64 * 1024;
+
+    // Each shard owns the characters of the names that hash to it
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string_view, Symbol> symbols;
+        std::vector<std::unique_ptr<char[]>> blocks;
+        size_t blockUsed = blockSize;
+
+        std::string_view store(std::string_view name);
+    };
+
+    // Symbol -> name, in fixed-size segments so that readers never see a
+    // reallocation. A segment pointer is published before any symbol in it.
+    static constexpr size_t segmentBits = 12;
+    static constexpr size_t segmentSize = size_t(1) << segmentBits;
+    static constexpr size_t maxSegments = 4096;
+
+    Shard shards[shardCount];
+    std::atomic<Symbol> nextSymbol{1};
+    std::atomic<std::string_view*> segments[maxSegments] = {};
+    std::mutex segmentMutex;
+
+    std::string_view* segmentFor(Symbol symbol);
+};
+
+} // namespace tribhasha
+
+#endif // TRIBHASHA_INTERNER_H
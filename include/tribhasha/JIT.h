@@ -24,6 +24,21 @@ public:
     // Add a module to the JIT
     llvm::Error addModule(std::unique_ptr<llvm::Module> module);
     
+    // Add a module that comes with its own context
+    llvm::Error addModule(llvm::orc::ThreadSafeModule module);
+    
+    // Make `alias` another name for the function `target`, which need not
+    // have been added yet
+    llvm::Error addAlias(const std::string& alias, const std::string& target);
+    
+    // What was added under one key can be removed together, so its
+    // symbols can be defined again
+    using ModuleKey = llvm::orc::ResourceTrackerSP;
+    ModuleKey createModuleKey();
+    llvm::Error addModule(llvm::orc::ThreadSafeModule module, const ModuleKey& key);
+    llvm::Error addAlias(const std::string& alias, const std::string& target, const ModuleKey& key);
+    llvm::Error removeModule(const ModuleKey& key);
+    
     // Look up a symbol in the JIT
     llvm::Expected<llvm::JITEvaluatedSymbol> lookup(const std::string& name);
     
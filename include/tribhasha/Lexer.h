@@ -2,18 +2,58 @@
 #define TRIBHASHA_LEXER_H
 
 #include "Token.h"
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace tribhasha {
 
+class TokenBuffer;
+
+// Inputs smaller than two chunks of this size are not worth splitting
+constexpr size_t defaultParallelChunkSize = 1 << 20;
+
+// An edit to a source buffer: `removed` bytes at `offset` were replaced by
+// `inserted`
+struct SourceEdit {
+    size_t offset;
+    size_t removed;
+    std::string_view inserted;
+};
+
+// Where relex() changed a token array: tokens [begin, oldEnd) of the old
+// array were replaced by tokens [begin, newEnd) of the new one
+struct RelexRange {
+    size_t begin;
+    size_t oldEnd;
+    size_t newEnd;
+};
+
+// The lexer does not copy its input. Tokens record offsets into `source`,
+// and lines are not tracked while scanning: positions are worked out from
+// the offsets only when an error is reported.
 class Lexer {
 private:
-    std::string source;
+    std::string_view source;
     std::vector<Token> tokens;
     int start = 0;
     int current = 0;
-    int line = 1;
+    
+    // Line table for error positions, built on the first error
+    std::unique_ptr<SourceFile> file;
+    
+    // While lexing a chunk speculatively, errors are recorded instead of
+    // printed, since the chunk's start state may turn out to be wrong
+    struct DeferredError {
+        int offset;
+        std::string message;
+    };
+    bool deferErrors = false;
+    std::vector<DeferredError> deferredErrors;
+    
+    // Errors reported so far
+    size_t errorCount = 0;
     
     // Helper methods
     bool isAtEnd() const;
@@ -22,30 +62,58 @@ private:
     char peek() const;
     char peekNext() const;
     
+    // Raw pointers for the vectorized scanners in SimdScan.h
+    const char* cursor() const;
+    const char* end() const;
+    int positionOf(const char* p) const;
+    
     // Lexing methods
     void scanToken();
-    void addToken(TokenType type);
-    void addToken(TokenType type, const std::string& literal);
+    void scanRange(int begin, int limit);
+    Token& addToken(TokenType type);
     
     // Specific token scanners
     void scanString();
     void scanNumber();
     void scanIdentifier();
+    void scanUnicode();
     
-    // Helper for Unicode support
+    // ASCII character classes (non-ASCII goes through Unicode.h)
     bool isAlpha(char c) const;
-    bool isUnicodeAlpha(const std::string& s, size_t pos) const;
+    bool isWhitespace(char c) const;
     bool isDigit(char c) const;
-    bool isAlphaNumeric(char c) const;
-    bool isUnicodeAlphaNumeric(const std::string& s, size_t pos) const;
     
-    // Error handling
-    void error(int line, const std::string& message);
+    // Error handling. Errors are reported at the start of the lexeme.
+    void error(const std::string& message);
+    void report(int offset, const std::string& message);
     
 public:
-    explicit Lexer(std::string source);
+    explicit Lexer(std::string_view source);
     
     std::vector<Token> scanTokens();
+    
+    // Scan just the next token, for callers that consume tokens as they go
+    // instead of keeping the whole array. Once the source is exhausted this
+    // returns the end-of-file token, every time it is called.
+    Token nextToken();
+    
+    // Lex on `threadCount` threads (0 = one per core) by splitting the source
+    // at line boundaries. Chunks that turn out to start inside a string
+    // literal are re-lexed from the correct position, so the result is
+    // identical to scanTokens(), diagnostics included.
+    std::vector<Token> scanTokensParallel(unsigned threadCount,
+                                          size_t minChunkSize = defaultParallelChunkSize);
+    
+    bool hadError() const { return errorCount > 0; }
+    
+    // Update `tokens`, the result of lexing some source, for `newSource`,
+    // which is that source with `edit` applied. Only the tokens around the
+    // edit are lexed again, and the ones after it are moved as a whole (see
+    // TokenBuffer), so the cost follows the size of the edit rather than of
+    // the source. Diagnostics are only reported if `reportErrors` is set,
+    // and only for the text lexed again.
+    static RelexRange relex(TokenBuffer& tokens, std::string_view newSource,
+                            const SourceEdit& edit, bool reportErrors = false);
 };
 
 } // namespace tribhasha
@@ -3,72 +3,105 @@
 
 #include "Token.h"
 #include "AST.h"
+#include "Diagnostics.h"
 #include <vector>
-#include <memory>
-#include <stdexcept>
 
 namespace tribhasha {
 
-class ParseError : public std::runtime_error {
-public:
-    explicit ParseError(const std::string& message) : std::runtime_error(message) {}
-};
+// Token arrays shorter than two chunks of this many tokens are parsed on
+// one thread
+constexpr size_t defaultParallelParseChunk = 1 << 16;
 
+// Parses a token array into statements. Syntax errors never unwind: they
+// are recorded in `diagnostics`, the parser enters panic mode (which
+// silences the cascade of errors that usually follows the first one), and
+// parse() skips to the next statement boundary and drops the declaration
+// that failed.
 class Parser {
 private:
-    std::vector<Token> tokens;
+    const std::vector<Token>& tokens;
+    std::string_view source;
+    ASTContext& context;
     int current = 0;
     
+    // Index of the token treated as the end of input: the end-of-file token,
+    // or the first token after the range a parallel worker was given
+    int limit;
+    
+    Diagnostics diagnostics;
+    bool panicMode = false;
+    
+    // Work stacks of the expression parser, kept between expressions so
+    // they are only allocated once
+    struct PendingOperator {
+        enum Kind : uint8_t { PREFIX, INFIX, GROUP, CALL };
+        Kind kind;
+        uint8_t power;
+        uint32_t token;        // the operator, or the opening '('
+        uint32_t operandBase;  // CALL: where the arguments start
+    };
+    std::vector<Expr*> operands;
+    std::vector<PendingOperator> operators;
+    
     // Helper methods
     bool isAtEnd() const;
-    Token peek() const;
-    Token previous() const;
-    Token advance();
+    const Token& peek() const;
+    const Token& previous() const;
+    const Token& advance();
     bool check(TokenType type) const;
     bool match(TokenType type);
-    bool matchAny(const std::vector<TokenType>& types);
-    Token consume(TokenType type, const std::string& message);
-    ParseError error(Token token, const std::string& message);
+    const Token& consume(TokenType type, const char* message);
+    void error(const Token& token, std::string message);
+    void report(const Token& token, std::string message);
     void synchronize();
     
-    // Grammar rules
-    std::shared_ptr<Expr> expression();
-    std::shared_ptr<Expr> assignment();
-    std::shared_ptr<Expr> equality();
-    std::shared_ptr<Expr> comparison();
-    std::shared_ptr<Expr> term();
-    std::shared_ptr<Expr> factor();
-    std::shared_ptr<Expr> unary();
-    std::shared_ptr<Expr> call();
-    std::shared_ptr<Expr> primary();
-    std::shared_ptr<Expr> finishCall(std::shared_ptr<Expr> callee);
+    // Expressions are parsed by operator precedence without recursion
+    Expr* expression();
+    Expr* primary();
+    void reduce(uint8_t power, bool rightAssociative);
+    void reduceOperator();
+    bool insideCall() const;
     
-    std::shared_ptr<Stmt> statement();
-    std::shared_ptr<Stmt> declaration();
-    std::shared_ptr<Stmt> varDeclaration();
-    std::shared_ptr<Stmt> expressionStatement();
-    std::shared_ptr<Stmt> blockStatement();
-    std::shared_ptr<Stmt> ifStatement();
-    std::shared_ptr<Stmt> whileStatement();
-    std::shared_ptr<Stmt> forStatement();
-    std::shared_ptr<Stmt> functionDeclaration(const std::string& kind);
-    std::shared_ptr<Stmt> returnStatement();
+    Stmt* statement();
+    Stmt* declaration();
+    Stmt* varDeclaration(ValueType declaredType);
+    ValueType typeAnnotation();
+    Stmt* expressionStatement();
+    Stmt* blockStatement();
+    Span<Stmt*> blockBody();
+    Stmt* ifStatement();
+    Stmt* whileStatement();
+    Stmt* forStatement();
+    Stmt* functionDeclaration();
+    Stmt* returnStatement();
     
-    // Language-specific helpers
-    TokenType getVarTokenType() const;
-    TokenType getFunctionTokenType() const;
-    TokenType getIfTokenType() const;
-    TokenType getElseTokenType() const;
-    TokenType getWhileTokenType() const;
-    TokenType getForTokenType() const;
-    TokenType getReturnTokenType() const;
-    TokenType getTrueTokenType() const;
-    TokenType getFalseTokenType() const;
+    // Parse one top-level declaration into `statements`, recovering from
+    // any error in it
+    void topLevelDeclaration(std::vector<Stmt*>& statements);
+    
+    // Reparses one top-level declaration at a time
+    friend class IncrementalParser;
+    
+    // A parser for the tokens [begin, end) only
+    Parser(const std::vector<Token>& tokens, std::string_view source, ASTContext& context,
+           int begin, int end);
     
 public:
-    explicit Parser(std::vector<Token> tokens);
+    // `tokens` were lexed from `source`; both must outlive the parser. The
+    // nodes are allocated in `context`.
+    Parser(const std::vector<Token>& tokens, std::string_view source, ASTContext& context);
+    
+    std::vector<Stmt*> parse();
+    
+    // Same result and diagnostics as parse(), with independent top-level
+    // declarations parsed on up to `threadCount` threads (0 means one per
+    // core)
+    std::vector<Stmt*> parseParallel(unsigned threadCount,
+                                     size_t minChunkSize = defaultParallelParseChunk);
     
-    std::vector<std::shared_ptr<Stmt>> parse();
+    // Everything reported by parse()
+    const Diagnostics& getDiagnostics() const { return diagnostics; }
+    bool hadError() const { return diagnostics.hasErrors(); }
 };
 
 } // namespace tribhasha
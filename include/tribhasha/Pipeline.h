@@ -0,0 +1,49 @@
+#ifndef TRIBHASHA_PIPELINE_H
+#define TRIBHASHA_PIPELINE_H
+
+#include "Diagnostics.h"
+#include "JIT.h"
+#include <string>
+#include <string_view>
+
+namespace tribhasha {
+
+// Compiles a script with every stage on its own thread, connected by
+// bounded SPSCQueues:
+//
+//   lexer     token batches
+//   parser    batches of resolved top-level declarations, each batch in its
+//             own arena
+//   codegen   one module per top-level function, plus the program's main
+//   JIT       adds each module and compiles it right away
+//
+// Work flows through as soon as it is ready, so compiling a large script
+// takes about as long as its slowest stage rather than the sum of them,
+// and memory is bounded by what the queues hold. A declaration's AST is
+// freed once it has been lowered.
+class CompilePipeline {
+private:
+    std::string_view source;
+    TribhashaJIT& jit;
+    bool memoize;
+    bool parallel;
+    Diagnostics diagnostics;
+    std::string jitError;
+
+public:
+    // `source` and `jit` must outlive the pipeline. `memoize` and
+    // `parallel` are passed on to CodeGen (see setMemoize, setParallel).
+    CompilePipeline(std::string_view source, TribhashaJIT& jit, bool memoize = false, bool parallel = false);
+
+    // Run all the stages to completion. On success main is in the JIT,
+    // ready to execute. Returns false if the script has syntax, name or
+    // type errors (see getDiagnostics()) or a module could not be compiled (getJITError()).
+    bool run();
+
+    const Diagnostics& getDiagnostics() const { return diagnostics; }
+    const std::string& getJITError() const { return jitError; }
+};
+
+} // namespace tribhasha
+
+#endif // TRIBHASHA_PIPELINE_H
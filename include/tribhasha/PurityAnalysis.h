@@ -0,0 +1,71 @@
+#ifndef TRIBHASHA_PURITYANALYSIS_H
+#define TRIBHASHA_PURITYANALYSIS_H
+
+#include "AST.h"
+#include <cstdint>
+#include <vector>
+
+namespace tribhasha {
+
+// Works out which functions of a resolved program are pure and which are
+// recursive, and marks their FunctionStmts.
+//
+// A function is pure if everything it calls is a pure function of the
+// program. Output only happens through calls to print and printf, which
+// are never pure, and a function cannot see any other function's
+// variables, so a pure function's result depends on its arguments alone
+// and calling it has no effect that can be observed. A name defined as a
+// function more than once is pure only if every definition is.
+//
+// A function is recursive if it can end up calling itself, directly or
+// through other functions.
+//
+// An open program (streaming, pipelined) is analyzed a declaration at a
+// time. What is known about earlier functions is kept, so a later one may
+// call them; an earlier function can never call a later one.
+class PurityAnalysis : public ASTVisitor<PurityAnalysis> {
+private:
+    struct Function {
+        FunctionStmt* stmt;
+        std::vector<Symbol> callees;
+    };
+
+    enum class Purity : uint8_t { Undefined, Pure, Impure };
+
+    // Purity of every function analyzed so far, indexed by Symbol
+    std::vector<Purity> purity;
+
+    // Functions of the statements being analyzed
+    std::vector<Function> functions;
+    size_t current;
+
+    Purity& purityOf(Symbol name);
+
+public:
+    PurityAnalysis();
+
+    void analyze(const std::vector<Stmt*>& statements);
+
+    bool isPure(Symbol name) const;
+
+    void visitBinaryExpr(BinaryExpr* expr);
+    void visitLogicalExpr(LogicalExpr* expr);
+    void visitGroupingExpr(GroupingExpr* expr);
+    void visitLiteralExpr(LiteralExpr* expr);
+    void visitUnaryExpr(UnaryExpr* expr);
+    void visitVariableExpr(VariableExpr* expr);
+    void visitAssignExpr(AssignExpr* expr);
+    void visitCallExpr(CallExpr* expr);
+
+    void visitExpressionStmt(ExpressionStmt* stmt);
+    void visitVarStmt(VarStmt* stmt);
+    void visitBlockStmt(BlockStmt* stmt);
+    void visitIfStmt(IfStmt* stmt);
+    void visitWhileStmt(WhileStmt* stmt);
+    void visitFunctionStmt(FunctionStmt* stmt);
+    void visitReturnStmt(ReturnStmt* stmt);
+};
+
+} // namespace tribhasha
+
+#endif // TRIBHASHA_PURITYANALYSIS_H
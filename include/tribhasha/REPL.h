@@ -3,10 +3,21 @@
 
 #include "Lexer.h"
 #include "Parser.h"
+#include "IncrementalParser.h"
+#include "Resolver.h"
+#include "ConstantFolder.h"
+#include "PurityAnalysis.h"
+#include "TypeInference.h"
 #include "CodeGen.h"
+#include "FunctionShape.h"
 #include "JIT.h"
+#include "SourceManager.h"
+#include "TokenBuffer.h"
 #include <string>
+#include <string_view>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace tribhasha {
@@ -19,10 +30,47 @@ private:
     // Keep track of history
     std::vector<std::string> history;
     
+    // Files loaded during the session
+    SourceManager sources;
+    
+    // A function of a loaded script, compiled into a module of its own
+    struct CompiledFunction {
+        FunctionShape shape;
+        FunctionTable::Signature signature;
+        std::vector<std::string> uses;  // what its module links to
+        TribhashaJIT::ModuleKey key;
+    };
+    
+    // A file loaded with 'load', kept up to date when it is loaded again:
+    // only the text around the edit is lexed again (Lexer::relex), only
+    // the declarations it touched are parsed again, and a function keeps
+    // its compiled module while it would be generated the same way. The
+    // analyses still run over the whole script, since types and constants
+    // flow between declarations, and so does the code outside functions.
+    // Each script has a JIT of its own, where its main is defined.
+    struct LoadedScript {
+        std::string text;  // as last loaded
+        TokenBuffer tokens;
+        IncrementalParser parser;
+        std::unique_ptr<TribhashaJIT> jit;
+        std::unordered_map<std::string, CompiledFunction> functions;  // by name
+        TribhashaJIT::ModuleKey program;  // main; null until the script compiles
+    };
+    std::unordered_map<std::string, std::unique_ptr<LoadedScript>> loadedScripts;
+    
     // Helper methods
     std::string readLine(const std::string& prompt);
-    void printTokens(const std::vector<Token>& tokens);
-    void printAST(const std::vector<std::shared_ptr<Stmt>>& statements);
+    void printTokens(const SourceFile& file, const std::vector<Token>& tokens);
+    void printAST(const std::vector<Stmt*>& statements);
+    
+    // Generate code for `statements` and run it
+    void runStatements(const std::vector<Stmt*>& statements);
+    
+    // Generate code for the statements of `script`, keeping the modules of
+    // functions that are not `changed` and would come out the same, and run
+    // it. False on JIT errors, which are printed.
+    bool runScript(LoadedScript& script, const std::vector<Stmt*>& statements,
+                   const std::unordered_set<Symbol>& changed);
     
     // ANSI colors for syntax highlighting
     static const std::string RESET;
@@ -34,8 +82,10 @@ private:
     static const std::string CYAN;
     static const std::string WHITE;
     
-    // Syntax highlighting helpers
-    std::string highlightSyntax(const std::string& source);
+    // Syntax highlighting helpers. The tokens are the ones being executed:
+    // a line's from the lexer that runs it, a loaded file's from the
+    // script's TokenBuffer after Lexer::relex; nothing is lexed twice.
+    std::string highlightSyntax(std::string_view source, const std::vector<Token>& tokens);
     std::string getColorForToken(const Token& token);
     
 public:
@@ -45,7 +95,7 @@ public:
     void run();
     
     // Execute a single line of code
-    void executeLine(const std::string& line);
+    void executeLine(std::string_view line);
     
     // Execute a file
     void executeFile(const std::string& filename);
@@ -0,0 +1,85 @@
+#ifndef TRIBHASHA_RESOLVER_H
+#define TRIBHASHA_RESOLVER_H
+
+#include "AST.h"
+#include "Diagnostics.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace tribhasha {
+
+// Binds every variable to a slot in the frame of the function it lives in,
+// before code is generated. Each declaration gets a slot of its own, and
+// every VariableExpr and AssignExpr records the slot of the declaration it
+// refers to, so CodeGen indexes a flat array instead of looking names up.
+//
+// A function body cannot see the variables of the code around it, so a
+// slot alone (with no scope depth) identifies a variable. References to
+// variables that are not in scope are reported as diagnostics. The callee
+// of a call names a function, not a variable, and is left alone.
+//
+// Top-level statements share one frame, main's, which keeps growing across
+// calls to resolve() so a script can be resolved a declaration at a time.
+class Resolver : public ASTVisitor<Resolver> {
+private:
+    // The innermost binding of a symbol, valid only inside the function it
+    // was made in
+    struct Binding {
+        uint32_t function;
+        uint32_t slot;
+    };
+    static constexpr uint32_t unbound = ~0u;
+
+    std::vector<Binding> bindings;
+
+    // Bindings replaced by a declaration, restored when its scope ends
+    std::vector<std::pair<Symbol, Binding>> shadowed;
+
+    // The function being resolved (0 for top-level code), and its next
+    // free slot
+    uint32_t currentFunction = 0;
+    uint32_t functionCount = 0;
+    uint32_t nextSlot = 0;
+    uint32_t mainSlots = 0;
+
+    // Base of the top-level statement being resolved (see Stmt::base)
+    uint32_t base = 0;
+    Diagnostics diagnostics;
+
+    uint32_t declare(Symbol name);
+    uint32_t lookup(const Token& name);
+    void endScope(size_t mark);
+
+public:
+    // Resolve top-level statements, in order
+    void resolve(const std::vector<Stmt*>& statements);
+    void resolve(Stmt* statement);
+
+    // Slots used by top-level code so far
+    uint32_t getMainSlotCount() const { return mainSlots; }
+
+    const Diagnostics& getDiagnostics() const { return diagnostics; }
+    bool hadError() const { return diagnostics.hasErrors(); }
+
+    void visitBinaryExpr(BinaryExpr* expr);
+    void visitLogicalExpr(LogicalExpr* expr);
+    void visitGroupingExpr(GroupingExpr* expr);
+    void visitLiteralExpr(LiteralExpr* expr);
+    void visitUnaryExpr(UnaryExpr* expr);
+    void visitVariableExpr(VariableExpr* expr);
+    void visitAssignExpr(AssignExpr* expr);
+    void visitCallExpr(CallExpr* expr);
+
+    void visitExpressionStmt(ExpressionStmt* stmt);
+    void visitVarStmt(VarStmt* stmt);
+    void visitBlockStmt(BlockStmt* stmt);
+    void visitIfStmt(IfStmt* stmt);
+    void visitWhileStmt(WhileStmt* stmt);
+    void visitFunctionStmt(FunctionStmt* stmt);
+    void visitReturnStmt(ReturnStmt* stmt);
+};
+
+} // namespace tribhasha
+
+#endif // TRIBHASHA_RESOLVER_H
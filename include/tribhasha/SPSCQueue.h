@@ -0,0 +1,90 @@
+#ifndef TRIBHASHA_SPSCQUEUE_H
+#define TRIBHASHA_SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace tribhasha {
+
+// A bounded queue between exactly one producer thread and one consumer
+// thread. Pushing and popping are a load and a store on two counters, with
+// no locks; a full or empty queue is waited out by yielding. The producer
+// closes the queue when it is done, after which pop() drains what is left
+// and then fails.
+template <typename T>
+class SPSCQueue {
+private:
+    std::vector<T> slots;
+    size_t mask;
+
+    // Items pushed and popped so far. Each counter is written by one side
+    // only and lives on its own cache line.
+    alignas(64) std::atomic<size_t> pushed{0};
+    alignas(64) std::atomic<size_t> popped{0};
+    alignas(64) std::atomic<bool> closed{false};
+
+    static size_t roundUp(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        return size;
+    }
+
+public:
+    // Holds up to `capacity` items, rounded up to a power of two
+    explicit SPSCQueue(size_t capacity)
+        : slots(roundUp(capacity)), mask(slots.size() - 1) {}
+
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+    // Producer side
+    bool tryPush(T& value) {
+        size_t tail = pushed.load(std::memory_order_relaxed);
+        if (tail - popped.load(std::memory_order_acquire) == slots.size()) {
+            return false;
+        }
+        slots[tail & mask] = std::move(value);
+        pushed.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    void push(T value) {
+        while (!tryPush(value)) {
+            std::this_thread::yield();
+        }
+    }
+
+    void close() {
+        closed.store(true, std::memory_order_release);
+    }
+
+    // Consumer side
+    bool tryPop(T& value) {
+        size_t head = popped.load(std::memory_order_relaxed);
+        if (head == pushed.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = std::move(slots[head & mask]);
+        popped.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Wait for the next item; false once the queue is closed and empty
+    bool pop(T& value) {
+        while (!tryPop(value)) {
+            if (closed.load(std::memory_order_acquire)) {
+                // Anything pushed before close() is visible now
+                return tryPop(value);
+            }
+            std::this_thread::yield();
+        }
+        return true;
+    }
+};
+
+} // namespace tribhasha
+
+#endif // TRIBHASHA_SPSCQUEUE_H
@@ -0,0 +1,30 @@
+#ifndef TRIBHASHA_SIMDSCAN_H
+#define TRIBHASHA_SIMDSCAN_H
+
+namespace tribhasha {
+namespace simd {
+
+// Vectorized scanners used by the lexer's hot loops. Each one scans the
+// range [p, end) and returns a pointer to the first byte it did not consume
+// (or `end`). They never read outside the range.
+//
+// On x86 the SSE2 versions are the baseline and AVX2 versions are selected
+// at runtime when the CPU supports them; other targets use scalar loops.
+
+// Skip spaces, tabs, carriage returns and newlines.
+const char* skipWhitespace(const char* p, const char* end);
+
+// Find the next '\n' (the end of a // comment).
+const char* findNewline(const char* p, const char* end);
+
+// Find the next '"'.
+const char* findQuote(const char* p, const char* end);
+
+// Skip a run of ASCII identifier characters [A-Za-z0-9_]. Stops at the
+// first non-ASCII byte so the caller can classify it.
+const char* skipAsciiIdentifier(const char* p, const char* end);
+
+} // namespace simd
+} // namespace tribhasha
+
+#endif // TRIBHASHA_SIMDSCAN_H
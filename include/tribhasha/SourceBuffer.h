@@ -0,0 +1,49 @@
+#ifndef TRIBHASHA_SOURCEBUFFER_H
+#define TRIBHASHA_SOURCEBUFFER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace tribhasha {
+
+// Read-only view of a script's bytes.
+//
+// Files are memory-mapped where the platform supports it, so the source is
+// never copied on its way into the lexer. Tokens and AST nodes refer into
+// this buffer, so it must outlive everything produced from it.
+class SourceBuffer {
+private:
+    std::string name;
+    const char* data = nullptr;
+    size_t size = 0;
+
+    // Set when the bytes are mapped and must be unmapped on destruction
+    bool mapped = false;
+
+    // Backing storage when the buffer is not mapped
+    std::string contents;
+
+    SourceBuffer() = default;
+
+public:
+    ~SourceBuffer();
+
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    // Map a file into memory. Returns nullptr if the file cannot be opened.
+    static std::unique_ptr<SourceBuffer> fromFile(const std::string& filename);
+
+    // Wrap an in-memory string (REPL input, tests)
+    static std::unique_ptr<SourceBuffer> fromString(std::string name, std::string contents);
+
+    std::string_view getText() const { return std::string_view(data, size); }
+    const std::string& getName() const { return name; }
+    bool isMapped() const { return mapped; }
+};
+
+} // namespace tribhasha
+
+#endif // TRIBHASHA_SOURCEBUFFER_H
@@ -0,0 +1,67 @@
+#ifndef TRIBHASHA_SOURCEMANAGER_H
+#define TRIBHASHA_SOURCEMANAGER_H
+
+#include "SourceBuffer.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tribhasha {
+
+// A 1-based position. Columns count code points, not bytes, so they line up
+// with what an editor shows for Devanagari and Bengali text.
+struct LineColumn {
+    uint32_t line;
+    uint32_t column;
+};
+
+// The text of one script together with its line-offset table. Tokens only
+// record byte offsets; the table that turns an offset into a line and column
+// is built the first time a position is asked for, so lexing and parsing
+// never pay for it.
+class SourceFile {
+private:
+    std::string name;
+    std::string_view text;
+
+    mutable std::once_flag linesBuilt;
+    mutable std::vector<uint32_t> lineStarts;
+
+    void buildLineTable() const;
+
+public:
+    explicit SourceFile(std::string_view text, std::string name = std::string());
+
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    std::string_view getText() const { return text; }
+    const std::string& getName() const { return name; }
+
+    // Position of a byte offset; an offset past the end maps to the end
+    LineColumn getLineColumn(uint32_t offset) const;
+    uint32_t getLine(uint32_t offset) const;
+};
+
+// Owns every script loaded in a session and the line tables that go with
+// them. Buffers and files stay alive (and in place) until the manager is
+// destroyed, so tokens and AST nodes may keep views into them.
+class SourceManager {
+private:
+    std::vector<std::unique_ptr<SourceBuffer>> buffers;
+    std::vector<std::unique_ptr<SourceFile>> files;
+
+public:
+    // Map a file. Returns nullptr if the file cannot be opened.
+    const SourceFile* loadFile(const std::string& filename);
+
+    const SourceFile& addBuffer(std::unique_ptr<SourceBuffer> buffer);
+    const SourceFile& addString(std::string name, std::string contents);
+};
+
+} // namespace tribhasha
+
+#endif // TRIBHASHA_SOURCEMANAGER_H
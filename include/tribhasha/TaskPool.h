@@ -0,0 +1,94 @@
+#ifndef TRIBHASHA_TASKPOOL_H
+#define TRIBHASHA_TASKPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tribhasha {
+
+// The work-stealing pool that runs the calls generated code forks (see
+// CodeGen::setParallel).
+//
+// Every worker thread has a queue of its own; threads that are not
+// workers, such as the one running main, share one more. A forked task is
+// pushed onto the forking thread's queue and joined by that same thread,
+// which runs it itself if nobody has taken it yet. Idle workers, and
+// threads waiting for a task another thread took, take the oldest task
+// from any queue, which is the one highest up the recursion and so the
+// largest.
+//
+// Forking stops below a depth of nested parallel calls (enter() and
+// leave()) that gives every thread plenty of tasks to steal; below it the
+// generated code runs serially. A pool of one thread never forks.
+class TaskPool {
+public:
+    struct Task;
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task*> tasks;
+    };
+
+    // One per worker, then the one for other threads
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    size_t depthLimit;
+
+    // Tasks in the queues, and what idle workers wait on
+    std::atomic<size_t> queued{0};
+    std::atomic<bool> stopping{false};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    Queue& ownQueue();
+    Task* take();
+    void execute(Task* task);
+    void work(size_t index);
+
+public:
+    // `threads` counts the calling thread; 0 means one per core
+    explicit TaskPool(unsigned threads = 0);
+    ~TaskPool();
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    // The pool generated code runs on, started on first use
+    static TaskPool& global();
+
+    unsigned getThreads() const { return static_cast<unsigned>(workers.size() + 1); }
+
+    // Start a parallel call, if this thread is not already deep enough
+    // that the calls above it keep every thread busy. Returns false, and
+    // nothing needs undoing, if the call should run serially; otherwise
+    // leave() must follow when it returns.
+    bool enter();
+    void leave();
+
+    // Make `run(frame)` available to other threads. The same thread must
+    // join() the task before `frame` goes away.
+    Task* fork(void (*run)(void*), void* frame);
+
+    // Wait until the task has run, running it here if no other thread has
+    // started it and other tasks meanwhile if one has
+    void join(Task* task);
+};
+
+} // namespace tribhasha
+
+// Entry points for generated code, on TaskPool::global()
+extern "C" {
+int tribhasha_enter();
+void tribhasha_leave();
+void* tribhasha_fork(void (*run)(void*), void* frame);
+void tribhasha_join(void* task);
+}
+
+#endif // TRIBHASHA_TASKPOOL_H
@@ -1,7 +1,11 @@
 #ifndef TRIBHASHA_TOKEN_H
 #define TRIBHASHA_TOKEN_H
 
+#include "Interner.h"
+#include "SourceManager.h"
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 #include <iostream>
@@ -9,7 +13,7 @@
 namespace tribhasha {
 
 // Token types
-enum class TokenType {
+enum class TokenType : uint8_t {
     // Special tokens
     END_OF_FILE,
     ERROR,
@@ -21,47 +25,26 @@ enum class TokenType {
     STRING_LITERAL,
     BOOL_LITERAL,
     
-    // Keywords - English
-    VAR_EN,        // var
-    FUNCTION_EN,   // function
-    IF_EN,         // if
-    ELSE_EN,       // else
-    WHILE_EN,      // while
-    FOR_EN,        // for
-    RETURN_EN,     // return
-    TRUE_EN,       // true
-    FALSE_EN,      // false
-    AND_EN,        // and
-    OR_EN,         // or
-    NOT_EN,        // not
+    // Keywords. Each concept has one kind whatever the spelling; the
+    // language it was written in is carried in Token::language.
+    KW_VAR,        // var / चर / ভেৰিয়েবল
+    KW_FUNCTION,   // function / फलन / কাৰ্য্য
+    KW_IF,         // if / अगर / যদি
+    KW_ELSE,       // else / अन्यथा / নহলে
+    KW_WHILE,      // while / जबतक / যতক্ষণ
+    KW_FOR,        // for / के_लिए / ৰ_বাবে
+    KW_RETURN,     // return / वापस / ঘূৰাই_দিয়ক
+    KW_TRUE,       // true / सही / সত্য
+    KW_FALSE,      // false / गलत / মিছা
+    KW_AND,        // and / और / আৰু
+    KW_OR,         // or / या / বা
+    KW_NOT,        // not / नहीं / নহয় (also '!')
     
-    // Keywords - Hindi
-    VAR_HI,        // चर
-    FUNCTION_HI,   // फलन
-    IF_HI,         // अगर
-    ELSE_HI,       // अन्यथा
-    WHILE_HI,      // जबतक
-    FOR_HI,        // के_लिए
-    RETURN_HI,     // वापस
-    TRUE_HI,       // सही
-    FALSE_HI,      // गलत
-    AND_HI,        // और
-    OR_HI,         // या
-    NOT_HI,        // नहीं
-    
-    // Keywords - Assamese
-    VAR_AS,        // ভেৰিয়েবল
-    FUNCTION_AS,   // কাৰ্য্য
-    IF_AS,         // যদি
-    ELSE_AS,       // নহলে
-    WHILE_AS,      // যতক্ষণ
-    FOR_AS,        // ৰ_বাবে
-    RETURN_AS,     // ঘূৰাই_দিয়ক
-    TRUE_AS,       // সত্য
-    FALSE_AS,      // মিছা
-    AND_AS,        // আৰু
-    OR_AS,         // বা
-    NOT_AS,        // নহয়
+    // Type names, for annotations
+    KW_INT,        // int / पूर्णांक / পূৰ্ণসংখ্যা
+    KW_FLOAT,      // float / दशमलव / দশমিক
+    KW_STRING,     // string / वाक्य / বাক্য
+    KW_BOOL,       // bool / बूलियन / বুলিয়ান
     
     // Operators
     PLUS,          // +
@@ -94,33 +77,68 @@ enum class TokenType {
     COLON,         // :
 };
 
+// Natural language a keyword was spelled in
+enum class Language : uint8_t {
+    NONE,          // not a keyword, or a symbol such as '!'
+    ENGLISH,
+    HINDI,
+    ASSAMESE,
+};
+
 // Token structure
+//
+// A token records where its lexeme is in the source rather than the text or
+// its line; SourceFile turns the offset into a line and column when a
+// diagnostic needs one. String literal lexemes keep their quotes. Numeric
+// literals carry their value, parsed once by the lexer, and identifiers
+// carry their interned Symbol.
 struct Token {
     TokenType type;
-    std::string lexeme;
-    int line;
+    Language language = Language::NONE;
+    uint32_t offset;
+    uint32_t length;
+    union {
+        int64_t intValue;
+        double floatValue;
+        Symbol symbol;
+    };
+    
+    Token(TokenType type, uint32_t offset, uint32_t length)
+        : type(type), offset(offset), length(length), intValue(0) {}
+    
+    // The token's text in the source it was lexed from
+    std::string_view lexeme(std::string_view source) const {
+        return source.substr(offset, length);
+    }
     
-    Token(TokenType type, std::string lexeme, int line)
-        : type(type), lexeme(std::move(lexeme)), line(line) {}
+    uint32_t end() const { return offset + length; }
     
-    std::string toString() const;
+    std::string toString(const SourceFile& file) const;
 };
 
-// Keyword lookup tables
+// Result of a keyword lookup
+struct KeywordInfo {
+    TokenType type;        // IDENTIFIER when the word is not a keyword
+    Language language;
+};
+
+// Keyword recognition over all three languages. Lookup is a perfect hash
+// computed at compile time, so it never allocates or probes more than once.
 class Keywords {
-private:
-    static std::unordered_map<std::string, TokenType> englishKeywords;
-    static std::unordered_map<std::string, TokenType> hindiKeywords;
-    static std::unordered_map<std::string, TokenType> assameseKeywords;
-    
 public:
-    static TokenType getKeywordType(const std::string& word);
-    static bool isKeyword(const std::string& word);
+    static KeywordInfo lookup(std::string_view word);
+    static TokenType getKeywordType(std::string_view word);
+    static bool isKeyword(std::string_view word);
+    static bool isKeyword(TokenType type);
+    
+    // Spelling of a keyword kind in the given language
+    static std::string_view spelling(TokenType type, Language language);
     
-    // Helper to get the canonical keyword in any language
+    // Keyword kinds are already canonical; kept for callers that compare
+    // keyword kinds across languages
     static TokenType normalizeKeywordType(TokenType type);
     
-    // Initialize the keyword maps
+    // Nothing to initialize any more; the tables are constexpr
     static void initialize();
 };
 
@@ -0,0 +1,67 @@
+#ifndef TRIBHASHA_TOKENBUFFER_H
+#define TRIBHASHA_TOKENBUFFER_H
+
+#include "Token.h"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace tribhasha {
+
+// The tokens of a source buffer that is being edited (see Lexer::relex).
+//
+// Tokens are kept in chunks, each with offsets relative to the chunk's
+// start. Replacing the tokens an edit touched rewrites the chunks they are
+// in; the chunks after them move by recording the change in size once, in
+// a Fenwick tree of shifts, and a second one counts the tokens in each
+// chunk to find a token by index. Tokens after an edit are never visited,
+// so an edit costs about as much as the tokens it replaces plus a
+// logarithm of the file. Chunks are re-split once one grows to several
+// times its size or half of them are empty.
+class TokenBuffer {
+private:
+    struct Chunk {
+        int64_t base;               // its start, before the shifts
+        std::vector<Token> tokens;  // with offsets from the start
+    };
+
+    std::vector<Chunk> chunks;
+    std::vector<int64_t> shifts;  // Fenwick tree, summed up to a chunk
+    std::vector<int64_t> counts;  // Fenwick tree of tokens per chunk
+    size_t tokenCount = 0;
+    size_t emptyChunks = 0;
+
+    int64_t startOf(size_t chunk) const;
+    void shiftFrom(size_t chunk, int64_t delta);
+    void count(size_t chunk, int64_t delta);
+
+    // The chunk holding token `index`, and the index of its first token;
+    // the last chunk, past its end, for size()
+    std::pair<size_t, size_t> locate(size_t index) const;
+
+    // Put `tokens`, with absolute offsets, into `chunk`
+    void fill(size_t chunk, std::vector<Token> tokens);
+
+    void rebuild(std::vector<Token> tokens);
+
+public:
+    TokenBuffer() = default;
+    explicit TokenBuffer(std::vector<Token> tokens);
+
+    size_t size() const { return tokenCount; }
+
+    // Token `index`, with its offset in the current source
+    Token operator[](size_t index) const;
+
+    // All of the tokens, for a parser
+    std::vector<Token> toVector() const;
+
+    // Replace tokens [begin, end) with `replacement`, whose offsets are in
+    // the edited source, and move the tokens from `end` on by `delta` bytes
+    void replace(size_t begin, size_t end, const std::vector<Token>& replacement, int64_t delta);
+};
+
+} // namespace tribhasha
+
+#endif // TRIBHASHA_TOKENBUFFER_H
@@ -0,0 +1,113 @@
+#ifndef TRIBHASHA_TYPEINFERENCE_H
+#define TRIBHASHA_TYPEINFERENCE_H
+
+#include "AST.h"
+#include "Diagnostics.h"
+#include <cstdint>
+#include <vector>
+
+namespace tribhasha {
+
+// Works out a static type for every variable, parameter, function result
+// and expression of a resolved program, so CodeGen can keep integers in
+// i64 and conditions in i1 and only convert where values of different
+// types meet.
+//
+// A variable has one type, the join of everything stored in it. A
+// function's parameters take the join of the arguments of every call to it
+// and its result the join of its return values, so a function called only
+// with integers works on integers. The program is walked repeatedly,
+// starting from Unknown and widening, until nothing changes; whatever is
+// still Unknown then (a parameter of a function nobody calls, say) is
+// taken to be a Float, as everything used to be, and the walk goes on from
+// there. Division always gives a Float.
+//
+// An open program is compiled as it is parsed (streaming, pipelined), so
+// code that has not been seen yet can still call its functions and store
+// in its top-level variables. Each call to infer() then settles the types
+// of what it defines for good: numeric parameters and top-level variables
+// are Floats, and later calls and stores are converted to fit. Variables
+// inside functions and blocks are still typed precisely.
+//
+// A type written in a declaration (`int x`, `function float f(int n)`) is
+// the type, not a starting point: storing, passing or returning anything
+// that does not fit it is reported as a diagnostic. An Int fits a Float.
+// Without one, numbers of any type mix, but strings and numbers do not:
+// storing both in one place is reported too.
+class TypeInference : public ASTVisitor<TypeInference, ValueType, void> {
+private:
+    struct Signature {
+        std::vector<ValueType> params;
+        std::vector<bool> declaredParams;
+        ValueType result = ValueType::Unknown;
+        bool declaredResult = false;
+        bool defined = false;
+        bool sealed = false;  // already compiled, in an open program
+    };
+
+    struct Slot {
+        ValueType type = ValueType::Unknown;
+        bool declared = false;
+        bool sealed = false;  // a top-level variable already compiled
+    };
+
+    // Function signatures, indexed by Symbol
+    std::vector<Signature> signatures;
+
+    // Slots of main (the first frame), then of every function, in the
+    // order the walk meets them
+    std::vector<std::vector<Slot>> frames;
+    size_t currentFrame = 0;
+    size_t functionCount = 0;
+    Symbol currentFunction = 0;
+    bool inFunction = false;
+
+    bool open;
+    bool changed = false;
+
+    // Mismatches are only reported on a last walk, once the types have
+    // settled
+    bool reporting = false;
+    Diagnostics diagnostics;
+
+    // Base of the top-level statement being walked (see Stmt::base)
+    uint32_t base = 0;
+
+    void walk(const std::vector<Stmt*>& statements);
+    void widen(ValueType& type, ValueType with);
+    void store(ValueType& type, bool declared, ValueType value, const Token& at, bool sealed = false);
+    Slot& slotAt(uint32_t slot);
+    Signature* signatureOf(Symbol name);
+    bool settleUnknowns();
+
+public:
+    explicit TypeInference(bool open = false);
+
+    // Infer the types of top-level statements, in order, which may call
+    // functions defined by earlier calls
+    void infer(const std::vector<Stmt*>& statements);
+
+    const Diagnostics& getDiagnostics() const { return diagnostics; }
+    bool hadError() const { return diagnostics.hasErrors(); }
+
+    ValueType visitBinaryExpr(BinaryExpr* expr);
+    ValueType visitLogicalExpr(LogicalExpr* expr);
+    ValueType visitGroupingExpr(GroupingExpr* expr);
+    ValueType visitLiteralExpr(LiteralExpr* expr);
+    ValueType visitUnaryExpr(UnaryExpr* expr);
+    ValueType visitVariableExpr(VariableExpr* expr);
+    ValueType visitAssignExpr(AssignExpr* expr);
+    ValueType visitCallExpr(CallExpr* expr);
+
+    void visitExpressionStmt(ExpressionStmt* stmt);
+    void visitVarStmt(VarStmt* stmt);
+    void visitBlockStmt(BlockStmt* stmt);
+    void visitIfStmt(IfStmt* stmt);
+    void visitWhileStmt(WhileStmt* stmt);
+    void visitFunctionStmt(FunctionStmt* stmt);
+    void visitReturnStmt(ReturnStmt* stmt);
+};
+
+} // namespace tribhasha
+
+#endif // TRIBHASHA_TYPEINFERENCE_H
@@ -0,0 +1,38 @@
+#ifndef TRIBHASHA_UNICODE_H
+#define TRIBHASHA_UNICODE_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace tribhasha {
+namespace unicode {
+
+// A decoded code point and the number of bytes it occupied. `length` is 0
+// when the bytes are not well-formed UTF-8.
+struct DecodedCodePoint {
+    uint32_t codePoint;
+    unsigned length;
+};
+
+// Decode one UTF-8 sequence from [p, end) with a table-driven DFA. Rejects
+// overlong forms, surrogates and values above U+10FFFF.
+DecodedCodePoint decode(const char* p, const char* end);
+
+// Identifier classes. ASCII follows the lexer's [A-Za-z_][A-Za-z0-9_]*; the
+// Devanagari (U+0900-U+097F) and Bengali (U+0980-U+09FF) blocks follow
+// XID_Start / XID_Continue, so combining marks, nukta and virama continue an
+// identifier while the danda and other punctuation end it. ZWJ and ZWNJ are
+// allowed inside identifiers, as UAX #31 permits for Indic conjuncts.
+bool isIdentifierStart(uint32_t codePoint);
+bool isIdentifierContinue(uint32_t codePoint);
+
+// Length in bytes of the identifier character at p, or 0 if the bytes there
+// do not start (or continue) an identifier. Devanagari and Bengali letters
+// are recognized straight from their three-byte encoding.
+size_t identifierStartLength(const char* p, const char* end);
+size_t identifierContinueLength(const char* p, const char* end);
+
+} // namespace unicode
+} // namespace tribhasha
+
+#endif // TRIBHASHA_UNICODE_H
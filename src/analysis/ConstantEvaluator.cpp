@@ -0,0 +1,630 @@
+#include "tribhasha/ConstantEvaluator.h"
+#include "tribhasha/ASTCache.h"
+#include "tribhasha/Interner.h"
+#include "tribhasha/SourceBuffer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+namespace tribhasha {
+
+namespace {
+
+// Limits on one call worked out at compile time, and on all of them
+constexpr size_t stepLimit = 1 << 20;
+constexpr size_t totalStepLimit = 1 << 24;
+constexpr size_t depthLimit = 512;
+constexpr size_t slotLimit = 1 << 16;
+
+// CodeGen keeps anything of an unknown type in a double
+ValueType storageType(ValueType type) {
+    return type == ValueType::Unknown ? ValueType::Float : type;
+}
+
+// The zero CodeGen returns from a function that ends without a value
+Constant zeroOf(ValueType type) {
+    Constant zero;
+    type = storageType(type);
+    if (type != ValueType::String) {
+        zero.type = type;
+    }
+    return zero;
+}
+
+// Every function defined in `statement`, including nested ones
+void collectFunctions(Stmt* statement, std::vector<FunctionStmt*>& found) {
+    if (BlockStmt* block = statement->as<BlockStmt>()) {
+        for (Stmt* s : block->statements) collectFunctions(s, found);
+    } else if (IfStmt* branch = statement->as<IfStmt>()) {
+        collectFunctions(branch->thenBranch, found);
+        if (branch->elseBranch) collectFunctions(branch->elseBranch, found);
+    } else if (WhileStmt* loop = statement->as<WhileStmt>()) {
+        collectFunctions(loop->body, found);
+    } else if (FunctionStmt* function = statement->as<FunctionStmt>()) {
+        found.push_back(function);
+        for (Stmt* s : function->body) collectFunctions(s, found);
+    }
+}
+
+// Stored results, all integers in host byte order:
+//
+//   header
+//   entries  entryCount x {u32 nameLength, u32 argumentCount, the name,
+//                          argumentCount x {i64 type, i64 int, i64 float bits},
+//                          {i64 type, i64 int, i64 float bits} of the result}
+//
+// The header holds a hash of the entries, so a damaged file is never read.
+constexpr char resultsMagic[8] = {'T', 'R', 'I', 'B', 'E', 'V', 'L', '\n'};
+constexpr uint32_t resultsVersion = 1;
+constexpr uint32_t byteOrderMark = 0x01020304;
+
+struct ResultsHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint64_t entryCount;
+    uint64_t entriesHash;
+};
+
+// A constant is three words, as in the keys of the results
+constexpr size_t constantWords = 3;
+
+void appendWord(std::string& out, int64_t word) {
+    out.append(reinterpret_cast<const char*>(&word), sizeof(word));
+}
+
+// Only numbers and booleans are ever worked out
+bool isStorable(int64_t type) {
+    return type >= static_cast<int64_t>(ValueType::Bool) && type <= static_cast<int64_t>(ValueType::Float);
+}
+
+} // namespace
+
+// Constants
+Constant Constant::of(Expr* expr) {
+    Constant value;
+    LiteralExpr* literal = expr->as<LiteralExpr>();
+    if (!literal) {
+        return value;
+    }
+    switch (literal->type) {
+        case TokenType::INT_LITERAL:
+            value.type = ValueType::Int;
+            value.intValue = literal->intValue;
+            break;
+        case TokenType::FLOAT_LITERAL:
+            value.type = ValueType::Float;
+            value.floatValue = literal->floatValue;
+            break;
+        case TokenType::KW_TRUE:
+        case TokenType::KW_FALSE:
+            value.type = ValueType::Bool;
+            value.intValue = literal->type == TokenType::KW_TRUE;
+            break;
+        default:
+            return value;
+    }
+    // A literal is read as the type the inference gave it
+    return value.as(expr->valueType);
+}
+
+bool Constant::isTrue() const {
+    if (type == ValueType::Float) {
+        return !std::isnan(floatValue) && floatValue != 0.0;
+    }
+    return intValue != 0;
+}
+
+Constant Constant::as(ValueType to) const {
+    to = storageType(to);
+    if (!known() || to == type) {
+        return *this;
+    }
+    Constant result;
+    switch (to) {
+        case ValueType::Bool:
+            result.type = ValueType::Bool;
+            result.intValue = isTrue();
+            break;
+        case ValueType::Int:
+            result.type = ValueType::Int;
+            if (type == ValueType::Float) {
+                // Out of range (or NaN), the conversion has no value
+                if (!(floatValue >= -9223372036854775808.0 && floatValue < 9223372036854775808.0)) {
+                    return Constant();
+                }
+                result.intValue = static_cast<int64_t>(floatValue);
+            } else {
+                result.intValue = intValue;
+            }
+            break;
+        case ValueType::Float:
+            result.type = ValueType::Float;
+            result.floatValue = static_cast<double>(intValue);
+            break;
+        default:
+            break;
+    }
+    return result;
+}
+
+Constant applyBinary(TokenType op, ValueType type, const Constant& left, const Constant& right) {
+    type = storageType(type);
+    Constant a = left.as(type);
+    Constant b = right.as(type);
+    Constant result;
+    if (!a.known() || !b.known()) {
+        return result;
+    }
+
+    if (type == ValueType::Int) {
+        // Wrapping, as the i64 instructions do
+        uint64_t x = static_cast<uint64_t>(a.intValue);
+        uint64_t y = static_cast<uint64_t>(b.intValue);
+        result.type = ValueType::Int;
+        switch (op) {
+            case TokenType::PLUS:  result.intValue = static_cast<int64_t>(x + y); return result;
+            case TokenType::MINUS: result.intValue = static_cast<int64_t>(x - y); return result;
+            case TokenType::STAR:  result.intValue = static_cast<int64_t>(x * y); return result;
+            case TokenType::MODULO:
+                // These trap
+                if (b.intValue == 0 || (a.intValue == std::numeric_limits<int64_t>::min() && b.intValue == -1)) {
+                    return Constant();
+                }
+                result.intValue = a.intValue % b.intValue;
+                return result;
+            default:
+                break;
+        }
+        result.type = ValueType::Bool;
+        switch (op) {
+            case TokenType::LESS:          result.intValue = a.intValue < b.intValue; return result;
+            case TokenType::LESS_EQUAL:    result.intValue = a.intValue <= b.intValue; return result;
+            case TokenType::GREATER:       result.intValue = a.intValue > b.intValue; return result;
+            case TokenType::GREATER_EQUAL: result.intValue = a.intValue >= b.intValue; return result;
+            case TokenType::EQUAL:         result.intValue = a.intValue == b.intValue; return result;
+            case TokenType::NOT_EQUAL:     result.intValue = a.intValue != b.intValue; return result;
+            default:                       return Constant();
+        }
+    }
+    if (type != ValueType::Float) {
+        return result;
+    }
+
+    double x = a.floatValue;
+    double y = b.floatValue;
+    result.type = ValueType::Float;
+    switch (op) {
+        case TokenType::PLUS:   result.floatValue = x + y; return result;
+        case TokenType::MINUS:  result.floatValue = x - y; return result;
+        case TokenType::STAR:   result.floatValue = x * y; return result;
+        case TokenType::SLASH:  result.floatValue = x / y; return result;
+        case TokenType::MODULO: result.floatValue = std::fmod(x, y); return result;
+        default:                break;
+    }
+    // Unordered comparisons: true if either side is NaN
+    bool unordered = std::isnan(x) || std::isnan(y);
+    result.type = ValueType::Bool;
+    switch (op) {
+        case TokenType::LESS:          result.intValue = unordered || x < y; return result;
+        case TokenType::LESS_EQUAL:    result.intValue = unordered || x <= y; return result;
+        case TokenType::GREATER:       result.intValue = unordered || x > y; return result;
+        case TokenType::GREATER_EQUAL: result.intValue = unordered || x >= y; return result;
+        case TokenType::EQUAL:         result.intValue = unordered || x == y; return result;
+        case TokenType::NOT_EQUAL:     result.intValue = unordered || x != y; return result;
+        default:                       return Constant();
+    }
+}
+
+// Evaluator
+void ConstantEvaluator::define(const std::vector<Stmt*>& statements) {
+    definitions.clear();
+    results = loaded;
+
+    std::vector<FunctionStmt*> found;
+    for (Stmt* statement : statements) {
+        collectFunctions(statement, found);
+    }
+    for (FunctionStmt* function : found) {
+        Definition* definition = definitionOf(function->name.symbol);
+        definition->ambiguous = definition->function != nullptr;
+        definition->function = function;
+    }
+}
+
+ConstantEvaluator::Definition* ConstantEvaluator::definitionOf(Symbol name) {
+    if (name >= definitions.size()) {
+        definitions.resize(std::max<size_t>(name + 1, Interner::global().limit()));
+    }
+    return &definitions[name];
+}
+
+bool ConstantEvaluator::isPure(Symbol name) {
+    if (name >= definitions.size()) {
+        return false;
+    }
+    const Definition& definition = definitions[name];
+    return definition.function && definition.function->pure && !definition.ambiguous;
+}
+
+bool ConstantEvaluator::step() {
+    if (++steps > stepLimit || ++totalSteps > totalStepLimit) {
+        failed = true;
+    }
+    return !failed;
+}
+
+Constant ConstantEvaluator::fail() {
+    failed = true;
+    return Constant();
+}
+
+Constant ConstantEvaluator::call(Symbol name, const std::vector<Constant>& arguments) {
+    if (!isPure(name) || totalSteps > totalStepLimit) {
+        return Constant();
+    }
+    steps = 0;
+    failed = false;
+    returning = false;
+    Constant result = invoke(definitions[name].function, arguments);
+    return failed ? Constant() : result;
+}
+
+Constant ConstantEvaluator::invoke(FunctionStmt* function, const std::vector<Constant>& arguments) {
+    if (arguments.size() != function->params.size() || depth >= depthLimit ||
+        slots.size() + function->slotCount > slotLimit) {
+        return fail();
+    }
+
+    // Arguments are passed as the parameters' types
+    std::vector<int64_t> key{static_cast<int64_t>(function->name.symbol)};
+    std::vector<Constant> parameters;
+    parameters.reserve(arguments.size());
+    for (size_t i = 0; i < arguments.size(); i++) {
+        Constant argument = arguments[i].as(function->paramTypes[i]);
+        if (!argument.known()) {
+            return fail();
+        }
+        int64_t bits;
+        std::memcpy(&bits, &argument.floatValue, sizeof(bits));
+        key.insert(key.end(), {static_cast<int64_t>(argument.type), argument.intValue, bits});
+        parameters.push_back(argument);
+    }
+    auto remembered = results.find(key);
+    if (remembered != results.end()) {
+        return remembered->second;
+    }
+
+    size_t outerBase = frameBase;
+    FunctionStmt* outerFunction = currentFunction;
+    frameBase = slots.size();
+    currentFunction = function;
+    depth++;
+    slots.resize(frameBase + std::max<size_t>(function->slotCount, parameters.size()));
+    std::copy(parameters.begin(), parameters.end(), slots.begin() + frameBase);
+
+    returning = false;
+    for (Stmt* statement : function->body) {
+        if (!visit(statement)) break;
+    }
+    Constant result = returning ? returnValue : zeroOf(function->returnType);
+    returning = false;
+
+    slots.resize(frameBase);
+    frameBase = outerBase;
+    currentFunction = outerFunction;
+    depth--;
+
+    if (failed || !result.known()) {
+        return fail();
+    }
+    results.emplace(std::move(key), result);
+    return result;
+}
+
+// Expressions
+Constant ConstantEvaluator::visitBinaryExpr(BinaryExpr* expr) {
+    std::vector<BinaryExpr*> chain = leftChain(expr);
+    if (!step()) return Constant();
+    Constant left = visit(chain.front()->left);
+    for (BinaryExpr* link : chain) {
+        if (link != chain.front() && !step()) return Constant();
+        Constant right = visit(link->right);
+        if (failed) return Constant();
+
+        // As CodeGen: arithmetic in the result's type, comparisons in the
+        // operands' wider type
+        ValueType type = link->valueType;
+        if (type == ValueType::Bool) {
+            type = joinTypes(link->left->valueType, link->right->valueType);
+            if (type == ValueType::Bool) type = ValueType::Int;
+        }
+        left = applyBinary(link->op.type, type, left, right);
+        if (!left.known()) return fail();
+    }
+    return left;
+}
+
+Constant ConstantEvaluator::visitLogicalExpr(LogicalExpr* expr) {
+    std::vector<LogicalExpr*> chain = leftChain(expr);
+    if (!step()) return Constant();
+    Constant left = visit(chain.front()->left);
+    if (failed) return Constant();
+
+    for (LogicalExpr* link : chain) {
+        if (link != chain.front() && !step()) return Constant();
+        Constant result;
+        result.type = ValueType::Bool;
+        bool isAnd = link->op.type == TokenType::KW_AND;
+        if (left.isTrue() != isAnd) {
+            result.intValue = !isAnd;
+        } else {
+            Constant right = visit(link->right);
+            if (failed) return Constant();
+            result.intValue = right.isTrue();
+        }
+        left = result;
+    }
+    return left;
+}
+
+Constant ConstantEvaluator::visitGroupingExpr(GroupingExpr* expr) {
+    return visit(expr->expression);
+}
+
+Constant ConstantEvaluator::visitLiteralExpr(LiteralExpr* expr) {
+    if (!step()) return Constant();
+    Constant value = Constant::of(expr);
+    return value.known() ? value : fail();
+}
+
+Constant ConstantEvaluator::visitUnaryExpr(UnaryExpr* expr) {
+    if (!step()) return Constant();
+    Constant operand = visit(expr->right);
+    if (failed) return Constant();
+
+    Constant result;
+    if (expr->op.type == TokenType::KW_NOT) {
+        result.type = ValueType::Bool;
+        result.intValue = !operand.isTrue();
+        return result;
+    }
+    result = operand.as(expr->valueType);
+    if (result.type == ValueType::Float) {
+        result.floatValue = -result.floatValue;
+    } else if (result.type == ValueType::Int) {
+        result.intValue = static_cast<int64_t>(0 - static_cast<uint64_t>(result.intValue));
+    } else {
+        return fail();
+    }
+    return result;
+}
+
+Constant ConstantEvaluator::visitVariableExpr(VariableExpr* expr) {
+    if (!step()) return Constant();
+    Constant value = slots[frameBase + expr->slot];
+    return value.known() ? value : fail();
+}
+
+Constant ConstantEvaluator::visitAssignExpr(AssignExpr* expr) {
+    if (!step()) return Constant();
+    Constant value = visit(expr->value);
+    if (failed) return Constant();
+
+    // Stored as the variable's type
+    Constant& slot = slots[frameBase + expr->slot];
+    value = value.as(slot.type);
+    if (!value.known()) return fail();
+    slot = value;
+    return value;
+}
+
+Constant ConstantEvaluator::visitCallExpr(CallExpr* expr) {
+    if (!step()) return Constant();
+    VariableExpr* callee = expr->callee->as<VariableExpr>();
+    if (!callee || !isPure(callee->name.symbol)) {
+        return fail();
+    }
+
+    std::vector<Constant> arguments;
+    arguments.reserve(expr->arguments.size());
+    for (Expr* argument : expr->arguments) {
+        arguments.push_back(visit(argument));
+        if (failed) return Constant();
+    }
+    Constant result = invoke(definitions[callee->name.symbol].function, arguments);
+    if (failed) return Constant();
+    result = result.as(expr->valueType);
+    return result.known() ? result : fail();
+}
+
+// Statements
+bool ConstantEvaluator::visitExpressionStmt(ExpressionStmt* stmt) {
+    visit(stmt->expression);
+    return !failed;
+}
+
+bool ConstantEvaluator::visitVarStmt(VarStmt* stmt) {
+    if (!step()) return false;
+    Constant value = stmt->initializer ? visit(stmt->initializer) : zeroOf(stmt->valueType);
+    if (failed) return false;
+    value = value.as(stmt->valueType);
+    if (!value.known()) {
+        fail();
+        return false;
+    }
+    slots[frameBase + stmt->slot] = value;
+    return true;
+}
+
+bool ConstantEvaluator::visitBlockStmt(BlockStmt* stmt) {
+    for (Stmt* statement : stmt->statements) {
+        if (!visit(statement)) return false;
+    }
+    return true;
+}
+
+bool ConstantEvaluator::visitIfStmt(IfStmt* stmt) {
+    if (!step()) return false;
+    Constant condition = visit(stmt->condition);
+    if (failed) return false;
+    if (condition.isTrue()) {
+        return visit(stmt->thenBranch);
+    }
+    return stmt->elseBranch ? visit(stmt->elseBranch) : true;
+}
+
+bool ConstantEvaluator::visitWhileStmt(WhileStmt* stmt) {
+    for (;;) {
+        if (!step()) return false;
+        Constant condition = visit(stmt->condition);
+        if (failed) return false;
+        if (!condition.isTrue()) return true;
+        if (!visit(stmt->body)) return false;
+    }
+}
+
+bool ConstantEvaluator::visitFunctionStmt(FunctionStmt*) {
+    // Defines a function; nothing happens when it is reached
+    return true;
+}
+
+bool ConstantEvaluator::visitReturnStmt(ReturnStmt* stmt) {
+    if (!step()) return false;
+    Constant value = stmt->value ? visit(stmt->value) : zeroOf(currentFunction->returnType);
+    if (failed) return false;
+    returnValue = value.as(currentFunction->returnType);
+    if (!returnValue.known()) {
+        fail();
+        return false;
+    }
+    returning = true;
+    return false;
+}
+
+// Stored results
+std::string evalCachePath(const std::string& scriptPath) {
+    return scriptPath + ".evalcache";
+}
+
+bool ConstantEvaluator::loadResults(const std::string& path, std::string_view source) {
+    std::unique_ptr<SourceBuffer> file = SourceBuffer::fromFile(path);
+    if (!file || file->getText().size() < sizeof(ResultsHeader)) {
+        return false;
+    }
+
+    std::string_view bytes = file->getText();
+    ResultsHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    std::string_view entries = bytes.substr(sizeof(header));
+    if (std::memcmp(header.magic, resultsMagic, sizeof(resultsMagic)) != 0 ||
+        header.version != resultsVersion || header.byteOrder != byteOrderMark ||
+        header.sourceSize != source.size() || header.sourceHash != hashSource(source) ||
+        header.entriesHash != hashSource(entries)) {
+        return false;
+    }
+
+    std::map<std::vector<int64_t>, Constant> read;
+    size_t at = 0;
+    auto take = [&](void* out, size_t size) {
+        if (entries.size() - at < size) return false;
+        std::memcpy(out, entries.data() + at, size);
+        at += size;
+        return true;
+    };
+
+    for (uint64_t i = 0; i < header.entryCount; i++) {
+        uint32_t nameLength, argumentCount;
+        if (!take(&nameLength, sizeof(nameLength)) || !take(&argumentCount, sizeof(argumentCount)) ||
+            entries.size() - at < nameLength) {
+            return false;
+        }
+        std::string_view name = entries.substr(at, nameLength);
+        at += nameLength;
+
+        // Symbols are only meaningful within one process
+        std::vector<int64_t> key{static_cast<int64_t>(Interner::global().intern(name))};
+        int64_t words[constantWords];
+        for (uint32_t j = 0; j < argumentCount; j++) {
+            if (!take(words, sizeof(words)) || !isStorable(words[0])) {
+                return false;
+            }
+            key.insert(key.end(), words, words + constantWords);
+        }
+
+        Constant result;
+        if (!take(words, sizeof(words)) || !isStorable(words[0])) {
+            return false;
+        }
+        result.type = static_cast<ValueType>(words[0]);
+        result.intValue = words[1];
+        std::memcpy(&result.floatValue, &words[2], sizeof(result.floatValue));
+        read.emplace(std::move(key), result);
+    }
+    if (at != entries.size()) {
+        return false;
+    }
+
+    loaded = std::move(read);
+    return true;
+}
+
+bool ConstantEvaluator::saveResults(const std::string& path, std::string_view source) const {
+    if (results.size() <= loaded.size()) {
+        return true;
+    }
+
+    std::string entries;
+    for (const auto& [key, result] : results) {
+        std::string_view name = Interner::global().name(static_cast<Symbol>(key[0]));
+        uint32_t nameLength = static_cast<uint32_t>(name.size());
+        uint32_t argumentCount = static_cast<uint32_t>((key.size() - 1) / constantWords);
+        entries.append(reinterpret_cast<const char*>(&nameLength), sizeof(nameLength));
+        entries.append(reinterpret_cast<const char*>(&argumentCount), sizeof(argumentCount));
+        entries += name;
+        for (size_t i = 1; i < key.size(); i++) {
+            appendWord(entries, key[i]);
+        }
+        int64_t bits;
+        std::memcpy(&bits, &result.floatValue, sizeof(bits));
+        appendWord(entries, static_cast<int64_t>(result.type));
+        appendWord(entries, result.intValue);
+        appendWord(entries, bits);
+    }
+
+    ResultsHeader header{};
+    std::memcpy(header.magic, resultsMagic, sizeof(resultsMagic));
+    header.version = resultsVersion;
+    header.byteOrder = byteOrderMark;
+    header.sourceHash = hashSource(source);
+    header.sourceSize = source.size();
+    header.entryCount = results.size();
+    header.entriesHash = hashSource(entries);
+
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(entries.data(), static_cast<std::streamsize>(entries.size()));
+        if (!file) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace tribhasha
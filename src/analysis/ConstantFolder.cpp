@@ -0,0 +1,426 @@
+#include "tribhasha/ConstantFolder.h"
+#include <algorithm>
+
+namespace tribhasha {
+
+namespace {
+
+// Marks the slots assigned to anywhere in a function's own code. Nested
+// functions have frames of their own and are skipped.
+class AssignmentFinder : public ASTVisitor<AssignmentFinder> {
+public:
+    explicit AssignmentFinder(std::vector<bool>& assigned) : assigned(assigned) {}
+
+    void visitBinaryExpr(BinaryExpr* expr) { operands(leftChain(expr)); }
+    void visitLogicalExpr(LogicalExpr* expr) { operands(leftChain(expr)); }
+    void visitGroupingExpr(GroupingExpr* expr) { visit(expr->expression); }
+    void visitLiteralExpr(LiteralExpr*) {}
+    void visitUnaryExpr(UnaryExpr* expr) { visit(expr->right); }
+    void visitVariableExpr(VariableExpr*) {}
+    void visitAssignExpr(AssignExpr* expr) {
+        if (expr->slot >= assigned.size()) {
+            assigned.resize(expr->slot + 1, false);
+        }
+        assigned[expr->slot] = true;
+        visit(expr->value);
+    }
+    void visitCallExpr(CallExpr* expr) {
+        for (Expr* argument : expr->arguments) visit(argument);
+    }
+
+    void visitExpressionStmt(ExpressionStmt* stmt) { visit(stmt->expression); }
+    void visitVarStmt(VarStmt* stmt) { if (stmt->initializer) visit(stmt->initializer); }
+    void visitBlockStmt(BlockStmt* stmt) { for (Stmt* s : stmt->statements) visit(s); }
+    void visitIfStmt(IfStmt* stmt) {
+        visit(stmt->condition);
+        visit(stmt->thenBranch);
+        if (stmt->elseBranch) visit(stmt->elseBranch);
+    }
+    void visitWhileStmt(WhileStmt* stmt) { visit(stmt->condition); visit(stmt->body); }
+    void visitFunctionStmt(FunctionStmt*) {}
+    void visitReturnStmt(ReturnStmt* stmt) { if (stmt->value) visit(stmt->value); }
+
+private:
+    std::vector<bool>& assigned;
+
+    template <typename Node>
+    void operands(const std::vector<Node*>& chain) {
+        visit(chain.front()->left);
+        for (Node* link : chain) visit(link->right);
+    }
+};
+
+// A function defined inside a branch exists whether or not the branch
+// runs, so such a branch cannot be dropped
+bool definesFunction(Stmt* statement) {
+    if (!statement) return false;
+    switch (statement->getKind()) {
+        case StmtKind::Function:
+            return true;
+        case StmtKind::Block:
+            for (Stmt* inner : statement->as<BlockStmt>()->statements) {
+                if (definesFunction(inner)) return true;
+            }
+            return false;
+        case StmtKind::If: {
+            IfStmt* branch = statement->as<IfStmt>();
+            return definesFunction(branch->thenBranch) || definesFunction(branch->elseBranch);
+        }
+        case StmtKind::While:
+            return definesFunction(statement->as<WhileStmt>()->body);
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
+ConstantFolder::ConstantFolder(bool open) : open(open) {}
+
+void ConstantFolder::fold(std::vector<Stmt*>& statements, ASTContext& context) {
+    this->context = &context;
+    evaluator.define(statements);
+    findAssignments(Span<Stmt*>(statements.data(), statements.size()));
+
+    std::vector<Stmt*> folded;
+    folded.reserve(statements.size());
+    for (Stmt* statement : statements) {
+        if (Stmt* result = visit(statement)) {
+            result->base = statement->base;
+            folded.push_back(result);
+        }
+    }
+    statements = std::move(folded);
+    this->context = nullptr;
+}
+
+void ConstantFolder::findAssignments(Span<Stmt*> statements) {
+    AssignmentFinder finder(frame->assigned);
+    for (Stmt* statement : statements) {
+        finder.visit(statement);
+    }
+
+    // In an open program a variable can be assigned after declarations
+    // that already read it as a constant; from here on it is not one
+    size_t known = std::min(frame->constants.size(), frame->assigned.size());
+    for (size_t slot = 0; slot < known; slot++) {
+        if (frame->assigned[slot]) frame->constants[slot] = Constant();
+    }
+}
+
+Expr* ConstantFolder::literal(const Constant& value) {
+    // Folded numbers have no source text
+    LiteralExpr* literal;
+    switch (value.type) {
+        case ValueType::Bool:
+            literal = value.intValue ? context->create<LiteralExpr>("true", TokenType::KW_TRUE)
+                                     : context->create<LiteralExpr>("false", TokenType::KW_FALSE);
+            break;
+        case ValueType::Int:
+            literal = context->create<LiteralExpr>(std::string_view(), TokenType::INT_LITERAL);
+            literal->intValue = value.intValue;
+            break;
+        default:
+            literal = context->create<LiteralExpr>(std::string_view(), TokenType::FLOAT_LITERAL);
+            literal->floatValue = value.floatValue;
+            break;
+    }
+    literal->valueType = value.type;
+    return literal;
+}
+
+Stmt* ConstantFolder::orEmpty(Stmt* statement) {
+    // Branches and loop bodies cannot be left out
+    return statement ? statement : context->create<BlockStmt>(Span<Stmt*>());
+}
+
+Span<Stmt*> ConstantFolder::foldAll(Span<Stmt*> statements, bool& changed) {
+    std::vector<Stmt*> folded;
+    folded.reserve(statements.size());
+    for (Stmt* statement : statements) {
+        Stmt* result = visit(statement);
+        if (result) {
+            folded.push_back(result);
+        }
+        changed |= result != statement;
+    }
+    return changed ? context->copy(folded) : statements;
+}
+
+// Expressions
+Expr* ConstantFolder::visitBinaryExpr(BinaryExpr* expr) {
+    std::vector<BinaryExpr*> chain = leftChain(expr);
+    Expr* left = visit(chain.front()->left);
+    for (BinaryExpr* link : chain) {
+        left = foldBinary(link, left, visit(link->right));
+    }
+    return left;
+}
+
+Expr* ConstantFolder::foldBinary(BinaryExpr* expr, Expr* left, Expr* right) {
+    Constant a = Constant::of(left);
+    Constant b = Constant::of(right);
+    if (a.known() && b.known()) {
+        // As CodeGen: arithmetic in the result's type, comparisons in the
+        // operands' wider type
+        ValueType type = expr->valueType;
+        if (type == ValueType::Bool) {
+            type = joinTypes(left->valueType, right->valueType);
+            if (type == ValueType::Bool) type = ValueType::Int;
+        }
+        Constant result = applyBinary(expr->op.type, type, a, b);
+        if (result.known()) {
+            return literal(result);
+        }
+    }
+    if (left == expr->left && right == expr->right) {
+        return expr;
+    }
+    BinaryExpr* binary = context->create<BinaryExpr>(left, expr->op, right);
+    binary->valueType = expr->valueType;
+    return binary;
+}
+
+Expr* ConstantFolder::visitLogicalExpr(LogicalExpr* expr) {
+    std::vector<LogicalExpr*> chain = leftChain(expr);
+    Expr* left = visit(chain.front()->left);
+    for (LogicalExpr* link : chain) {
+        left = foldLogical(link, left, visit(link->right));
+    }
+    return left;
+}
+
+Expr* ConstantFolder::foldLogical(LogicalExpr* expr, Expr* left, Expr* right) {
+    // The right operand is not evaluated when the left one decides
+    Constant a = Constant::of(left);
+    if (a.known()) {
+        bool isAnd = expr->op.type == TokenType::KW_AND;
+        Constant result;
+        result.type = ValueType::Bool;
+        if (a.isTrue() != isAnd) {
+            result.intValue = !isAnd;
+            return literal(result);
+        }
+        Constant b = Constant::of(right);
+        if (b.known()) {
+            result.intValue = b.isTrue();
+            return literal(result);
+        }
+    }
+    if (left == expr->left && right == expr->right) {
+        return expr;
+    }
+    LogicalExpr* logical = context->create<LogicalExpr>(left, expr->op, right);
+    logical->valueType = expr->valueType;
+    return logical;
+}
+
+Expr* ConstantFolder::visitGroupingExpr(GroupingExpr* expr) {
+    Expr* inner = visit(expr->expression);
+    if (inner->is<LiteralExpr>()) {
+        return inner;
+    }
+    if (inner == expr->expression) {
+        return expr;
+    }
+    GroupingExpr* grouping = context->create<GroupingExpr>(inner);
+    grouping->valueType = expr->valueType;
+    return grouping;
+}
+
+Expr* ConstantFolder::visitLiteralExpr(LiteralExpr* expr) {
+    return expr;
+}
+
+Expr* ConstantFolder::visitUnaryExpr(UnaryExpr* expr) {
+    Expr* operand = visit(expr->right);
+
+    Constant value = Constant::of(operand);
+    if (value.known()) {
+        Constant result;
+        if (expr->op.type == TokenType::KW_NOT) {
+            result.type = ValueType::Bool;
+            result.intValue = !value.isTrue();
+            return literal(result);
+        }
+        result = value.as(expr->valueType);
+        if (result.type == ValueType::Float) {
+            result.floatValue = -result.floatValue;
+            return literal(result);
+        }
+        if (result.type == ValueType::Int) {
+            result.intValue = static_cast<int64_t>(0 - static_cast<uint64_t>(result.intValue));
+            return literal(result);
+        }
+    }
+    if (operand == expr->right) {
+        return expr;
+    }
+    UnaryExpr* unary = context->create<UnaryExpr>(expr->op, operand);
+    unary->valueType = expr->valueType;
+    return unary;
+}
+
+Expr* ConstantFolder::visitVariableExpr(VariableExpr* expr) {
+    if (expr->slot < frame->constants.size() && frame->constants[expr->slot].known()) {
+        return literal(frame->constants[expr->slot]);
+    }
+    return expr;
+}
+
+Expr* ConstantFolder::visitAssignExpr(AssignExpr* expr) {
+    Expr* value = visit(expr->value);
+    if (value == expr->value) {
+        return expr;
+    }
+    AssignExpr* assign = context->create<AssignExpr>(expr->name, value);
+    assign->slot = expr->slot;
+    assign->valueType = expr->valueType;
+    return assign;
+}
+
+Expr* ConstantFolder::visitCallExpr(CallExpr* expr) {
+    // The callee names a function and has no slot to look at
+    bool changed = false;
+    bool constant = true;
+    std::vector<Expr*> arguments;
+    std::vector<Constant> values;
+    arguments.reserve(expr->arguments.size());
+    for (Expr* argument : expr->arguments) {
+        arguments.push_back(visit(argument));
+        changed |= arguments.back() != argument;
+        values.push_back(Constant::of(arguments.back()));
+        constant &= values.back().known();
+    }
+
+    // A pure function called with constants can be run now
+    VariableExpr* callee = expr->callee->as<VariableExpr>();
+    if (constant && callee) {
+        Constant result = evaluator.call(callee->name.symbol, values).as(expr->valueType);
+        if (result.known()) {
+            return literal(result);
+        }
+    }
+
+    if (!changed) {
+        return expr;
+    }
+    CallExpr* call = context->create<CallExpr>(expr->callee, expr->paren, context->copy(arguments));
+    call->valueType = expr->valueType;
+    return call;
+}
+
+// Statements
+Stmt* ConstantFolder::visitExpressionStmt(ExpressionStmt* stmt) {
+    Expr* expression = visit(stmt->expression);
+    if (expression->is<LiteralExpr>()) {
+        return nullptr;
+    }
+    return expression == stmt->expression ? stmt : context->create<ExpressionStmt>(expression);
+}
+
+Stmt* ConstantFolder::visitVarStmt(VarStmt* stmt) {
+    Expr* initializer = stmt->initializer ? visit(stmt->initializer) : nullptr;
+
+    // The value is stored, and read back, as the variable's type
+    Constant value = initializer ? Constant::of(initializer).as(stmt->valueType) : Constant();
+    bool assigned = stmt->slot < frame->assigned.size() && frame->assigned[stmt->slot];
+    if (value.known() && !assigned) {
+        if (stmt->slot >= frame->constants.size()) {
+            frame->constants.resize(stmt->slot + 1);
+        }
+        frame->constants[stmt->slot] = value;
+
+        // Nothing reads the variable any more, unless top-level code still
+        // to come assigns to it
+        if (!open || frame != &mainFrame) {
+            return nullptr;
+        }
+    }
+
+    if (initializer == stmt->initializer) {
+        return stmt;
+    }
+    VarStmt* var = context->create<VarStmt>(stmt->name, initializer, stmt->declaredType);
+    var->slot = stmt->slot;
+    var->valueType = stmt->valueType;
+    return var;
+}
+
+Stmt* ConstantFolder::visitBlockStmt(BlockStmt* stmt) {
+    bool changed = false;
+    Span<Stmt*> statements = foldAll(stmt->statements, changed);
+    if (statements.empty()) {
+        return nullptr;
+    }
+    return changed ? context->create<BlockStmt>(statements) : stmt;
+}
+
+Stmt* ConstantFolder::visitIfStmt(IfStmt* stmt) {
+    Expr* condition = visit(stmt->condition);
+    Stmt* thenBranch = visit(stmt->thenBranch);
+    Stmt* elseBranch = stmt->elseBranch ? visit(stmt->elseBranch) : nullptr;
+
+    Constant value = Constant::of(condition);
+    if (value.known()) {
+        bool taken = value.isTrue();
+        if (!definesFunction(taken ? elseBranch : thenBranch)) {
+            return taken ? thenBranch : elseBranch;
+        }
+    }
+
+    if (condition == stmt->condition && thenBranch == stmt->thenBranch && elseBranch == stmt->elseBranch) {
+        return stmt;
+    }
+    return context->create<IfStmt>(condition, orEmpty(thenBranch), elseBranch);
+}
+
+Stmt* ConstantFolder::visitWhileStmt(WhileStmt* stmt) {
+    Expr* condition = visit(stmt->condition);
+    Stmt* body = visit(stmt->body);
+
+    Constant value = Constant::of(condition);
+    if (value.known() && !value.isTrue() && !definesFunction(body)) {
+        return nullptr;
+    }
+
+    if (condition == stmt->condition && body == stmt->body) {
+        return stmt;
+    }
+    return context->create<WhileStmt>(condition, orEmpty(body));
+}
+
+Stmt* ConstantFolder::visitFunctionStmt(FunctionStmt* stmt) {
+    // A frame of its own; its body is all there is of it, so every
+    // assignment is known up front
+    Frame functionFrame;
+    Frame* outerFrame = frame;
+    frame = &functionFrame;
+    findAssignments(stmt->body);
+
+    bool changed = false;
+    Span<Stmt*> body = foldAll(stmt->body, changed);
+    frame = outerFrame;
+
+    if (!changed) {
+        return stmt;
+    }
+    FunctionStmt* function = context->create<FunctionStmt>(
+        stmt->name, stmt->params, stmt->declaredParamTypes, stmt->declaredReturnType,
+        stmt->paramTypes, body);
+    function->returnType = stmt->returnType;
+    function->slotCount = stmt->slotCount;
+    function->pure = stmt->pure;
+    function->recursive = stmt->recursive;
+    return function;
+}
+
+Stmt* ConstantFolder::visitReturnStmt(ReturnStmt* stmt) {
+    if (!stmt->value) {
+        return stmt;
+    }
+    Expr* value = visit(stmt->value);
+    return value == stmt->value ? stmt : context->create<ReturnStmt>(stmt->keyword, value);
+}
+
+} // namespace tribhasha
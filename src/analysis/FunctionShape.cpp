@@ -0,0 +1,207 @@
+#include "tribhasha/FunctionShape.h"
+#include <algorithm>
+#include <cstring>
+
+namespace tribhasha {
+
+namespace {
+
+// Words of the shape that are not kinds, slots or values
+enum Marker : uint64_t {
+    CallSelf = 1000,
+    CallOther,
+    NoValue
+};
+
+// Writes a function out as a sequence of words: the kind of each node in
+// prefix order, then what tells nodes of the kind apart
+class ShapeWriter : public ASTVisitor<ShapeWriter> {
+public:
+    ShapeWriter(std::vector<uint64_t>& words, Symbol self) : words(words), self(self) {}
+
+    void write(FunctionStmt* function) {
+        words.push_back(function->params.size());
+        for (size_t i = 0; i < function->params.size(); i++) {
+            words.push_back(static_cast<uint64_t>(function->paramTypes[i]));
+        }
+        words.push_back(static_cast<uint64_t>(function->returnType));
+        words.push_back(function->slotCount);
+        words.push_back(function->pure | function->recursive << 1);
+        words.push_back(function->body.size());
+        for (Stmt* statement : function->body) {
+            visit(statement);
+        }
+    }
+
+    void visitBinaryExpr(BinaryExpr* expr) {
+        // Still in prefix order: the operators from the outermost in, then
+        // the operands
+        std::vector<BinaryExpr*> chain = leftChain(expr);
+        for (auto link = chain.rbegin(); link != chain.rend(); ++link) {
+            expression(*link);
+            words.push_back(static_cast<uint64_t>(Keywords::normalizeKeywordType((*link)->op.type)));
+        }
+        visit(chain.front()->left);
+        for (BinaryExpr* link : chain) {
+            visit(link->right);
+        }
+    }
+    void visitLogicalExpr(LogicalExpr* expr) {
+        // Still in prefix order: the operators from the outermost in, then
+        // the operands
+        std::vector<LogicalExpr*> chain = leftChain(expr);
+        for (auto link = chain.rbegin(); link != chain.rend(); ++link) {
+            expression(*link);
+            words.push_back(static_cast<uint64_t>(Keywords::normalizeKeywordType((*link)->op.type)));
+        }
+        visit(chain.front()->left);
+        for (LogicalExpr* link : chain) {
+            visit(link->right);
+        }
+    }
+    void visitGroupingExpr(GroupingExpr* expr) {
+        expression(expr);
+        visit(expr->expression);
+    }
+    void visitLiteralExpr(LiteralExpr* expr) {
+        expression(expr);
+        words.push_back(static_cast<uint64_t>(Keywords::normalizeKeywordType(expr->type)));
+        if (expr->type == TokenType::INT_LITERAL) {
+            words.push_back(static_cast<uint64_t>(expr->intValue));
+        } else if (expr->type == TokenType::FLOAT_LITERAL) {
+            uint64_t bits;
+            std::memcpy(&bits, &expr->floatValue, sizeof bits);
+            words.push_back(bits);
+        } else if (expr->type == TokenType::STRING_LITERAL) {
+            words.push_back(expr->value.size());
+            for (size_t i = 0; i < expr->value.size(); i += sizeof(uint64_t)) {
+                uint64_t chunk = 0;
+                std::memcpy(&chunk, expr->value.data() + i, std::min(sizeof chunk, expr->value.size() - i));
+                words.push_back(chunk);
+            }
+        }
+    }
+    void visitUnaryExpr(UnaryExpr* expr) {
+        expression(expr);
+        words.push_back(static_cast<uint64_t>(Keywords::normalizeKeywordType(expr->op.type)));
+        visit(expr->right);
+    }
+    void visitVariableExpr(VariableExpr* expr) {
+        expression(expr);
+        words.push_back(expr->slot);
+    }
+    void visitAssignExpr(AssignExpr* expr) {
+        expression(expr);
+        words.push_back(expr->slot);
+        visit(expr->value);
+    }
+    void visitCallExpr(CallExpr* expr) {
+        expression(expr);
+        VariableExpr* callee = expr->callee->as<VariableExpr>();
+        Symbol name = callee ? callee->name.symbol : 0;
+        if (name == self) {
+            words.push_back(CallSelf);
+        } else {
+            words.push_back(CallOther);
+            words.push_back(name);
+        }
+        words.push_back(expr->arguments.size());
+        for (Expr* argument : expr->arguments) {
+            visit(argument);
+        }
+    }
+
+    void visitExpressionStmt(ExpressionStmt* stmt) {
+        statement(stmt);
+        visit(stmt->expression);
+    }
+    void visitVarStmt(VarStmt* stmt) {
+        statement(stmt);
+        words.push_back(stmt->slot);
+        words.push_back(static_cast<uint64_t>(stmt->declaredType));
+        words.push_back(static_cast<uint64_t>(stmt->valueType));
+        optional(stmt->initializer);
+    }
+    void visitBlockStmt(BlockStmt* stmt) {
+        statement(stmt);
+        words.push_back(stmt->statements.size());
+        for (Stmt* inner : stmt->statements) {
+            visit(inner);
+        }
+    }
+    void visitIfStmt(IfStmt* stmt) {
+        statement(stmt);
+        visit(stmt->condition);
+        visit(stmt->thenBranch);
+        if (stmt->elseBranch) {
+            visit(stmt->elseBranch);
+        } else {
+            words.push_back(NoValue);
+        }
+    }
+    void visitWhileStmt(WhileStmt* stmt) {
+        statement(stmt);
+        visit(stmt->condition);
+        visit(stmt->body);
+    }
+    void visitFunctionStmt(FunctionStmt* stmt) {
+        // A nested function is defined under its own name
+        statement(stmt);
+        words.push_back(stmt->name.symbol);
+        ShapeWriter(words, stmt->name.symbol).write(stmt);
+    }
+    void visitReturnStmt(ReturnStmt* stmt) {
+        statement(stmt);
+        optional(stmt->value);
+    }
+
+private:
+    std::vector<uint64_t>& words;
+    Symbol self;
+
+    // Kinds of expressions and statements get distinct words
+    void expression(Expr* expr) {
+        words.push_back(static_cast<uint64_t>(expr->getKind()));
+        words.push_back(static_cast<uint64_t>(expr->valueType));
+    }
+    void statement(Stmt* stmt) {
+        words.push_back(0x100 + static_cast<uint64_t>(stmt->getKind()));
+    }
+    void optional(Expr* expr) {
+        if (expr) {
+            visit(expr);
+        } else {
+            words.push_back(NoValue);
+        }
+    }
+};
+
+} // namespace
+
+FunctionShape::FunctionShape(FunctionStmt* function) {
+    ShapeWriter(words, function->name.symbol).write(function);
+
+    // FNV-1a over the words
+    hashValue = 0xcbf29ce484222325;
+    for (uint64_t word : words) {
+        hashValue = (hashValue ^ word) * 0x100000001b3;
+    }
+}
+
+const std::string* FunctionShapes::find(const FunctionShape& shape) const {
+    auto found = known.find(shape.hash());
+    if (found == known.end()) {
+        return nullptr;
+    }
+    for (const auto& [candidate, name] : found->second) {
+        if (candidate == shape) return &name;
+    }
+    return nullptr;
+}
+
+void FunctionShapes::add(FunctionShape shape, std::string name) {
+    uint64_t hash = shape.hash();
+    known[hash].emplace_back(std::move(shape), std::move(name));
+}
+
+} // namespace tribhasha
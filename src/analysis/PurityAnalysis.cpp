@@ -0,0 +1,220 @@
+#include "tribhasha/PurityAnalysis.h"
+#include <algorithm>
+#include <unordered_map>
+
+namespace tribhasha {
+
+namespace {
+
+constexpr size_t noFunction = ~size_t(0);
+
+// Marks every function that is part of a cycle of `calls` (indices into
+// `functions`), with Tarjan's algorithm. Kept iterative, since call chains
+// can be long.
+void findCycles(const std::vector<std::vector<size_t>>& calls, std::vector<FunctionStmt*>& functions) {
+    size_t count = calls.size();
+    std::vector<size_t> order(count, noFunction);
+    std::vector<size_t> low(count);
+    std::vector<bool> onStack(count);
+    std::vector<size_t> stack;
+    std::vector<std::pair<size_t, size_t>> work;  // function, next call
+    size_t visited = 0;
+
+    for (size_t root = 0; root < count; root++) {
+        if (order[root] != noFunction) continue;
+        order[root] = low[root] = visited++;
+        stack.push_back(root);
+        onStack[root] = true;
+        work.emplace_back(root, 0);
+
+        while (!work.empty()) {
+            auto& [function, next] = work.back();
+            if (next < calls[function].size()) {
+                size_t callee = calls[function][next++];
+                if (callee == function) {
+                    functions[function]->recursive = true;
+                } else if (order[callee] == noFunction) {
+                    order[callee] = low[callee] = visited++;
+                    stack.push_back(callee);
+                    onStack[callee] = true;
+                    work.emplace_back(callee, 0);
+                } else if (onStack[callee]) {
+                    low[function] = std::min(low[function], order[callee]);
+                }
+                continue;
+            }
+
+            size_t done = function;
+            work.pop_back();
+            if (!work.empty()) {
+                size_t caller = work.back().first;
+                low[caller] = std::min(low[caller], low[done]);
+            }
+            if (low[done] != order[done]) continue;
+
+            // `done` is the root of a strongly connected component
+            size_t member;
+            bool cycle = stack.back() != done;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                onStack[member] = false;
+                if (cycle) functions[member]->recursive = true;
+            } while (member != done);
+        }
+    }
+}
+
+} // namespace
+
+PurityAnalysis::PurityAnalysis() : current(noFunction) {}
+
+PurityAnalysis::Purity& PurityAnalysis::purityOf(Symbol name) {
+    if (name >= purity.size()) {
+        purity.resize(std::max<size_t>(name + 1, Interner::global().limit()), Purity::Undefined);
+    }
+    return purity[name];
+}
+
+bool PurityAnalysis::isPure(Symbol name) const {
+    return name < purity.size() && purity[name] == Purity::Pure;
+}
+
+void PurityAnalysis::analyze(const std::vector<Stmt*>& statements) {
+    functions.clear();
+    current = noFunction;
+    for (Stmt* statement : statements) {
+        visit(statement);
+    }
+
+    // Start from every new function being pure (unless a definition of
+    // the same name was not) and take it back from those that call
+    // anything else, until nothing changes
+    for (Function& function : functions) {
+        Purity& known = purityOf(function.stmt->name.symbol);
+        if (known == Purity::Undefined) known = Purity::Pure;
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (Function& function : functions) {
+            Purity& known = purityOf(function.stmt->name.symbol);
+            if (known != Purity::Pure) continue;
+            for (Symbol callee : function.callees) {
+                if (!isPure(callee)) {
+                    known = Purity::Impure;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // Calls between the new functions; a call by name reaches every
+    // definition of it
+    std::unordered_map<Symbol, std::vector<size_t>> byName;
+    for (size_t i = 0; i < functions.size(); i++) {
+        byName[functions[i].stmt->name.symbol].push_back(i);
+    }
+    std::vector<std::vector<size_t>> calls(functions.size());
+    std::vector<FunctionStmt*> stmts;
+    for (size_t i = 0; i < functions.size(); i++) {
+        for (Symbol callee : functions[i].callees) {
+            auto found = byName.find(callee);
+            if (found == byName.end()) continue;
+            calls[i].insert(calls[i].end(), found->second.begin(), found->second.end());
+        }
+        FunctionStmt* stmt = functions[i].stmt;
+        stmt->pure = isPure(stmt->name.symbol);
+        stmt->recursive = false;
+        stmts.push_back(stmt);
+    }
+    findCycles(calls, stmts);
+}
+
+// Expressions
+void PurityAnalysis::visitBinaryExpr(BinaryExpr* expr) {
+    std::vector<BinaryExpr*> chain = leftChain(expr);
+    visit(chain.front()->left);
+    for (BinaryExpr* link : chain) {
+        visit(link->right);
+    }
+}
+
+void PurityAnalysis::visitLogicalExpr(LogicalExpr* expr) {
+    std::vector<LogicalExpr*> chain = leftChain(expr);
+    visit(chain.front()->left);
+    for (LogicalExpr* link : chain) {
+        visit(link->right);
+    }
+}
+
+void PurityAnalysis::visitGroupingExpr(GroupingExpr* expr) {
+    visit(expr->expression);
+}
+
+void PurityAnalysis::visitLiteralExpr(LiteralExpr*) {}
+
+void PurityAnalysis::visitUnaryExpr(UnaryExpr* expr) {
+    visit(expr->right);
+}
+
+void PurityAnalysis::visitVariableExpr(VariableExpr*) {}
+
+void PurityAnalysis::visitAssignExpr(AssignExpr* expr) {
+    visit(expr->value);
+}
+
+void PurityAnalysis::visitCallExpr(CallExpr* expr) {
+    if (current != noFunction) {
+        // A callee that is not a plain name never resolves to a function;
+        // symbol 0 is never defined
+        VariableExpr* callee = expr->callee->as<VariableExpr>();
+        functions[current].callees.push_back(callee ? callee->name.symbol : 0);
+    }
+    for (Expr* argument : expr->arguments) {
+        visit(argument);
+    }
+}
+
+// Statements
+void PurityAnalysis::visitExpressionStmt(ExpressionStmt* stmt) {
+    visit(stmt->expression);
+}
+
+void PurityAnalysis::visitVarStmt(VarStmt* stmt) {
+    if (stmt->initializer) visit(stmt->initializer);
+}
+
+void PurityAnalysis::visitBlockStmt(BlockStmt* stmt) {
+    for (Stmt* statement : stmt->statements) {
+        visit(statement);
+    }
+}
+
+void PurityAnalysis::visitIfStmt(IfStmt* stmt) {
+    visit(stmt->condition);
+    visit(stmt->thenBranch);
+    if (stmt->elseBranch) visit(stmt->elseBranch);
+}
+
+void PurityAnalysis::visitWhileStmt(WhileStmt* stmt) {
+    visit(stmt->condition);
+    visit(stmt->body);
+}
+
+void PurityAnalysis::visitFunctionStmt(FunctionStmt* stmt) {
+    size_t outer = current;
+    current = functions.size();
+    functions.push_back({stmt, {}});
+    for (Stmt* statement : stmt->body) {
+        visit(statement);
+    }
+    current = outer;
+}
+
+void PurityAnalysis::visitReturnStmt(ReturnStmt* stmt) {
+    if (stmt->value) visit(stmt->value);
+}
+
+} // namespace tribhasha
@@ -0,0 +1,151 @@
+#include "tribhasha/Resolver.h"
+#include <algorithm>
+
+namespace tribhasha {
+
+void Resolver::resolve(const std::vector<Stmt*>& statements) {
+    for (Stmt* statement : statements) {
+        resolve(statement);
+    }
+}
+
+void Resolver::resolve(Stmt* statement) {
+    base = statement->base;
+    visit(statement);
+    mainSlots = nextSlot;
+}
+
+uint32_t Resolver::declare(Symbol name) {
+    if (name >= bindings.size()) {
+        bindings.resize(std::max<size_t>(name + 1, Interner::global().limit()), Binding{unbound, 0});
+    }
+    shadowed.emplace_back(name, bindings[name]);
+    bindings[name] = Binding{currentFunction, nextSlot};
+    return nextSlot++;
+}
+
+uint32_t Resolver::lookup(const Token& name) {
+    // Bindings made in an enclosing function are not visible
+    if (name.symbol < bindings.size() && bindings[name.symbol].function == currentFunction) {
+        return bindings[name.symbol].slot;
+    }
+    diagnostics.error(base + name.offset, name.length, "Undefined variable.");
+    return 0;
+}
+
+void Resolver::endScope(size_t mark) {
+    // Undo the bindings made since `mark`, newest first
+    while (shadowed.size() > mark) {
+        bindings[shadowed.back().first] = shadowed.back().second;
+        shadowed.pop_back();
+    }
+}
+
+// Expressions
+void Resolver::visitBinaryExpr(BinaryExpr* expr) {
+    std::vector<BinaryExpr*> chain = leftChain(expr);
+    visit(chain.front()->left);
+    for (BinaryExpr* link : chain) {
+        visit(link->right);
+    }
+}
+
+void Resolver::visitLogicalExpr(LogicalExpr* expr) {
+    std::vector<LogicalExpr*> chain = leftChain(expr);
+    visit(chain.front()->left);
+    for (LogicalExpr* link : chain) {
+        visit(link->right);
+    }
+}
+
+void Resolver::visitGroupingExpr(GroupingExpr* expr) {
+    visit(expr->expression);
+}
+
+void Resolver::visitLiteralExpr(LiteralExpr*) {}
+
+void Resolver::visitUnaryExpr(UnaryExpr* expr) {
+    visit(expr->right);
+}
+
+void Resolver::visitVariableExpr(VariableExpr* expr) {
+    expr->slot = lookup(expr->name);
+}
+
+void Resolver::visitAssignExpr(AssignExpr* expr) {
+    visit(expr->value);
+    expr->slot = lookup(expr->name);
+}
+
+void Resolver::visitCallExpr(CallExpr* expr) {
+    // Functions are called by name
+    if (!expr->callee->is<VariableExpr>()) {
+        visit(expr->callee);
+    }
+    for (Expr* argument : expr->arguments) {
+        visit(argument);
+    }
+}
+
+// Statements
+void Resolver::visitExpressionStmt(ExpressionStmt* stmt) {
+    visit(stmt->expression);
+}
+
+void Resolver::visitVarStmt(VarStmt* stmt) {
+    // The initializer still sees any variable the new one shadows
+    if (stmt->initializer) {
+        visit(stmt->initializer);
+    }
+    stmt->slot = declare(stmt->name.symbol);
+}
+
+void Resolver::visitBlockStmt(BlockStmt* stmt) {
+    size_t scope = shadowed.size();
+    for (Stmt* statement : stmt->statements) {
+        visit(statement);
+    }
+    endScope(scope);
+}
+
+void Resolver::visitIfStmt(IfStmt* stmt) {
+    visit(stmt->condition);
+    visit(stmt->thenBranch);
+    if (stmt->elseBranch) {
+        visit(stmt->elseBranch);
+    }
+}
+
+void Resolver::visitWhileStmt(WhileStmt* stmt) {
+    visit(stmt->condition);
+    visit(stmt->body);
+}
+
+void Resolver::visitFunctionStmt(FunctionStmt* stmt) {
+    // A fresh frame; the enclosing one carries on after the body
+    uint32_t outerFunction = currentFunction;
+    uint32_t outerSlot = nextSlot;
+    currentFunction = ++functionCount;
+    nextSlot = 0;
+    size_t scope = shadowed.size();
+
+    for (const Token& param : stmt->params) {
+        declare(param.symbol);
+    }
+    for (Stmt* statement : stmt->body) {
+        visit(statement);
+    }
+    stmt->slotCount = nextSlot;
+
+    endScope(scope);
+    currentFunction = outerFunction;
+    nextSlot = outerSlot;
+}
+
+void Resolver::visitReturnStmt(ReturnStmt* stmt) {
+    if (stmt->value) {
+        visit(stmt->value);
+    }
+}
+
+} // namespace tribhasha
@@ -0,0 +1,356 @@
+#include "tribhasha/TypeInference.h"
+#include <algorithm>
+#include <string>
+
+namespace tribhasha {
+
+namespace {
+
+// Arithmetic on booleans counts them as integers
+ValueType arithmetic(ValueType left, ValueType right) {
+    ValueType type = joinTypes(left, right);
+    return type == ValueType::Bool ? ValueType::Int : type;
+}
+
+// Whether a value can go where `declared` is expected
+bool fits(ValueType value, ValueType declared) {
+    return value == declared || value == ValueType::Unknown ||
+           (value == ValueType::Int && declared == ValueType::Float);
+}
+
+// Whether one of two known types is a String and the other is not
+bool mixes(ValueType a, ValueType b) {
+    return a != ValueType::Unknown && b != ValueType::Unknown &&
+           (a == ValueType::String) != (b == ValueType::String);
+}
+
+const char* typeName(ValueType type) {
+    switch (type) {
+        case ValueType::Bool: return "bool";
+        case ValueType::Int: return "int";
+        case ValueType::Float: return "float";
+        case ValueType::String: return "string";
+        default: return "unknown";
+    }
+}
+
+} // namespace
+
+TypeInference::TypeInference(bool open) : frames(1), open(open) {}
+
+void TypeInference::infer(const std::vector<Stmt*>& statements) {
+    // Frames of functions from earlier calls are not needed again; main's
+    // carries on
+    frames.resize(1);
+
+    do {
+        do {
+            changed = false;
+            walk(statements);
+        } while (changed);
+    } while (settleUnknowns());
+
+    reporting = true;
+    walk(statements);
+    reporting = false;
+
+    if (open) {
+        for (Signature& signature : signatures) {
+            signature.sealed = signature.defined;
+        }
+        for (Slot& slot : frames[0]) {
+            slot.sealed = true;
+        }
+    }
+}
+
+void TypeInference::walk(const std::vector<Stmt*>& statements) {
+    functionCount = 0;
+    for (Stmt* statement : statements) {
+        base = statement->base;
+        visit(statement);
+
+        // Statements not seen yet may store anything in a top-level
+        // variable of an open program
+        VarStmt* variable = statement->as<VarStmt>();
+        if (open && variable) {
+            Slot& slot = slotAt(variable->slot);
+            if (!slot.declared && slot.type != ValueType::String) {
+                widen(slot.type, ValueType::Float);
+            }
+        }
+    }
+}
+
+void TypeInference::widen(ValueType& type, ValueType with) {
+    ValueType joined = joinTypes(type, with);
+    if (joined != type) {
+        type = joined;
+        changed = true;
+    }
+}
+
+void TypeInference::store(ValueType& type, bool declared, ValueType value, const Token& at, bool sealed) {
+    if (!declared) {
+        // Once the types settle, `type` is a String wherever a string went
+        // (unless it was sealed before), so any number stored there mixes
+        if (reporting && mixes(type, value)) {
+            diagnostics.error(base + at.offset, at.length,
+                              std::string("Cannot mix ") + typeName(type) + " and " + typeName(value) + " values.");
+        }
+        if (!sealed) {
+            widen(type, value);
+        }
+    } else if (reporting && !fits(value, type)) {
+        diagnostics.error(base + at.offset, at.length,
+                          std::string("Expected ") + typeName(type) + ", got " + typeName(value) + ".");
+    }
+}
+
+TypeInference::Slot& TypeInference::slotAt(uint32_t slot) {
+    // Main's frame grows as top-level code is added
+    std::vector<Slot>& frame = frames[currentFrame];
+    if (slot >= frame.size()) {
+        frame.resize(slot + 1);
+    }
+    return frame[slot];
+}
+
+TypeInference::Signature* TypeInference::signatureOf(Symbol name) {
+    if (name >= signatures.size()) {
+        signatures.resize(std::max<size_t>(name + 1, Interner::global().limit()));
+    }
+    return &signatures[name];
+}
+
+bool TypeInference::settleUnknowns() {
+    bool settled = false;
+    auto settle = [&](ValueType& type) {
+        if (type == ValueType::Unknown) {
+            type = ValueType::Float;
+            settled = true;
+        }
+    };
+
+    for (std::vector<Slot>& frame : frames) {
+        for (Slot& slot : frame) {
+            settle(slot.type);
+        }
+    }
+    for (Signature& signature : signatures) {
+        if (signature.defined && !signature.sealed) {
+            std::for_each(signature.params.begin(), signature.params.end(), settle);
+            settle(signature.result);
+        }
+    }
+    return settled;
+}
+
+// Expressions
+ValueType TypeInference::visitBinaryExpr(BinaryExpr* expr) {
+    std::vector<BinaryExpr*> chain = leftChain(expr);
+    ValueType left = visit(chain.front()->left);
+    for (BinaryExpr* link : chain) {
+        ValueType right = visit(link->right);
+        switch (link->op.type) {
+            case TokenType::PLUS:
+            case TokenType::MINUS:
+            case TokenType::STAR:
+            case TokenType::MODULO:
+                left = link->valueType = arithmetic(left, right);
+                break;
+            case TokenType::SLASH:
+                // 7 / 2 is 3.5, whatever the operands are
+                left = link->valueType = joinTypes(arithmetic(left, right), ValueType::Float);
+                break;
+            default:
+                left = link->valueType = ValueType::Bool;
+                break;
+        }
+    }
+    return left;
+}
+
+ValueType TypeInference::visitLogicalExpr(LogicalExpr* expr) {
+    std::vector<LogicalExpr*> chain = leftChain(expr);
+    visit(chain.front()->left);
+    for (LogicalExpr* link : chain) {
+        visit(link->right);
+        link->valueType = ValueType::Bool;
+    }
+    return ValueType::Bool;
+}
+
+ValueType TypeInference::visitGroupingExpr(GroupingExpr* expr) {
+    return expr->valueType = visit(expr->expression);
+}
+
+ValueType TypeInference::visitLiteralExpr(LiteralExpr* expr) {
+    switch (expr->type) {
+        case TokenType::INT_LITERAL:
+            return expr->valueType = ValueType::Int;
+        case TokenType::STRING_LITERAL:
+            return expr->valueType = ValueType::String;
+        case TokenType::KW_TRUE:
+        case TokenType::KW_FALSE:
+            return expr->valueType = ValueType::Bool;
+        default:
+            return expr->valueType = ValueType::Float;
+    }
+}
+
+ValueType TypeInference::visitUnaryExpr(UnaryExpr* expr) {
+    ValueType operand = visit(expr->right);
+    if (expr->op.type == TokenType::KW_NOT) {
+        return expr->valueType = ValueType::Bool;
+    }
+    return expr->valueType = arithmetic(operand, ValueType::Unknown);
+}
+
+ValueType TypeInference::visitVariableExpr(VariableExpr* expr) {
+    return expr->valueType = slotAt(expr->slot).type;
+}
+
+ValueType TypeInference::visitAssignExpr(AssignExpr* expr) {
+    ValueType value = visit(expr->value);
+    Slot& slot = slotAt(expr->slot);
+    store(slot.type, slot.declared, value, expr->name, slot.sealed);
+    return expr->valueType = slot.type;
+}
+
+ValueType TypeInference::visitCallExpr(CallExpr* expr) {
+    VariableExpr* callee = expr->callee->as<VariableExpr>();
+    if (!callee) {
+        visit(expr->callee);
+    }
+
+    std::vector<ValueType> arguments;
+    arguments.reserve(expr->arguments.size());
+    for (Expr* argument : expr->arguments) {
+        arguments.push_back(visit(argument));
+    }
+
+    // Anything that is not a function of the program returns a Float
+    Signature* signature = callee ? signatureOf(callee->name.symbol) : nullptr;
+    if (!signature || !signature->defined) {
+        return expr->valueType = ValueType::Float;
+    }
+
+    // Calls can still widen the parameters of a function that is not
+    // compiled yet, but never past a declared type
+    size_t count = std::min(arguments.size(), signature->params.size());
+    for (size_t i = 0; i < count; i++) {
+        store(signature->params[i], signature->declaredParams[i], arguments[i], callee->name, signature->sealed);
+    }
+    return expr->valueType = signature->result;
+}
+
+// Statements
+void TypeInference::visitExpressionStmt(ExpressionStmt* stmt) {
+    visit(stmt->expression);
+}
+
+void TypeInference::visitVarStmt(VarStmt* stmt) {
+    ValueType initial = stmt->initializer ? visit(stmt->initializer) : ValueType::Unknown;
+    Slot& slot = slotAt(stmt->slot);
+    if (stmt->declaredType != ValueType::Unknown) {
+        slot.type = stmt->declaredType;
+        slot.declared = true;
+    }
+    store(slot.type, slot.declared, initial, stmt->name, slot.sealed);
+    stmt->valueType = slot.type;
+}
+
+void TypeInference::visitBlockStmt(BlockStmt* stmt) {
+    for (Stmt* statement : stmt->statements) {
+        visit(statement);
+    }
+}
+
+void TypeInference::visitIfStmt(IfStmt* stmt) {
+    visit(stmt->condition);
+    visit(stmt->thenBranch);
+    if (stmt->elseBranch) {
+        visit(stmt->elseBranch);
+    }
+}
+
+void TypeInference::visitWhileStmt(WhileStmt* stmt) {
+    visit(stmt->condition);
+    visit(stmt->body);
+}
+
+void TypeInference::visitFunctionStmt(FunctionStmt* stmt) {
+    // A function compiled earlier is being replaced
+    Symbol name = stmt->name.symbol;
+    Signature* signature = signatureOf(name);
+    if (signature->sealed) {
+        *signature = Signature();
+    }
+    signature->defined = true;
+    if (signature->params.size() < stmt->params.size()) {
+        signature->params.resize(stmt->params.size(), ValueType::Unknown);
+        signature->declaredParams.resize(stmt->params.size(), false);
+    }
+
+    // Declared types are fixed. Otherwise, in an open program, the calls
+    // that matter have not been seen yet.
+    for (size_t i = 0; i < stmt->params.size(); i++) {
+        if (stmt->declaredParamTypes[i] != ValueType::Unknown) {
+            signature->params[i] = stmt->declaredParamTypes[i];
+            signature->declaredParams[i] = true;
+        } else if (open) {
+            widen(signature->params[i], ValueType::Float);
+        }
+    }
+    if (stmt->declaredReturnType != ValueType::Unknown) {
+        signature->result = stmt->declaredReturnType;
+        signature->declaredResult = true;
+    }
+
+    size_t outerFrame = currentFrame;
+    Symbol outerFunction = currentFunction;
+    bool outerInFunction = inFunction;
+    currentFrame = ++functionCount;
+    currentFunction = name;
+    inFunction = true;
+    if (currentFrame == frames.size()) {
+        frames.emplace_back(stmt->slotCount);
+    }
+
+    // Parameters hold what the calls pass in, and whatever the body
+    // stores in them
+    for (uint32_t i = 0; i < stmt->params.size(); i++) {
+        Slot& slot = slotAt(i);
+        slot.declared = signatures[name].declaredParams[i];
+        if (slot.declared) {
+            slot.type = signatures[name].params[i];
+        } else {
+            widen(slot.type, signatures[name].params[i]);
+        }
+    }
+    for (Stmt* statement : stmt->body) {
+        visit(statement);
+    }
+    for (uint32_t i = 0; i < stmt->params.size(); i++) {
+        if (!signatures[name].declaredParams[i]) {
+            widen(signatures[name].params[i], slotAt(i).type);
+        }
+        stmt->paramTypes[i] = signatures[name].params[i];
+    }
+    stmt->returnType = signatures[name].result;
+
+    currentFrame = outerFrame;
+    currentFunction = outerFunction;
+    inFunction = outerInFunction;
+}
+
+void TypeInference::visitReturnStmt(ReturnStmt* stmt) {
+    ValueType value = stmt->value ? visit(stmt->value) : ValueType::Unknown;
+    if (inFunction) {
+        Signature& signature = signatures[currentFunction];
+        store(signature.result, signature.declaredResult, value, stmt->keyword);
+    }
+}
+
+} // namespace tribhasha
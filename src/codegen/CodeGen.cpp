@@ -1,15 +1,121 @@
 #include "tribhasha/CodeGen.h"
+#include <algorithm>
 #include <iostream>
+#include <optional>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Function.h>
+#include <llvm/IR/GlobalAlias.h>
+#include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Verifier.h>
 
 namespace tribhasha {
 
-CodeGen::CodeGen() : builder(context) {
+namespace {
+
+// Results a memoized function keeps (a power of two), and how many slots
+// a lookup tries before a new result overwrites the first
+constexpr uint64_t memoSlots = 1 << 12;
+constexpr uint64_t memoProbes = 8;
+
+llvm::StringRef toStringRef(std::string_view text) {
+    return llvm::StringRef(text.data(), text.size());
+}
+
+// Identifier tokens carry their symbol, so no source text is needed
+std::string_view nameOf(const Token& identifier) {
+    return Interner::global().name(identifier.symbol);
+}
+
+// The type arithmetic and comparisons on two operands are done in;
+// booleans count as integers
+ValueType operandType(Expr* left, Expr* right) {
+    ValueType type = joinTypes(left->valueType, right->valueType);
+    return type == ValueType::Bool ? ValueType::Int : type;
+}
+
+bool definesFunction(Stmt* statement) {
+    if (!statement) return false;
+    switch (statement->getKind()) {
+        case StmtKind::Function:
+            return true;
+        case StmtKind::Block:
+            for (Stmt* inner : statement->as<BlockStmt>()->statements) {
+                if (definesFunction(inner)) return true;
+            }
+            return false;
+        case StmtKind::If: {
+            IfStmt* branch = statement->as<IfStmt>();
+            return definesFunction(branch->thenBranch) || definesFunction(branch->elseBranch);
+        }
+        case StmtKind::While:
+            return definesFunction(statement->as<WhileStmt>()->body);
+        default:
+            return false;
+    }
+}
+
+// Long operator chains are walked with a list of what is left to look at
+// rather than by recursing
+bool assigns(Expr* expr) {
+    std::vector<Expr*> pending{expr};
+    while (!pending.empty()) {
+        Expr* next = pending.back();
+        pending.pop_back();
+        switch (next->getKind()) {
+            case ExprKind::Binary:
+                pending.push_back(next->as<BinaryExpr>()->left);
+                pending.push_back(next->as<BinaryExpr>()->right);
+                break;
+            case ExprKind::Logical:
+                pending.push_back(next->as<LogicalExpr>()->left);
+                pending.push_back(next->as<LogicalExpr>()->right);
+                break;
+            case ExprKind::Grouping:
+                pending.push_back(next->as<GroupingExpr>()->expression);
+                break;
+            case ExprKind::Unary:
+                pending.push_back(next->as<UnaryExpr>()->right);
+                break;
+            case ExprKind::Assign:
+                return true;
+            case ExprKind::Call:
+                for (Expr* argument : next->as<CallExpr>()->arguments) {
+                    pending.push_back(argument);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return false;
+}
+
+// The calls whose results `expr` combines, outside the arguments of other
+// calls, from left to right
+void combinedCalls(Expr* expr, std::vector<CallExpr*>& calls) {
+    std::vector<Expr*> pending{expr};
+    while (!pending.empty()) {
+        Expr* next = pending.back();
+        pending.pop_back();
+        if (BinaryExpr* binary = next->as<BinaryExpr>()) {
+            pending.push_back(binary->right);
+            pending.push_back(binary->left);
+        } else if (GroupingExpr* grouping = next->as<GroupingExpr>()) {
+            pending.push_back(grouping->expression);
+        } else if (CallExpr* call = next->as<CallExpr>()) {
+            calls.push_back(call);
+        }
+    }
+}
+
+} // namespace
+
+CodeGen::CodeGen(FunctionTable* sharedFunctions)
+    : ownedContext(std::make_unique<llvm::LLVMContext>()), context(*ownedContext),
+      builder(context), sharedFunctions(sharedFunctions) {
     initialize();
 }
 
@@ -38,14 +144,29 @@ std::unique_ptr<llvm::Module> CodeGen::getModule() {
     return std::move(module);
 }
 
-void CodeGen::generate(const std::vector<std::shared_ptr<Stmt>>& statements) {
+llvm::orc::ThreadSafeModule CodeGen::takeThreadSafeModule() {
+    return llvm::orc::ThreadSafeModule(std::move(module), std::move(ownedContext));
+}
+
+void CodeGen::generate(const std::vector<Stmt*>& statements) {
+    beginProgram();
+    
+    // Generate code for each statement
+    for (const auto& stmt : statements) {
+        visit(stmt);
+    }
+    
+    finishProgram();
+}
+
+void CodeGen::beginProgram() {
     // Create a main function for the program
     llvm::FunctionType* mainType = llvm::FunctionType::get(
         llvm::Type::getInt32Ty(context),
         false
     );
     
-    llvm::Function* main = llvm::Function::Create(
+    mainFunction = llvm::Function::Create(
         mainType,
         llvm::Function::ExternalLinkage,
         "main",
@@ -53,28 +174,30 @@ void CodeGen::generate(const std::vector<std::shared_ptr<Stmt>>& statements) {
     );
     
     // Create a basic block to start insertion into
-    llvm::BasicBlock* block = llvm::BasicBlock::Create(context, "entry", main);
+    llvm::BasicBlock* block = llvm::BasicBlock::Create(context, "entry", mainFunction);
     builder.SetInsertPoint(block);
     
     // Set current function
-    currentFunction = main;
-    
-    // Generate code for each statement
-    for (const auto& stmt : statements) {
-        stmt->accept(this);
-    }
-    
+    currentFunction = mainFunction;
+}
+
+void CodeGen::generate(Stmt* statement) {
+    visit(statement);
+}
+
+void CodeGen::finishProgram() {
     // Return 0 from main
     builder.CreateRet(llvm::ConstantInt::get(context, llvm::APInt(32, 0)));
     
     // Verify the function
-    llvm::verifyFunction(*main);
+    llvm::verifyFunction(*mainFunction);
+    mainFunction = nullptr;
 }
 
 // Helper methods
-llvm::AllocaInst* CodeGen::createEntryBlockAlloca(llvm::Function* function, const std::string& varName) {
+llvm::AllocaInst* CodeGen::createEntryBlockAlloca(llvm::Function* function, llvm::StringRef varName, llvm::Type* type) {
     llvm::IRBuilder<> tempBuilder(&function->getEntryBlock(), function->getEntryBlock().begin());
-    return tempBuilder.CreateAlloca(llvm::Type::getDoubleTy(context), 0, varName.c_str());
+    return tempBuilder.CreateAlloca(type, 0, varName);
 }
 
 llvm::Value* CodeGen::logErrorV(const std::string& str) {
@@ -82,72 +205,487 @@ llvm::Value* CodeGen::logErrorV(const std::string& str) {
     return nullptr;
 }
 
-llvm::Function* CodeGen::getFunction(const std::string& name) {
-    // First, check if the function is in our module
-    if (auto* F = module->getFunction(name)) {
-        return F;
+llvm::Value* CodeGen::toCondition(llvm::Value* value, const llvm::Twine& name) {
+    // Comparisons already produce an i1; numbers are true when non-zero
+    llvm::Type* type = value->getType();
+    if (type->isIntegerTy(1)) {
+        return value;
+    }
+    if (type->isFloatingPointTy()) {
+        return builder.CreateFCmpONE(value, llvm::ConstantFP::get(type, 0.0), name);
+    }
+    return builder.CreateICmpNE(value, llvm::ConstantInt::get(type, 0), name);
+}
+
+llvm::Type* CodeGen::typeOf(ValueType type) {
+    switch (type) {
+        case ValueType::Bool:
+            return llvm::Type::getInt1Ty(context);
+        case ValueType::Int:
+            return llvm::Type::getInt64Ty(context);
+        case ValueType::String:
+            return llvm::Type::getInt8PtrTy(context);
+        default:
+            // Floats, and anything the inference did not see
+            return llvm::Type::getDoubleTy(context);
+    }
+}
+
+llvm::Value* CodeGen::convert(llvm::Value* value, llvm::Type* type) {
+    llvm::Type* from = value->getType();
+    if (from == type) {
+        return value;
+    }
+    
+    // Booleans are 0 and 1; numbers are true when non-zero
+    if (type->isIntegerTy(1) && (from->isIntegerTy() || from->isFloatingPointTy())) {
+        return toCondition(value, "tobool");
+    }
+    if (from->isIntegerTy() && type->isFloatingPointTy()) {
+        return from->isIntegerTy(1) ? builder.CreateUIToFP(value, type, "tofloat")
+                                    : builder.CreateSIToFP(value, type, "tofloat");
+    }
+    if (from->isFloatingPointTy() && type->isIntegerTy()) {
+        return builder.CreateFPToSI(value, type, "toint");
+    }
+    if (from->isIntegerTy() && type->isIntegerTy()) {
+        return builder.CreateIntCast(value, type, !from->isIntegerTy(1), "toint");
+    }
+    return logErrorV("Cannot convert between a string and a number");
+}
+
+llvm::Function* CodeGen::getFunction(Symbol name) {
+    // Functions defined in the program
+    if (name < functions.size() && functions[name]) {
+        return functions[name];
     }
     
-    // If not, check if we can codegen the declaration now
-    auto it = functions.find(name);
-    if (it != functions.end()) {
-        return it->second;
+    // Otherwise anything already declared in the module, such as printf
+    llvm::StringRef spelling = toStringRef(Interner::global().name(name));
+    if (llvm::Function* function = module->getFunction(spelling)) {
+        return function;
     }
     
-    return nullptr;
+    // Or a function generated into another module of the program
+    const FunctionTable::Signature* signature = sharedFunctions ? sharedFunctions->find(name) : nullptr;
+    if (!signature) {
+        return nullptr;
+    }
+    std::vector<llvm::Type*> argTypes;
+    for (ValueType type : signature->params) {
+        argTypes.push_back(typeOf(type));
+    }
+    llvm::FunctionType* functionType = llvm::FunctionType::get(typeOf(signature->result), argTypes, false);
+    if (llvm::Function* function = module->getFunction(signature->linkName)) {
+        return function;
+    }
+    return llvm::Function::Create(functionType, llvm::Function::ExternalLinkage, signature->linkName, module.get());
+}
+
+llvm::AllocaInst* CodeGen::lookupVariable(uint32_t slot) const {
+    // Empty if the declaration's initializer failed to generate
+    return slot < frame.size() ? frame[slot] : nullptr;
+}
+
+void CodeGen::bindVariable(uint32_t slot, llvm::AllocaInst* alloca) {
+    // Top-level code is generated as it is resolved, so main's frame grows
+    if (slot >= frame.size()) {
+        frame.resize(slot + 1, nullptr);
+    }
+    frame[slot] = alloca;
+}
+
+// A value of any type as the 64 bits that identify it
+llvm::Value* CodeGen::toBits(llvm::Value* value) {
+    llvm::Type* type = value->getType();
+    llvm::Type* bits = builder.getInt64Ty();
+    if (type->isIntegerTy(64)) {
+        return value;
+    }
+    if (type->isIntegerTy()) {
+        return builder.CreateZExt(value, bits);
+    }
+    if (type->isDoubleTy()) {
+        return builder.CreateBitCast(value, bits);
+    }
+    return builder.CreatePtrToInt(value, bits);
+}
+
+llvm::Value* CodeGen::fromBits(llvm::Value* bits, llvm::Type* type) {
+    if (type->isIntegerTy(64)) {
+        return bits;
+    }
+    if (type->isIntegerTy()) {
+        return builder.CreateTrunc(bits, type);
+    }
+    if (type->isDoubleTy()) {
+        return builder.CreateBitCast(bits, type);
+    }
+    return builder.CreateIntToPtr(bits, type);
+}
+
+// Fill in `wrapper`, which looks its arguments up in a table of earlier
+// results and only calls `body` (with the same signature) for new ones.
+// The table is open-addressed: a key's home slot comes from a hash of the
+// arguments' bits, and the slots after it are tried in turn. A new result
+// goes in the first free slot, or replaces the one in the home slot once
+// memoProbes slots are taken, so the table never grows.
+void CodeGen::generateMemoWrapper(llvm::Function* wrapper, llvm::Function* body) {
+    llvm::Type* bits = builder.getInt64Ty();
+    llvm::Type* flag = builder.getInt8Ty();
+    uint64_t keySize = std::max<uint64_t>(wrapper->arg_size(), 1);
+
+    // The wrapper's name is unique in the module, so each table is new
+    auto createTable = [&](llvm::Type* element, uint64_t size, const char* part) {
+        llvm::ArrayType* type = llvm::ArrayType::get(element, size);
+        auto* table = llvm::cast<llvm::GlobalVariable>(
+            module->getOrInsertGlobal((wrapper->getName() + ".memo." + part).str(), type));
+        table->setLinkage(llvm::GlobalValue::InternalLinkage);
+        table->setInitializer(llvm::ConstantAggregateZero::get(type));
+        return table;
+    };
+    llvm::GlobalVariable* keys = createTable(bits, memoSlots * keySize, "keys");
+    llvm::GlobalVariable* values = createTable(bits, memoSlots, "values");
+    llvm::GlobalVariable* used = createTable(flag, memoSlots, "used");
+
+    auto element = [&](llvm::GlobalVariable* table, llvm::Value* index) {
+        return builder.CreateInBoundsGEP(table->getValueType(), table, {builder.getInt64(0), index});
+    };
+
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", wrapper);
+    llvm::BasicBlock* probe = llvm::BasicBlock::Create(context, "probe", wrapper);
+    llvm::BasicBlock* compare = llvm::BasicBlock::Create(context, "compare", wrapper);
+    llvm::BasicBlock* next = llvm::BasicBlock::Create(context, "next", wrapper);
+    llvm::BasicBlock* hit = llvm::BasicBlock::Create(context, "hit", wrapper);
+    llvm::BasicBlock* miss = llvm::BasicBlock::Create(context, "miss", wrapper);
+
+    // Hash the arguments
+    builder.SetInsertPoint(entry);
+    std::vector<llvm::Value*> arguments;
+    std::vector<llvm::Value*> key;
+    llvm::Value* hash = builder.getInt64(0);
+    for (auto& arg : wrapper->args()) {
+        arguments.push_back(&arg);
+        key.push_back(toBits(&arg));
+        hash = builder.CreateMul(builder.CreateXor(hash, key.back()), builder.getInt64(0x9E3779B97F4A7C15));
+    }
+    // Every bit of the key has to reach the low bits the slot is taken
+    // from: a whole-number double has nothing but zeros in its low 44
+    // bits. Finished with the MurmurHash3 avalanche.
+    hash = builder.CreateXor(hash, builder.CreateLShr(hash, 33));
+    hash = builder.CreateMul(hash, builder.getInt64(0xFF51AFD7ED558CCD));
+    hash = builder.CreateXor(hash, builder.CreateLShr(hash, 33));
+    hash = builder.CreateMul(hash, builder.getInt64(0xC4CEB9FE1A85EC53));
+    hash = builder.CreateXor(hash, builder.CreateLShr(hash, 33));
+    llvm::Value* home = builder.CreateAnd(hash, memoSlots - 1, "home");
+    builder.CreateBr(probe);
+
+    // Look at the slots from home on until one is free or holds the key
+    builder.SetInsertPoint(probe);
+    llvm::PHINode* probeCount = builder.CreatePHI(bits, 2, "probes");
+    probeCount->addIncoming(builder.getInt64(0), entry);
+    llvm::Value* slot = builder.CreateAnd(builder.CreateAdd(home, probeCount), memoSlots - 1, "slot");
+    llvm::Value* taken = builder.CreateLoad(flag, element(used, slot));
+    builder.CreateCondBr(builder.CreateICmpNE(taken, builder.getInt8(0)), compare, miss);
+
+    builder.SetInsertPoint(compare);
+    llvm::Value* keyBase = builder.CreateMul(slot, builder.getInt64(keySize));
+    llvm::Value* match = builder.getTrue();
+    for (size_t i = 0; i < key.size(); i++) {
+        llvm::Value* stored = builder.CreateLoad(bits, element(keys, builder.CreateAdd(keyBase, builder.getInt64(i))));
+        match = builder.CreateAnd(match, builder.CreateICmpEQ(stored, key[i]));
+    }
+    builder.CreateCondBr(match, hit, next);
+
+    builder.SetInsertPoint(next);
+    llvm::Value* nextCount = builder.CreateAdd(probeCount, builder.getInt64(1));
+    probeCount->addIncoming(nextCount, next);
+    builder.CreateCondBr(builder.CreateICmpULT(nextCount, builder.getInt64(memoProbes)), probe, miss);
+
+    builder.SetInsertPoint(hit);
+    llvm::Value* remembered = builder.CreateLoad(bits, element(values, slot));
+    builder.CreateRet(fromBits(remembered, wrapper->getReturnType()));
+
+    // Compute the result and keep it, in the free slot or over the home one
+    builder.SetInsertPoint(miss);
+    llvm::PHINode* target = builder.CreatePHI(bits, 2, "target");
+    target->addIncoming(slot, probe);
+    target->addIncoming(home, next);
+    llvm::Value* result = builder.CreateCall(body, arguments);
+    keyBase = builder.CreateMul(target, builder.getInt64(keySize));
+    for (size_t i = 0; i < key.size(); i++) {
+        builder.CreateStore(key[i], element(keys, builder.CreateAdd(keyBase, builder.getInt64(i))));
+    }
+    builder.CreateStore(toBits(result), element(values, target));
+    builder.CreateStore(builder.getInt8(1), element(used, target));
+    builder.CreateRet(result);
+
+    llvm::verifyFunction(*wrapper);
+}
+
+// Fill in `dispatch`, which runs `forking` while the TaskPool wants more
+// tasks and `serial` once it has enough
+void CodeGen::generateForkDispatch(llvm::Function* dispatch, llvm::Function* forking, llvm::Function* serial) {
+    llvm::FunctionCallee enter = module->getOrInsertFunction("tribhasha_enter", builder.getInt32Ty());
+    llvm::FunctionCallee leave = module->getOrInsertFunction("tribhasha_leave", builder.getVoidTy());
+    
+    llvm::BasicBlock* entry = llvm::BasicBlock::Create(context, "entry", dispatch);
+    llvm::BasicBlock* parallelBlock = llvm::BasicBlock::Create(context, "parallel", dispatch);
+    llvm::BasicBlock* serialBlock = llvm::BasicBlock::Create(context, "serial", dispatch);
+    std::vector<llvm::Value*> arguments;
+    for (auto& arg : dispatch->args()) {
+        arguments.push_back(&arg);
+    }
+    
+    builder.SetInsertPoint(entry);
+    llvm::Value* entered = builder.CreateCall(enter, {}, "entered");
+    builder.CreateCondBr(builder.CreateICmpNE(entered, builder.getInt32(0)), parallelBlock, serialBlock);
+    
+    builder.SetInsertPoint(parallelBlock);
+    llvm::Value* result = builder.CreateCall(forking, arguments);
+    builder.CreateCall(leave, {});
+    builder.CreateRet(result);
+    
+    builder.SetInsertPoint(serialBlock);
+    llvm::CallInst* serialResult = builder.CreateCall(serial, arguments);
+    serialResult->setTailCall();
+    builder.CreateRet(serialResult);
+    
+    llvm::verifyFunction(*dispatch);
+}
+
+// Whether `expr` combines two or more calls that can run as tasks, which
+// go in `calls` in order. Nothing in it may assign, since the calls run
+// in a different order from the rest.
+bool CodeGen::findForkableCalls(BinaryExpr* expr, std::vector<CallExpr*>& calls) {
+    combinedCalls(expr, calls);
+    if (calls.size() < 2 || assigns(expr)) {
+        return false;
+    }
+    for (CallExpr* call : calls) {
+        VariableExpr* name = call->callee->as<VariableExpr>();
+        llvm::Function* callee = name ? getFunction(name->name.symbol) : nullptr;
+        if (!callee || callee->arg_size() != call->arguments.size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+llvm::Value* CodeGen::generateForkJoin(BinaryExpr* expr, const std::vector<CallExpr*>& calls) {
+    llvm::Type* bytes = builder.getInt8PtrTy();
+    llvm::FunctionCallee fork = module->getOrInsertFunction("tribhasha_fork", bytes, bytes, bytes);
+    llvm::FunctionCallee join = module->getOrInsertFunction("tribhasha_join", builder.getVoidTy(), bytes);
+    
+    // Every call but the last is forked, with its arguments and then its
+    // result in a frame on this function's stack
+    struct Forked {
+        CallExpr* call;
+        llvm::StructType* frameType;
+        llvm::AllocaInst* frame;
+        llvm::Value* task;
+    };
+    std::vector<Forked> forked;
+    for (size_t i = 0; i + 1 < calls.size(); i++) {
+        CallExpr* call = calls[i];
+        llvm::Function* callee = getFunction(call->callee->as<VariableExpr>()->name.symbol);
+        std::vector<llvm::Type*> fields(callee->getFunctionType()->param_begin(),
+                                        callee->getFunctionType()->param_end());
+        fields.push_back(callee->getReturnType());
+        llvm::StructType* frameType = llvm::StructType::get(context, fields);
+        llvm::AllocaInst* frameSlot = createEntryBlockAlloca(currentFunction, "task.frame", frameType);
+        
+        for (size_t j = 0; j < call->arguments.size(); j++) {
+            llvm::Value* argValue = visit(call->arguments[j]);
+            if (argValue) {
+                argValue = convert(argValue, fields[j]);
+            }
+            if (!argValue) {
+                return nullptr;
+            }
+            builder.CreateStore(argValue, builder.CreateStructGEP(frameType, frameSlot, j));
+        }
+        llvm::Value* task = builder.CreateCall(fork, {
+            builder.CreateBitCast(getTaskFunction(callee, frameType), bytes),
+            builder.CreateBitCast(frameSlot, bytes)
+        }, "task");
+        forked.push_back({call, frameType, frameSlot, task});
+    }
+    
+    // The last call runs here meanwhile. The tasks are joined newest
+    // first, the order in which this thread can run any nobody took.
+    llvm::Value* last = visit(calls.back());
+    if (!last) {
+        return nullptr;
+    }
+    std::vector<std::pair<CallExpr*, llvm::Value*>> results{{calls.back(), last}};
+    for (auto it = forked.rbegin(); it != forked.rend(); ++it) {
+        builder.CreateCall(join, {it->task});
+        unsigned resultField = it->frameType->getNumElements() - 1;
+        llvm::Value* result = builder.CreateLoad(
+            it->frameType->getElementType(resultField),
+            builder.CreateStructGEP(it->frameType, it->frame, resultField), "joined");
+        results.emplace_back(it->call, convert(result, typeOf(it->call->valueType)));
+    }
+    
+    // Combine the results as the serial code would
+    bool wasForking = forking;
+    forking = false;
+    joinedCalls.swap(results);
+    llvm::Value* combined = visitBinaryExpr(expr);
+    joinedCalls.swap(results);
+    forking = wasForking;
+    return combined;
+}
+
+// The function a task of `callee` runs: it calls `callee` with the
+// arguments in a frame of `frameType` and leaves the result after them
+llvm::Function* CodeGen::getTaskFunction(llvm::Function* callee, llvm::StructType* frameType) {
+    std::string name = (callee->getName() + ".task").str();
+    if (llvm::Function* task = module->getFunction(name)) {
+        return task;
+    }
+    
+    llvm::FunctionType* taskType = llvm::FunctionType::get(builder.getVoidTy(), {builder.getInt8PtrTy()}, false);
+    llvm::Function* task = llvm::Function::Create(taskType, llvm::Function::InternalLinkage, name, module.get());
+    llvm::IRBuilderBase::InsertPointGuard guard(builder);
+    builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", task));
+    
+    llvm::Value* frameSlot = builder.CreateBitCast(task->getArg(0), frameType->getPointerTo());
+    std::vector<llvm::Value*> arguments;
+    for (unsigned i = 0; i < callee->arg_size(); i++) {
+        arguments.push_back(builder.CreateLoad(frameType->getElementType(i),
+                                               builder.CreateStructGEP(frameType, frameSlot, i)));
+    }
+    llvm::Value* result = builder.CreateCall(callee, arguments);
+    builder.CreateStore(result, builder.CreateStructGEP(frameType, frameSlot, callee->arg_size()));
+    builder.CreateRetVoid();
+    
+    llvm::verifyFunction(*task);
+    return task;
 }
 
 // Expression visitors
-void* CodeGen::visitBinaryExpr(BinaryExpr* expr) {
-    llvm::Value* left = static_cast<llvm::Value*>(expr->left->accept(this));
-    llvm::Value* right = static_cast<llvm::Value*>(expr->right->accept(this));
+llvm::Value* CodeGen::visitBinaryExpr(BinaryExpr* expr) {
+    std::vector<CallExpr*> calls;
+    if (forking && findForkableCalls(expr, calls)) {
+        return generateForkJoin(expr, calls);
+    }
     
+    std::vector<BinaryExpr*> chain = leftChain(expr);
+    llvm::Value* left = visit(chain.front()->left);
+    for (BinaryExpr* link : chain) {
+        llvm::Value* right = left ? visit(link->right) : nullptr;
+        left = generateBinary(link, left, right);
+    }
+    return left;
+}
+
+// The operation `expr` on operands already generated
+llvm::Value* CodeGen::generateBinary(BinaryExpr* expr, llvm::Value* left, llvm::Value* right) {
     if (!left || !right) {
         return logErrorV("Invalid binary operands");
     }
     
+    // Arithmetic is done in the type of its result, comparisons in the
+    // wider type of their operands
+    bool comparison = expr->valueType == ValueType::Bool;
+    llvm::Type* type = typeOf(comparison ? operandType(expr->left, expr->right) : expr->valueType);
+    if (type->isPointerTy()) {
+        return logErrorV("Invalid binary operands");
+    }
+    left = convert(left, type);
+    right = convert(right, type);
+    bool floating = type->isFloatingPointTy();
+    
     switch (expr->op.type) {
         case TokenType::PLUS:
-            return builder.CreateFAdd(left, right, "addtmp");
+            return floating ? builder.CreateFAdd(left, right, "addtmp") : builder.CreateAdd(left, right, "addtmp");
         case TokenType::MINUS:
-            return builder.CreateFSub(left, right, "subtmp");
+            return floating ? builder.CreateFSub(left, right, "subtmp") : builder.CreateSub(left, right, "subtmp");
         case TokenType::STAR:
-            return builder.CreateFMul(left, right, "multmp");
+            return floating ? builder.CreateFMul(left, right, "multmp") : builder.CreateMul(left, right, "multmp");
         case TokenType::SLASH:
             return builder.CreateFDiv(left, right, "divtmp");
         case TokenType::MODULO:
-            return builder.CreateFRem(left, right, "modtmp");
+            return floating ? builder.CreateFRem(left, right, "modtmp") : builder.CreateSRem(left, right, "modtmp");
         case TokenType::LESS:
-            return builder.CreateFCmpULT(left, right, "cmptmp");
+            return floating ? builder.CreateFCmpULT(left, right, "cmptmp") : builder.CreateICmpSLT(left, right, "cmptmp");
         case TokenType::LESS_EQUAL:
-            return builder.CreateFCmpULE(left, right, "cmptmp");
+            return floating ? builder.CreateFCmpULE(left, right, "cmptmp") : builder.CreateICmpSLE(left, right, "cmptmp");
         case TokenType::GREATER:
-            return builder.CreateFCmpUGT(left, right, "cmptmp");
+            return floating ? builder.CreateFCmpUGT(left, right, "cmptmp") : builder.CreateICmpSGT(left, right, "cmptmp");
         case TokenType::GREATER_EQUAL:
-            return builder.CreateFCmpUGE(left, right, "cmptmp");
+            return floating ? builder.CreateFCmpUGE(left, right, "cmptmp") : builder.CreateICmpSGE(left, right, "cmptmp");
         case TokenType::EQUAL:
-            return builder.CreateFCmpUEQ(left, right, "cmptmp");
+            return floating ? builder.CreateFCmpUEQ(left, right, "cmptmp") : builder.CreateICmpEQ(left, right, "cmptmp");
         case TokenType::NOT_EQUAL:
-            return builder.CreateFCmpUNE(left, right, "cmptmp");
+            return floating ? builder.CreateFCmpUNE(left, right, "cmptmp") : builder.CreateICmpNE(left, right, "cmptmp");
         default:
             return logErrorV("Unknown binary operator");
     }
 }
 
-void* CodeGen::visitGroupingExpr(GroupingExpr* expr) {
+llvm::Value* CodeGen::visitLogicalExpr(LogicalExpr* expr) {
+    std::vector<LogicalExpr*> chain = leftChain(expr);
+    llvm::Value* left = visit(chain.front()->left);
+    for (LogicalExpr* link : chain) {
+        left = generateLogical(link, left);
+    }
+    return left;
+}
+
+// `expr` with its left operand already generated
+llvm::Value* CodeGen::generateLogical(LogicalExpr* expr, llvm::Value* left) {
+    if (!left) {
+        return logErrorV("Invalid logical operand");
+    }
+    left = toCondition(left, "lhscond");
+    
+    // Only evaluate the right operand if the left one does not decide
+    bool isAnd = expr->op.type == TokenType::KW_AND;
+    llvm::BasicBlock* leftBB = builder.GetInsertBlock();
+    llvm::Function* function = leftBB->getParent();
+    llvm::BasicBlock* rightBB = llvm::BasicBlock::Create(context, isAnd ? "and.rhs" : "or.rhs", function);
+    llvm::BasicBlock* mergeBB = llvm::BasicBlock::Create(context, isAnd ? "and.end" : "or.end");
+    
+    if (isAnd) {
+        builder.CreateCondBr(left, rightBB, mergeBB);
+    } else {
+        builder.CreateCondBr(left, mergeBB, rightBB);
+    }
+    
+    builder.SetInsertPoint(rightBB);
+    llvm::Value* right = visit(expr->right);
+    if (!right) {
+        return logErrorV("Invalid logical operand");
+    }
+    right = toCondition(right, "rhscond");
+    llvm::BasicBlock* rightEndBB = builder.GetInsertBlock();
+    builder.CreateBr(mergeBB);
+    
+    function->getBasicBlockList().push_back(mergeBB);
+    builder.SetInsertPoint(mergeBB);
+    llvm::PHINode* result = builder.CreatePHI(llvm::Type::getInt1Ty(context), 2, isAnd ? "andtmp" : "ortmp");
+    result->addIncoming(isAnd ? builder.getFalse() : builder.getTrue(), leftBB);
+    result->addIncoming(right, rightEndBB);
+    return result;
+}
+
+llvm::Value* CodeGen::visitGroupingExpr(GroupingExpr* expr) {
     // Simply visit the contained expression
-    return expr->expression->accept(this);
+    return visit(expr->expression);
 }
 
-void* CodeGen::visitLiteralExpr(LiteralExpr* expr) {
+llvm::Value* CodeGen::visitLiteralExpr(LiteralExpr* expr) {
     switch (expr->type) {
         case TokenType::INT_LITERAL:
-            return llvm::ConstantInt::get(llvm::Type::getInt32Ty(context), std::stoi(expr->value));
+            return llvm::ConstantInt::get(llvm::Type::getInt64Ty(context), expr->intValue);
         case TokenType::FLOAT_LITERAL:
-            return llvm::ConstantFP::get(llvm::Type::getDoubleTy(context), std::stod(expr->value));
+            return llvm::ConstantFP::get(llvm::Type::getDoubleTy(context), expr->floatValue);
         case TokenType::STRING_LITERAL: {
             // Create a global string constant
-            llvm::Constant* stringConstant = llvm::ConstantDataArray::getString(context, expr->value);
+            llvm::Constant* stringConstant = llvm::ConstantDataArray::getString(context, toStringRef(expr->value));
             llvm::GlobalVariable* globalStr = new llvm::GlobalVariable(
                 *module,
                 stringConstant->getType(),
@@ -166,71 +704,78 @@ void* CodeGen::visitLiteralExpr(LiteralExpr* expr) {
                 indices
             );
         }
-        case TokenType::TRUE_EN:
-        case TokenType::TRUE_HI:
-        case TokenType::TRUE_AS:
+        case TokenType::KW_TRUE:
             return llvm::ConstantInt::getTrue(context);
-        case TokenType::FALSE_EN:
-        case TokenType::FALSE_HI:
-        case TokenType::FALSE_AS:
+        case TokenType::KW_FALSE:
             return llvm::ConstantInt::getFalse(context);
         default:
             return logErrorV("Unknown literal type");
     }
 }
 
-void* CodeGen::visitUnaryExpr(UnaryExpr* expr) {
-    llvm::Value* operand = static_cast<llvm::Value*>(expr->right->accept(this));
+llvm::Value* CodeGen::visitUnaryExpr(UnaryExpr* expr) {
+    llvm::Value* operand = visit(expr->right);
     if (!operand) {
         return logErrorV("Invalid unary operand");
     }
     
     switch (expr->op.type) {
         case TokenType::MINUS:
-            return builder.CreateFNeg(operand, "negtmp");
-        case TokenType::NOT_EN:
-        case TokenType::NOT_HI:
-        case TokenType::NOT_AS:
-            return builder.CreateNot(operand, "nottmp");
+            if (expr->valueType == ValueType::String) {
+                return logErrorV("Invalid unary operand");
+            }
+            operand = convert(operand, typeOf(expr->valueType));
+            if (operand->getType()->isFloatingPointTy()) {
+                return builder.CreateFNeg(operand, "negtmp");
+            }
+            return builder.CreateNeg(operand, "negtmp");
+        case TokenType::KW_NOT:
+            return builder.CreateNot(toCondition(operand, "notcond"), "nottmp");
         default:
             return logErrorV("Unknown unary operator");
     }
 }
 
-void* CodeGen::visitVariableExpr(VariableExpr* expr) {
-    // Look up the variable in the symbol table
-    llvm::AllocaInst* alloca = namedValues[expr->name.lexeme];
+llvm::Value* CodeGen::visitVariableExpr(VariableExpr* expr) {
+    // The variable's slot was found by the Resolver
+    llvm::AllocaInst* alloca = lookupVariable(expr->slot);
     if (!alloca) {
-        return logErrorV("Unknown variable name: " + expr->name.lexeme);
+        return logErrorV("Unknown variable name: " + std::string(nameOf(expr->name)));
     }
     
     // Load the value
-    return builder.CreateLoad(llvm::Type::getDoubleTy(context), alloca, expr->name.lexeme.c_str());
+    return builder.CreateLoad(alloca->getAllocatedType(), alloca, toStringRef(nameOf(expr->name)));
 }
 
-void* CodeGen::visitAssignExpr(AssignExpr* expr) {
+llvm::Value* CodeGen::visitAssignExpr(AssignExpr* expr) {
     // Generate code for the right-hand side expression
-    llvm::Value* value = static_cast<llvm::Value*>(expr->value->accept(this));
+    llvm::Value* value = visit(expr->value);
     if (!value) {
         return nullptr;
     }
     
-    // Look up the variable in the symbol table
-    llvm::AllocaInst* alloca = namedValues[expr->name.lexeme];
+    // The variable's slot was found by the Resolver
+    llvm::AllocaInst* alloca = lookupVariable(expr->slot);
     if (!alloca) {
-        return logErrorV("Unknown variable name: " + expr->name.lexeme);
+        return logErrorV("Unknown variable name: " + std::string(nameOf(expr->name)));
     }
     
-    // Store the value
+    // Store the value, as the variable's type
+    value = convert(value, alloca->getAllocatedType());
+    if (!value) {
+        return nullptr;
+    }
     builder.CreateStore(value, alloca);
     return value;
 }
 
-void* CodeGen::visitCallExpr(CallExpr* expr) {
+llvm::Value* CodeGen::visitCallExpr(CallExpr* expr) {
+    for (const auto& [call, result] : joinedCalls) {
+        if (call == expr) return result;
+    }
+    
     // Get the function to call
-    llvm::Function* callee = getFunction(
-        static_cast<VariableExpr*>(expr->callee.get())->name.lexeme
-    );
+    llvm::Function* callee = getFunction(static_cast<VariableExpr*>(expr->callee)->name.symbol);
     
     if (!callee) {
         return logErrorV("Unknown function referenced");
@@ -241,10 +786,13 @@ void* CodeGen::visitCallExpr(CallExpr* expr) {
         return logErrorV("Incorrect number of arguments passed");
     }
     
-    // Generate code for arguments
+    // Generate code for arguments, as the parameters' types
     std::vector<llvm::Value*> argsV;
     for (const auto& arg : expr->arguments) {
-        llvm::Value* argValue = static_cast<llvm::Value*>(arg->accept(this));
+        llvm::Value* argValue = visit(arg);
+        if (argValue) {
+            argValue = convert(argValue, callee->getFunctionType()->getParamType(argsV.size()));
+        }
         if (!argValue) {
             return nullptr;
         }
@@ -252,69 +800,59 @@ void* CodeGen::visitCallExpr(CallExpr* expr) {
     }
     
     // Create the call
-    return builder.CreateCall(callee, argsV, "calltmp");
+    return convert(builder.CreateCall(callee, argsV, "calltmp"), typeOf(expr->valueType));
 }
 
 // Statement visitors
-void* CodeGen::visitExpressionStmt(ExpressionStmt* stmt) {
+void CodeGen::visitExpressionStmt(ExpressionStmt* stmt) {
     // Generate code for the expression
-    return stmt->expression->accept(this);
+    visit(stmt->expression);
 }
 
-void* CodeGen::visitVarStmt(VarStmt* stmt) {
+void CodeGen::visitVarStmt(VarStmt* stmt) {
+    llvm::Type* type = typeOf(stmt->valueType);
     llvm::Value* initValue = nullptr;
     
     // Generate code for the initializer if it exists
     if (stmt->initializer) {
-        initValue = static_cast<llvm::Value*>(stmt->initializer->accept(this));
+        initValue = visit(stmt->initializer);
+        if (initValue) {
+            initValue = convert(initValue, type);
+        }
         if (!initValue) {
-            return nullptr;
+            return;
         }
     } else {
         // Default initialization to 0
-        initValue = llvm::ConstantFP::get(llvm::Type::getDoubleTy(context), 0.0);
+        initValue = llvm::Constant::getNullValue(type);
     }
     
     // Create a variable allocation in the current function
-    llvm::AllocaInst* alloca = createEntryBlockAlloca(currentFunction, stmt->name.lexeme);
+    llvm::AllocaInst* alloca = createEntryBlockAlloca(currentFunction, toStringRef(nameOf(stmt->name)), type);
     
     // Store the initial value
     builder.CreateStore(initValue, alloca);
     
     // Add to symbol table
-    namedValues[stmt->name.lexeme] = alloca;
-    
-    return nullptr;
+    bindVariable(stmt->slot, alloca);
 }
 
-void* CodeGen::visitBlockStmt(BlockStmt* stmt) {
-    // Save the current symbol table
-    std::unordered_map<std::string, llvm::AllocaInst*> oldNamedValues = namedValues;
-    
-    // Generate code for each statement in the block
+void CodeGen::visitBlockStmt(BlockStmt* stmt) {
+    // Scoping was settled by the Resolver: every variable has its own slot
     for (const auto& statement : stmt->statements) {
-        statement->accept(this);
+        visit(statement);
     }
-    
-    // Restore the original symbol table
-    namedValues = oldNamedValues;
-    
-    return nullptr;
 }
 
-void* CodeGen::visitIfStmt(IfStmt* stmt) {
+void CodeGen::visitIfStmt(IfStmt* stmt) {
     // Generate condition
-    llvm::Value* condV = static_cast<llvm::Value*>(stmt->condition->accept(this));
+    llvm::Value* condV = visit(stmt->condition);
     if (!condV) {
-        return nullptr;
+        return;
     }
     
     // Convert condition to boolean (non-zero is true)
-    condV = builder.CreateFCmpONE(
-        condV,
-        llvm::ConstantFP::get(llvm::Type::getDoubleTy(context), 0.0),
-        "ifcond"
-    );
+    condV = toCondition(condV, "ifcond");
     
     // Create blocks for then, else, and merge
     llvm::Function* function = builder.GetInsertBlock()->getParent();
@@ -331,25 +869,23 @@ void* CodeGen::visitIfStmt(IfStmt* stmt) {
     
     // Generate then block
     builder.SetInsertPoint(thenBB);
-    stmt->thenBranch->accept(this);
+    visit(stmt->thenBranch);
     builder.CreateBr(mergeBB);
     
     // Generate else block if it exists
     if (stmt->elseBranch) {
         function->getBasicBlockList().push_back(elseBB);
         builder.SetInsertPoint(elseBB);
-        stmt->elseBranch->accept(this);
+        visit(stmt->elseBranch);
         builder.CreateBr(mergeBB);
     }
     
     // Generate merge block
     function->getBasicBlockList().push_back(mergeBB);
     builder.SetInsertPoint(mergeBB);
-    
-    return nullptr;
 }
 
-void* CodeGen::visitWhileStmt(WhileStmt* stmt) {
+void CodeGen::visitWhileStmt(WhileStmt* stmt) {
     // Create blocks for loop condition, body, and after
     llvm::Function* function = builder.GetInsertBlock()->getParent();
     llvm::BasicBlock* condBB = llvm::BasicBlock::Create(context, "loopcond", function);
@@ -361,54 +897,141 @@ void* CodeGen::visitWhileStmt(WhileStmt* stmt) {
     
     // Generate condition block
     builder.SetInsertPoint(condBB);
-    llvm::Value* condV = static_cast<llvm::Value*>(stmt->condition->accept(this));
+    llvm::Value* condV = visit(stmt->condition);
     if (!condV) {
-        return nullptr;
+        return;
     }
     
     // Convert condition to boolean
-    condV = builder.CreateFCmpONE(
-        condV,
-        llvm::ConstantFP::get(llvm::Type::getDoubleTy(context), 0.0),
-        "loopcond"
-    );
+    condV = toCondition(condV, "loopcond");
     
     builder.CreateCondBr(condV, bodyBB, afterBB);
     
     // Generate body block
     function->getBasicBlockList().push_back(bodyBB);
     builder.SetInsertPoint(bodyBB);
-    stmt->body->accept(this);
+    visit(stmt->body);
     builder.CreateBr(condBB);
     
     // Generate after block
     function->getBasicBlockList().push_back(afterBB);
     builder.SetInsertPoint(afterBB);
-    
-    return nullptr;
 }
 
-void* CodeGen::visitFunctionStmt(FunctionStmt* stmt) {
-    // Create a function type
-    std::vector<llvm::Type*> argTypes(stmt->params.size(), llvm::Type::getDoubleTy(context));
+void CodeGen::visitFunctionStmt(FunctionStmt* stmt) {
+    // Code after the declaration goes where it would have gone
+    llvm::BasicBlock* oldBlock = builder.GetInsertBlock();
+    
+    // Create a function type, from the inferred types
+    std::vector<llvm::Type*> argTypes;
+    for (size_t i = 0; i < stmt->params.size(); i++) {
+        argTypes.push_back(typeOf(stmt->paramTypes[i]));
+    }
     llvm::FunctionType* functionType = llvm::FunctionType::get(
-        llvm::Type::getDoubleTy(context),
+        typeOf(stmt->returnType),
         argTypes,
         false
     );
     
+    Symbol name = stmt->name.symbol;
+    if (name >= functions.size()) {
+        functions.resize(std::max<size_t>(name + 1, Interner::global().limit()), nullptr);
+    }
+    
+    // A function defined again changes what calls of it in functions
+    // generated later mean, so their shapes no longer say what they do.
+    // Only first definitions are shared: calls of a function inside its
+    // redefinition still go to the one before.
+    FunctionShapes& shapes = sharedFunctions ? sharedFunctions->getShapes() : ownShapes;
+    llvm::StringRef spelling = toStringRef(nameOf(stmt->name));
+    bool redefined = functions[name] || (sharedFunctions && sharedFunctions->find(name));
+    if (redefined) {
+        shapes = FunctionShapes();
+    }
+    std::optional<FunctionShape> shape;
+    if (!redefined && !module->getNamedValue(spelling) &&
+        std::none_of(stmt->body.begin(), stmt->body.end(), definesFunction)) {
+        shape.emplace(stmt);
+    }
+    
+    // A function already generated under another name gets this one too
+    if (const std::string* existing = shape ? shapes.find(*shape) : nullptr) {
+        llvm::Function* target = module->getFunction(*existing);
+        if (target && !target->isDeclaration()) {
+            llvm::GlobalAlias::create(functionType, 0, llvm::GlobalValue::ExternalLinkage, spelling, target, module.get());
+        } else {
+            target = llvm::cast<llvm::Function>(module->getOrInsertFunction(*existing, functionType).getCallee());
+            aliases.emplace_back(spelling.str(), *existing);
+        }
+        functions[name] = target;
+        if (sharedFunctions) {
+            std::vector<ValueType> params(stmt->paramTypes, stmt->paramTypes + stmt->params.size());
+            sharedFunctions->define(name, {std::move(params), stmt->returnType, spelling.str()});
+        }
+        return;
+    }
+    
     // Create the function
     llvm::Function* function = llvm::Function::Create(
         functionType,
         llvm::Function::ExternalLinkage,
-        stmt->name.lexeme,
+        spelling,
         module.get()
     );
+    auto createPart = [&](const char* part) {
+        return llvm::Function::Create(
+            functionType,
+            llvm::Function::InternalLinkage,
+            function->getName() + "." + part,
+            module.get()
+        );
+    };
+    
+    if (memoize && stmt->pure && stmt->recursive) {
+        // A memoized function's body goes in a function of its own, which
+        // `function` calls when the result is not in its table. Calls in
+        // the body still go through the table.
+        llvm::Function* body = createPart("uncached");
+        generateBody(stmt, body, false);
+        generateMemoWrapper(function, body);
+    } else if (parallel && stmt->pure && stmt->recursive &&
+               std::none_of(stmt->body.begin(), stmt->body.end(), definesFunction)) {
+        // The body twice: a copy that forks, and a serial one that calls
+        // itself directly, for `function` to choose from. A function
+        // defined inside would be defined twice.
+        llvm::Function* forkingBody = createPart("parallel");
+        llvm::Function* serialBody = createPart("serial");
+        generateBody(stmt, forkingBody, true);
+        llvm::Function* outer = functions[name];
+        functions[name] = serialBody;
+        generateBody(stmt, serialBody, false);
+        functions[name] = outer;
+        generateForkDispatch(function, forkingBody, serialBody);
+    } else {
+        generateBody(stmt, function, false);
+    }
+    
+    // Add function to symbol table
+    functions[name] = function;
+    if (shape) {
+        shapes.add(std::move(*shape), function->getName().str());
+    }
+    if (sharedFunctions) {
+        std::vector<ValueType> params(stmt->paramTypes, stmt->paramTypes + stmt->params.size());
+        sharedFunctions->define(name, {std::move(params), stmt->returnType, function->getName().str()});
+    }
     
+    if (oldBlock) {
+        builder.SetInsertPoint(oldBlock);
+    }
+}
+
+// Generate the body of `stmt` into `function`, which has its signature
+void CodeGen::generateBody(FunctionStmt* stmt, llvm::Function* function, bool fork) {
     // Set names for all arguments
     unsigned i = 0;
     for (auto& arg : function->args()) {
-        arg.setName(stmt->params[i++].lexeme);
+        arg.setName(toStringRef(nameOf(stmt->params[i++])));
     }
     
     // Create a new basic block to start insertion into
@@ -417,54 +1040,63 @@ void* CodeGen::visitFunctionStmt(FunctionStmt* stmt) {
     
     // Save the current function
     llvm::Function* oldFunction = currentFunction;
+    bool oldForking = forking;
     currentFunction = function;
+    forking = fork;
     
-    // Save the current named values
-    std::unordered_map<std::string, llvm::AllocaInst*> oldNamedValues = namedValues;
-    namedValues.clear();
+    // The function gets a frame of its own; the parameters take its
+    // first slots
+    std::vector<llvm::AllocaInst*> outerFrame(stmt->slotCount, nullptr);
+    frame.swap(outerFrame);
     
     // Create allocas for arguments
+    i = 0;
     for (auto& arg : function->args()) {
-        llvm::AllocaInst* alloca = createEntryBlockAlloca(function, arg.getName().str());
+        llvm::AllocaInst* alloca = createEntryBlockAlloca(function, arg.getName(), arg.getType());
         builder.CreateStore(&arg, alloca);
-        namedValues[arg.getName().str()] = alloca;
+        bindVariable(i++, alloca);
     }
     
     // Generate code for function body
     for (const auto& statement : stmt->body) {
-        statement->accept(this);
+        visit(statement);
     }
     
     // Return a default value if control flow reaches the end of the function
-    if (!block->getTerminator()) {
-        builder.CreateRet(llvm::ConstantFP::get(llvm::Type::getDoubleTy(context), 0.0));
+    if (!builder.GetInsertBlock()->getTerminator()) {
+        builder.CreateRet(llvm::Constant::getNullValue(function->getReturnType()));
     }
     
     // Verify the function
     llvm::verifyFunction(*function);
     
-    // Add function to symbol table
-    functions[stmt->name.lexeme] = function;
-    
-    // Restore the old function and named values
+    // Restore the old function and its variables
     currentFunction = oldFunction;
-    namedValues = oldNamedValues;
-    
-    return nullptr;
+    forking = oldForking;
+    frame.swap(outerFrame);
 }
 
-void* CodeGen::visitReturnStmt(ReturnStmt* stmt) {
+void CodeGen::visitReturnStmt(ReturnStmt* stmt) {
+    llvm::Type* returnType = currentFunction->getReturnType();
     llvm::Value* returnValue = nullptr;
     
     if (stmt->value) {
-        returnValue = static_cast<llvm::Value*>(stmt->value->accept(this));
+        returnValue = visit(stmt->value);
+        if (!returnValue) {
+            return;
+        }
+        returnValue = convert(returnValue, returnType);
+        if (!returnValue) {
+            return;
+        }
     } else {
-        returnValue = llvm::ConstantFP::get(llvm::Type::getDoubleTy(context), 0.0);
+        returnValue = llvm::Constant::getNullValue(returnType);
     }
     
     builder.CreateRet(returnValue);
     
-    return nullptr;
+    // Anything after the return is unreachable, but still needs a block
+    builder.SetInsertPoint(llvm::BasicBlock::Create(context, "afterreturn", currentFunction));
 }
 
 } // namespace tribhasha
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include "tribhasha/JIT.h"
+#include "tribhasha/TaskPool.h"
+#include <llvm/ExecutionEngine/Orc/Core.h>
 #include <llvm/ExecutionEngine/Orc/LLJIT.h>
 #include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
 #include <llvm/Support/Error.h>
@@ -24,6 +26,20 @@ llvm::Expected<std::unique_ptr<TribhashaJIT>> TribhashaJIT::create() {
         return lljit.takeError();
     }
     
+    // Parallel code calls into the runtime's task pool
+    llvm::orc::LLJIT& jit = **lljit;
+    auto runtimeSymbol = [&](void* address) {
+        return llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(address), llvm::JITSymbolFlags::Exported);
+    };
+    llvm::orc::SymbolMap runtime;
+    runtime[jit.mangleAndIntern("tribhasha_enter")] = runtimeSymbol(reinterpret_cast<void*>(&tribhasha_enter));
+    runtime[jit.mangleAndIntern("tribhasha_leave")] = runtimeSymbol(reinterpret_cast<void*>(&tribhasha_leave));
+    runtime[jit.mangleAndIntern("tribhasha_fork")] = runtimeSymbol(reinterpret_cast<void*>(&tribhasha_fork));
+    runtime[jit.mangleAndIntern("tribhasha_join")] = runtimeSymbol(reinterpret_cast<void*>(&tribhasha_join));
+    if (llvm::Error error = jit.getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(runtime)))) {
+        return error;
+    }
+    
     return std::unique_ptr<TribhashaJIT>(new TribhashaJIT(std::move(*lljit)));
 }
 
@@ -39,6 +55,35 @@ llvm::Error TribhashaJIT::addModule(std::unique_ptr<llvm::Module> module) {
     return lljit->addIRModule(std::move(threadSafeModule));
 }
 
+llvm::Error TribhashaJIT::addModule(llvm::orc::ThreadSafeModule module) {
+    return lljit->addIRModule(std::move(module));
+}
+
+llvm::Error TribhashaJIT::addAlias(const std::string& alias, const std::string& target) {
+    return addAlias(alias, target, nullptr);
+}
+
+TribhashaJIT::ModuleKey TribhashaJIT::createModuleKey() {
+    return lljit->getMainJITDylib().createResourceTracker();
+}
+
+llvm::Error TribhashaJIT::addModule(llvm::orc::ThreadSafeModule module, const ModuleKey& key) {
+    return lljit->addIRModule(key, std::move(module));
+}
+
+llvm::Error TribhashaJIT::addAlias(const std::string& alias, const std::string& target, const ModuleKey& key) {
+    llvm::orc::SymbolAliasMap aliases;
+    aliases[lljit->mangleAndIntern(alias)] = llvm::orc::SymbolAliasMapEntry(
+        lljit->mangleAndIntern(target),
+        llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable
+    );
+    return lljit->getMainJITDylib().define(llvm::orc::symbolAliases(std::move(aliases)), key);
+}
+
+llvm::Error TribhashaJIT::removeModule(const ModuleKey& key) {
+    return key->remove();
+}
+
 // Look up a symbol in the JIT
 llvm::Expected<llvm::JITEvaluatedSymbol> TribhashaJIT::lookup(const std::string& name) {
     return lljit->lookup(name);
@@ -0,0 +1,92 @@
+#include "tribhasha/Lexer.h"
+#include "tribhasha/TokenBuffer.h"
+
+namespace tribhasha {
+
+namespace {
+
+// How far past the end of a token the lexer may have looked while scanning
+// it: "1." peeks at the character after the dot, and an identifier decodes
+// the whole code point that follows it. A token that ends at least this far
+// before an edit cannot have been changed by it.
+constexpr size_t maxLookahead = 4;
+
+} // namespace
+
+RelexRange Lexer::relex(TokenBuffer& tokens, std::string_view newSource, const SourceEdit& edit,
+                        bool reportErrors) {
+    // The end-of-file token sits at the end of the old source
+    size_t oldSize = tokens.size() == 0 ? 0 : tokens[tokens.size() - 1].offset;
+    if (tokens.size() == 0 || edit.offset + edit.removed > oldSize ||
+        newSource.size() != oldSize - edit.removed + edit.inserted.size()) {
+        // Not an edit of this token array; start over
+        size_t oldCount = tokens.size();
+        Lexer lexer(newSource);
+        lexer.deferErrors = !reportErrors;
+        tokens = TokenBuffer(lexer.scanTokens());
+        return {0, oldCount, tokens.size()};
+    }
+
+    const int64_t delta = static_cast<int64_t>(edit.inserted.size()) - static_cast<int64_t>(edit.removed);
+    const size_t editEnd = edit.offset + edit.inserted.size();
+
+    // Restart after the last token the edit cannot have touched; the lexer
+    // is always at a token boundary there
+    size_t first = 0;
+    size_t last = tokens.size() - 1;
+    while (first < last) {
+        size_t middle = first + (last - first) / 2;
+        if (tokens[middle].end() + maxLookahead <= edit.offset) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+
+    Lexer lexer(newSource);
+    lexer.deferErrors = !reportErrors;
+    if (first > 0) {
+        lexer.current = static_cast<int>(tokens[first - 1].end());
+    }
+
+    // Re-lex until a token starts where an old token (past the edit) started.
+    // From there on the input is unchanged, so the old tokens are still right
+    // apart from their offsets.
+    size_t resume = first;
+    size_t eof = tokens.size() - 1;
+    bool synchronized = false;
+
+    while (!lexer.isAtEnd()) {
+        size_t before = lexer.tokens.size();
+        lexer.start = lexer.current;
+        lexer.scanToken();
+        if (lexer.tokens.size() == before) continue;
+
+        size_t start = static_cast<size_t>(lexer.start);
+        if (start < editEnd) continue;
+
+        int64_t target = static_cast<int64_t>(start) - delta;
+        while (resume < eof && tokens[resume].offset < target) {
+            resume++;
+        }
+        if (resume < eof && tokens[resume].offset == target) {
+            lexer.tokens.pop_back();
+            synchronized = true;
+            break;
+        }
+    }
+
+    if (!synchronized) {
+        resume = tokens.size();
+        lexer.tokens.emplace_back(TokenType::END_OF_FILE, static_cast<uint32_t>(newSource.size()), 0);
+    }
+
+    // Splice the re-lexed tokens in place of the ones they replace; the
+    // tokens after them move without being visited
+    std::vector<Token>& relexed = lexer.tokens;
+    tokens.replace(first, resume, relexed, delta);
+
+    return {first, resume, first + relexed.size()};
+}
+
+} // namespace tribhasha
@@ -0,0 +1,73 @@
+#include "tribhasha/Interner.h"
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+namespace tribhasha {
+
+Interner& Interner::global() {
+    static Interner interner;
+    return interner;
+}
+
+std::string_view Interner::Shard::store(std::string_view name) {
+    if (name.size() > blockSize) {
+        // Oversized names get a block of their own
+        blocks.emplace_back(new char[name.size()]);
+        std::memcpy(blocks.back().get(), name.data(), name.size());
+        return std::string_view(blocks.back().get(), name.size());
+    }
+
+    if (blockSize - blockUsed < name.size()) {
+        blocks.emplace_back(new char[blockSize]);
+        blockUsed = 0;
+    }
+
+    char* destination = blocks.back().get() + blockUsed;
+    std::memcpy(destination, name.data(), name.size());
+    blockUsed += name.size();
+    return std::string_view(destination, name.size());
+}
+
+std::string_view* Interner::segmentFor(Symbol symbol) {
+    size_t index = symbol >> segmentBits;
+    if (index >= maxSegments) {
+        throw std::length_error("too many distinct identifiers");
+    }
+
+    std::string_view* segment = segments[index].load(std::memory_order_acquire);
+    if (segment) return segment;
+
+    std::lock_guard<std::mutex> lock(segmentMutex);
+    segment = segments[index].load(std::memory_order_relaxed);
+    if (!segment) {
+        segment = new std::string_view[segmentSize];
+        segments[index].store(segment, std::memory_order_release);
+    }
+    return segment;
+}
+
+Symbol Interner::intern(std::string_view name) {
+    size_t hash = std::hash<std::string_view>{}(name);
+    Shard& shard = shards[(hash >> 7) % shardCount];
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.symbols.find(name);
+    if (it != shard.symbols.end()) {
+        return it->second;
+    }
+
+    std::string_view stored = shard.store(name);
+    Symbol symbol = nextSymbol.fetch_add(1, std::memory_order_acq_rel);
+    segmentFor(symbol)[symbol & (segmentSize - 1)] = stored;
+    shard.symbols.emplace(stored, symbol);
+    return symbol;
+}
+
+std::string_view Interner::name(Symbol symbol) const {
+    if (symbol == noSymbol || (symbol >> segmentBits) >= maxSegments) return {};
+    const std::string_view* segment = segments[symbol >> segmentBits].load(std::memory_order_acquire);
+    return segment ? segment[symbol & (segmentSize - 1)] : std::string_view();
+}
+
+} // namespace tribhasha
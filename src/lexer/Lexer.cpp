@@ -1,164 +1,179 @@
 #include "tribhasha/Lexer.h"
+#include "tribhasha/SimdScan.h"
+#include "tribhasha/Unicode.h"
+#include <charconv>
 #include <iostream>
-#include <codecvt>
-#include <locale>
 
 namespace tribhasha {
 
-// Initialize static keyword maps
-std::unordered_map<std::string, TokenType> Keywords::englishKeywords = {
-    {"var", TokenType::VAR_EN},
-    {"function", TokenType::FUNCTION_EN},
-    {"if", TokenType::IF_EN},
-    {"else", TokenType::ELSE_EN},
-    {"while", TokenType::WHILE_EN},
-    {"for", TokenType::FOR_EN},
-    {"return", TokenType::RETURN_EN},
-    {"true", TokenType::TRUE_EN},
-    {"false", TokenType::FALSE_EN},
-    {"and", TokenType::AND_EN},
-    {"or", TokenType::OR_EN},
-    {"not", TokenType::NOT_EN}
+namespace {
+
+struct KeywordEntry {
+    std::string_view text;
+    TokenType type;
+    Language language;
 };
 
-std::unordered_map<std::string, TokenType> Keywords::hindiKeywords = {
-    {"चर", TokenType::VAR_HI},
-    {"फलन", TokenType::FUNCTION_HI},
-    {"अगर", TokenType::IF_HI},
-    {"अन्यथा", TokenType::ELSE_HI},
-    {"जबतक", TokenType::WHILE_HI},
-    {"के_लिए", TokenType::FOR_HI},
-    {"वापस", TokenType::RETURN_HI},
-    {"सही", TokenType::TRUE_HI},
-    {"गलत", TokenType::FALSE_HI},
-    {"और", TokenType::AND_HI},
-    {"या", TokenType::OR_HI},
-    {"नहीं", TokenType::NOT_HI}
+constexpr KeywordEntry keywordList[] = {
+    {"var", TokenType::KW_VAR, Language::ENGLISH},
+    {"function", TokenType::KW_FUNCTION, Language::ENGLISH},
+    {"if", TokenType::KW_IF, Language::ENGLISH},
+    {"else", TokenType::KW_ELSE, Language::ENGLISH},
+    {"while", TokenType::KW_WHILE, Language::ENGLISH},
+    {"for", TokenType::KW_FOR, Language::ENGLISH},
+    {"return", TokenType::KW_RETURN, Language::ENGLISH},
+    {"true", TokenType::KW_TRUE, Language::ENGLISH},
+    {"false", TokenType::KW_FALSE, Language::ENGLISH},
+    {"and", TokenType::KW_AND, Language::ENGLISH},
+    {"or", TokenType::KW_OR, Language::ENGLISH},
+    {"not", TokenType::KW_NOT, Language::ENGLISH},
+    {"int", TokenType::KW_INT, Language::ENGLISH},
+    {"float", TokenType::KW_FLOAT, Language::ENGLISH},
+    {"string", TokenType::KW_STRING, Language::ENGLISH},
+    {"bool", TokenType::KW_BOOL, Language::ENGLISH},
+    
+    {"चर", TokenType::KW_VAR, Language::HINDI},
+    {"फलन", TokenType::KW_FUNCTION, Language::HINDI},
+    {"अगर", TokenType::KW_IF, Language::HINDI},
+    {"अन्यथा", TokenType::KW_ELSE, Language::HINDI},
+    {"जबतक", TokenType::KW_WHILE, Language::HINDI},
+    {"के_लिए", TokenType::KW_FOR, Language::HINDI},
+    {"वापस", TokenType::KW_RETURN, Language::HINDI},
+    {"सही", TokenType::KW_TRUE, Language::HINDI},
+    {"गलत", TokenType::KW_FALSE, Language::HINDI},
+    {"और", TokenType::KW_AND, Language::HINDI},
+    {"या", TokenType::KW_OR, Language::HINDI},
+    {"नहीं", TokenType::KW_NOT, Language::HINDI},
+    {"पूर्णांक", TokenType::KW_INT, Language::HINDI},
+    {"दशमलव", TokenType::KW_FLOAT, Language::HINDI},
+    {"वाक्य", TokenType::KW_STRING, Language::HINDI},
+    {"बूलियन", TokenType::KW_BOOL, Language::HINDI},
+    
+    {"ভেৰিয়েবল", TokenType::KW_VAR, Language::ASSAMESE},
+    {"কাৰ্য্য", TokenType::KW_FUNCTION, Language::ASSAMESE},
+    {"যদি", TokenType::KW_IF, Language::ASSAMESE},
+    {"নহলে", TokenType::KW_ELSE, Language::ASSAMESE},
+    {"যতক্ষণ", TokenType::KW_WHILE, Language::ASSAMESE},
+    {"ৰ_বাবে", TokenType::KW_FOR, Language::ASSAMESE},
+    {"ঘূৰাই_দিয়ক", TokenType::KW_RETURN, Language::ASSAMESE},
+    {"সত্য", TokenType::KW_TRUE, Language::ASSAMESE},
+    {"মিছা", TokenType::KW_FALSE, Language::ASSAMESE},
+    {"আৰু", TokenType::KW_AND, Language::ASSAMESE},
+    {"বা", TokenType::KW_OR, Language::ASSAMESE},
+    {"নহয়", TokenType::KW_NOT, Language::ASSAMESE},
+    {"পূৰ্ণসংখ্যা", TokenType::KW_INT, Language::ASSAMESE},
+    {"দশমিক", TokenType::KW_FLOAT, Language::ASSAMESE},
+    {"বাক্য", TokenType::KW_STRING, Language::ASSAMESE},
+    {"বুলিয়ান", TokenType::KW_BOOL, Language::ASSAMESE},
 };
 
-std::unordered_map<std::string, TokenType> Keywords::assameseKeywords = {
-    {"ভেৰিয়েবল", TokenType::VAR_AS},
-    {"কাৰ্য্য", TokenType::FUNCTION_AS},
-    {"যদি", TokenType::IF_AS},
-    {"নহলে", TokenType::ELSE_AS},
-    {"যতক্ষণ", TokenType::WHILE_AS},
-    {"ৰ_বাবে", TokenType::FOR_AS},
-    {"ঘূৰাই_দিয়ক", TokenType::RETURN_AS},
-    {"সত্য", TokenType::TRUE_AS},
-    {"মিছা", TokenType::FALSE_AS},
-    {"আৰু", TokenType::AND_AS},
-    {"বা", TokenType::OR_AS},
-    {"নহয়", TokenType::NOT_AS}
+constexpr size_t keywordCount = sizeof(keywordList) / sizeof(keywordList[0]);
+
+// Perfect hash over the keyword list. The hash only samples the length and
+// four bytes of the word (first, third, middle, last), which already tells
+// every keyword apart; the seed is searched for at compile time so that no
+// two keywords share a slot.
+constexpr size_t keywordTableSize = 256;
+constexpr uint8_t emptySlot = 0xFF;
+
+constexpr uint32_t keywordHash(uint32_t seed, std::string_view word) {
+    size_t n = word.size();
+    uint32_t h = seed ^ static_cast<uint32_t>(n);
+    h = (h ^ static_cast<uint8_t>(word[0])) * 0x01000193u;
+    h = (h ^ static_cast<uint8_t>(word[n > 2 ? 2 : n - 1])) * 0x01000193u;
+    h = (h ^ static_cast<uint8_t>(word[n / 2])) * 0x01000193u;
+    h = (h ^ static_cast<uint8_t>(word[n - 1])) * 0x01000193u;
+    return (h ^ (h >> 16)) & (keywordTableSize - 1);
+}
+
+constexpr bool isPerfectSeed(uint32_t seed) {
+    bool used[keywordTableSize] = {};
+    for (size_t i = 0; i < keywordCount; i++) {
+        uint32_t slot = keywordHash(seed, keywordList[i].text);
+        if (used[slot]) return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t findKeywordSeed() {
+    uint32_t seed = 0x811C9DC5u;
+    while (!isPerfectSeed(seed)) seed++;
+    return seed;
+}
+
+constexpr uint32_t keywordSeed = findKeywordSeed();
+
+struct KeywordTable {
+    uint8_t slots[keywordTableSize];
+    size_t minLength;
+    size_t maxLength;
 };
 
-// Implementation of Keywords class methods
-TokenType Keywords::getKeywordType(const std::string& word) {
-    // Check English keywords
-    auto it = englishKeywords.find(word);
-    if (it != englishKeywords.end()) {
-        return it->second;
+constexpr KeywordTable buildKeywordTable() {
+    KeywordTable table = {};
+    for (size_t i = 0; i < keywordTableSize; i++) table.slots[i] = emptySlot;
+    table.minLength = keywordList[0].text.size();
+    table.maxLength = keywordList[0].text.size();
+    for (size_t i = 0; i < keywordCount; i++) {
+        table.slots[keywordHash(keywordSeed, keywordList[i].text)] = static_cast<uint8_t>(i);
+        if (keywordList[i].text.size() < table.minLength) table.minLength = keywordList[i].text.size();
+        if (keywordList[i].text.size() > table.maxLength) table.maxLength = keywordList[i].text.size();
     }
-    
-    // Check Hindi keywords
-    it = hindiKeywords.find(word);
-    if (it != hindiKeywords.end()) {
-        return it->second;
+    return table;
+}
+
+constexpr KeywordTable keywordTable = buildKeywordTable();
+
+static_assert(keywordCount < emptySlot, "keyword indices must fit in a slot");
+
+} // namespace
+
+// Implementation of Keywords class methods
+KeywordInfo Keywords::lookup(std::string_view word) {
+    if (word.size() < keywordTable.minLength || word.size() > keywordTable.maxLength) {
+        return {TokenType::IDENTIFIER, Language::NONE};
     }
     
-    // Check Assamese keywords
-    it = assameseKeywords.find(word);
-    if (it != assameseKeywords.end()) {
-        return it->second;
+    uint8_t index = keywordTable.slots[keywordHash(keywordSeed, word)];
+    if (index != emptySlot && keywordList[index].text == word) {
+        return {keywordList[index].type, keywordList[index].language};
     }
     
-    return TokenType::IDENTIFIER;
+    return {TokenType::IDENTIFIER, Language::NONE};
 }
 
-bool Keywords::isKeyword(const std::string& word) {
-    return englishKeywords.find(word) != englishKeywords.end() ||
-           hindiKeywords.find(word) != hindiKeywords.end() ||
-           assameseKeywords.find(word) != assameseKeywords.end();
+TokenType Keywords::getKeywordType(std::string_view word) {
+    return lookup(word).type;
 }
 
-TokenType Keywords::normalizeKeywordType(TokenType type) {
-    // Convert language-specific keywords to a canonical form
-    switch (type) {
-        // Variable declarations
-        case TokenType::VAR_EN:
-        case TokenType::VAR_HI:
-        case TokenType::VAR_AS:
-            return TokenType::VAR_EN;
-            
-        // Functions
-        case TokenType::FUNCTION_EN:
-        case TokenType::FUNCTION_HI:
-        case TokenType::FUNCTION_AS:
-            return TokenType::FUNCTION_EN;
-            
-        // Control flow
-        case TokenType::IF_EN:
-        case TokenType::IF_HI:
-        case TokenType::IF_AS:
-            return TokenType::IF_EN;
-            
-        case TokenType::ELSE_EN:
-        case TokenType::ELSE_HI:
-        case TokenType::ELSE_AS:
-            return TokenType::ELSE_EN;
-            
-        case TokenType::WHILE_EN:
-        case TokenType::WHILE_HI:
-        case TokenType::WHILE_AS:
-            return TokenType::WHILE_EN;
-            
-        case TokenType::FOR_EN:
-        case TokenType::FOR_HI:
-        case TokenType::FOR_AS:
-            return TokenType::FOR_EN;
-            
-        case TokenType::RETURN_EN:
-        case TokenType::RETURN_HI:
-        case TokenType::RETURN_AS:
-            return TokenType::RETURN_EN;
-            
-        // Boolean literals
-        case TokenType::TRUE_EN:
-        case TokenType::TRUE_HI:
-        case TokenType::TRUE_AS:
-            return TokenType::TRUE_EN;
-            
-        case TokenType::FALSE_EN:
-        case TokenType::FALSE_HI:
-        case TokenType::FALSE_AS:
-            return TokenType::FALSE_EN;
-            
-        // Logical operators
-        case TokenType::AND_EN:
-        case TokenType::AND_HI:
-        case TokenType::AND_AS:
-            return TokenType::AND_EN;
-            
-        case TokenType::OR_EN:
-        case TokenType::OR_HI:
-        case TokenType::OR_AS:
-            return TokenType::OR_EN;
-            
-        case TokenType::NOT_EN:
-        case TokenType::NOT_HI:
-        case TokenType::NOT_AS:
-            return TokenType::NOT_EN;
-            
-        default:
-            return type;
+bool Keywords::isKeyword(std::string_view word) {
+    return lookup(word).type != TokenType::IDENTIFIER;
+}
+
+bool Keywords::isKeyword(TokenType type) {
+    return type >= TokenType::KW_VAR && type <= TokenType::KW_BOOL;
+}
+
+std::string_view Keywords::spelling(TokenType type, Language language) {
+    for (const auto& entry : keywordList) {
+        if (entry.type == type && entry.language == language) {
+            return entry.text;
+        }
     }
+    return std::string_view();
+}
+
+TokenType Keywords::normalizeKeywordType(TokenType type) {
+    return type;
 }
 
 void Keywords::initialize() {
-    // Already initialized in the static initializers
+    // Already initialized at compile time
 }
 
 // Token toString method
-std::string Token::toString() const {
+std::string Token::toString(const SourceFile& file) const {
     std::string typeStr;
     
     // Convert token type to string
@@ -170,45 +185,23 @@ std::string Token::toString() const {
         case TokenType::FLOAT_LITERAL: typeStr = "FLOAT_LITERAL"; break;
         case TokenType::STRING_LITERAL: typeStr = "STRING_LITERAL"; break;
         case TokenType::BOOL_LITERAL: typeStr = "BOOL_LITERAL"; break;
-        // English keywords
-        case TokenType::VAR_EN: typeStr = "VAR_EN"; break;
-        case TokenType::FUNCTION_EN: typeStr = "FUNCTION_EN"; break;
-        case TokenType::IF_EN: typeStr = "IF_EN"; break;
-        case TokenType::ELSE_EN: typeStr = "ELSE_EN"; break;
-        case TokenType::WHILE_EN: typeStr = "WHILE_EN"; break;
-        case TokenType::FOR_EN: typeStr = "FOR_EN"; break;
-        case TokenType::RETURN_EN: typeStr = "RETURN_EN"; break;
-        case TokenType::TRUE_EN: typeStr = "TRUE_EN"; break;
-        case TokenType::FALSE_EN: typeStr = "FALSE_EN"; break;
-        case TokenType::AND_EN: typeStr = "AND_EN"; break;
-        case TokenType::OR_EN: typeStr = "OR_EN"; break;
-        case TokenType::NOT_EN: typeStr = "NOT_EN"; break;
-        // Hindi keywords
-        case TokenType::VAR_HI: typeStr = "VAR_HI"; break;
-        case TokenType::FUNCTION_HI: typeStr = "FUNCTION_HI"; break;
-        case TokenType::IF_HI: typeStr = "IF_HI"; break;
-        case TokenType::ELSE_HI: typeStr = "ELSE_HI"; break;
-        case TokenType::WHILE_HI: typeStr = "WHILE_HI"; break;
-        case TokenType::FOR_HI: typeStr = "FOR_HI"; break;
-        case TokenType::RETURN_HI: typeStr = "RETURN_HI"; break;
-        case TokenType::TRUE_HI: typeStr = "TRUE_HI"; break;
-        case TokenType::FALSE_HI: typeStr = "FALSE_HI"; break;
-        case TokenType::AND_HI: typeStr = "AND_HI"; break;
-        case TokenType::OR_HI: typeStr = "OR_HI"; break;
-        case TokenType::NOT_HI: typeStr = "NOT_HI"; break;
-        // Assamese keywords
-        case TokenType::VAR_AS: typeStr = "VAR_AS"; break;
-        case TokenType::FUNCTION_AS: typeStr = "FUNCTION_AS"; break;
-        case TokenType::IF_AS: typeStr = "IF_AS"; break;
-        case TokenType::ELSE_AS: typeStr = "ELSE_AS"; break;
-        case TokenType::WHILE_AS: typeStr = "WHILE_AS"; break;
-        case TokenType::FOR_AS: typeStr = "FOR_AS"; break;
-        case TokenType::RETURN_AS: typeStr = "RETURN_AS"; break;
-        case TokenType::TRUE_AS: typeStr = "TRUE_AS"; break;
-        case TokenType::FALSE_AS: typeStr = "FALSE_AS"; break;
-        case TokenType::AND_AS: typeStr = "AND_AS"; break;
-        case TokenType::OR_AS: typeStr = "OR_AS"; break;
-        case TokenType::NOT_AS: typeStr = "NOT_AS"; break;
+        // Keywords
+        case TokenType::KW_VAR: typeStr = "VAR"; break;
+        case TokenType::KW_FUNCTION: typeStr = "FUNCTION"; break;
+        case TokenType::KW_IF: typeStr = "IF"; break;
+        case TokenType::KW_ELSE: typeStr = "ELSE"; break;
+        case TokenType::KW_WHILE: typeStr = "WHILE"; break;
+        case TokenType::KW_FOR: typeStr = "FOR"; break;
+        case TokenType::KW_RETURN: typeStr = "RETURN"; break;
+        case TokenType::KW_TRUE: typeStr = "TRUE"; break;
+        case TokenType::KW_FALSE: typeStr = "FALSE"; break;
+        case TokenType::KW_AND: typeStr = "AND"; break;
+        case TokenType::KW_OR: typeStr = "OR"; break;
+        case TokenType::KW_NOT: typeStr = "NOT"; break;
+        case TokenType::KW_INT: typeStr = "INT"; break;
+        case TokenType::KW_FLOAT: typeStr = "FLOAT"; break;
+        case TokenType::KW_STRING: typeStr = "STRING"; break;
+        case TokenType::KW_BOOL: typeStr = "BOOL"; break;
         // Operators
         case TokenType::PLUS: typeStr = "PLUS"; break;
         case TokenType::MINUS: typeStr = "MINUS"; break;
@@ -238,11 +231,21 @@ std::string Token::toString() const {
         default: typeStr = "UNKNOWN"; break;
     }
     
-    return typeStr + " " + lexeme + " (line " + std::to_string(line) + ")";
+    // Keywords are tagged with the language they were written in
+    switch (language) {
+        case Language::ENGLISH: typeStr += "_EN"; break;
+        case Language::HINDI: typeStr += "_HI"; break;
+        case Language::ASSAMESE: typeStr += "_AS"; break;
+        case Language::NONE: break;
+    }
+    
+    LineColumn position = file.getLineColumn(offset);
+    return typeStr + " " + std::string(lexeme(file.getText())) + " (line " + std::to_string(position.line) +
+           ", column " + std::to_string(position.column) + ")";
 }
 
 // Lexer implementation
-Lexer::Lexer(std::string source) : source(std::move(source)) {}
+Lexer::Lexer(std::string_view source) : source(source) {}
 
 std::vector<Token> Lexer::scanTokens() {
     while (!isAtEnd()) {
@@ -251,8 +254,34 @@ std::vector<Token> Lexer::scanTokens() {
         scanToken();
     }
     
-    tokens.emplace_back(TokenType::END_OF_FILE, "", line);
-    return tokens;
+    // An empty lexeme at the end of the buffer
+    tokens.emplace_back(TokenType::END_OF_FILE, static_cast<uint32_t>(source.size()), 0);
+    return std::move(tokens);
+}
+
+Token Lexer::nextToken() {
+    // Nothing is kept: `tokens` only ever holds the token being scanned
+    while (!isAtEnd()) {
+        start = current;
+        scanToken();
+        if (!tokens.empty()) {
+            Token token = tokens.back();
+            tokens.pop_back();
+            return token;
+        }
+    }
+    
+    return Token(TokenType::END_OF_FILE, static_cast<uint32_t>(source.size()), 0);
+}
+
+void Lexer::scanRange(int begin, int limit) {
+    // The last token may run past `limit`; it is finished here so the chunk
+    // after it can tell that it has to resynchronize
+    current = begin;
+    while (current < limit && !isAtEnd()) {
+        start = current;
+        scanToken();
+    }
 }
 
 void Lexer::scanToken() {
@@ -276,7 +305,7 @@ void Lexer::scanToken() {
         case '%': addToken(TokenType::MODULO); break;
         
         // One or two character tokens
-        case '!': addToken(match('=') ? TokenType::NOT_EQUAL : TokenType::NOT_EN); break;
+        case '!': addToken(match('=') ? TokenType::NOT_EQUAL : TokenType::KW_NOT); break;
         case '=': addToken(match('=') ? TokenType::EQUAL : TokenType::ASSIGN); break;
         case '<': addToken(match('=') ? TokenType::LESS_EQUAL : TokenType::LESS); break;
         case '>': addToken(match('=') ? TokenType::GREATER_EQUAL : TokenType::GREATER); break;
@@ -285,21 +314,22 @@ void Lexer::scanToken() {
         case '/':
             if (match('/')) {
                 // A comment goes until the end of the line
-                while (peek() != '\n' && !isAtEnd()) advance();
+                current = positionOf(simd::findNewline(cursor(), end()));
             } else {
                 addToken(TokenType::SLASH);
             }
             break;
             
         // Whitespace
+        case '\n':
         case ' ':
         case '\r':
         case '\t':
-            // Ignore whitespace
-            break;
-            
-        case '\n':
-            line++;
+            // Ignore whitespace; single separators are the common case, so
+            // only hand longer runs (indentation, blank lines) to the scanner
+            if (isWhitespace(peek())) {
+                current = positionOf(simd::skipWhitespace(cursor(), end()));
+            }
             break;
             
         // String literals
@@ -308,10 +338,12 @@ void Lexer::scanToken() {
         default:
             if (isDigit(c)) {
                 scanNumber();
-            } else if (isAlpha(c) || isUnicodeAlpha(source, current - 1)) {
+            } else if (isAlpha(c)) {
                 scanIdentifier();
+            } else if (static_cast<unsigned char>(c) >= 0x80) {
+                scanUnicode();
             } else {
-                error(line, "Unexpected character.");
+                error("Unexpected character.");
             }
             break;
     }
@@ -333,6 +365,18 @@ bool Lexer::match(char expected) {
     return true;
 }
 
+const char* Lexer::cursor() const {
+    return source.data() + current;
+}
+
+const char* Lexer::end() const {
+    return source.data() + source.size();
+}
+
+int Lexer::positionOf(const char* p) const {
+    return static_cast<int>(p - source.data());
+}
+
 char Lexer::peek() const {
     if (isAtEnd()) return '\0';
     return source[current];
@@ -344,48 +388,95 @@ char Lexer::peekNext() const {
 }
 
 void Lexer::scanString() {
-    while (peek() != '"' && !isAtEnd()) {
-        if (peek() == '\n') line++;
-        advance();
-    }
+    current = positionOf(simd::findQuote(cursor(), end()));
     
     if (isAtEnd()) {
-        error(line, "Unterminated string.");
+        error("Unterminated string.");
         return;
     }
     
     // The closing "
     advance();
     
-    // Trim the surrounding quotes
-    std::string value = source.substr(start + 1, current - start - 2);
-    addToken(TokenType::STRING_LITERAL, value);
+    // The lexeme keeps its quotes; the parser trims them
+    addToken(TokenType::STRING_LITERAL);
 }
 
 void Lexer::scanNumber() {
     while (isDigit(peek())) advance();
     
     // Look for a fractional part
-    if (peek() == '.' && isDigit(peekNext())) {
+    bool fractional = peek() == '.' && isDigit(peekNext());
+    if (fractional) {
         // Consume the "."
         advance();
         
         while (isDigit(peek())) advance();
-        
-        addToken(TokenType::FLOAT_LITERAL, source.substr(start, current - start));
+    }
+    
+    // Parse the value straight from the source, however long the literal
+    const char* first = source.data() + start;
+    const char* last = source.data() + current;
+    std::from_chars_result result;
+    int64_t intValue = 0;
+    double floatValue = 0;
+    if (fractional) {
+        result = std::from_chars(first, last, floatValue);
+    } else {
+        result = std::from_chars(first, last, intValue);
+    }
+    if (result.ec == std::errc::result_out_of_range) {
+        error("Number literal out of range.");
+        return;
+    }
+    
+    if (fractional) {
+        addToken(TokenType::FLOAT_LITERAL).floatValue = floatValue;
     } else {
-        addToken(TokenType::INT_LITERAL, source.substr(start, current - start));
+        addToken(TokenType::INT_LITERAL).intValue = intValue;
     }
 }
 
 void Lexer::scanIdentifier() {
-    while (isAlphaNumeric(peek()) || isUnicodeAlphaNumeric(source, current)) advance();
+    // Consume ASCII runs in blocks and fall back to the Unicode check for
+    // anything else
+    while (true) {
+        current = positionOf(simd::skipAsciiIdentifier(cursor(), end()));
+        size_t length = unicode::identifierContinueLength(cursor(), end());
+        if (length == 0) break;
+        current += static_cast<int>(length);
+    }
     
     // See if the identifier is a reserved word
-    std::string text = source.substr(start, current - start);
-    TokenType type = Keywords::getKeywordType(text);
+    std::string_view word = source.substr(start, current - start);
+    KeywordInfo keyword = Keywords::lookup(word);
     
-    addToken(type);
+    Token& token = addToken(keyword.type);
+    token.language = keyword.language;
+    if (keyword.type == TokenType::IDENTIFIER) {
+        token.symbol = Interner::global().intern(word);
+    }
+}
+
+void Lexer::scanUnicode() {
+    // advance() only consumed the lead byte; classify the whole code point
+    const char* first = source.data() + start;
+    size_t length = unicode::identifierStartLength(first, end());
+    if (length != 0) {
+        current = start + static_cast<int>(length);
+        scanIdentifier();
+        return;
+    }
+    
+    unicode::DecodedCodePoint decoded = unicode::decode(first, end());
+    if (decoded.length == 0) {
+        error("Invalid UTF-8 sequence.");
+        return;
+    }
+    
+    // Skip the whole character so it is reported once, not once per byte
+    current = start + static_cast<int>(decoded.length);
+    error("Unexpected character.");
 }
 
 bool Lexer::isAlpha(char c) const {
@@ -394,43 +485,35 @@ bool Lexer::isAlpha(char c) const {
            c == '_';
 }
 
-bool Lexer::isUnicodeAlpha(const std::string& s, size_t pos) const {
-    // Basic check for Devanagari (Hindi) and Bengali (Assamese) script characters
-    // This is a simplification - a real implementation would use Unicode libraries
-    unsigned char c = s[pos];
-    
-    // Check if it's a multi-byte UTF-8 character
-    if ((c & 0xC0) == 0xC0) {
-        // Devanagari range: U+0900 to U+097F (approx)
-        // Bengali range: U+0980 to U+09FF (approx)
-        return true;
-    }
-    
-    return false;
+bool Lexer::isWhitespace(char c) const {
+    return c == ' ' || c == '\r' || c == '\t' || c == '\n';
 }
 
 bool Lexer::isDigit(char c) const {
     return c >= '0' && c <= '9';
 }
 
-bool Lexer::isAlphaNumeric(char c) const {
-    return isAlpha(c) || isDigit(c);
-}
-
-bool Lexer::isUnicodeAlphaNumeric(const std::string& s, size_t pos) const {
-    return isUnicodeAlpha(s, pos);
+Token& Lexer::addToken(TokenType type) {
+    return tokens.emplace_back(type, static_cast<uint32_t>(start), static_cast<uint32_t>(current - start));
 }
 
-void Lexer::addToken(TokenType type) {
-    addToken(type, source.substr(start, current - start));
-}
-
-void Lexer::addToken(TokenType type, const std::string& literal) {
-    tokens.emplace_back(type, literal, line);
+void Lexer::error(const std::string& message) {
+    if (deferErrors) {
+        deferredErrors.push_back({start, message});
+        return;
+    }
+    report(start, message);
 }
 
-void Lexer::error(int line, const std::string& message) {
-    std::cerr << "[line " << line << "] Error: " << message << std::endl;
+void Lexer::report(int offset, const std::string& message) {
+    errorCount++;
+    if (!file) {
+        file = std::make_unique<SourceFile>(source);
+    }
+    
+    LineColumn position = file->getLineColumn(static_cast<uint32_t>(offset));
+    std::cerr << "[line " << position.line << ", column " << position.column << "] Error: "
+              << message << std::endl;
 }
 
 } // namespace tribhasha
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "tribhasha/Lexer.h"
+#include <algorithm>
+#include <thread>
+
+namespace tribhasha {
+
+std::vector<Token> Lexer::scanTokensParallel(unsigned threadCount, size_t minChunkSize) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    size_t chunkCount = std::min<size_t>(threadCount, source.size() / std::max<size_t>(minChunkSize, 1));
+    if (chunkCount < 2) {
+        return scanTokens();
+    }
+
+    // Split at line starts. A chunk can still begin inside a multi-line
+    // string literal; that is detected and repaired while stitching.
+    std::vector<int> bounds{0};
+    for (size_t i = 1; i < chunkCount; i++) {
+        size_t newline = source.find('\n', source.size() * i / chunkCount);
+        if (newline == std::string_view::npos) break;
+        int boundary = static_cast<int>(newline + 1);
+        if (boundary > bounds.back() && boundary < static_cast<int>(source.size())) {
+            bounds.push_back(boundary);
+        }
+    }
+    bounds.push_back(static_cast<int>(source.size()));
+
+    if (bounds.size() < 3) {
+        return scanTokens();
+    }
+
+    // Lex every chunk speculatively, as if it started at a token boundary.
+    // The first chunk runs on this thread.
+    size_t count = bounds.size() - 1;
+    std::vector<Lexer> chunks;
+    chunks.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        chunks.emplace_back(source);
+        chunks.back().deferErrors = true;
+    }
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < count; i++) {
+        workers.emplace_back([&chunks, &bounds, i] {
+            chunks[i].scanRange(bounds[i], bounds[i + 1]);
+        });
+    }
+    chunks[0].scanRange(bounds[0], bounds[1]);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    // Stitch the chunks together in order. `current` tracks where the
+    // correct token stream has got to.
+    tokens.clear();
+    std::vector<DeferredError> errors;
+    current = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        Lexer& chunk = chunks[i];
+        size_t keepFrom = 0;
+        int keepOffset = bounds[i];
+
+        if (current > bounds[i]) {
+            // The previous chunk's last token (a string literal, or a run of
+            // whitespace) ran into this chunk, so this chunk may have started
+            // in the wrong state. Re-lex from the right place until a token
+            // starts where one of the speculative tokens starts; from there
+            // on the two streams are identical.
+            Lexer relexer(source);
+            relexer.deferErrors = true;
+            relexer.current = current;
+
+            bool synchronized = false;
+            while (relexer.current < chunk.current && !relexer.isAtEnd()) {
+                size_t before = relexer.tokens.size();
+                relexer.start = relexer.current;
+                relexer.scanToken();
+                if (relexer.tokens.size() == before) continue;
+
+                uint32_t offset = relexer.tokens.back().offset;
+                auto match = std::lower_bound(chunk.tokens.begin(), chunk.tokens.end(), offset,
+                    [](const Token& t, uint32_t value) { return t.offset < value; });
+                if (match != chunk.tokens.end() && match->offset == offset) {
+                    keepFrom = static_cast<size_t>(match - chunk.tokens.begin());
+                    keepOffset = static_cast<int>(offset);
+                    relexer.tokens.pop_back();
+                    synchronized = true;
+                    break;
+                }
+            }
+
+            tokens.insert(tokens.end(), relexer.tokens.begin(), relexer.tokens.end());
+            errors.insert(errors.end(), relexer.deferredErrors.begin(), relexer.deferredErrors.end());
+
+            if (!synchronized) {
+                // The re-lex covered the whole chunk
+                current = relexer.current;
+                continue;
+            }
+        }
+
+        tokens.insert(tokens.end(), chunk.tokens.begin() + keepFrom, chunk.tokens.end());
+        for (const auto& error : chunk.deferredErrors) {
+            if (error.offset >= keepOffset) {
+                errors.push_back(error);
+            }
+        }
+
+        current = chunk.current;
+    }
+
+    // Report diagnostics in source order, as the sequential lexer would
+    for (const auto& error : errors) {
+        report(error.offset, error.message);
+    }
+
+    tokens.emplace_back(TokenType::END_OF_FILE, static_cast<uint32_t>(source.size()), 0);
+    return std::move(tokens);
+}
+
+} // namespace tribhasha
@@ -0,0 +1,213 @@
+#include "tribhasha/SimdScan.h"
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define TRIBHASHA_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+namespace tribhasha {
+namespace simd {
+
+namespace {
+
+// Scalar classification shared by every implementation for the tails
+inline bool isWhitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+inline bool isAsciiIdentifier(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '_';
+}
+
+#ifdef TRIBHASHA_SIMD_X86
+
+// Byte masks for one 16-byte block. The identifier test uses the usual
+// "subtract, then compare with the bias flipped" trick because SSE2 only
+// has signed byte comparisons.
+inline unsigned whitespaceMask16(__m128i v) {
+    __m128i ws = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+        _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+    return static_cast<unsigned>(_mm_movemask_epi8(ws));
+}
+
+inline unsigned identifierMask16(__m128i v) {
+    const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i alpha = _mm_cmplt_epi8(
+        _mm_add_epi8(_mm_sub_epi8(lower, _mm_set1_epi8('a')), bias),
+        _mm_set1_epi8(static_cast<char>(26 - 128)));
+    __m128i digit = _mm_cmplt_epi8(
+        _mm_add_epi8(_mm_sub_epi8(v, _mm_set1_epi8('0')), bias),
+        _mm_set1_epi8(static_cast<char>(10 - 128)));
+    __m128i underscore = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    return static_cast<unsigned>(_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), underscore)));
+}
+
+const char* skipWhitespaceSSE2(const char* p, const char* end) {
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned ws = whitespaceMask16(v);
+        if (ws != 0xFFFFu) {
+            return p + __builtin_ctz(~ws);
+        }
+        p += 16;
+    }
+    return p;
+}
+
+const char* findNewlineSSE2(const char* p, const char* end) {
+    const __m128i newline = _mm_set1_epi8('\n');
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, newline)));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return p;
+}
+
+const char* findQuoteSSE2(const char* p, const char* end) {
+    const __m128i quote = _mm_set1_epi8('"');
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return p;
+}
+
+const char* skipAsciiIdentifierSSE2(const char* p, const char* end) {
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = identifierMask16(v);
+        if (mask != 0xFFFFu) {
+            return p + __builtin_ctz(~mask);
+        }
+        p += 16;
+    }
+    return p;
+}
+
+// AVX2 versions: the same algorithms over 32-byte blocks, compiled for AVX2
+// regardless of the baseline flags and only called after a CPU check.
+#define TRIBHASHA_AVX2 __attribute__((target("avx2")))
+
+TRIBHASHA_AVX2 const char* skipWhitespaceAVX2(const char* p, const char* end) {
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i ws = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(ws));
+        if (mask != 0xFFFFFFFFu) {
+            return p + __builtin_ctz(~mask);
+        }
+        p += 32;
+    }
+    return skipWhitespaceSSE2(p, end);
+}
+
+TRIBHASHA_AVX2 const char* findNewlineAVX2(const char* p, const char* end) {
+    const __m256i newline = _mm256_set1_epi8('\n');
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, newline)));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return findNewlineSSE2(p, end);
+}
+
+TRIBHASHA_AVX2 const char* findQuoteAVX2(const char* p, const char* end) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return findQuoteSSE2(p, end);
+}
+
+TRIBHASHA_AVX2 const char* skipAsciiIdentifierAVX2(const char* p, const char* end) {
+    const __m256i bias = _mm256_set1_epi8(static_cast<char>(0x80));
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        // AVX2 has no signed less-than for bytes, so compare the other way
+        __m256i alpha = _mm256_cmpgt_epi8(
+            _mm256_set1_epi8(static_cast<char>(26 - 128)),
+            _mm256_add_epi8(_mm256_sub_epi8(lower, _mm256_set1_epi8('a')), bias));
+        __m256i digit = _mm256_cmpgt_epi8(
+            _mm256_set1_epi8(static_cast<char>(10 - 128)),
+            _mm256_add_epi8(_mm256_sub_epi8(v, _mm256_set1_epi8('0')), bias));
+        __m256i underscore = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_or_si256(alpha, digit), underscore)));
+        if (mask != 0xFFFFFFFFu) {
+            return p + __builtin_ctz(~mask);
+        }
+        p += 32;
+    }
+    return skipAsciiIdentifierSSE2(p, end);
+}
+
+#undef TRIBHASHA_AVX2
+
+// Decided once; the branch on it is perfectly predictable. The explicit
+// init is required because this runs from a static constructor.
+const bool hasAVX2 = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+}();
+
+#endif // TRIBHASHA_SIMD_X86
+
+} // namespace
+
+const char* skipWhitespace(const char* p, const char* end) {
+#ifdef TRIBHASHA_SIMD_X86
+    p = hasAVX2 ? skipWhitespaceAVX2(p, end) : skipWhitespaceSSE2(p, end);
+#endif
+    while (p < end && isWhitespace(*p)) p++;
+    return p;
+}
+
+const char* findNewline(const char* p, const char* end) {
+#ifdef TRIBHASHA_SIMD_X86
+    p = hasAVX2 ? findNewlineAVX2(p, end) : findNewlineSSE2(p, end);
+#endif
+    const void* found = std::memchr(p, '\n', static_cast<size_t>(end - p));
+    return found ? static_cast<const char*>(found) : end;
+}
+
+const char* findQuote(const char* p, const char* end) {
+#ifdef TRIBHASHA_SIMD_X86
+    p = hasAVX2 ? findQuoteAVX2(p, end) : findQuoteSSE2(p, end);
+#endif
+    const void* found = std::memchr(p, '"', static_cast<size_t>(end - p));
+    return found ? static_cast<const char*>(found) : end;
+}
+
+const char* skipAsciiIdentifier(const char* p, const char* end) {
+#ifdef TRIBHASHA_SIMD_X86
+    p = hasAVX2 ? skipAsciiIdentifierAVX2(p, end) : skipAsciiIdentifierSSE2(p, end);
+#endif
+    while (p < end && isAsciiIdentifier(*p)) p++;
+    return p;
+}
+
+} // namespace simd
+} // namespace tribhasha
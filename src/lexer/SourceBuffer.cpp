@@ -0,0 +1,77 @@
+#include "tribhasha/SourceBuffer.h"
+#include <fstream>
+#include <sstream>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace tribhasha {
+
+SourceBuffer::~SourceBuffer() {
+#if !defined(_WIN32)
+    if (mapped) {
+        munmap(const_cast<char*>(data), size);
+    }
+#endif
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::fromFile(const std::string& filename) {
+#if !defined(_WIN32)
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return nullptr;
+    }
+
+    // Empty files cannot be mapped; hand back an empty buffer instead
+    if (st.st_size == 0) {
+        close(fd);
+        return fromString(filename, std::string());
+    }
+
+    void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (addr != MAP_FAILED) {
+        // The lexer reads the file front to back exactly once
+        madvise(addr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+        std::unique_ptr<SourceBuffer> buffer(new SourceBuffer());
+        buffer->name = filename;
+        buffer->data = static_cast<const char*>(addr);
+        buffer->size = static_cast<size_t>(st.st_size);
+        buffer->mapped = true;
+        return buffer;
+    }
+#endif
+
+    // Fall back to reading the whole file
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+        return nullptr;
+    }
+
+    std::stringstream stream;
+    stream << file.rdbuf();
+    return fromString(filename, stream.str());
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::fromString(std::string name, std::string contents) {
+    std::unique_ptr<SourceBuffer> buffer(new SourceBuffer());
+    buffer->name = std::move(name);
+    buffer->contents = std::move(contents);
+    buffer->data = buffer->contents.data();
+    buffer->size = buffer->contents.size();
+    return buffer;
+}
+
+} // namespace tribhasha
@@ -0,0 +1,61 @@
+#include "tribhasha/SourceManager.h"
+#include "tribhasha/SimdScan.h"
+#include <algorithm>
+#include <utility>
+
+namespace tribhasha {
+
+SourceFile::SourceFile(std::string_view text, std::string name)
+    : name(std::move(name)), text(text) {}
+
+void SourceFile::buildLineTable() const {
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+
+    lineStarts.push_back(0);
+    for (const char* p = simd::findNewline(begin, end); p < end; p = simd::findNewline(p + 1, end)) {
+        lineStarts.push_back(static_cast<uint32_t>(p + 1 - begin));
+    }
+}
+
+uint32_t SourceFile::getLine(uint32_t offset) const {
+    std::call_once(linesBuilt, [this] { buildLineTable(); });
+
+    // The last line start at or before the offset
+    auto next = std::upper_bound(lineStarts.begin(), lineStarts.end(), offset);
+    return static_cast<uint32_t>(next - lineStarts.begin());
+}
+
+LineColumn SourceFile::getLineColumn(uint32_t offset) const {
+    offset = std::min<uint32_t>(offset, static_cast<uint32_t>(text.size()));
+    uint32_t line = getLine(offset);
+
+    // Count code points from the start of the line: every byte except the
+    // UTF-8 continuation bytes starts one
+    uint32_t column = 1;
+    for (uint32_t i = lineStarts[line - 1]; i < offset; i++) {
+        if ((static_cast<unsigned char>(text[i]) & 0xC0) != 0x80) column++;
+    }
+
+    return {line, column};
+}
+
+const SourceFile* SourceManager::loadFile(const std::string& filename) {
+    auto buffer = SourceBuffer::fromFile(filename);
+    if (!buffer) {
+        return nullptr;
+    }
+    return &addBuffer(std::move(buffer));
+}
+
+const SourceFile& SourceManager::addBuffer(std::unique_ptr<SourceBuffer> buffer) {
+    files.push_back(std::make_unique<SourceFile>(buffer->getText(), buffer->getName()));
+    buffers.push_back(std::move(buffer));
+    return *files.back();
+}
+
+const SourceFile& SourceManager::addString(std::string name, std::string contents) {
+    return addBuffer(SourceBuffer::fromString(std::move(name), std::move(contents)));
+}
+
+} // namespace tribhasha
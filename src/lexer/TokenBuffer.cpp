@@ -0,0 +1,169 @@
+#include "tribhasha/TokenBuffer.h"
+#include <algorithm>
+
+namespace tribhasha {
+
+namespace {
+
+// Tokens per chunk when the buffer is split up, and how large one may grow
+// from edits before it is split again
+constexpr size_t chunkTokens = 256;
+constexpr size_t maxChunkTokens = 4 * chunkTokens;
+
+Token absolute(Token token, int64_t start) {
+    token.offset = static_cast<uint32_t>(start + token.offset);
+    return token;
+}
+
+} // namespace
+
+TokenBuffer::TokenBuffer(std::vector<Token> tokens) {
+    rebuild(std::move(tokens));
+}
+
+int64_t TokenBuffer::startOf(size_t chunk) const {
+    int64_t start = chunks[chunk].base;
+    for (size_t i = chunk + 1; i > 0; i -= i & (~i + 1)) {
+        start += shifts[i - 1];
+    }
+    return start;
+}
+
+// Move `chunk` and every chunk after it
+void TokenBuffer::shiftFrom(size_t chunk, int64_t delta) {
+    for (size_t i = chunk + 1; i <= shifts.size(); i += i & (~i + 1)) {
+        shifts[i - 1] += delta;
+    }
+}
+
+void TokenBuffer::count(size_t chunk, int64_t delta) {
+    for (size_t i = chunk + 1; i <= counts.size(); i += i & (~i + 1)) {
+        counts[i - 1] += delta;
+    }
+}
+
+std::pair<size_t, size_t> TokenBuffer::locate(size_t index) const {
+    // Skip the longest run of chunks that all end at or before `index`
+    size_t skipped = 0;
+    int64_t remaining = static_cast<int64_t>(index);
+    size_t step = 1;
+    while (step * 2 <= counts.size()) step *= 2;
+    for (; step > 0; step /= 2) {
+        if (skipped + step <= counts.size() && counts[skipped + step - 1] <= remaining) {
+            skipped += step;
+            remaining -= counts[skipped - 1];
+        }
+    }
+    if (skipped == chunks.size()) {
+        return {chunks.size() - 1, tokenCount - chunks.back().tokens.size()};
+    }
+    return {skipped, index - static_cast<size_t>(remaining)};
+}
+
+void TokenBuffer::fill(size_t chunk, std::vector<Token> tokens) {
+    Chunk& target = chunks[chunk];
+    bool wasEmpty = target.tokens.empty();
+    count(chunk, static_cast<int64_t>(tokens.size()) - static_cast<int64_t>(target.tokens.size()));
+
+    if (!tokens.empty()) {
+        int64_t start = tokens.front().offset;
+        target.base += start - startOf(chunk);
+        for (Token& token : tokens) {
+            token.offset = static_cast<uint32_t>(token.offset - start);
+        }
+    }
+    target.tokens = std::move(tokens);
+
+    if (wasEmpty && !target.tokens.empty()) {
+        emptyChunks--;
+    } else if (!wasEmpty && target.tokens.empty()) {
+        emptyChunks++;
+    }
+}
+
+void TokenBuffer::rebuild(std::vector<Token> tokens) {
+    tokenCount = tokens.size();
+    chunks.clear();
+    for (size_t begin = 0; begin < tokens.size() || chunks.empty(); begin += chunkTokens) {
+        size_t end = std::min(tokens.size(), begin + chunkTokens);
+        Chunk chunk{begin < end ? tokens[begin].offset : 0, {}};
+        chunk.tokens.reserve(end - begin);
+        for (size_t i = begin; i < end; i++) {
+            chunk.tokens.push_back(absolute(tokens[i], -chunk.base));
+        }
+        chunks.push_back(std::move(chunk));
+    }
+
+    shifts.assign(chunks.size(), 0);
+    counts.assign(chunks.size(), 0);
+    emptyChunks = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        count(i, static_cast<int64_t>(chunks[i].tokens.size()));
+        emptyChunks += chunks[i].tokens.empty();
+    }
+}
+
+Token TokenBuffer::operator[](size_t index) const {
+    auto [chunk, first] = locate(index);
+    return absolute(chunks[chunk].tokens[index - first], startOf(chunk));
+}
+
+std::vector<Token> TokenBuffer::toVector() const {
+    std::vector<Token> tokens;
+    tokens.reserve(tokenCount);
+    for (size_t i = 0; i < chunks.size(); i++) {
+        int64_t start = startOf(i);
+        for (const Token& token : chunks[i].tokens) {
+            tokens.push_back(absolute(token, start));
+        }
+    }
+    return tokens;
+}
+
+void TokenBuffer::replace(size_t begin, size_t end, const std::vector<Token>& replacement, int64_t delta) {
+    auto [first, firstStart] = locate(begin);
+    auto [last, lastStart] = locate(end);
+    size_t keptBefore = begin - firstStart;
+    size_t replacedInLast = end - lastStart;
+
+    // The first chunk keeps its tokens before `begin` and takes the new ones
+    int64_t start = startOf(first);
+    const std::vector<Token>& old = chunks[first].tokens;
+    std::vector<Token> tokens;
+    tokens.reserve(keptBefore + replacement.size() + (first == last ? old.size() - replacedInLast : 0));
+    for (size_t i = 0; i < keptBefore; i++) {
+        tokens.push_back(absolute(old[i], start));
+    }
+    tokens.insert(tokens.end(), replacement.begin(), replacement.end());
+
+    if (first == last) {
+        // The rest of the chunk moves with the chunks after it
+        for (size_t i = replacedInLast; i < old.size(); i++) {
+            tokens.push_back(absolute(old[i], start + delta));
+        }
+        fill(first, std::move(tokens));
+        if (first + 1 < chunks.size()) {
+            shiftFrom(first + 1, delta);
+        }
+    } else {
+        fill(first, std::move(tokens));
+        for (size_t i = first + 1; i < last; i++) {
+            if (!chunks[i].tokens.empty()) fill(i, {});
+        }
+
+        // The last chunk keeps the offsets of the tokens it still has
+        std::vector<Token>& rest = chunks[last].tokens;
+        bool wasEmpty = rest.empty();
+        rest.erase(rest.begin(), rest.begin() + replacedInLast);
+        count(last, -static_cast<int64_t>(replacedInLast));
+        if (!wasEmpty && rest.empty()) emptyChunks++;
+        shiftFrom(last, delta);
+    }
+    tokenCount = tokenCount - (end - begin) + replacement.size();
+
+    if (chunks[first].tokens.size() > maxChunkTokens || emptyChunks * 2 > chunks.size()) {
+        rebuild(toVector());
+    }
+}
+
+} // namespace tribhasha
@@ -0,0 +1,145 @@
+#include "tribhasha/Unicode.h"
+
+namespace tribhasha {
+namespace unicode {
+
+namespace {
+
+// UTF-8 decoding DFA in the style of Bjoern Hoehrmann's decoder. Bytes are
+// first mapped to one of 12 classes; the state (a multiple of 12) plus the
+// class then indexes the transition table.
+constexpr uint8_t byteClass[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9, 9,
+    7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    8, 8, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+    10, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 4, 3, 3, 11, 6, 6, 6, 5, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+};
+
+constexpr uint8_t ACCEPT = 0;
+constexpr uint8_t REJECT = 12;
+
+constexpr uint8_t transitions[108] = {
+    // ACCEPT: start of a sequence
+    0, 12, 24, 36, 60, 96, 84, 12, 12, 12, 48, 72,
+    // REJECT
+    12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,
+    // One continuation byte left
+    12, 0, 12, 12, 12, 12, 12, 0, 12, 0, 12, 12,
+    // Two continuation bytes left
+    12, 24, 12, 12, 12, 12, 12, 24, 12, 24, 12, 12,
+    // After E0: A0..BF (no overlongs)
+    12, 12, 12, 12, 12, 12, 12, 24, 12, 12, 12, 12,
+    // After ED: 80..9F (no surrogates)
+    12, 24, 12, 12, 12, 12, 12, 12, 12, 24, 12, 12,
+    // After F0: 90..BF (no overlongs)
+    12, 12, 12, 12, 12, 12, 12, 36, 12, 36, 12, 12,
+    // After F1..F3: any continuation byte
+    12, 36, 12, 12, 12, 12, 12, 36, 12, 36, 12, 12,
+    // After F4: 80..8F (nothing above U+10FFFF)
+    12, 36, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,
+};
+
+// XID_Start / XID_Continue for U+0900..U+09FF (Devanagari and Bengali),
+// one bit per code point, generated from the Unicode 14.0 character database.
+constexpr uint64_t indicStart[4] = {
+    0x23fffffffffffff0ull, 0xfffe0003ff010000ull,
+    0x23c5fdfffff99fe1ull, 0x10030003b0004000ull,
+};
+
+constexpr uint64_t indicContinue[4] = {
+    0xffffffffffffffffull, 0xfffeffcfffffffffull,
+    0xf3c5fdfffff99fefull, 0x5003ffcfb080799full,
+};
+
+constexpr uint32_t indicFirst = 0x0900;
+constexpr uint32_t indicLast = 0x09FF;
+constexpr uint32_t zeroWidthNonJoiner = 0x200C;
+constexpr uint32_t zeroWidthJoiner = 0x200D;
+
+inline bool testBit(const uint64_t* table, uint32_t index) {
+    return (table[index >> 6] >> (index & 63)) & 1;
+}
+
+inline bool isAsciiStart(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+inline bool isAsciiContinue(unsigned char c) {
+    return isAsciiStart(c) || (c >= '0' && c <= '9');
+}
+
+// Both Indic blocks encode as E0 A4..A7 xx, which maps directly onto an
+// index into the bit tables without running the general decoder. Returns
+// -1 when the bytes are something else.
+inline int indicIndex(const unsigned char* p, const char* end) {
+    if (reinterpret_cast<const char*>(p) + 3 > end) return -1;
+    if (p[0] != 0xE0 || (p[1] & 0xFC) != 0xA4 || (p[2] & 0xC0) != 0x80) return -1;
+    return ((p[1] - 0xA4) << 6) | (p[2] & 0x3F);
+}
+
+} // namespace
+
+DecodedCodePoint decode(const char* p, const char* end) {
+    uint32_t state = ACCEPT;
+    uint32_t codePoint = 0;
+
+    for (unsigned length = 1; p < end; length++, p++) {
+        unsigned char byte = static_cast<unsigned char>(*p);
+        uint32_t type = byteClass[byte];
+
+        codePoint = (state != ACCEPT) ? (byte & 0x3Fu) | (codePoint << 6) : (0xFFu >> type) & byte;
+        state = transitions[state + type];
+
+        if (state == ACCEPT) return {codePoint, length};
+        if (state == REJECT) break;
+    }
+
+    return {0xFFFD, 0};
+}
+
+bool isIdentifierStart(uint32_t codePoint) {
+    if (codePoint < 0x80) return isAsciiStart(static_cast<unsigned char>(codePoint));
+    if (codePoint >= indicFirst && codePoint <= indicLast) {
+        return testBit(indicStart, codePoint - indicFirst);
+    }
+    return false;
+}
+
+bool isIdentifierContinue(uint32_t codePoint) {
+    if (codePoint < 0x80) return isAsciiContinue(static_cast<unsigned char>(codePoint));
+    if (codePoint >= indicFirst && codePoint <= indicLast) {
+        return testBit(indicContinue, codePoint - indicFirst);
+    }
+    return codePoint == zeroWidthNonJoiner || codePoint == zeroWidthJoiner;
+}
+
+size_t identifierStartLength(const char* p, const char* end) {
+    if (p >= end) return 0;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(p);
+    if (bytes[0] < 0x80) return isAsciiStart(bytes[0]) ? 1 : 0;
+
+    int index = indicIndex(bytes, end);
+    if (index >= 0) return testBit(indicStart, static_cast<uint32_t>(index)) ? 3 : 0;
+
+    DecodedCodePoint decoded = decode(p, end);
+    return decoded.length != 0 && isIdentifierStart(decoded.codePoint) ? decoded.length : 0;
+}
+
+size_t identifierContinueLength(const char* p, const char* end) {
+    if (p >= end) return 0;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(p);
+    if (bytes[0] < 0x80) return isAsciiContinue(bytes[0]) ? 1 : 0;
+
+    int index = indicIndex(bytes, end);
+    if (index >= 0) return testBit(indicContinue, static_cast<uint32_t>(index)) ? 3 : 0;
+
+    DecodedCodePoint decoded = decode(p, end);
+    return decoded.length != 0 && isIdentifierContinue(decoded.codePoint) ? decoded.length : 0;
+}
+
+} // namespace unicode
+} // namespace tribhasha
@@ -1,11 +1,18 @@
 #include "tribhasha/Lexer.h"
 #include "tribhasha/Parser.h"
+#include "tribhasha/ASTCache.h"
+#include "tribhasha/DeclarationStream.h"
+#include "tribhasha/Pipeline.h"
+#include "tribhasha/Resolver.h"
+#include "tribhasha/ConstantFolder.h"
+#include "tribhasha/PurityAnalysis.h"
+#include "tribhasha/TypeInference.h"
 #include "tribhasha/CodeGen.h"
 #include "tribhasha/JIT.h"
 #include "tribhasha/REPL.h"
+#include "tribhasha/SourceManager.h"
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <cstdlib>
 #include <string>
 #include <memory>
 
@@ -19,6 +26,12 @@ void printUsage(const std::string& programName) {
     std::cout << "  -t, --tokens        Print tokens (requires file)" << std::endl;
     std::cout << "  -a, --ast           Print AST (requires file)" << std::endl;
     std::cout << "  -e, --execute       Execute the file (default)" << std::endl;
+    std::cout << "  -j, --jobs <n>      Threads for the front end (0 = all cores, default 1)" << std::endl;
+    std::cout << "  --stream            Compile one declaration at a time in bounded memory" << std::endl;
+    std::cout << "  --pipeline          Lex, parse, generate and compile on concurrent threads" << std::endl;
+    std::cout << "  --ast-cache         Reuse the parsed AST (<file>.astcache) and compile-time results (<file>.evalcache) when the file is unchanged" << std::endl;
+    std::cout << "  --memoize           Cache the results of pure recursive functions" << std::endl;
+    std::cout << "  --parallel          Run independent calls in pure recursive functions on all cores" << std::endl;
     std::cout << "If no file is provided, the REPL will start." << std::endl;
 }
 
@@ -28,53 +41,227 @@ void printVersion() {
     std::cout << "Copyright (c) 2025 रायन तामुली (Raayan Tamuly)" << std::endl;
 }
 
-bool executeFile(const std::string& filename) {
-    // Read the file
-    std::ifstream file(filename);
+// Lex and parse a script, or rebuild its AST from the cache next to it if
+// `useCache` is set and the cache was written for this exact text. Fresh
+// parses refresh the cache. Returns false, after printing the diagnostics,
+// if the script does not parse.
+bool parseScript(const SourceFile& file, unsigned jobs, bool useCache,
+                 ASTContext& astContext, std::vector<Stmt*>& statements) {
+    std::string_view source = file.getText();
+    std::string cachePath = astCachePath(file.getName());
+    
+    if (useCache) {
+        if (auto cache = ASTCacheReader::open(cachePath, source)) {
+            if (cache->decodeStatements(astContext, statements)) {
+                return true;
+            }
+            // Corrupt; parse it again below
+            astContext.reset();
+        }
+    }
+    
+    // Tokenize
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokensParallel(jobs);
+    
+    // Parse
+    Parser parser(tokens, source, astContext);
+    statements = parser.parseParallel(jobs);
+    if (parser.hadError()) {
+        parser.getDiagnostics().print(std::cerr, file);
+        return false;
+    }
+    
+    // Only scripts without errors are cached, so a cache hit never hides one
+    if (useCache && !lexer.hadError()) {
+        writeASTCache(cachePath, source, tokens, statements);
+    }
+    return true;
+}
+
+// JIT the program `codegen` generated and run its main function
+bool runProgram(CodeGen& codegen) {
+    // Get the module
+    auto module = codegen.getModule();
+    
+    // Create JIT
+    auto jitResult = TribhashaJIT::create();
+    if (!jitResult) {
+        std::cerr << "Error creating JIT" << std::endl;
+        return false;
+    }
+    
+    auto jit = std::move(*jitResult);
+    
+    // Add the module to the JIT
+    auto err = jit->addModule(std::move(module));
+    if (err) {
+        std::cerr << "Error adding module to JIT" << std::endl;
+        return false;
+    }
+    
+    // Execute the main function
+    err = jit->executeMain();
+    if (err) {
+        std::cerr << "Error executing code" << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
+bool executeFile(const std::string& filename, unsigned jobs, bool useCache, bool memoize, bool parallel) {
+    // Map the file; tokens record offsets into the mapping
+    SourceManager sources;
+    const SourceFile* file = sources.loadFile(filename);
     if (!file) {
         std::cerr << "Error: Could not open file " << filename << std::endl;
         return false;
     }
     
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string source = buffer.str();
-    
     try {
-        // Tokenize
-        Lexer lexer(source);
-        std::vector<Token> tokens = lexer.scanTokens();
+        ASTContext astContext;
+        std::vector<Stmt*> statements;
+        if (!parseScript(*file, jobs, useCache, astContext, statements)) {
+            return false;
+        }
         
-        // Parse
-        Parser parser(tokens);
-        std::vector<std::shared_ptr<Stmt>> statements = parser.parse();
+        // Bind variables to slots
+        Resolver resolver;
+        resolver.resolve(statements);
+        if (resolver.hadError()) {
+            resolver.getDiagnostics().print(std::cerr, *file);
+            return false;
+        }
+        
+        // Work out and check the types
+        TypeInference inference;
+        inference.infer(statements);
+        if (inference.hadError()) {
+            inference.getDiagnostics().print(std::cerr, *file);
+            return false;
+        }
+        PurityAnalysis().analyze(statements);
+        
+        // Calls worked out on an earlier run of this text are not run again
+        ConstantFolder folder;
+        std::string resultsPath = evalCachePath(filename);
+        if (useCache) {
+            folder.getEvaluator().loadResults(resultsPath, file->getText());
+        }
+        folder.fold(statements, astContext);
+        if (useCache) {
+            folder.getEvaluator().saveResults(resultsPath, file->getText());
+        }
         
         // Generate code
         CodeGen codegen;
+        codegen.setMemoize(memoize);
+        codegen.setParallel(parallel);
         codegen.generate(statements);
         
-        // Get the module
-        auto module = codegen.getModule();
+        return runProgram(codegen);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// Compile a script one top-level declaration at a time: tokens are scanned
+// as the parser asks for them, and each declaration is lowered and its AST
+// dropped before the next one is parsed. Only the generated module grows
+// with the script.
+bool executeFileStreaming(const std::string& filename, bool memoize, bool parallel) {
+    // Map the file; pages of it are read in as the lexer reaches them
+    SourceManager sources;
+    const SourceFile* file = sources.loadFile(filename);
+    if (!file) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+    
+    std::string_view source = file->getText();
+    
+    try {
+        Lexer lexer(source);
+        DeclarationStream stream(lexer, source);
+        ASTContext astContext;
+        CodeGen codegen;
+        codegen.setMemoize(memoize);
+        codegen.setParallel(parallel);
+        codegen.beginProgram();
+        
+        Resolver resolver;
+        TypeInference inference(true);
+        PurityAnalysis purity;
+        ConstantFolder folder(true);
+        std::vector<Stmt*> statements;
+        while (stream.next(astContext, statements)) {
+            // After an error the rest is only checked, not compiled
+            if (!stream.hadError()) {
+                resolver.resolve(statements);
+            }
+            if (!stream.hadError() && !resolver.hadError()) {
+                inference.infer(statements);
+            }
+            if (!stream.hadError() && !resolver.hadError() && !inference.hadError()) {
+                purity.analyze(statements);
+                folder.fold(statements, astContext);
+                for (Stmt* statement : statements) {
+                    codegen.generate(statement);
+                }
+            }
+            statements.clear();
+            astContext.reset();
+        }
+        
+        if (stream.hadError() || resolver.hadError() || inference.hadError()) {
+            stream.getDiagnostics().print(std::cerr, *file);
+            resolver.getDiagnostics().print(std::cerr, *file);
+            inference.getDiagnostics().print(std::cerr, *file);
+            return false;
+        }
         
-        // Create JIT
+        codegen.finishProgram();
+        return runProgram(codegen);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// Compile a script with the lexer, parser, code generator and JIT each on
+// their own thread, then run it
+bool executeFilePipelined(const std::string& filename, bool memoize, bool parallel) {
+    // Map the file; tokens record offsets into the mapping
+    SourceManager sources;
+    const SourceFile* file = sources.loadFile(filename);
+    if (!file) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+    
+    try {
         auto jitResult = TribhashaJIT::create();
         if (!jitResult) {
             std::cerr << "Error creating JIT" << std::endl;
             return false;
         }
-        
         auto jit = std::move(*jitResult);
         
-        // Add the module to the JIT
-        auto err = jit->addModule(std::move(module));
-        if (err) {
-            std::cerr << "Error adding module to JIT" << std::endl;
+        CompilePipeline pipeline(file->getText(), *jit, memoize, parallel);
+        if (!pipeline.run()) {
+            if (pipeline.getDiagnostics().hasErrors()) {
+                pipeline.getDiagnostics().print(std::cerr, *file);
+            } else {
+                std::cerr << "Error compiling module: " << pipeline.getJITError() << std::endl;
+            }
             return false;
         }
         
         // Execute the main function
-        err = jit->executeMain();
-        if (err) {
+        if (auto err = jit->executeMain()) {
+            llvm::consumeError(std::move(err));
             std::cerr << "Error executing code" << std::endl;
             return false;
         }
@@ -86,48 +273,49 @@ bool executeFile(const std::string& filename) {
     }
 }
 
-void printTokens(const std::string& filename) {
-    // Read the file
-    std::ifstream file(filename);
+void printTokens(const std::string& filename, unsigned jobs, bool useCache) {
+    // Map the file; tokens record offsets into the mapping
+    SourceManager sources;
+    const SourceFile* file = sources.loadFile(filename);
     if (!file) {
         std::cerr << "Error: Could not open file " << filename << std::endl;
         return;
     }
     
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string source = buffer.str();
+    std::string_view source = file->getText();
     
-    // Tokenize
-    Lexer lexer(source);
-    std::vector<Token> tokens = lexer.scanTokens();
+    // The cache keeps the token stream too
+    std::vector<Token> tokens;
+    std::unique_ptr<ASTCacheReader> cache;
+    if (useCache) {
+        cache = ASTCacheReader::open(astCachePath(filename), source);
+    }
+    if (!cache || !cache->decodeTokens(tokens)) {
+        Lexer lexer(source);
+        tokens = lexer.scanTokensParallel(jobs);
+    }
     
     // Print tokens
     for (const auto& token : tokens) {
-        std::cout << token.toString() << std::endl;
+        std::cout << token.toString(*file) << std::endl;
     }
 }
 
-void printAST(const std::string& filename) {
-    // Read the file
-    std::ifstream file(filename);
+void printAST(const std::string& filename, unsigned jobs, bool useCache) {
+    // Map the file; tokens record offsets into the mapping
+    SourceManager sources;
+    const SourceFile* file = sources.loadFile(filename);
     if (!file) {
         std::cerr << "Error: Could not open file " << filename << std::endl;
         return;
     }
     
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string source = buffer.str();
-    
     try {
-        // Tokenize
-        Lexer lexer(source);
-        std::vector<Token> tokens = lexer.scanTokens();
-        
-        // Parse
-        Parser parser(tokens);
-        std::vector<std::shared_ptr<Stmt>> statements = parser.parse();
+        ASTContext astContext;
+        std::vector<Stmt*> statements;
+        if (!parseScript(*file, jobs, useCache, astContext, statements)) {
+            return;
+        }
         
         // Print AST
         std::cout << "AST with " << statements.size() << " statements" << std::endl;
@@ -153,6 +341,12 @@ int main(int argc, char* argv[]) {
     bool printTokensFlag = false;
     bool printASTFlag = false;
     bool executeFlag = true;
+    unsigned jobs = 1;
+    bool useCache = false;
+    bool streaming = false;
+    bool pipelined = false;
+    bool memoize = false;
+    bool parallel = false;
     
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
@@ -171,6 +365,22 @@ int main(int argc, char* argv[]) {
             executeFlag = false;
         } else if (arg == "-e" || arg == "--execute") {
             executeFlag = true;
+        } else if (arg == "-j" || arg == "--jobs") {
+            if (i + 1 >= argc) {
+                std::cerr << "Error: " << arg << " requires a thread count" << std::endl;
+                return 1;
+            }
+            jobs = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--ast-cache") {
+            useCache = true;
+        } else if (arg == "--stream") {
+            streaming = true;
+        } else if (arg == "--pipeline") {
+            pipelined = true;
+        } else if (arg == "--memoize") {
+            memoize = true;
+        } else if (arg == "--parallel") {
+            parallel = true;
         } else if (arg[0] == '-') {
             std::cerr << "Unknown option: " << arg << std::endl;
             printUsage(argv[0]);
@@ -189,15 +399,18 @@ int main(int argc, char* argv[]) {
     
     // Execute the requested actions
     if (printTokensFlag) {
-        printTokens(filename);
+        printTokens(filename, jobs, useCache);
     }
     
     if (printASTFlag) {
-        printAST(filename);
+        printAST(filename, jobs, useCache);
     }
     
     if (executeFlag && !filename.empty()) {
-        if (!executeFile(filename)) {
+        bool ok = pipelined ? executeFilePipelined(filename, memoize, parallel)
+                : streaming ? executeFileStreaming(filename, memoize, parallel)
+                : executeFile(filename, jobs, useCache, memoize, parallel);
+        if (!ok) {
             return 1;
         }
     }
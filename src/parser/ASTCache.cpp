@@ -0,0 +1,757 @@
+#include "tribhasha/ASTCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+namespace tribhasha {
+
+// File layout, all integers in host byte order:
+//
+//   header
+//   symbols     symbolCount x {u32 offset, u32 length}   first occurrence
+//                                                         of each identifier
+//   tokens      tokenCount x {u32 offset, u32 length | type << 24, u32 extra}
+//                                                         extra is the symbol
+//                                                         index of an identifier,
+//                                                         the value index of a
+//                                                         number, or else the
+//                                                         keyword's language
+//   values      valueCount x u64                          numeric literal values
+//   statements  statementCount x u64                      offset of each
+//                                                         top-level statement
+//   nodes       nodesSize bytes                           pre-order encoding
+//
+// A node is its kind byte (nullTag for an absent optional child) followed
+// by its fields; tokens are u32 indices into the token table and lists are
+// a u32 count followed by the elements. The header holds a hash of the
+// sections, so a damaged file is rejected before anything is decoded.
+
+namespace {
+
+constexpr char cacheMagic[8] = {'T', 'R', 'I', 'B', 'A', 'S', 'T', '\n'};
+constexpr uint32_t byteOrderMark = 0x01020304;
+constexpr uint8_t nullTag = 0xFF;
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t sourceHash;
+    uint64_t sourceSize;
+    uint32_t symbolCount;
+    uint32_t tokenCount;
+    uint32_t statementCount;
+    uint32_t valueCount;
+    uint64_t nodesSize;
+    uint64_t sectionsHash;
+};
+
+constexpr size_t symbolRecordSize = 8;
+constexpr size_t tokenRecordSize = 12;
+constexpr size_t valueRecordSize = 8;
+constexpr size_t statementRecordSize = 8;
+
+// Token lengths share a word with the type
+constexpr uint32_t maxTokenLength = (1u << 24) - 1;
+
+// The last token type and language a record can hold
+constexpr TokenType lastTokenType = TokenType::COLON;
+constexpr Language lastLanguage = Language::ASSAMESE;
+
+bool hasValue(TokenType type) {
+    return type == TokenType::INT_LITERAL || type == TokenType::FLOAT_LITERAL;
+}
+
+// Whether the parser builds a node of `kind` around an operator of `type`
+bool isOperator(ExprKind kind, TokenType type) {
+    switch (kind) {
+        case ExprKind::Binary:
+            return type >= TokenType::PLUS && type <= TokenType::GREATER_EQUAL;
+        case ExprKind::Logical:
+            return type == TokenType::KW_AND || type == TokenType::KW_OR;
+        case ExprKind::Unary:
+            return type == TokenType::MINUS || type == TokenType::KW_NOT;
+        default:
+            return false;
+    }
+}
+
+bool isLiteral(TokenType type) {
+    return hasValue(type) || type == TokenType::STRING_LITERAL ||
+           type == TokenType::KW_TRUE || type == TokenType::KW_FALSE;
+}
+
+template <typename T>
+T load(const char* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+uint64_t rotateLeft(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+// Serializes a tree into the node section
+class CacheWriter : public ASTVisitor<CacheWriter> {
+private:
+    const std::vector<Token>& tokens;
+    std::string_view source;
+
+public:
+    std::string out;
+    bool failed = false;
+
+    CacheWriter(const std::vector<Token>& tokens, std::string_view source)
+        : tokens(tokens), source(source) {}
+
+    template <typename T>
+    void put(T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    // Every token in the tree is a copy of one in the token array, which is
+    // sorted by offset
+    void token(const Token& token) {
+        auto it = std::lower_bound(tokens.begin(), tokens.end(), token.offset,
+            [](const Token& t, uint32_t offset) { return t.offset < offset; });
+        if (it == tokens.end() || it->offset != token.offset || it->type != token.type) {
+            failed = true;
+            put<uint32_t>(0);
+            return;
+        }
+        put(static_cast<uint32_t>(it - tokens.begin()));
+    }
+
+    void optional(Expr* expr) {
+        if (expr) visit(expr); else put(nullTag);
+    }
+
+    void optional(Stmt* stmt) {
+        if (stmt) visit(stmt); else put(nullTag);
+    }
+
+    void list(Span<Stmt*> statements) {
+        put(static_cast<uint32_t>(statements.size()));
+        for (Stmt* statement : statements) visit(statement);
+    }
+
+    void kind(ExprKind kind) { put(static_cast<uint8_t>(kind)); }
+    void kind(StmtKind kind) { put(static_cast<uint8_t>(kind)); }
+
+    // In prefix order, as if each operator were written before its
+    // operands in turn: the operators from the outermost in, then the
+    // first operand and the right ones
+    template <typename Node>
+    void chain(const std::vector<Node*>& links) {
+        for (auto link = links.rbegin(); link != links.rend(); ++link) {
+            kind(Node::Kind);
+            token((*link)->op);
+        }
+        visit(links.front()->left);
+        for (Node* link : links) visit(link->right);
+    }
+
+    void visitBinaryExpr(BinaryExpr* expr) {
+        chain(leftChain(expr));
+    }
+
+    void visitLogicalExpr(LogicalExpr* expr) {
+        chain(leftChain(expr));
+    }
+
+    void visitGroupingExpr(GroupingExpr* expr) {
+        kind(ExprKind::Grouping);
+        visit(expr->expression);
+    }
+
+    void visitLiteralExpr(LiteralExpr* expr) {
+        kind(ExprKind::Literal);
+        put(static_cast<uint8_t>(expr->type));
+
+        // true and false are spelled by the parser; everything else views
+        // the source
+        uint32_t offset = 0;
+        uint32_t length = 0;
+        if (expr->type != TokenType::KW_TRUE && expr->type != TokenType::KW_FALSE) {
+            if (expr->value.data() < source.data() ||
+                expr->value.data() + expr->value.size() > source.data() + source.size()) {
+                failed = true;
+            } else {
+                offset = static_cast<uint32_t>(expr->value.data() - source.data());
+                length = static_cast<uint32_t>(expr->value.size());
+            }
+        }
+        put(offset);
+        put(length);
+        put(expr->intValue);
+    }
+
+    void visitUnaryExpr(UnaryExpr* expr) {
+        kind(ExprKind::Unary);
+        token(expr->op);
+        visit(expr->right);
+    }
+
+    void visitVariableExpr(VariableExpr* expr) {
+        kind(ExprKind::Variable);
+        token(expr->name);
+    }
+
+    void visitAssignExpr(AssignExpr* expr) {
+        kind(ExprKind::Assign);
+        token(expr->name);
+        visit(expr->value);
+    }
+
+    void visitCallExpr(CallExpr* expr) {
+        kind(ExprKind::Call);
+        visit(expr->callee);
+        token(expr->paren);
+        put(static_cast<uint32_t>(expr->arguments.size()));
+        for (Expr* argument : expr->arguments) visit(argument);
+    }
+
+    void visitExpressionStmt(ExpressionStmt* stmt) {
+        kind(StmtKind::Expression);
+        visit(stmt->expression);
+    }
+
+    void visitVarStmt(VarStmt* stmt) {
+        kind(StmtKind::Var);
+        token(stmt->name);
+        put(static_cast<uint8_t>(stmt->declaredType));
+        optional(stmt->initializer);
+    }
+
+    void visitBlockStmt(BlockStmt* stmt) {
+        kind(StmtKind::Block);
+        list(stmt->statements);
+    }
+
+    void visitIfStmt(IfStmt* stmt) {
+        kind(StmtKind::If);
+        visit(stmt->condition);
+        visit(stmt->thenBranch);
+        optional(stmt->elseBranch);
+    }
+
+    void visitWhileStmt(WhileStmt* stmt) {
+        kind(StmtKind::While);
+        visit(stmt->condition);
+        visit(stmt->body);
+    }
+
+    void visitFunctionStmt(FunctionStmt* stmt) {
+        kind(StmtKind::Function);
+        token(stmt->name);
+        put(static_cast<uint8_t>(stmt->declaredReturnType));
+        put(static_cast<uint32_t>(stmt->params.size()));
+        for (size_t i = 0; i < stmt->params.size(); i++) {
+            token(stmt->params[i]);
+            put(static_cast<uint8_t>(stmt->declaredParamTypes[i]));
+        }
+        list(stmt->body);
+    }
+
+    void visitReturnStmt(ReturnStmt* stmt) {
+        kind(StmtKind::Return);
+        token(stmt->keyword);
+        optional(stmt->value);
+    }
+};
+
+} // namespace
+
+// Rebuilds nodes from the node section. Every read is bounds-checked; the
+// first bad byte marks the decode as failed and everything after it
+// returns nullptr.
+class CacheDecoder {
+private:
+    const ASTCacheReader& reader;
+    ASTContext& context;
+    const char* cursor;
+    const char* end;
+
+public:
+    bool failed = false;
+
+    CacheDecoder(const ASTCacheReader& reader, ASTContext& context, const char* begin, const char* end)
+        : reader(reader), context(context), cursor(begin), end(end) {}
+
+    template <typename T>
+    T get() {
+        if (failed || static_cast<size_t>(end - cursor) < sizeof(T)) {
+            failed = true;
+            return T();
+        }
+        T value = load<T>(cursor);
+        cursor += sizeof(T);
+        return value;
+    }
+
+    Token token() {
+        Token token(TokenType::ERROR, 0, 0);
+        if (!reader.decodeToken(get<uint32_t>(), token)) {
+            failed = true;
+        }
+        return token;
+    }
+
+    // A token that has to be an operator of a `kind` node, or a name
+    Token op(ExprKind kind) {
+        Token token = this->token();
+        if (!isOperator(kind, token.type)) failed = true;
+        return token;
+    }
+
+    Token name() {
+        Token token = this->token();
+        if (token.type != TokenType::IDENTIFIER) failed = true;
+        return token;
+    }
+
+    ValueType valueType() {
+        uint8_t type = get<uint8_t>();
+        if (type > static_cast<uint8_t>(ValueType::String)) {
+            failed = true;
+            return ValueType::Unknown;
+        }
+        return static_cast<ValueType>(type);
+    }
+
+    // A list length, checked against what is left so a bad count cannot
+    // ask for a huge allocation
+    uint32_t count() {
+        uint32_t value = get<uint32_t>();
+        if (value > static_cast<size_t>(end - cursor)) {
+            failed = true;
+            return 0;
+        }
+        return value;
+    }
+
+    // A chain as CacheWriter writes it, its first tag already read. The
+    // operators come first, so one whose left operand is another of the
+    // same kind is read in a loop rather than by recursing.
+    template <typename Node>
+    Expr* chain() {
+        std::vector<Token> operators{op(Node::Kind)};
+        while (!failed && cursor < end && static_cast<uint8_t>(*cursor) == static_cast<uint8_t>(Node::Kind)) {
+            cursor++;
+            operators.push_back(op(Node::Kind));
+        }
+        Expr* left = expr();
+        for (auto op = operators.rbegin(); op != operators.rend() && !failed; ++op) {
+            Expr* right = expr();
+            if (failed) break;
+            left = context.create<Node>(left, *op, right);
+        }
+        return failed ? nullptr : left;
+    }
+
+    Expr* expr(bool nullable = false) {
+        uint8_t tag = get<uint8_t>();
+        if (failed) return nullptr;
+        if (tag == nullTag) {
+            if (!nullable) failed = true;
+            return nullptr;
+        }
+
+        switch (static_cast<ExprKind>(tag)) {
+            case ExprKind::Binary:
+                return chain<BinaryExpr>();
+            case ExprKind::Logical:
+                return chain<LogicalExpr>();
+            case ExprKind::Grouping: {
+                Expr* inner = expr();
+                return failed ? nullptr : context.create<GroupingExpr>(inner);
+            }
+            case ExprKind::Literal: {
+                TokenType type = static_cast<TokenType>(get<uint8_t>());
+                uint32_t offset = get<uint32_t>();
+                uint32_t length = get<uint32_t>();
+                int64_t value = get<int64_t>();
+                if (!isLiteral(type)) failed = true;
+
+                std::string_view text;
+                if (type == TokenType::KW_TRUE) {
+                    text = "true";
+                } else if (type == TokenType::KW_FALSE) {
+                    text = "false";
+                } else if (offset <= reader.source.size() && length <= reader.source.size() - offset) {
+                    text = reader.source.substr(offset, length);
+                } else {
+                    failed = true;
+                }
+                if (failed) return nullptr;
+
+                LiteralExpr* literal = context.create<LiteralExpr>(text, type);
+                literal->intValue = value;
+                return literal;
+            }
+            case ExprKind::Unary: {
+                Token op = this->op(ExprKind::Unary);
+                Expr* right = expr();
+                return failed ? nullptr : context.create<UnaryExpr>(op, right);
+            }
+            case ExprKind::Variable: {
+                Token name = this->name();
+                return failed ? nullptr : context.create<VariableExpr>(name);
+            }
+            case ExprKind::Assign: {
+                Token name = this->name();
+                Expr* value = expr();
+                return failed ? nullptr : context.create<AssignExpr>(name, value);
+            }
+            case ExprKind::Call: {
+                Expr* callee = expr();
+                Token paren = token();
+                uint32_t size = count();
+                std::vector<Expr*> arguments;
+                arguments.reserve(size);
+                for (uint32_t i = 0; i < size && !failed; i++) {
+                    arguments.push_back(expr());
+                }
+                return failed ? nullptr : context.create<CallExpr>(callee, paren, context.copy(arguments));
+            }
+        }
+
+        failed = true;
+        return nullptr;
+    }
+
+    Stmt* stmt(bool nullable = false) {
+        uint8_t tag = get<uint8_t>();
+        if (failed) return nullptr;
+        if (tag == nullTag) {
+            if (!nullable) failed = true;
+            return nullptr;
+        }
+
+        switch (static_cast<StmtKind>(tag)) {
+            case StmtKind::Expression: {
+                Expr* expression = expr();
+                return failed ? nullptr : context.create<ExpressionStmt>(expression);
+            }
+            case StmtKind::Var: {
+                Token name = this->name();
+                ValueType declaredType = valueType();
+                Expr* initializer = expr(true);
+                return failed ? nullptr : context.create<VarStmt>(name, initializer, declaredType);
+            }
+            case StmtKind::Block: {
+                Span<Stmt*> statements = list();
+                return failed ? nullptr : context.create<BlockStmt>(statements);
+            }
+            case StmtKind::If: {
+                Expr* condition = expr();
+                Stmt* thenBranch = stmt();
+                Stmt* elseBranch = stmt(true);
+                return failed ? nullptr : context.create<IfStmt>(condition, thenBranch, elseBranch);
+            }
+            case StmtKind::While: {
+                Expr* condition = expr();
+                Stmt* body = stmt();
+                return failed ? nullptr : context.create<WhileStmt>(condition, body);
+            }
+            case StmtKind::Function: {
+                Token name = this->name();
+                ValueType returnType = valueType();
+                uint32_t size = count();
+                std::vector<Token> params;
+                std::vector<ValueType> paramTypes;
+                params.reserve(size);
+                paramTypes.reserve(size);
+                for (uint32_t i = 0; i < size && !failed; i++) {
+                    params.push_back(this->name());
+                    paramTypes.push_back(valueType());
+                }
+                Span<Stmt*> body = list();
+                if (failed) return nullptr;
+                return context.create<FunctionStmt>(name, context.copy(params), context.copy(paramTypes), returnType,
+                                                    context.array(params.size(), ValueType::Unknown), body);
+            }
+            case StmtKind::Return: {
+                Token keyword = token();
+                Expr* value = expr(true);
+                return failed ? nullptr : context.create<ReturnStmt>(keyword, value);
+            }
+        }
+
+        failed = true;
+        return nullptr;
+    }
+
+    Span<Stmt*> list() {
+        uint32_t size = count();
+        std::vector<Stmt*> statements;
+        statements.reserve(size);
+        for (uint32_t i = 0; i < size && !failed; i++) {
+            statements.push_back(stmt());
+        }
+        return failed ? Span<Stmt*>() : context.copy(statements);
+    }
+};
+
+uint64_t hashSource(std::string_view source) {
+    // Eight bytes per step, mixed with the xxHash64 round and finished with
+    // the MurmurHash3 avalanche
+    constexpr uint64_t prime1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+
+    const char* p = source.data();
+    size_t size = source.size();
+    uint64_t hash = prime1 ^ (size * prime2);
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        hash = rotateLeft(hash + load<uint64_t>(p + i) * prime2, 31) * prime1;
+    }
+
+    if (i < size) {
+        uint64_t tail = 0;
+        std::memcpy(&tail, p + i, size - i);
+        hash = rotateLeft(hash + tail * prime2, 31) * prime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+std::string astCachePath(const std::string& scriptPath) {
+    return scriptPath + ".astcache";
+}
+
+bool writeASTCache(const std::string& path, std::string_view source,
+                   const std::vector<Token>& tokens, const std::vector<Stmt*>& statements) {
+    CacheWriter writer(tokens, source);
+    std::vector<uint64_t> statementOffsets;
+    statementOffsets.reserve(statements.size());
+    for (Stmt* statement : statements) {
+        statementOffsets.push_back(writer.out.size());
+        writer.visit(statement);
+    }
+    if (writer.failed) {
+        return false;
+    }
+
+    // Identifiers are numbered by first occurrence
+    std::unordered_map<Symbol, uint32_t> localSymbols;
+    std::string symbolSection;
+    std::string tokenSection;
+    std::string valueSection;
+    tokenSection.reserve(tokens.size() * tokenRecordSize);
+
+    auto append = [](std::string& section, auto value) {
+        section.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    };
+
+    for (const Token& token : tokens) {
+        if (token.length > maxTokenLength) {
+            return false;
+        }
+
+        uint32_t extra = static_cast<uint32_t>(token.language);
+        if (token.type == TokenType::IDENTIFIER) {
+            auto inserted = localSymbols.emplace(token.symbol, static_cast<uint32_t>(localSymbols.size()));
+            if (inserted.second) {
+                append(symbolSection, token.offset);
+                append(symbolSection, token.length);
+            }
+            extra = inserted.first->second;
+        } else if (hasValue(token.type)) {
+            extra = static_cast<uint32_t>(valueSection.size() / valueRecordSize);
+            append(valueSection, token.intValue);
+        }
+
+        append(tokenSection, token.offset);
+        append(tokenSection, token.length | static_cast<uint32_t>(token.type) << 24);
+        append(tokenSection, extra);
+    }
+
+    CacheHeader header{};
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = astCacheVersion;
+    header.byteOrder = byteOrderMark;
+    header.sourceHash = hashSource(source);
+    header.sourceSize = source.size();
+    header.symbolCount = static_cast<uint32_t>(localSymbols.size());
+    header.tokenCount = static_cast<uint32_t>(tokens.size());
+    header.statementCount = static_cast<uint32_t>(statements.size());
+    header.valueCount = static_cast<uint32_t>(valueSection.size() / valueRecordSize);
+    header.nodesSize = writer.out.size();
+
+    std::string sections;
+    sections.reserve(symbolSection.size() + tokenSection.size() + valueSection.size() +
+                     statementOffsets.size() * statementRecordSize + writer.out.size());
+    sections += symbolSection;
+    sections += tokenSection;
+    sections += valueSection;
+    sections.append(reinterpret_cast<const char*>(statementOffsets.data()),
+                    statementOffsets.size() * statementRecordSize);
+    sections += writer.out;
+    header.sectionsHash = hashSource(sections);
+
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(sections.data(), static_cast<std::streamsize>(sections.size()));
+        if (!file) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<ASTCacheReader> ASTCacheReader::open(const std::string& path, std::string_view source) {
+    std::unique_ptr<SourceBuffer> file = SourceBuffer::fromFile(path);
+    if (!file || file->getText().size() < sizeof(CacheHeader)) {
+        return nullptr;
+    }
+
+    std::string_view bytes = file->getText();
+    CacheHeader header = load<CacheHeader>(bytes.data());
+    if (std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 ||
+        header.version != astCacheVersion || header.byteOrder != byteOrderMark ||
+        header.sourceSize != source.size() || header.sourceHash != hashSource(source)) {
+        return nullptr;
+    }
+
+    // The sections must exactly fill the file
+    uint64_t expected = sizeof(CacheHeader) +
+                        uint64_t{header.symbolCount} * symbolRecordSize +
+                        uint64_t{header.tokenCount} * tokenRecordSize +
+                        uint64_t{header.valueCount} * valueRecordSize +
+                        uint64_t{header.statementCount} * statementRecordSize +
+                        header.nodesSize;
+    if (expected != bytes.size() || hashSource(bytes.substr(sizeof(CacheHeader))) != header.sectionsHash) {
+        return nullptr;
+    }
+
+    std::unique_ptr<ASTCacheReader> reader(new ASTCacheReader());
+    const char* p = bytes.data() + sizeof(CacheHeader);
+    reader->source = source;
+    reader->symbolCount = header.symbolCount;
+    reader->tokenCount = header.tokenCount;
+    reader->statementCount = header.statementCount;
+    reader->valueCount = header.valueCount;
+    reader->symbolTable = p;
+    reader->tokenTable = reader->symbolTable + size_t{header.symbolCount} * symbolRecordSize;
+    reader->valueTable = reader->tokenTable + size_t{header.tokenCount} * tokenRecordSize;
+    reader->statementTable = reader->valueTable + size_t{header.valueCount} * valueRecordSize;
+    reader->nodes = reader->statementTable + size_t{header.statementCount} * statementRecordSize;
+    reader->end = bytes.data() + bytes.size();
+    reader->symbols.assign(header.symbolCount, noSymbol);
+    reader->file = std::move(file);
+    return reader;
+}
+
+bool ASTCacheReader::decodeToken(uint32_t index, Token& token) const {
+    if (index >= tokenCount) {
+        return false;
+    }
+
+    const char* record = tokenTable + size_t{index} * tokenRecordSize;
+    uint32_t offset = load<uint32_t>(record);
+    uint32_t lengthAndType = load<uint32_t>(record + 4);
+    uint32_t extra = load<uint32_t>(record + 8);
+    uint32_t length = lengthAndType & maxTokenLength;
+    uint32_t type = lengthAndType >> 24;
+    if (offset > source.size() || length > source.size() - offset ||
+        type > static_cast<uint32_t>(lastTokenType)) {
+        return false;
+    }
+
+    token = Token(static_cast<TokenType>(type), offset, length);
+
+    if (hasValue(token.type)) {
+        if (extra >= valueCount) {
+            return false;
+        }
+        token.intValue = load<int64_t>(valueTable + size_t{extra} * valueRecordSize);
+        return true;
+    }
+    if (token.type != TokenType::IDENTIFIER) {
+        if (extra > static_cast<uint32_t>(lastLanguage)) {
+            return false;
+        }
+        token.language = static_cast<Language>(extra);
+        return true;
+    }
+
+    if (extra >= symbolCount) {
+        return false;
+    }
+    Symbol& symbol = symbols[extra];
+    if (symbol == noSymbol) {
+        const char* name = symbolTable + size_t{extra} * symbolRecordSize;
+        uint32_t nameOffset = load<uint32_t>(name);
+        uint32_t nameLength = load<uint32_t>(name + 4);
+        if (nameOffset > source.size() || nameLength > source.size() - nameOffset) {
+            return false;
+        }
+        symbol = Interner::global().intern(source.substr(nameOffset, nameLength));
+    }
+    token.symbol = symbol;
+    return true;
+}
+
+Stmt* ASTCacheReader::decodeStatement(size_t index, ASTContext& context) const {
+    if (index >= statementCount) {
+        return nullptr;
+    }
+
+    uint64_t offset = load<uint64_t>(statementTable + index * statementRecordSize);
+    if (offset >= static_cast<uint64_t>(end - nodes)) {
+        return nullptr;
+    }
+
+    CacheDecoder decoder(*this, context, nodes + offset, end);
+    Stmt* statement = decoder.stmt();
+    return decoder.failed ? nullptr : statement;
+}
+
+bool ASTCacheReader::decodeStatements(ASTContext& context, std::vector<Stmt*>& statements) const {
+    statements.clear();
+    statements.reserve(statementCount);
+    for (size_t i = 0; i < statementCount; i++) {
+        Stmt* statement = decodeStatement(i, context);
+        if (!statement) {
+            return false;
+        }
+        statements.push_back(statement);
+    }
+    return true;
+}
+
+bool ASTCacheReader::decodeTokens(std::vector<Token>& tokens) const {
+    tokens.clear();
+    tokens.reserve(tokenCount);
+    for (uint32_t i = 0; i < tokenCount; i++) {
+        Token token(TokenType::ERROR, 0, 0);
+        if (!decodeToken(i, token)) {
+            return false;
+        }
+        tokens.push_back(token);
+    }
+    return true;
+}
+
+} // namespace tribhasha
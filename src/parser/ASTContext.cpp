@@ -0,0 +1,50 @@
+#include "tribhasha/ASTContext.h"
+#include <algorithm>
+#include <iterator>
+
+namespace tribhasha {
+
+void* ASTContext::allocateSlow(size_t size, size_t alignment) {
+    // Slabs double up to a limit so small scripts stay small; anything that
+    // would not fit in a fresh slab gets one of its own
+    size_t slabSize = std::max(nextSlabSize, size + alignment);
+    nextSlabSize = std::min(nextSlabSize * 2, maxSlabSize);
+
+    if (slabs.empty()) frontSlabSize = slabSize;
+    slabs.emplace_back(new char[slabSize]);
+    cursor = slabs.back().get();
+    limit = cursor + slabSize;
+
+    return allocate(size, alignment);
+}
+
+void ASTContext::reset() {
+    if (slabs.empty()) return;
+
+    slabs.resize(1);
+    cursor = slabs.front().get();
+    limit = cursor + frontSlabSize;
+    nextSlabSize = firstSlabSize * 2;
+    bytesAllocated = 0;
+}
+
+void ASTContext::absorb(ASTContext& other) {
+    if (other.slabs.empty()) return;
+
+    // The absorbed slabs are only kept alive, never allocated from again
+    if (slabs.empty()) {
+        frontSlabSize = other.frontSlabSize;
+    }
+    slabs.insert(slabs.end(), std::make_move_iterator(other.slabs.begin()),
+                 std::make_move_iterator(other.slabs.end()));
+    bytesAllocated += other.bytesAllocated;
+
+    other.slabs.clear();
+    other.cursor = nullptr;
+    other.limit = nullptr;
+    other.nextSlabSize = firstSlabSize;
+    other.frontSlabSize = 0;
+    other.bytesAllocated = 0;
+}
+
+} // namespace tribhasha
@@ -0,0 +1,57 @@
+#include "tribhasha/DeclarationStream.h"
+
+namespace tribhasha {
+
+DeclarationStream::DeclarationStream(Lexer& lexer, std::string_view source)
+    : DeclarationStream([&lexer] { return lexer.nextToken(); }, source) {}
+
+DeclarationStream::DeclarationStream(std::function<Token()> nextToken, std::string_view source)
+    : nextToken(std::move(nextToken)), source(source) {
+    window.push_back(this->nextToken());
+}
+
+bool DeclarationStream::next(ASTContext& context, std::vector<Stmt*>& statements) {
+    // The token left over from the last declaration starts this one
+    Token first = window.back();
+    window.clear();
+    window.push_back(first);
+    if (first.type == TokenType::END_OF_FILE) {
+        return false;
+    }
+
+    // Collect up to and including the token after the declaration
+    int depth = 0;
+    while (window.back().type != TokenType::END_OF_FILE) {
+        TokenType type = window.back().type;
+        switch (type) {
+            case TokenType::LEFT_PAREN:
+            case TokenType::LEFT_BRACE:
+                depth++;
+                break;
+            case TokenType::RIGHT_PAREN:
+            case TokenType::RIGHT_BRACE:
+                // Unbalanced input just never reaches depth 0 again
+                if (depth > 0) depth--;
+                break;
+            default:
+                break;
+        }
+
+        window.push_back(nextToken());
+        if (depth == 0 && (type == TokenType::SEMICOLON || type == TokenType::RIGHT_BRACE) &&
+            window.back().type != TokenType::KW_ELSE) {
+            break;
+        }
+    }
+
+    Parser parser(window, source, context);
+    std::vector<Stmt*> parsed = parser.parse();
+    statements.insert(statements.end(), parsed.begin(), parsed.end());
+
+    for (const Diagnostic& diagnostic : parser.getDiagnostics().all()) {
+        diagnostics.error(diagnostic.offset, diagnostic.length, diagnostic.message);
+    }
+    return true;
+}
+
+} // namespace tribhasha
@@ -0,0 +1,46 @@
+#include "tribhasha/Diagnostics.h"
+#include <iterator>
+
+namespace tribhasha {
+
+void Diagnostics::append(Diagnostics&& other) {
+    if (entries.empty()) {
+        entries = std::move(other.entries);
+    } else {
+        entries.insert(entries.end(), std::make_move_iterator(other.entries.begin()),
+                       std::make_move_iterator(other.entries.end()));
+    }
+    other.entries.clear();
+}
+
+std::string Diagnostics::format(const SourceFile& file) const {
+    std::string_view text = file.getText();
+    std::string out;
+    
+    for (const Diagnostic& diagnostic : entries) {
+        LineColumn position = file.getLineColumn(diagnostic.offset);
+        out += "[line " + std::to_string(position.line) + ", column " + std::to_string(position.column) + "] Error";
+        
+        if (diagnostic.offset >= text.size()) {
+            out += " at end";
+        } else if (diagnostic.length > 0) {
+            out += " at '";
+            out += text.substr(diagnostic.offset, diagnostic.length);
+            out += "'";
+        }
+        
+        out += ": ";
+        out += diagnostic.message;
+        out += '\n';
+    }
+    
+    return out;
+}
+
+void Diagnostics::print(std::ostream& out, const SourceFile& file) const {
+    if (entries.empty()) return;
+    out << format(file);
+    out.flush();
+}
+
+} // namespace tribhasha
@@ -0,0 +1,245 @@
+#include "tribhasha/IncrementalParser.h"
+#include "tribhasha/ASTCache.h"
+#include <algorithm>
+#include <cstring>
+
+namespace tribhasha {
+
+namespace {
+
+// Cuts a declaration just parsed loose from the source: token offsets
+// become relative to `begin`, its first byte, and literal text is copied
+// into the arena. It can then move, and outlive the source, as it is.
+class Detacher : public ASTVisitor<Detacher> {
+private:
+    uint32_t begin;
+    ASTContext& context;
+
+public:
+    Detacher(uint32_t begin, ASTContext& context) : begin(begin), context(context) {}
+
+    void token(Token& token) {
+        token.offset -= begin;
+    }
+
+    void visitBinaryExpr(BinaryExpr* expr) {
+        std::vector<BinaryExpr*> chain = leftChain(expr);
+        visit(chain.front()->left);
+        for (BinaryExpr* link : chain) {
+            token(link->op);
+            visit(link->right);
+        }
+    }
+
+    void visitLogicalExpr(LogicalExpr* expr) {
+        std::vector<LogicalExpr*> chain = leftChain(expr);
+        visit(chain.front()->left);
+        for (LogicalExpr* link : chain) {
+            token(link->op);
+            visit(link->right);
+        }
+    }
+
+    void visitGroupingExpr(GroupingExpr* expr) {
+        visit(expr->expression);
+    }
+
+    void visitLiteralExpr(LiteralExpr* expr) {
+        // true and false are spelled by the parser
+        if (expr->type == TokenType::KW_TRUE || expr->type == TokenType::KW_FALSE || expr->value.empty()) return;
+
+        char* text = static_cast<char*>(context.allocate(expr->value.size(), 1));
+        std::memcpy(text, expr->value.data(), expr->value.size());
+        expr->value = std::string_view(text, expr->value.size());
+    }
+
+    void visitUnaryExpr(UnaryExpr* expr) {
+        token(expr->op);
+        visit(expr->right);
+    }
+
+    void visitVariableExpr(VariableExpr* expr) {
+        token(expr->name);
+    }
+
+    void visitAssignExpr(AssignExpr* expr) {
+        token(expr->name);
+        visit(expr->value);
+    }
+
+    void visitCallExpr(CallExpr* expr) {
+        visit(expr->callee);
+        token(expr->paren);
+        for (Expr* argument : expr->arguments) visit(argument);
+    }
+
+    void visitExpressionStmt(ExpressionStmt* stmt) {
+        visit(stmt->expression);
+    }
+
+    void visitVarStmt(VarStmt* stmt) {
+        token(stmt->name);
+        if (stmt->initializer) visit(stmt->initializer);
+    }
+
+    void visitBlockStmt(BlockStmt* stmt) {
+        for (Stmt* statement : stmt->statements) visit(statement);
+    }
+
+    void visitIfStmt(IfStmt* stmt) {
+        visit(stmt->condition);
+        visit(stmt->thenBranch);
+        if (stmt->elseBranch) visit(stmt->elseBranch);
+    }
+
+    void visitWhileStmt(WhileStmt* stmt) {
+        visit(stmt->condition);
+        visit(stmt->body);
+    }
+
+    void visitFunctionStmt(FunctionStmt* stmt) {
+        token(stmt->name);
+        // Spans are read-only views, but the parameters live in the
+        // (mutable) arena
+        for (const Token& param : stmt->params) token(const_cast<Token&>(param));
+        for (Stmt* statement : stmt->body) visit(statement);
+    }
+
+    void visitReturnStmt(ReturnStmt* stmt) {
+        token(stmt->keyword);
+        if (stmt->value) visit(stmt->value);
+    }
+};
+
+// Below this the arena is never worth compacting
+constexpr size_t minCompactBytes = 256 * 1024;
+
+} // namespace
+
+IncrementalParser::IncrementalParser()
+    : context(std::make_unique<ASTContext>()) {}
+
+const IncrementalParser::Declaration* IncrementalParser::findReusable(
+        const std::vector<Token>& tokens, std::string_view source, int first, size_t next,
+        const std::vector<bool>& reused) const {
+    uint32_t begin = tokens[first].offset;
+    int64_t sizeChange = static_cast<int64_t>(source.size()) - static_cast<int64_t>(sourceSize);
+    int limit = static_cast<int>(tokens.size()) - 1;
+
+    auto at = [&](int64_t oldBegin) -> const Declaration* {
+        auto it = std::lower_bound(declarations.begin(), declarations.end(), oldBegin,
+            [](const Declaration& d, int64_t offset) { return d.begin < offset; });
+        return it != declarations.end() && it->begin == oldBegin ? &*it : nullptr;
+    };
+
+    const Declaration* candidates[] = {
+        at(begin),
+        at(begin - sizeChange),
+        next < declarations.size() ? &declarations[next] : nullptr,
+    };
+
+    for (const Declaration* d : candidates) {
+        if (!d || !d->clean || reused[static_cast<size_t>(d - declarations.data())]) continue;
+
+        // The same tokens, and not followed by an 'else' that the old parse
+        // would have taken into an 'if'
+        int end = first + static_cast<int>(d->tokenCount);
+        if (end > limit || tokens[end - 1].end() - begin != d->length ||
+            tokens[end].type == TokenType::KW_ELSE) {
+            continue;
+        }
+        if (hashSource(source.substr(begin, d->length)) == d->hash) {
+            return d;
+        }
+    }
+    return nullptr;
+}
+
+ParseUpdate IncrementalParser::update(std::string_view source, const std::vector<Token>& tokens) {
+    // Once most of the arena is dead, build the tree in a fresh one. Old
+    // declarations are still matched so the update reports the same changes.
+    size_t liveBytes = context->getBytesAllocated() - garbageBytes;
+    bool compact = garbageBytes > minCompactBytes && garbageBytes > liveBytes;
+    std::unique_ptr<ASTContext> fresh = compact ? std::make_unique<ASTContext>() : nullptr;
+    ASTContext& arena = compact ? *fresh : *context;
+
+    Parser parser(tokens, source, arena);
+    std::vector<Declaration> parsed;
+    std::vector<Stmt*> result;
+    std::vector<bool> reused(declarations.size(), false);
+    ParseUpdate update;
+    size_t next = 0;
+
+    while (!parser.isAtEnd()) {
+        int first = parser.current;
+        uint32_t begin = tokens[first].offset;
+        const Declaration* match = findReusable(tokens, source, first, next, reused);
+
+        if (match) {
+            size_t index = static_cast<size_t>(match - declarations.data());
+            reused[index] = true;
+            next = index + 1;
+        }
+
+        if (match && !compact) {
+            if (match->statement) {
+                match->statement->base = begin;
+            }
+            Declaration declaration = *match;
+            declaration.begin = begin;
+            parsed.push_back(declaration);
+            result.push_back(match->statement);
+            parser.current = first + static_cast<int>(match->tokenCount);
+            continue;
+        }
+
+        size_t diagnosticsBefore = parser.diagnostics.size();
+        size_t bytesBefore = arena.getBytesAllocated();
+        size_t count = result.size();
+        parser.topLevelDeclaration(result);
+
+        Declaration declaration;
+        declaration.begin = begin;
+        declaration.length = tokens[parser.current - 1].end() - begin;
+        declaration.tokenCount = static_cast<uint32_t>(parser.current - first);
+        declaration.hash = hashSource(source.substr(begin, declaration.length));
+        declaration.statement = result.size() > count ? result.back() : nullptr;
+        if (declaration.statement) {
+            Detacher(begin, arena).visit(declaration.statement);
+            declaration.statement->base = begin;
+        }
+        declaration.bytes = arena.getBytesAllocated() - bytesBefore;
+        declaration.clean = parser.diagnostics.size() == diagnosticsBefore;
+        parsed.push_back(declaration);
+
+        if (!match && declaration.statement) {
+            update.changed.push_back(result.size() - 1);
+        }
+    }
+
+    // Whatever was not matched is gone
+    size_t index = 0;
+    for (size_t i = 0; i < declarations.size(); i++) {
+        if (reused[i]) {
+            index += declarations[i].statement ? 1 : 0;
+            continue;
+        }
+        garbageBytes += declarations[i].bytes;
+        if (declarations[i].statement) {
+            update.removed.push_back(index++);
+        }
+    }
+
+    if (compact) {
+        context = std::move(fresh);
+        garbageBytes = 0;
+    }
+
+    declarations = std::move(parsed);
+    statements = std::move(result);
+    diagnostics = std::move(parser.diagnostics);
+    sourceSize = source.size();
+    return update;
+}
+
+} // namespace tribhasha
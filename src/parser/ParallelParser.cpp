@@ -0,0 +1,134 @@
+#include "tribhasha/Parser.h"
+#include <algorithm>
+#include <memory>
+#include <thread>
+
+namespace tribhasha {
+
+namespace {
+
+// Find token indices where a top-level declaration can start, about
+// `tokens / chunkCount` apart. A boundary is a token at bracket depth 0
+// right after a ';' or a '}' that closed to depth 0, except an 'else'
+// (which continues the 'if' before it). In a well-formed script every
+// boundary starts a new declaration; a parse error near one is caught
+// while stitching.
+std::vector<int> findChunkBounds(const std::vector<Token>& tokens, size_t chunkCount) {
+    int end = static_cast<int>(tokens.size()) - 1;
+    std::vector<int> bounds{0};
+    
+    size_t next = 1;
+    int target = static_cast<int>(tokens.size() * next / chunkCount);
+    int depth = 0;
+    
+    for (int i = 0; i < end && next < chunkCount; i++) {
+        TokenType type = tokens[i].type;
+        
+        if (depth == 0 && i >= target && i > bounds.back()) {
+            TokenType last = tokens[i - 1].type;
+            if ((last == TokenType::SEMICOLON || last == TokenType::RIGHT_BRACE) &&
+                type != TokenType::KW_ELSE) {
+                bounds.push_back(i);
+                next++;
+                target = static_cast<int>(tokens.size() * next / chunkCount);
+            }
+        }
+        
+        switch (type) {
+            case TokenType::LEFT_PAREN:
+            case TokenType::LEFT_BRACE:
+                depth++;
+                break;
+            case TokenType::RIGHT_PAREN:
+            case TokenType::RIGHT_BRACE:
+                // Unbalanced input just never reaches depth 0 again
+                if (depth > 0) depth--;
+                break;
+            default:
+                break;
+        }
+    }
+    
+    bounds.push_back(end);
+    return bounds;
+}
+
+} // namespace
+
+std::vector<Stmt*> Parser::parseParallel(unsigned threadCount, size_t minChunkSize) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    
+    // Only a parser at the start of its token array can split it
+    size_t chunkCount = std::min<size_t>(threadCount, tokens.size() / std::max<size_t>(minChunkSize, 1));
+    if (chunkCount < 2 || current != 0) {
+        return parse();
+    }
+    
+    std::vector<int> bounds = findChunkBounds(tokens, chunkCount);
+    if (bounds.size() < 3) {
+        return parse();
+    }
+    
+    // Parse every chunk into its own arena, as if it were a whole script.
+    // The first chunk runs on this thread.
+    size_t count = bounds.size() - 1;
+    std::vector<std::unique_ptr<ASTContext>> arenas;
+    std::vector<Parser> chunks;
+    std::vector<std::vector<Stmt*>> results(count);
+    arenas.reserve(count);
+    chunks.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        arenas.push_back(std::make_unique<ASTContext>());
+        chunks.push_back(Parser(tokens, source, *arenas.back(), bounds[i], bounds[i + 1]));
+    }
+    
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < count; i++) {
+        workers.emplace_back([&chunks, &results, i] {
+            results[i] = chunks[i].parse();
+        });
+    }
+    results[0] = chunks[0].parse();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    
+    // Stitch the chunks together in order. A chunk is only used if it
+    // parsed cleanly and the declarations before it ended exactly where it
+    // starts. Anything else is parsed again on this parser, as parse() would
+    // have, until it reaches the start of a clean chunk between declarations.
+    std::vector<Stmt*> statements;
+    
+    for (size_t i = 0; i < count; i++) {
+        if (current > bounds[i]) continue;
+        
+        if (current == bounds[i] && !chunks[i].hadError()) {
+            statements.insert(statements.end(), results[i].begin(), results[i].end());
+            current = bounds[i + 1];
+            continue;
+        }
+        
+        size_t resume = i + 1;
+        while (!isAtEnd()) {
+            topLevelDeclaration(statements);
+            
+            while (resume < count && bounds[resume] < current) {
+                resume++;
+            }
+            if (resume < count && bounds[resume] == current && !chunks[resume].hadError()) {
+                break;
+            }
+        }
+    }
+    
+    // The chunks' nodes now belong to the caller's context
+    for (auto& arena : arenas) {
+        context.absorb(*arena);
+    }
+    
+    return statements;
+}
+
+} // namespace tribhasha
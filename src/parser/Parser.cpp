@@ -1,44 +1,58 @@
 #include "tribhasha/Parser.h"
-#include <iostream>
+#include <array>
 
 namespace tribhasha {
 
-Parser::Parser(std::vector<Token> tokens) : tokens(std::move(tokens)) {}
+Parser::Parser(const std::vector<Token>& tokens, std::string_view source, ASTContext& context)
+    : Parser(tokens, source, context, 0, static_cast<int>(tokens.size()) - 1) {}
 
-std::vector<std::shared_ptr<Stmt>> Parser::parse() {
-    std::vector<std::shared_ptr<Stmt>> statements;
+Parser::Parser(const std::vector<Token>& tokens, std::string_view source, ASTContext& context,
+               int begin, int end)
+    : tokens(tokens), source(source), context(context), current(begin), limit(end) {}
+
+std::vector<Stmt*> Parser::parse() {
+    std::vector<Stmt*> statements;
     
     while (!isAtEnd()) {
-        try {
-            statements.push_back(declaration());
-        } catch (const ParseError& error) {
-            synchronize();
-        }
+        topLevelDeclaration(statements);
     }
     
     return statements;
 }
 
+void Parser::topLevelDeclaration(std::vector<Stmt*>& statements) {
+    Stmt* statement = declaration();
+    
+    // A declaration that went wrong is dropped as a whole
+    if (panicMode) {
+        synchronize();
+        return;
+    }
+    statements.push_back(statement);
+}
+
 // Helper methods
 bool Parser::isAtEnd() const {
-    return peek().type == TokenType::END_OF_FILE;
+    return current >= limit;
 }
 
-Token Parser::peek() const {
+const Token& Parser::peek() const {
     return tokens[current];
 }
 
-Token Parser::previous() const {
+const Token& Parser::previous() const {
     return tokens[current - 1];
 }
 
-Token Parser::advance() {
+const Token& Parser::advance() {
     if (!isAtEnd()) current++;
     return previous();
 }
 
 bool Parser::check(TokenType type) const {
-    if (isAtEnd()) return false;
+    // In panic mode nothing matches, so the parser stays on the token the
+    // error was reported at while the declaration unwinds by returning
+    if (panicMode || isAtEnd()) return false;
     return peek().type == type;
 }
 
@@ -50,57 +64,44 @@ bool Parser::match(TokenType type) {
     return false;
 }
 
-bool Parser::matchAny(const std::vector<TokenType>& types) {
-    for (const auto& type : types) {
-        if (match(type)) return true;
-    }
-    return false;
+const Token& Parser::consume(TokenType type, const char* message) {
+    if (check(type)) return advance();
+    
+    // Leave the token alone; the caller carries on as if it had been there
+    error(peek(), message);
+    return peek();
 }
 
-Token Parser::consume(TokenType type, const std::string& message) {
-    if (check(type)) return advance();
-    throw error(peek(), message);
+void Parser::error(const Token& token, std::string message) {
+    report(token, std::move(message));
+    panicMode = true;
 }
 
-ParseError Parser::error(Token token, const std::string& message) {
-    std::cerr << "[line " << token.line << "] Error";
-    
-    if (token.type == TokenType::END_OF_FILE) {
-        std::cerr << " at end";
-    } else {
-        std::cerr << " at '" << token.lexeme << "'";
-    }
-    
-    std::cerr << ": " << message << std::endl;
-    
-    return ParseError(message);
+void Parser::report(const Token& token, std::string message) {
+    // Whatever goes wrong while recovering from an error is most likely
+    // caused by it
+    if (panicMode) return;
+    diagnostics.error(token.offset, token.length, std::move(message));
 }
 
 void Parser::synchronize() {
+    panicMode = false;
     advance();
     
     while (!isAtEnd()) {
         if (previous().type == TokenType::SEMICOLON) return;
         
         switch (peek().type) {
-            case TokenType::VAR_EN:
-            case TokenType::VAR_HI:
-            case TokenType::VAR_AS:
-            case TokenType::FUNCTION_EN:
-            case TokenType::FUNCTION_HI:
-            case TokenType::FUNCTION_AS:
-            case TokenType::IF_EN:
-            case TokenType::IF_HI:
-            case TokenType::IF_AS:
-            case TokenType::WHILE_EN:
-            case TokenType::WHILE_HI:
-            case TokenType::WHILE_AS:
-            case TokenType::FOR_EN:
-            case TokenType::FOR_HI:
-            case TokenType::FOR_AS:
-            case TokenType::RETURN_EN:
-            case TokenType::RETURN_HI:
-            case TokenType::RETURN_AS:
+            case TokenType::KW_VAR:
+            case TokenType::KW_INT:
+            case TokenType::KW_FLOAT:
+            case TokenType::KW_STRING:
+            case TokenType::KW_BOOL:
+            case TokenType::KW_FUNCTION:
+            case TokenType::KW_IF:
+            case TokenType::KW_WHILE:
+            case TokenType::KW_FOR:
+            case TokenType::KW_RETURN:
                 return;
             default:
                 break;
@@ -110,169 +111,240 @@ void Parser::synchronize() {
     }
 }
 
-// Grammar rules
-std::shared_ptr<Expr> Parser::expression() {
-    return assignment();
-}
-
-std::shared_ptr<Expr> Parser::assignment() {
-    auto expr = equality();
-    
-    if (match(TokenType::ASSIGN)) {
-        Token equals = previous();
-        auto value = assignment();
+// Expressions
+//
+// A Pratt parser over explicit stacks: operators wait on `operators` until
+// an operator that binds less tightly (or the end of the expression) shows
+// up, and are then reduced onto `operands`. Groups and call argument lists
+// are markers on the same stack, so neither long operator chains nor deep
+// nesting recurse.
+
+namespace {
+
+// Binding power of each infix operator, indexed by token type; 0 means the
+// token does not continue an expression. Prefix operators bind tighter than
+// all of them.
+constexpr uint8_t assignmentPower = 1;
+constexpr uint8_t prefixPower = 8;
+
+constexpr std::array<uint8_t, 256> infixPowers = [] {
+    std::array<uint8_t, 256> powers{};
+    auto set = [&powers](TokenType type, uint8_t power) {
+        powers[static_cast<uint8_t>(type)] = power;
+    };
+    set(TokenType::ASSIGN, assignmentPower);
+    set(TokenType::KW_OR, 2);
+    set(TokenType::KW_AND, 3);
+    set(TokenType::EQUAL, 4);
+    set(TokenType::NOT_EQUAL, 4);
+    set(TokenType::LESS, 5);
+    set(TokenType::LESS_EQUAL, 5);
+    set(TokenType::GREATER, 5);
+    set(TokenType::GREATER_EQUAL, 5);
+    set(TokenType::PLUS, 6);
+    set(TokenType::MINUS, 6);
+    set(TokenType::STAR, 7);
+    set(TokenType::SLASH, 7);
+    set(TokenType::MODULO, 7);
+    return powers;
+}();
+
+constexpr uint8_t infixPower(TokenType type) {
+    return infixPowers[static_cast<uint8_t>(type)];
+}
+
+} // namespace
+
+Expr* Parser::expression() {
+    // Expressions never nest through this function, so whatever a failed
+    // expression left behind can simply be dropped
+    operands.clear();
+    operators.clear();
+    
+    bool expectOperand = true;
+    while (true) {
+        const Token& token = peek();
         
-        if (auto* varExpr = dynamic_cast<VariableExpr*>(expr.get())) {
-            Token name = varExpr->name;
-            return std::make_shared<AssignExpr>(name, value);
+        if (expectOperand) {
+            // Prefix operators and opening parentheses wait for their operand
+            if (token.type == TokenType::MINUS || token.type == TokenType::KW_NOT) {
+                operators.push_back({PendingOperator::PREFIX, prefixPower, static_cast<uint32_t>(current), 0});
+                advance();
+            } else if (token.type == TokenType::LEFT_PAREN) {
+                operators.push_back({PendingOperator::GROUP, 0, static_cast<uint32_t>(current), 0});
+                advance();
+            } else {
+                operands.push_back(primary());
+                if (panicMode) return operands.back();
+                expectOperand = false;
+            }
+            continue;
         }
         
-        error(equals, "Invalid assignment target.");
-    }
-    
-    return expr;
-}
-
-std::shared_ptr<Expr> Parser::equality() {
-    auto expr = comparison();
-    
-    while (matchAny({TokenType::EQUAL, TokenType::NOT_EQUAL})) {
-        Token op = previous();
-        auto right = comparison();
-        expr = std::make_shared<BinaryExpr>(expr, op, right);
-    }
-    
-    return expr;
-}
-
-std::shared_ptr<Expr> Parser::comparison() {
-    auto expr = term();
-    
-    while (matchAny({TokenType::LESS, TokenType::LESS_EQUAL, TokenType::GREATER, TokenType::GREATER_EQUAL})) {
-        Token op = previous();
-        auto right = term();
-        expr = std::make_shared<BinaryExpr>(expr, op, right);
+        // A call binds to the operand just parsed
+        if (token.type == TokenType::LEFT_PAREN) {
+            advance();
+            if (match(TokenType::RIGHT_PAREN)) {
+                operands.back() = context.create<CallExpr>(operands.back(), previous(), Span<Expr*>());
+            } else {
+                operators.push_back({PendingOperator::CALL, 0, static_cast<uint32_t>(current - 1),
+                                     static_cast<uint32_t>(operands.size())});
+                expectOperand = true;
+            }
+            continue;
+        }
+        
+        uint8_t power = infixPower(token.type);
+        if (power != 0) {
+            // Assignment is the only right-associative operator
+            reduce(power, power == assignmentPower);
+            operators.push_back({PendingOperator::INFIX, power, static_cast<uint32_t>(current), 0});
+            advance();
+            expectOperand = true;
+            continue;
+        }
+        
+        if (token.type == TokenType::COMMA && insideCall()) {
+            reduce(0, false);
+            advance();
+            expectOperand = true;
+            continue;
+        }
+        
+        // A ')' closes the innermost group or call, if there is one; otherwise
+        // it belongs to the statement around the expression
+        if (token.type == TokenType::RIGHT_PAREN && !operators.empty()) {
+            reduce(0, false);
+            if (!operators.empty()) {
+                PendingOperator open = operators.back();
+                operators.pop_back();
+                advance();
+                
+                if (open.kind == PendingOperator::GROUP) {
+                    operands.back() = context.create<GroupingExpr>(operands.back());
+                } else {
+                    std::vector<Expr*> arguments(operands.begin() + open.operandBase, operands.end());
+                    operands.resize(open.operandBase);
+                    operands.back() = context.create<CallExpr>(operands.back(), previous(), context.copy(arguments));
+                }
+                continue;
+            }
+        }
+        
+        // End of the expression
+        reduce(0, false);
+        if (!operators.empty()) {
+            error(token, operators.back().kind == PendingOperator::CALL
+                             ? "Expected ')' after arguments."
+                             : "Expected ')' after expression.");
+        }
+        return operands.back();
     }
-    
-    return expr;
 }
 
-std::shared_ptr<Expr> Parser::term() {
-    auto expr = factor();
-    
-    while (matchAny({TokenType::PLUS, TokenType::MINUS})) {
-        Token op = previous();
-        auto right = factor();
-        expr = std::make_shared<BinaryExpr>(expr, op, right);
+void Parser::reduce(uint8_t power, bool rightAssociative) {
+    // Reduce every waiting operator that binds at least as tightly (more
+    // tightly, for a right-associative one) as the incoming one. Groups and
+    // calls have power 0 and stop the reduction.
+    while (!operators.empty()) {
+        uint8_t top = operators.back().power;
+        if (top == 0 || top < power || (rightAssociative && top == power)) break;
+        reduceOperator();
     }
-    
-    return expr;
 }
 
-std::shared_ptr<Expr> Parser::factor() {
-    auto expr = unary();
+void Parser::reduceOperator() {
+    PendingOperator pending = operators.back();
+    operators.pop_back();
+    const Token& op = tokens[pending.token];
     
-    while (matchAny({TokenType::STAR, TokenType::SLASH, TokenType::MODULO})) {
-        Token op = previous();
-        auto right = unary();
-        expr = std::make_shared<BinaryExpr>(expr, op, right);
+    Expr* right = operands.back();
+    if (pending.kind == PendingOperator::PREFIX) {
+        operands.back() = context.create<UnaryExpr>(op, right);
+        return;
     }
     
-    return expr;
-}
-
-std::shared_ptr<Expr> Parser::unary() {
-    if (matchAny({TokenType::MINUS, TokenType::NOT_EN, TokenType::NOT_HI, TokenType::NOT_AS})) {
-        Token op = previous();
-        auto right = unary();
-        return std::make_shared<UnaryExpr>(op, right);
-    }
-    
-    return call();
-}
-
-std::shared_ptr<Expr> Parser::call() {
-    auto expr = primary();
+    operands.pop_back();
+    Expr* left = operands.back();
     
-    while (true) {
-        if (match(TokenType::LEFT_PAREN)) {
-            expr = finishCall(expr);
-        } else {
+    switch (op.type) {
+        case TokenType::ASSIGN:
+            if (auto* variable = left->as<VariableExpr>()) {
+                operands.back() = context.create<AssignExpr>(variable->name, right);
+            } else {
+                // Reported, but not worth abandoning the statement over
+                report(op, "Invalid assignment target.");
+            }
+            break;
+        case TokenType::KW_AND:
+        case TokenType::KW_OR:
+            operands.back() = context.create<LogicalExpr>(left, op, right);
+            break;
+        default:
+            operands.back() = context.create<BinaryExpr>(left, op, right);
             break;
-        }
     }
-    
-    return expr;
 }
 
-std::shared_ptr<Expr> Parser::finishCall(std::shared_ptr<Expr> callee) {
-    std::vector<std::shared_ptr<Expr>> arguments;
-    
-    if (!check(TokenType::RIGHT_PAREN)) {
-        do {
-            arguments.push_back(expression());
-        } while (match(TokenType::COMMA));
+bool Parser::insideCall() const {
+    for (auto it = operators.rbegin(); it != operators.rend(); ++it) {
+        if (it->kind == PendingOperator::CALL) return true;
+        if (it->kind == PendingOperator::GROUP) return false;
     }
-    
-    Token paren = consume(TokenType::RIGHT_PAREN, "Expected ')' after arguments.");
-    
-    return std::make_shared<CallExpr>(callee, paren, arguments);
+    return false;
 }
 
-std::shared_ptr<Expr> Parser::primary() {
+Expr* Parser::primary() {
     // True literal (in any language)
-    if (matchAny({TokenType::TRUE_EN, TokenType::TRUE_HI, TokenType::TRUE_AS})) {
-        return std::make_shared<LiteralExpr>("true", TokenType::TRUE_EN);
+    if (match(TokenType::KW_TRUE)) {
+        return context.create<LiteralExpr>("true", TokenType::KW_TRUE);
     }
     
     // False literal (in any language)
-    if (matchAny({TokenType::FALSE_EN, TokenType::FALSE_HI, TokenType::FALSE_AS})) {
-        return std::make_shared<LiteralExpr>("false", TokenType::FALSE_EN);
+    if (match(TokenType::KW_FALSE)) {
+        return context.create<LiteralExpr>("false", TokenType::KW_FALSE);
     }
     
     // Number literals
-    if (matchAny({TokenType::INT_LITERAL, TokenType::FLOAT_LITERAL})) {
-        return std::make_shared<LiteralExpr>(previous().lexeme, previous().type);
+    if (check(TokenType::INT_LITERAL) || check(TokenType::FLOAT_LITERAL)) {
+        const Token& literal = advance();
+        return context.create<LiteralExpr>(literal, literal.lexeme(source));
     }
     
-    // String literals
+    // String literals (the lexeme still has its quotes)
     if (match(TokenType::STRING_LITERAL)) {
-        return std::make_shared<LiteralExpr>(previous().lexeme, TokenType::STRING_LITERAL);
-    }
-    
-    // Grouping
-    if (match(TokenType::LEFT_PAREN)) {
-        auto expr = expression();
-        consume(TokenType::RIGHT_PAREN, "Expected ')' after expression.");
-        return std::make_shared<GroupingExpr>(expr);
+        std::string_view lexeme = previous().lexeme(source);
+        return context.create<LiteralExpr>(lexeme.substr(1, lexeme.size() - 2), TokenType::STRING_LITERAL);
     }
     
     // Variable
     if (match(TokenType::IDENTIFIER)) {
-        return std::make_shared<VariableExpr>(previous());
+        return context.create<VariableExpr>(previous());
     }
     
-    throw error(peek(), "Expected expression.");
+    // Stand in for the missing operand so the caller still gets a tree
+    error(peek(), "Expected expression.");
+    return context.create<LiteralExpr>(std::string_view(), TokenType::ERROR);
 }
 
-std::shared_ptr<Stmt> Parser::statement() {
+Stmt* Parser::statement() {
     // If statement (in any language)
-    if (matchAny({TokenType::IF_EN, TokenType::IF_HI, TokenType::IF_AS})) {
+    if (match(TokenType::KW_IF)) {
         return ifStatement();
     }
     
     // While statement (in any language)
-    if (matchAny({TokenType::WHILE_EN, TokenType::WHILE_HI, TokenType::WHILE_AS})) {
+    if (match(TokenType::KW_WHILE)) {
         return whileStatement();
     }
     
     // For statement (in any language)
-    if (matchAny({TokenType::FOR_EN, TokenType::FOR_HI, TokenType::FOR_AS})) {
+    if (match(TokenType::KW_FOR)) {
         return forStatement();
     }
     
     // Return statement (in any language)
-    if (matchAny({TokenType::RETURN_EN, TokenType::RETURN_HI, TokenType::RETURN_AS})) {
+    if (match(TokenType::KW_RETURN)) {
         return returnStatement();
     }
     
@@ -284,96 +356,116 @@ std::shared_ptr<Stmt> Parser::statement() {
     return expressionStatement();
 }
 
-std::shared_ptr<Stmt> Parser::declaration() {
-    // Variable declaration (in any language)
-    if (matchAny({TokenType::VAR_EN, TokenType::VAR_HI, TokenType::VAR_AS})) {
-        return varDeclaration();
+Stmt* Parser::declaration() {
+    // Variable declaration (in any language), with or without a type
+    if (match(TokenType::KW_VAR)) {
+        return varDeclaration(ValueType::Unknown);
+    }
+    ValueType type = typeAnnotation();
+    if (type != ValueType::Unknown) {
+        return varDeclaration(type);
     }
     
     // Function declaration (in any language)
-    if (matchAny({TokenType::FUNCTION_EN, TokenType::FUNCTION_HI, TokenType::FUNCTION_AS})) {
-        return functionDeclaration("function");
+    if (match(TokenType::KW_FUNCTION)) {
+        return functionDeclaration();
     }
     
     return statement();
 }
 
-std::shared_ptr<Stmt> Parser::varDeclaration() {
+Stmt* Parser::varDeclaration(ValueType declaredType) {
     Token name = consume(TokenType::IDENTIFIER, "Expected variable name.");
     
-    std::shared_ptr<Expr> initializer = nullptr;
+    Expr* initializer = nullptr;
     if (match(TokenType::ASSIGN)) {
         initializer = expression();
     }
     
     consume(TokenType::SEMICOLON, "Expected ';' after variable declaration.");
-    return std::make_shared<VarStmt>(name, initializer);
+    return context.create<VarStmt>(name, initializer, declaredType);
 }
 
-std::shared_ptr<Stmt> Parser::expressionStatement() {
+ValueType Parser::typeAnnotation() {
+    // A type name in any language, or Unknown (consuming nothing)
+    if (match(TokenType::KW_INT)) return ValueType::Int;
+    if (match(TokenType::KW_FLOAT)) return ValueType::Float;
+    if (match(TokenType::KW_STRING)) return ValueType::String;
+    if (match(TokenType::KW_BOOL)) return ValueType::Bool;
+    return ValueType::Unknown;
+}
+
+Stmt* Parser::expressionStatement() {
     auto expr = expression();
     consume(TokenType::SEMICOLON, "Expected ';' after expression.");
-    return std::make_shared<ExpressionStmt>(expr);
+    return context.create<ExpressionStmt>(expr);
+}
+
+Stmt* Parser::blockStatement() {
+    return context.create<BlockStmt>(blockBody());
 }
 
-std::shared_ptr<Stmt> Parser::blockStatement() {
-    std::vector<std::shared_ptr<Stmt>> statements;
+Span<Stmt*> Parser::blockBody() {
+    std::vector<Stmt*> statements;
     
-    while (!check(TokenType::RIGHT_BRACE) && !isAtEnd()) {
+    // Stop at the first error; parse() recovers from the top level
+    while (!check(TokenType::RIGHT_BRACE) && !isAtEnd() && !panicMode) {
         statements.push_back(declaration());
     }
     
     consume(TokenType::RIGHT_BRACE, "Expected '}' after block.");
-    return std::make_shared<BlockStmt>(statements);
+    return context.copy(statements);
 }
 
-std::shared_ptr<Stmt> Parser::ifStatement() {
+Stmt* Parser::ifStatement() {
     consume(TokenType::LEFT_PAREN, "Expected '(' after 'if'.");
     auto condition = expression();
     consume(TokenType::RIGHT_PAREN, "Expected ')' after if condition.");
     
     auto thenBranch = statement();
-    std::shared_ptr<Stmt> elseBranch = nullptr;
+    Stmt* elseBranch = nullptr;
     
-    if (matchAny({TokenType::ELSE_EN, TokenType::ELSE_HI, TokenType::ELSE_AS})) {
+    if (match(TokenType::KW_ELSE)) {
         elseBranch = statement();
     }
     
-    return std::make_shared<IfStmt>(condition, thenBranch, elseBranch);
+    return context.create<IfStmt>(condition, thenBranch, elseBranch);
 }
 
-std::shared_ptr<Stmt> Parser::whileStatement() {
+Stmt* Parser::whileStatement() {
     consume(TokenType::LEFT_PAREN, "Expected '(' after 'while'.");
     auto condition = expression();
     consume(TokenType::RIGHT_PAREN, "Expected ')' after while condition.");
     
     auto body = statement();
     
-    return std::make_shared<WhileStmt>(condition, body);
+    return context.create<WhileStmt>(condition, body);
 }
 
-std::shared_ptr<Stmt> Parser::forStatement() {
+Stmt* Parser::forStatement() {
     consume(TokenType::LEFT_PAREN, "Expected '(' after 'for'.");
     
     // Initializer
-    std::shared_ptr<Stmt> initializer;
+    Stmt* initializer;
     if (match(TokenType::SEMICOLON)) {
         initializer = nullptr;
-    } else if (matchAny({TokenType::VAR_EN, TokenType::VAR_HI, TokenType::VAR_AS})) {
-        initializer = varDeclaration();
+    } else if (match(TokenType::KW_VAR)) {
+        initializer = varDeclaration(ValueType::Unknown);
+    } else if (ValueType type = typeAnnotation(); type != ValueType::Unknown) {
+        initializer = varDeclaration(type);
     } else {
         initializer = expressionStatement();
     }
     
     // Condition
-    std::shared_ptr<Expr> condition = nullptr;
+    Expr* condition = nullptr;
     if (!check(TokenType::SEMICOLON)) {
         condition = expression();
     }
     consume(TokenType::SEMICOLON, "Expected ';' after loop condition.");
     
     // Increment
-    std::shared_ptr<Expr> increment = nullptr;
+    Expr* increment = nullptr;
     if (!check(TokenType::RIGHT_PAREN)) {
         increment = expression();
     }
@@ -384,118 +476,60 @@ std::shared_ptr<Stmt> Parser::forStatement() {
     
     // Desugar 'for' loop into a 'while' loop
     if (increment != nullptr) {
-        body = std::make_shared<BlockStmt>(std::vector<std::shared_ptr<Stmt>>{
+        body = context.create<BlockStmt>(context.copy(std::vector<Stmt*>{
             body,
-            std::make_shared<ExpressionStmt>(increment)
-        });
+            context.create<ExpressionStmt>(increment)
+        }));
     }
     
     if (condition == nullptr) {
-        condition = std::make_shared<LiteralExpr>("true", TokenType::TRUE_EN);
+        condition = context.create<LiteralExpr>("true", TokenType::KW_TRUE);
     }
-    body = std::make_shared<WhileStmt>(condition, body);
+    body = context.create<WhileStmt>(condition, body);
     
     if (initializer != nullptr) {
-        body = std::make_shared<BlockStmt>(std::vector<std::shared_ptr<Stmt>>{initializer, body});
+        body = context.create<BlockStmt>(context.copy(std::vector<Stmt*>{initializer, body}));
     }
     
     return body;
 }
 
-std::shared_ptr<Stmt> Parser::functionDeclaration(const std::string& kind) {
-    Token name = consume(TokenType::IDENTIFIER, "Expected " + kind + " name.");
+Stmt* Parser::functionDeclaration() {
+    // The result type, if any, comes before the name and each parameter's
+    // before the parameter
+    ValueType returnType = typeAnnotation();
+    Token name = consume(TokenType::IDENTIFIER, "Expected function name.");
     
-    consume(TokenType::LEFT_PAREN, "Expected '(' after " + kind + " name.");
+    consume(TokenType::LEFT_PAREN, "Expected '(' after function name.");
     std::vector<Token> parameters;
+    std::vector<ValueType> parameterTypes;
     
     if (!check(TokenType::RIGHT_PAREN)) {
         do {
+            parameterTypes.push_back(typeAnnotation());
             parameters.push_back(consume(TokenType::IDENTIFIER, "Expected parameter name."));
         } while (match(TokenType::COMMA));
     }
     
     consume(TokenType::RIGHT_PAREN, "Expected ')' after parameters.");
     
-    consume(TokenType::LEFT_BRACE, "Expected '{' before " + kind + " body.");
-    auto body = std::dynamic_pointer_cast<BlockStmt>(blockStatement())->statements;
+    consume(TokenType::LEFT_BRACE, "Expected '{' before function body.");
+    Span<Stmt*> body = blockBody();
     
-    return std::make_shared<FunctionStmt>(name, parameters, body);
+    return context.create<FunctionStmt>(name, context.copy(parameters), context.copy(parameterTypes), returnType,
+                                        context.array(parameters.size(), ValueType::Unknown), body);
 }
 
-std::shared_ptr<Stmt> Parser::returnStatement() {
+Stmt* Parser::returnStatement() {
     Token keyword = previous();
-    std::shared_ptr<Expr> value = nullptr;
+    Expr* value = nullptr;
     
     if (!check(TokenType::SEMICOLON)) {
         value = expression();
     }
     
     consume(TokenType::SEMICOLON, "Expected ';' after return value.");
-    return std::make_shared<ReturnStmt>(keyword, value);
-}
-
-// Language-specific helpers
-TokenType Parser::getVarTokenType() const {
-    if (check(TokenType::VAR_EN)) return TokenType::VAR_EN;
-    if (check(TokenType::VAR_HI)) return TokenType::VAR_HI;
-    if (check(TokenType::VAR_AS)) return TokenType::VAR_AS;
-    return TokenType::VAR_EN; // Default to English
-}
-
-TokenType Parser::getFunctionTokenType() const {
-    if (check(TokenType::FUNCTION_EN)) return TokenType::FUNCTION_EN;
-    if (check(TokenType::FUNCTION_HI)) return TokenType::FUNCTION_HI;
-    if (check(TokenType::FUNCTION_AS)) return TokenType::FUNCTION_AS;
-    return TokenType::FUNCTION_EN; // Default to English
-}
-
-TokenType Parser::getIfTokenType() const {
-    if (check(TokenType::IF_EN)) return TokenType::IF_EN;
-    if (check(TokenType::IF_HI)) return TokenType::IF_HI;
-    if (check(TokenType::IF_AS)) return TokenType::IF_AS;
-    return TokenType::IF_EN; // Default to English
-}
-
-TokenType Parser::getElseTokenType() const {
-    if (check(TokenType::ELSE_EN)) return TokenType::ELSE_EN;
-    if (check(TokenType::ELSE_HI)) return TokenType::ELSE_HI;
-    if (check(TokenType::ELSE_AS)) return TokenType::ELSE_AS;
-    return TokenType::ELSE_EN; // Default to English
-}
-
-TokenType Parser::getWhileTokenType() const {
-    if (check(TokenType::WHILE_EN)) return TokenType::WHILE_EN;
-    if (check(TokenType::WHILE_HI)) return TokenType::WHILE_HI;
-    if (check(TokenType::WHILE_AS)) return TokenType::WHILE_AS;
-    return TokenType::WHILE_EN; // Default to English
-}
-
-TokenType Parser::getForTokenType() const {
-    if (check(TokenType::FOR_EN)) return TokenType::FOR_EN;
-    if (check(TokenType::FOR_HI)) return TokenType::FOR_HI;
-    if (check(TokenType::FOR_AS)) return TokenType::FOR_AS;
-    return TokenType::FOR_EN; // Default to English
-}
-
-TokenType Parser::getReturnTokenType() const {
-    if (check(TokenType::RETURN_EN)) return TokenType::RETURN_EN;
-    if (check(TokenType::RETURN_HI)) return TokenType::RETURN_HI;
-    if (check(TokenType::RETURN_AS)) return TokenType::RETURN_AS;
-    return TokenType::RETURN_EN; // Default to English
-}
-
-TokenType Parser::getTrueTokenType() const {
-    if (check(TokenType::TRUE_EN)) return TokenType::TRUE_EN;
-    if (check(TokenType::TRUE_HI)) return TokenType::TRUE_HI;
-    if (check(TokenType::TRUE_AS)) return TokenType::TRUE_AS;
-    return TokenType::TRUE_EN; // Default to English
-}
-
-TokenType Parser::getFalseTokenType() const {
-    if (check(TokenType::FALSE_EN)) return TokenType::FALSE_EN;
-    if (check(TokenType::FALSE_HI)) return TokenType::FALSE_HI;
-    if (check(TokenType::FALSE_AS)) return TokenType::FALSE_AS;
-    return TokenType::FALSE_EN; // Default to English
+    return context.create<ReturnStmt>(keyword, value);
 }
 
 } // namespace tribhasha
\ No newline at end of file
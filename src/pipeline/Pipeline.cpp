@@ -0,0 +1,211 @@
+#include "tribhasha/Pipeline.h"
+#include "tribhasha/CodeGen.h"
+#include "tribhasha/ConstantFolder.h"
+#include "tribhasha/DeclarationStream.h"
+#include "tribhasha/Lexer.h"
+#include "tribhasha/PurityAnalysis.h"
+#include "tribhasha/Resolver.h"
+#include "tribhasha/SPSCQueue.h"
+#include "tribhasha/TypeInference.h"
+#include <memory>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+namespace tribhasha {
+
+namespace {
+
+// Tokens per batch handed from the lexer to the parser
+constexpr size_t tokenBatchSize = 4096;
+
+// Declarations are handed to codegen once their arena holds this much
+constexpr size_t declarationBatchBytes = 32 * 1024;
+
+// Items each queue holds before its producer waits
+constexpr size_t queueCapacity = 64;
+
+struct DeclarationBatch {
+    std::unique_ptr<ASTContext> context;
+    std::vector<Stmt*> statements;
+};
+
+struct CompiledUnit {
+    llvm::orc::ThreadSafeModule module;
+    std::string function;  // compiled as soon as it is added, if set
+    std::vector<std::pair<std::string, std::string>> aliases;  // of functions in other modules
+};
+
+} // namespace
+
+CompilePipeline::CompilePipeline(std::string_view source, TribhashaJIT& jit, bool memoize, bool parallel)
+    : source(source), jit(jit), memoize(memoize), parallel(parallel) {}
+
+bool CompilePipeline::run() {
+    SPSCQueue<std::vector<Token>> tokenBatches(queueCapacity);
+    SPSCQueue<DeclarationBatch> declarations(queueCapacity);
+    SPSCQueue<CompiledUnit> modules(queueCapacity);
+
+    // Parser: declarations from the token batches, resolved, typed,
+    // analyzed and folded as they are parsed. After an error nothing more
+    // is passed on, but parsing goes on to report the rest.
+    std::thread parserThread([&] {
+        Resolver resolver;
+        TypeInference inference(true);
+        PurityAnalysis purity;
+        ConstantFolder folder(true);
+        std::vector<Token> batch;
+        size_t position = 0;
+        DeclarationStream stream([&] {
+            while (position == batch.size()) {
+                if (!tokenBatches.pop(batch)) {
+                    return Token(TokenType::END_OF_FILE, static_cast<uint32_t>(source.size()), 0);
+                }
+                position = 0;
+            }
+            return batch[position++];
+        }, source);
+
+        DeclarationBatch current{std::make_unique<ASTContext>(), {}};
+        size_t done = 0;
+        while (stream.next(*current.context, current.statements)) {
+            // A declaration with a syntax error may be incomplete
+            std::vector<Stmt*> declaration(current.statements.begin() + done, current.statements.end());
+            if (!stream.hadError()) {
+                resolver.resolve(declaration);
+            }
+            if (!stream.hadError() && !resolver.hadError()) {
+                inference.infer(declaration);
+            }
+            if (stream.hadError() || resolver.hadError() || inference.hadError()) {
+                current.statements.clear();
+                current.context->reset();
+            } else {
+                purity.analyze(declaration);
+                folder.fold(declaration, *current.context);
+                current.statements.resize(done);
+                current.statements.insert(current.statements.end(), declaration.begin(), declaration.end());
+                if (current.context->getBytesAllocated() >= declarationBatchBytes) {
+                    declarations.push(std::move(current));
+                    current = DeclarationBatch{std::make_unique<ASTContext>(), {}};
+                }
+            }
+            done = current.statements.size();
+        }
+        if (!current.statements.empty()) {
+            declarations.push(std::move(current));
+        }
+        declarations.close();
+        diagnostics = stream.getDiagnostics();
+        Diagnostics resolverDiagnostics = resolver.getDiagnostics();
+        Diagnostics typeDiagnostics = inference.getDiagnostics();
+        diagnostics.append(std::move(resolverDiagnostics));
+        diagnostics.append(std::move(typeDiagnostics));
+    });
+
+    // Codegen: every top-level function gets a module (and context) of its
+    // own so the JIT can compile it while later ones are generated; the
+    // other statements build up main
+    std::thread codegenThread([&] {
+        FunctionTable functions;
+        std::unordered_set<std::string> separateFunctions;
+        CodeGen program(&functions);
+        program.setMemoize(memoize);
+        program.setParallel(parallel);
+        program.beginProgram();
+
+        DeclarationBatch batch;
+        while (declarations.pop(batch)) {
+            for (Stmt* statement : batch.statements) {
+                // A function defined again stays in main, where it
+                // replaces the first one as it always has. So does one
+                // whose name main's module already has (main itself, or
+                // printf): in a module of its own it would be linked in
+                // their place.
+                FunctionStmt* function = statement->as<FunctionStmt>();
+                std::string name(function ? Interner::global().name(function->name.symbol) : "");
+                if (!function || functions.find(function->name.symbol) || program.hasGlobal(name)) {
+                    program.generate(statement);
+                    continue;
+                }
+
+                CodeGen unit(&functions);
+                unit.setMemoize(memoize);
+                unit.setParallel(parallel);
+                unit.generate(statement);
+                separateFunctions.insert(name);
+                
+                // It can only be compiled now if everything it calls is
+                // already in the JIT, as printf and the runtime's functions
+                // are: functions defined inside main's code are not there
+                // until main is
+                CompiledUnit compiled{unit.takeThreadSafeModule(), name, unit.takeAliases()};
+                compiled.module.withModuleDo([&](llvm::Module& module) {
+                    for (llvm::Function& callee : module) {
+                        if (callee.isDeclaration() && callee.getName() != "printf" &&
+                            !callee.getName().startswith("tribhasha_") &&
+                            !separateFunctions.count(callee.getName().str())) {
+                            compiled.function.clear();
+                        }
+                    }
+                });
+                modules.push(std::move(compiled));
+            }
+            // The batch's AST is freed here, on reuse of `batch`
+        }
+
+        program.finishProgram();
+        modules.push({program.takeThreadSafeModule(), std::string(), program.takeAliases()});
+        modules.close();
+    });
+
+    // JIT: add each module as it comes and compile its function now,
+    // rather than all at once when main is looked up
+    std::thread jitThread([&] {
+        CompiledUnit unit;
+        while (modules.pop(unit)) {
+            if (!jitError.empty()) continue;
+
+            for (const auto& [alias, target] : unit.aliases) {
+                if (llvm::Error error = jit.addAlias(alias, target)) {
+                    jitError = llvm::toString(std::move(error));
+                }
+            }
+            if (!jitError.empty()) continue;
+            if (llvm::Error error = jit.addModule(std::move(unit.module))) {
+                jitError = llvm::toString(std::move(error));
+                continue;
+            }
+            if (!unit.function.empty()) {
+                auto symbol = jit.lookup(unit.function);
+                if (!symbol) {
+                    jitError = llvm::toString(symbol.takeError());
+                }
+            }
+        }
+    });
+
+    // Lexer, on this thread
+    Lexer lexer(source);
+    std::vector<Token> batch;
+    batch.reserve(tokenBatchSize);
+    for (;;) {
+        batch.push_back(lexer.nextToken());
+        bool done = batch.back().type == TokenType::END_OF_FILE;
+        if (done || batch.size() == tokenBatchSize) {
+            tokenBatches.push(std::move(batch));
+            batch = std::vector<Token>();
+            batch.reserve(tokenBatchSize);
+        }
+        if (done) break;
+    }
+    tokenBatches.close();
+
+    parserThread.join();
+    codegenThread.join();
+    jitThread.join();
+
+    return !diagnostics.hasErrors() && jitError.empty();
+}
+
+} // namespace tribhasha
@@ -1,7 +1,6 @@
 #include "tribhasha/REPL.h"
+#include <algorithm>
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <regex>
 #include <cctype>
 #include <llvm/Support/raw_ostream.h>
@@ -18,6 +17,41 @@ const std::string REPL::MAGENTA = "\033[35m";
 const std::string REPL::CYAN = "\033[36m";
 const std::string REPL::WHITE = "\033[37m";
 
+namespace {
+
+// Print `error`, if there is one, after `what`; true if there was
+bool reportError(llvm::Error error, const char* what) {
+    if (!error) {
+        return false;
+    }
+    std::cerr << what << ": ";
+    llvm::handleAllErrors(std::move(error), [](const llvm::ErrorInfoBase& info) {
+        info.log(llvm::errs());
+    });
+    std::cerr << std::endl;
+    return true;
+}
+
+// The one edit that turns `before` into `after`: everything between their
+// common prefix and common suffix
+SourceEdit findEdit(std::string_view before, std::string_view after) {
+    size_t prefix = std::mismatch(before.begin(), before.begin() + std::min(before.size(), after.size()),
+                                  after.begin()).first - before.begin();
+    size_t suffix = 0;
+    size_t limit = std::min(before.size(), after.size()) - prefix;
+    while (suffix < limit && before[before.size() - 1 - suffix] == after[after.size() - 1 - suffix]) {
+        suffix++;
+    }
+    return {prefix, before.size() - prefix - suffix, after.substr(prefix, after.size() - prefix - suffix)};
+}
+
+// Functions of the runtime, which every module can link to
+bool isRuntime(const std::string& name) {
+    return name == "printf" || name.rfind("tribhasha_", 0) == 0;
+}
+
+} // namespace
+
 REPL::REPL() {
     // Create JIT instance
     auto jitResult = TribhashaJIT::create();
@@ -51,7 +85,7 @@ void REPL::run() {
                       << "  exit/quit - Exit the REPL\n"
                       << "  clear - Clear the screen\n"
                       << "  history - Show command history\n"
-                      << "  load <filename> - Load and execute a file\n"
+                      << "  load <filename> - Load and execute a file (reloading parses only what changed)\n"
                       << "  tokens <code> - Show tokens for code\n"
                       << "  ast <code> - Show AST for code\n"
                       << std::endl;
@@ -66,21 +100,19 @@ void REPL::run() {
             std::string filename = line.substr(5);
             executeFile(filename);
         } else if (line.substr(0, 7) == "tokens ") {
-            std::string code = line.substr(7);
-            Lexer lexer(code);
+            SourceFile code(std::string_view(line).substr(7));
+            Lexer lexer(code.getText());
             std::vector<Token> tokens = lexer.scanTokens();
-            printTokens(tokens);
+            printTokens(code, tokens);
         } else if (line.substr(0, 4) == "ast ") {
-            std::string code = line.substr(4);
-            Lexer lexer(code);
+            SourceFile code(std::string_view(line).substr(4));
+            Lexer lexer(code.getText());
             std::vector<Token> tokens = lexer.scanTokens();
-            Parser parser(tokens);
-            try {
-                std::vector<std::shared_ptr<Stmt>> statements = parser.parse();
-                printAST(statements);
-            } catch (const ParseError& error) {
-                std::cerr << "Parse error: " << error.what() << std::endl;
-            }
+            ASTContext astContext;
+            Parser parser(tokens, code.getText(), astContext);
+            std::vector<Stmt*> statements = parser.parse();
+            parser.getDiagnostics().print(std::cerr, code);
+            printAST(statements);
         } else if (!line.empty()) {
             executeLine(line);
             history.push_back(line);
@@ -88,62 +120,254 @@ void REPL::run() {
     }
 }
 
-void REPL::executeLine(const std::string& line) {
+void REPL::executeLine(std::string_view line) {
     try {
-        // Print the code with syntax highlighting
-        std::cout << highlightSyntax(line) << std::endl;
-        
         // Tokenize
         Lexer lexer(line);
         std::vector<Token> tokens = lexer.scanTokens();
         
-        // Parse
-        Parser parser(tokens);
-        std::vector<std::shared_ptr<Stmt>> statements = parser.parse();
-        
-        // Generate code
-        CodeGen codegen;
-        codegen.generate(statements);
-        
-        // Get the module
-        auto module = codegen.getModule();
+        // Print the code with syntax highlighting
+        std::cout << highlightSyntax(line, tokens) << std::endl;
         
-        // Add the module to the JIT
-        auto err = jit->addModule(std::move(module));
-        if (err) {
-            std::cerr << "Error adding module to JIT: ";
-            llvm::handleAllErrors(std::move(err), [](const llvm::ErrorInfoBase& error) {
-                error.log(llvm::errs());
-            });
+        // Parse
+        ASTContext astContext;
+        Parser parser(tokens, line, astContext);
+        std::vector<Stmt*> statements = parser.parse();
+        if (parser.hadError()) {
+            parser.getDiagnostics().print(std::cerr, SourceFile(line));
             return;
         }
         
-        // Execute the main function
-        err = jit->executeMain();
-        if (err) {
-            std::cerr << "Error executing code: ";
-            llvm::handleAllErrors(std::move(err), [](const llvm::ErrorInfoBase& error) {
-                error.log(llvm::errs());
-            });
+        // Bind variables to slots
+        Resolver resolver;
+        resolver.resolve(statements);
+        if (resolver.hadError()) {
+            resolver.getDiagnostics().print(std::cerr, SourceFile(line));
             return;
         }
+        TypeInference inference;
+        inference.infer(statements);
+        if (inference.hadError()) {
+            inference.getDiagnostics().print(std::cerr, SourceFile(line));
+            return;
+        }
+        PurityAnalysis().analyze(statements);
+        ConstantFolder().fold(statements, astContext);
+        
+        runStatements(statements);
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
     }
 }
 
+void REPL::runStatements(const std::vector<Stmt*>& statements) {
+    // Generate code
+    CodeGen codegen;
+    codegen.generate(statements);
+    
+    // Get the module
+    auto module = codegen.getModule();
+    
+    // Add the module to the JIT
+    auto err = jit->addModule(std::move(module));
+    if (err) {
+        std::cerr << "Error adding module to JIT: ";
+        llvm::handleAllErrors(std::move(err), [](const llvm::ErrorInfoBase& error) {
+            error.log(llvm::errs());
+        });
+        return;
+    }
+    
+    // Execute the main function
+    err = jit->executeMain();
+    if (err) {
+        std::cerr << "Error executing code: ";
+        llvm::handleAllErrors(std::move(err), [](const llvm::ErrorInfoBase& error) {
+            error.log(llvm::errs());
+        });
+        return;
+    }
+}
+
 void REPL::executeFile(const std::string& filename) {
-    std::ifstream file(filename);
+    const SourceFile* file = sources.loadFile(filename);
     if (!file) {
         std::cerr << "Error: Could not open file " << filename << std::endl;
         return;
     }
     
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    std::string content = buffer.str();
+    std::string_view source = file->getText();
+    
+    try {
+        std::unique_ptr<LoadedScript>& script = loadedScripts[filename];
+        if (!script) {
+            auto jitResult = TribhashaJIT::create();
+            if (!jitResult) {
+                reportError(jitResult.takeError(), "Error creating JIT");
+                return;
+            }
+            script = std::make_unique<LoadedScript>();
+            script->jit = std::move(*jitResult);
+        }
+        
+        // Lex again only around what changed since the file was last
+        // loaded. Finding the edit compares the two texts, which costs far
+        // less than lexing them.
+        Lexer::relex(script->tokens, source, findEdit(script->text, source), true);
+        script->text.assign(source);
+        std::vector<Token> tokens = script->tokens.toVector();
+        
+        // Print the code with syntax highlighting
+        std::cout << highlightSyntax(source, tokens) << std::endl;
+        
+        // Parse again only the declarations that changed
+        IncrementalParser& parser = script->parser;
+        ParseUpdate update = parser.update(source, tokens);
+        if (parser.hadError()) {
+            parser.getDiagnostics().print(std::cerr, *file);
+            return;
+        }
+        
+        // The same program as last time; run it again as it is
+        if (script->program && update.changed.empty() && update.removed.empty()) {
+            reportError(script->jit->executeMain(), "Error executing code");
+            return;
+        }
+        
+        // Reused statements are resolved again too; slots in the top-level
+        // code move when declarations before them change
+        Resolver resolver;
+        resolver.resolve(parser.getStatements());
+        if (resolver.hadError()) {
+            resolver.getDiagnostics().print(std::cerr, *file);
+            return;
+        }
+        TypeInference inference;
+        inference.infer(parser.getStatements());
+        if (inference.hadError()) {
+            inference.getDiagnostics().print(std::cerr, *file);
+            return;
+        }
+        
+        std::unordered_set<Symbol> changed;
+        for (size_t index : update.changed) {
+            if (FunctionStmt* function = parser.getStatements()[index]->as<FunctionStmt>()) {
+                changed.insert(function->name.symbol);
+            }
+        }
+        
+        // The parser keeps its trees for the next load; what folding
+        // changes only lives until this run is over
+        ASTContext folded;
+        std::vector<Stmt*> statements = parser.getStatements();
+        PurityAnalysis().analyze(statements);
+        ConstantFolder().fold(statements, folded);
+        
+        if (runScript(*script, statements, changed)) {
+            reportError(script->jit->executeMain(), "Error executing code");
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+}
+
+bool REPL::runScript(LoadedScript& script, const std::vector<Stmt*>& statements,
+                     const std::unordered_set<Symbol>& changed) {
+    TribhashaJIT& jit = *script.jit;
+    FunctionTable table;
+    CodeGen program(&table);
+    program.beginProgram();
+    
+    // As in the pipeline, the first definition of each function gets a
+    // module of its own, unless main's module already has its name
+    std::unordered_map<std::string, FunctionStmt*> separate;
+    std::unordered_set<Symbol> defined;
+    for (Stmt* statement : statements) {
+        FunctionStmt* function = statement->as<FunctionStmt>();
+        if (!function || !defined.insert(function->name.symbol).second) continue;
+        std::string name(Interner::global().name(function->name.symbol));
+        if (!program.hasGlobal(name)) {
+            separate.emplace(std::move(name), function);
+        }
+    }
+    
+    // A function's module is kept if the function was not parsed again and
+    // has the shape it had, and everything the module links to is kept too
+    std::unordered_set<std::string> kept;
+    for (const auto& [name, compiled] : script.functions) {
+        auto found = separate.find(name);
+        if (found != separate.end() && !changed.count(found->second->name.symbol) &&
+            compiled.shape == FunctionShape(found->second)) {
+            kept.insert(name);
+        }
+    }
+    for (bool dropped = true; dropped;) {
+        dropped = false;
+        for (auto it = kept.begin(); it != kept.end();) {
+            const std::vector<std::string>& uses = script.functions.at(*it).uses;
+            bool linked = std::all_of(uses.begin(), uses.end(), [&](const std::string& use) {
+                return kept.count(use) || isRuntime(use);
+            });
+            it = linked ? std::next(it) : kept.erase(it);
+            dropped |= !linked;
+        }
+    }
+    
+    // Everything else goes, so it can be defined again
+    for (auto it = script.functions.begin(); it != script.functions.end();) {
+        if (kept.count(it->first)) {
+            ++it;
+            continue;
+        }
+        if (reportError(jit.removeModule(it->second.key), "Error removing module from JIT")) return false;
+        it = script.functions.erase(it);
+    }
+    if (script.program) {
+        if (reportError(jit.removeModule(script.program), "Error removing module from JIT")) return false;
+        script.program = nullptr;
+    }
     
-    executeLine(content);
+    for (Stmt* statement : statements) {
+        FunctionStmt* function = statement->as<FunctionStmt>();
+        std::string name(function ? Interner::global().name(function->name.symbol) : "");
+        auto found = function ? separate.find(name) : separate.end();
+        if (found == separate.end() || found->second != function) {
+            program.generate(statement);
+            continue;
+        }
+        if (kept.count(name)) {
+            table.define(function->name.symbol, script.functions.at(name).signature);
+            continue;
+        }
+        
+        CodeGen unit(&table);
+        unit.generate(statement);
+        std::vector<std::pair<std::string, std::string>> aliases = unit.takeAliases();
+        llvm::orc::ThreadSafeModule module = unit.takeThreadSafeModule();
+        std::vector<std::string> uses;
+        module.withModuleDo([&](llvm::Module& m) {
+            for (llvm::Function& callee : m) {
+                if (callee.isDeclaration()) uses.push_back(callee.getName().str());
+            }
+        });
+        for (const auto& alias : aliases) {
+            uses.push_back(alias.second);
+        }
+        
+        TribhashaJIT::ModuleKey key = jit.createModuleKey();
+        for (const auto& [alias, target] : aliases) {
+            if (reportError(jit.addAlias(alias, target, key), "Error adding module to JIT")) return false;
+        }
+        if (reportError(jit.addModule(std::move(module), key), "Error adding module to JIT")) return false;
+        script.functions.insert_or_assign(name, CompiledFunction{
+            FunctionShape(function), *table.find(function->name.symbol), std::move(uses), key});
+    }
+    
+    program.finishProgram();
+    TribhashaJIT::ModuleKey key = jit.createModuleKey();
+    if (reportError(jit.addModule(program.takeThreadSafeModule(), key), "Error adding module to JIT")) return false;
+    script.program = key;
+    return true;
 }
 
 std::string REPL::readLine(const std::string& prompt) {
@@ -153,42 +377,39 @@ std::string REPL::readLine(const std::string& prompt) {
     return line;
 }
 
-void REPL::printTokens(const std::vector<Token>& tokens) {
+void REPL::printTokens(const SourceFile& file, const std::vector<Token>& tokens) {
     for (const auto& token : tokens) {
-        std::cout << token.toString() << std::endl;
+        std::cout << token.toString(file) << std::endl;
     }
 }
 
-void REPL::printAST(const std::vector<std::shared_ptr<Stmt>>& statements) {
+void REPL::printAST(const std::vector<Stmt*>& statements) {
     // Simple representation of the AST
     std::cout << "AST with " << statements.size() << " statements" << std::endl;
     // TODO: Implement a proper AST printer
 }
 
-std::string REPL::highlightSyntax(const std::string& source) {
-    // Tokenize the source
-    Lexer lexer(source);
-    std::vector<Token> tokens = lexer.scanTokens();
-    
+std::string REPL::highlightSyntax(std::string_view source, const std::vector<Token>& tokens) {
     std::string result;
-    int lastPos = 0;
+    size_t lastPos = 0;
     
     for (const auto& token : tokens) {
-        // Add any whitespace before this token
-        int tokenStart = source.find(token.lexeme, lastPos);
-        if (tokenStart != std::string::npos && tokenStart > lastPos) {
-            result += source.substr(lastPos, tokenStart - lastPos);
+        // Add any whitespace (or comment) before this token
+        if (token.offset > lastPos) {
+            result += source.substr(lastPos, token.offset - lastPos);
         }
         
         // Add the colored token
-        result += getColorForToken(token) + token.lexeme + RESET;
+        result += getColorForToken(token);
+        result += token.lexeme(source);
+        result += RESET;
         
         // Update the lastPos
-        lastPos = tokenStart + token.lexeme.length();
+        lastPos = token.end();
     }
     
     // Add any remaining text
-    if (lastPos < static_cast<int>(source.length())) {
+    if (lastPos < source.length()) {
         result += source.substr(lastPos);
     }
     
@@ -197,43 +418,27 @@ std::string REPL::highlightSyntax(const std::string& source) {
 
 std::string REPL::getColorForToken(const Token& token) {
     switch (token.type) {
-        // Keywords - English
-        case TokenType::VAR_EN:
-        case TokenType::FUNCTION_EN:
-        case TokenType::IF_EN:
-        case TokenType::ELSE_EN:
-        case TokenType::WHILE_EN:
-        case TokenType::FOR_EN:
-        case TokenType::RETURN_EN:
-            return BLUE;
-            
-        // Keywords - Hindi
-        case TokenType::VAR_HI:
-        case TokenType::FUNCTION_HI:
-        case TokenType::IF_HI:
-        case TokenType::ELSE_HI:
-        case TokenType::WHILE_HI:
-        case TokenType::FOR_HI:
-        case TokenType::RETURN_HI:
-            return MAGENTA;
-            
-        // Keywords - Assamese
-        case TokenType::VAR_AS:
-        case TokenType::FUNCTION_AS:
-        case TokenType::IF_AS:
-        case TokenType::ELSE_AS:
-        case TokenType::WHILE_AS:
-        case TokenType::FOR_AS:
-        case TokenType::RETURN_AS:
-            return CYAN;
+        // Statement keywords, colored by the language they are written in
+        case TokenType::KW_VAR:
+        case TokenType::KW_FUNCTION:
+        case TokenType::KW_IF:
+        case TokenType::KW_ELSE:
+        case TokenType::KW_WHILE:
+        case TokenType::KW_FOR:
+        case TokenType::KW_RETURN:
+        case TokenType::KW_INT:
+        case TokenType::KW_FLOAT:
+        case TokenType::KW_STRING:
+        case TokenType::KW_BOOL:
+            switch (token.language) {
+                case Language::HINDI: return MAGENTA;
+                case Language::ASSAMESE: return CYAN;
+                default: return BLUE;
+            }
             
         // Boolean literals
-        case TokenType::TRUE_EN:
-        case TokenType::TRUE_HI:
-        case TokenType::TRUE_AS:
-        case TokenType::FALSE_EN:
-        case TokenType::FALSE_HI:
-        case TokenType::FALSE_AS:
+        case TokenType::KW_TRUE:
+        case TokenType::KW_FALSE:
             return YELLOW;
             
         // Other literals
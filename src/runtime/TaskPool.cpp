@@ -0,0 +1,190 @@
+#include "tribhasha/TaskPool.h"
+#include <algorithm>
+
+namespace tribhasha {
+
+namespace {
+
+// Levels of parallel calls beyond the first log2(threads), so there are
+// many more tasks than threads to even out uneven recursion
+constexpr size_t extraLevels = 6;
+
+struct ThreadState {
+    TaskPool* pool = nullptr;  // set on the pool's workers
+    size_t queue = 0;
+    size_t depth = 0;
+};
+
+thread_local ThreadState current;
+
+} // namespace
+
+struct TaskPool::Task {
+    void (*run)(void*);
+    void* frame;
+    size_t depth;  // of the thread that forked it
+    std::atomic<bool> done{false};
+};
+
+TaskPool::TaskPool(unsigned threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    size_t levels = 0;
+    while ((size_t(1) << levels) < threads) levels++;
+    depthLimit = levels + extraLevels;
+
+    for (unsigned i = 0; i < threads; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i + 1 < threads; i++) {
+        workers.emplace_back(&TaskPool::work, this, i);
+    }
+}
+
+TaskPool::~TaskPool() {
+    stopping = true;
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+TaskPool& TaskPool::global() {
+    static TaskPool pool;
+    return pool;
+}
+
+TaskPool::Queue& TaskPool::ownQueue() {
+    return current.pool == this ? *queues[current.queue] : *queues.back();
+}
+
+bool TaskPool::enter() {
+    if (workers.empty() || current.depth >= depthLimit) {
+        return false;
+    }
+    current.depth++;
+    return true;
+}
+
+void TaskPool::leave() {
+    current.depth--;
+}
+
+TaskPool::Task* TaskPool::fork(void (*run)(void*), void* frame) {
+    Task* task = new Task{run, frame, current.depth};
+    Queue& queue = ownQueue();
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+        queued++;
+    }
+
+    // Taking the lock orders this with a worker about to wait
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_one();
+    return task;
+}
+
+void TaskPool::join(Task* task) {
+    // Usually nobody has taken it, and it runs here as a plain call would
+    Queue& own = ownQueue();
+    bool mine = false;
+    {
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty() && own.tasks.back() == task) {
+            own.tasks.pop_back();
+            queued--;
+            mine = true;
+        }
+    }
+    if (mine) {
+        execute(task);
+    } else {
+        while (!task->done.load(std::memory_order_acquire)) {
+            if (Task* other = take()) {
+                execute(other);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+    delete task;
+}
+
+// The newest task of this thread's queue, or else the oldest of another
+TaskPool::Task* TaskPool::take() {
+    if (queued == 0) {
+        return nullptr;
+    }
+    Queue& own = ownQueue();
+    {
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            Task* task = own.tasks.back();
+            own.tasks.pop_back();
+            queued--;
+            return task;
+        }
+    }
+    size_t start = current.pool == this ? current.queue + 1 : 0;
+    for (size_t i = 0; i < queues.size(); i++) {
+        Queue& queue = *queues[(start + i) % queues.size()];
+        if (&queue == &own) continue;
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            Task* task = queue.tasks.front();
+            queue.tasks.pop_front();
+            queued--;
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void TaskPool::execute(Task* task) {
+    // The task is as deep as the code that forked it
+    size_t depth = current.depth;
+    current.depth = task->depth;
+    task->run(task->frame);
+    current.depth = depth;
+    task->done.store(true, std::memory_order_release);
+}
+
+void TaskPool::work(size_t index) {
+    current.pool = this;
+    current.queue = index;
+    while (!stopping) {
+        if (Task* task = take()) {
+            execute(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [&] { return stopping || queued > 0; });
+    }
+}
+
+} // namespace tribhasha
+
+using tribhasha::TaskPool;
+
+int tribhasha_enter() {
+    return TaskPool::global().enter();
+}
+
+void tribhasha_leave() {
+    TaskPool::global().leave();
+}
+
+void* tribhasha_fork(void (*run)(void*), void* frame) {
+    return TaskPool::global().fork(run, frame);
+}
+
+void tribhasha_join(void* task) {
+    TaskPool::global().join(static_cast<TaskPool::Task*>(task));
+}
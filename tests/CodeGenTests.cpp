@@ -0,0 +1,307 @@
+#include "tribhasha/Lexer.h"
+#include "tribhasha/Parser.h"
+#include "tribhasha/Resolver.h"
+#include "tribhasha/ConstantFolder.h"
+#include "tribhasha/PurityAnalysis.h"
+#include "tribhasha/TaskPool.h"
+#include "tribhasha/TypeInference.h"
+#include "tribhasha/CodeGen.h"
+#include "tribhasha/JIT.h"
+#include "tribhasha/Pipeline.h"
+#include <llvm/IR/Module.h>
+#include <iostream>
+#include <functional>
+#include <optional>
+
+using namespace tribhasha;
+
+// Compile a program through every pass; nothing if it does not compile
+std::optional<llvm::orc::ThreadSafeModule> compileProgram(const std::string& source,
+                                                          bool memoize = false, bool parallel = false) {
+    ASTContext context;
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokens();
+    Parser parser(tokens, source, context);
+    std::vector<Stmt*> statements = parser.parse();
+    Resolver resolver;
+    resolver.resolve(statements);
+    TypeInference inference;
+    inference.infer(statements);
+    if (parser.hadError() || resolver.hadError() || inference.hadError()) return std::nullopt;
+    PurityAnalysis().analyze(statements);
+    ConstantFolder().fold(statements, context);
+    
+    CodeGen codegen;
+    codegen.setMemoize(memoize);
+    codegen.setParallel(parallel);
+    codegen.generate(statements);
+    return codegen.takeThreadSafeModule();
+}
+
+// Run main of a program already in `jit`; -1 if it is not there
+int runMain(TribhashaJIT& jit) {
+    auto main = jit.lookup("main");
+    if (!main) {
+        llvm::consumeError(main.takeError());
+        return -1;
+    }
+    return reinterpret_cast<int (*)()>(main->getAddress())();
+}
+
+// JIT a compiled program and run main; -1 if it cannot be
+int runModule(llvm::orc::ThreadSafeModule module) {
+    auto jit = TribhashaJIT::create();
+    if (!jit) {
+        llvm::consumeError(jit.takeError());
+        return -1;
+    }
+    if (llvm::Error error = (*jit)->addModule(std::move(module))) {
+        llvm::consumeError(std::move(error));
+        return -1;
+    }
+    return runMain(**jit);
+}
+
+// Compile a program, JIT it and run main; -1 if it does not compile
+int runProgram(const std::string& source, bool memoize = false, bool parallel = false) {
+    std::optional<llvm::orc::ThreadSafeModule> module = compileProgram(source, memoize, parallel);
+    return module ? runModule(std::move(*module)) : -1;
+}
+
+// Long operator chains go through every pass and run. The loop keeps g's
+// call from being evaluated at compile time; the `and` chain is folded.
+bool testDeepExpressionsRun() {
+    const int depth = 100000;
+    
+    std::string source = "function int g(int a) { return a";
+    for (int i = 0; i < depth; i++) source += " + 1";
+    source += "; }\nvar t = true";
+    for (int i = 0; i < depth; i++) source += " and true";
+    source += ";\nvar n = 0;\nwhile (n < 2) { n = n + 1; }\n"
+              "if (g(n) != " + std::to_string(depth + 2) + ") { return 1; }\n"
+              "if (!t) { return 2; }\nreturn 0;";
+    
+    return runProgram(source) == 0;
+}
+
+// fib(24), with n only known at run time so the call is not evaluated at
+// compile time
+const std::string fibProgram = R"(
+    function fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }
+    var n = 0;
+    while (n < 24) { n = n + 1; }
+    return fib(n);
+)";
+const int fib24 = 46368;
+
+// Whether the compiled module has something `found` looks for
+bool moduleHas(llvm::orc::ThreadSafeModule& module, const std::function<bool(llvm::Module&)>& found) {
+    return module.withModuleDo([&](llvm::Module& m) { return found(m); });
+}
+
+// The memoized fib looks its results up in tables and gets the same
+// answer as the plain one
+bool testMemoizedFib() {
+    auto plain = compileProgram(fibProgram);
+    auto memoized = compileProgram(fibProgram, true);
+    if (!plain || !memoized) return false;
+    
+    auto hasTable = [](llvm::Module& m) { return m.getNamedGlobal("fib.memo.keys") != nullptr; };
+    bool tabled = moduleHas(*memoized, hasTable) && !moduleHas(*plain, hasTable);
+    
+    return tabled && runModule(std::move(*plain)) == fib24 && runModule(std::move(*memoized)) == fib24;
+}
+
+// fib(60) only finishes if its calls are found in the table. Float keys
+// must spread over it too, though a whole number has only zeros in its
+// low bits; unannotated parameters are Floats in a pipelined compile.
+const std::string fib60 = R"(
+    var n = 0;
+    while (n < 60) { n = n + 1; }
+    if (fib(n) != 1548008755920) { return 1; }
+    return 0;
+)";
+
+bool testMemoizedFloatFib() {
+    std::string typed = "function fib(float n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }" + fib60;
+    bool whole = runProgram(typed, true) == 0;
+    
+    std::string untyped = "function fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }" + fib60;
+    auto jit = TribhashaJIT::create();
+    if (!jit) {
+        llvm::consumeError(jit.takeError());
+        return false;
+    }
+    bool pipelined = CompilePipeline(untyped, **jit, true).run() && runMain(**jit) == 0;
+    
+    return whole && pipelined;
+}
+
+// The parallel fib forks its two calls on the task pool and gets the same
+// answer as the plain one
+bool testParallelFib() {
+    auto plain = compileProgram(fibProgram);
+    auto parallel = compileProgram(fibProgram, false, true);
+    if (!plain || !parallel) return false;
+    
+    auto forks = [](llvm::Module& m) { return m.getFunction("tribhasha_fork") != nullptr; };
+    bool forked = moduleHas(*parallel, forks) && !moduleHas(*plain, forks);
+    
+    bool same = true;
+    for (int round = 0; round < 5; round++) {
+        same &= runProgram(fibProgram, false, true) == fib24;
+    }
+    return forked && same && runModule(std::move(*plain)) == fib24 && runModule(std::move(*parallel)) == fib24;
+}
+
+// fibo is fib under another name; `swapped` adds its calls the other way
+// round, so it has a shape of its own
+std::string twoFibs(bool swapped) {
+    return std::string(R"(
+        function fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }
+        function fibo(n) { if (n < 2) { return n; } return )") +
+        (swapped ? "fibo(n - 2) + fibo(n - 1)" : "fibo(n - 1) + fibo(n - 2)") + R"(; }
+        var n = 0;
+        while (n < 24) { n = n + 1; }
+        return fib(n) - fibo(n - 1);
+    )";
+}
+
+// A function with the shape of one already generated becomes an alias of
+// it, within a module and, through the JIT, across the pipeline's modules;
+// either way the program gets what it gets with both generated
+bool testAliasedFib() {
+    int expected = runProgram(twoFibs(true));
+    
+    auto aliased = compileProgram(twoFibs(false));
+    auto separate = compileProgram(twoFibs(true));
+    if (!aliased || !separate) return false;
+    auto isAlias = [](llvm::Module& m) { return m.getNamedAlias("fibo") != nullptr; };
+    bool shared = moduleHas(*aliased, isAlias) && !moduleHas(*separate, isAlias);
+    bool same = expected == fib24 - 28657 && runModule(std::move(*aliased)) == expected;
+    
+    // Pipelined, each function has a module of its own
+    std::string source = twoFibs(false);
+    auto jit = TribhashaJIT::create();
+    if (!jit) {
+        llvm::consumeError(jit.takeError());
+        return false;
+    }
+    if (!CompilePipeline(source, **jit).run()) return false;
+    auto fib = (*jit)->lookup("fib");
+    auto fibo = (*jit)->lookup("fibo");
+    if (!fib || !fibo) {
+        if (!fib) llvm::consumeError(fib.takeError());
+        if (!fibo) llvm::consumeError(fibo.takeError());
+        return false;
+    }
+    bool linked = fib->getAddress() == fibo->getAddress() && runMain(**jit) == expected;
+    
+    return shared && same && linked;
+}
+
+// A function called main keeps its own code under the pipeline, apart
+// from the program's main, and other functions' calls of it find it
+bool testPipelinedMainFunction() {
+    std::string source = R"(
+        function main() { return 41; }
+        function next() { return main() + 1; }
+        var x = main();
+        return next() - x;
+    )";
+    auto jit = TribhashaJIT::create();
+    if (!jit) {
+        llvm::consumeError(jit.takeError());
+        return false;
+    }
+    return CompilePipeline(source, **jit).run() && runMain(**jit) == 1 && runProgram(source) == 1;
+}
+
+// What was added under a key goes when it is removed, and its names can
+// be defined again; modules added under other keys stay
+bool testRemovableModules() {
+    auto jit = TribhashaJIT::create();
+    if (!jit) {
+        llvm::consumeError(jit.takeError());
+        return false;
+    }
+    auto add = [&](const std::string& source) {
+        std::optional<llvm::orc::ThreadSafeModule> module = compileProgram(source);
+        TribhashaJIT::ModuleKey key = (*jit)->createModuleKey();
+        if (!module) return TribhashaJIT::ModuleKey();
+        if (llvm::Error error = (*jit)->addModule(std::move(*module), key)) {
+            llvm::consumeError(std::move(error));
+            return TribhashaJIT::ModuleKey();
+        }
+        return key;
+    };
+    auto remove = [&](const TribhashaJIT::ModuleKey& key) {
+        if (llvm::Error error = (*jit)->removeModule(key)) {
+            llvm::consumeError(std::move(error));
+            return false;
+        }
+        return true;
+    };
+    
+    TribhashaJIT::ModuleKey first = add("return 1;");
+    bool ran = first && runMain(**jit) == 1;
+    TribhashaJIT::ModuleKey second = first && remove(first) ? add("return 2;") : nullptr;
+    return ran && second && runMain(**jit) == 2 && remove(second) && runMain(**jit) == -1;
+}
+
+// Sums a range the way generated parallel code splits a call: half is
+// forked, half run here, and the task joined before the halves are added
+struct RangeSum {
+    TaskPool* pool;
+    int64_t low;
+    int64_t high;
+    int64_t result = 0;
+    
+    static void run(void* frame) {
+        RangeSum* range = static_cast<RangeSum*>(frame);
+        if (range->high - range->low < 2 || !range->pool->enter()) {
+            for (int64_t i = range->low; i < range->high; i++) range->result += i;
+            return;
+        }
+        int64_t middle = range->low + (range->high - range->low) / 2;
+        RangeSum left{range->pool, range->low, middle};
+        RangeSum right{range->pool, middle, range->high};
+        TaskPool::Task* task = range->pool->fork(run, &left);
+        run(&right);
+        range->pool->join(task);
+        range->pool->leave();
+        range->result = left.result + right.result;
+    }
+};
+
+// Forked tasks have all run by their joins, whichever thread ran them; a
+// pool of one thread never forks
+bool testTaskPool() {
+    TaskPool pool(4);
+    bool summed = true;
+    for (int round = 0; round < 20; round++) {
+        RangeSum range{&pool, 0, 1000000};
+        RangeSum::run(&range);
+        summed &= range.result == 499999500000;
+    }
+    
+    TaskPool single(1);
+    return summed && pool.getThreads() == 4 && !single.enter();
+}
+
+// Register all code generation tests
+void registerCodeGenTests() {
+    // Initialize keyword maps
+    Keywords::initialize();
+    
+    extern void registerTest(const std::string&, const std::string&, std::function<bool()>);
+    
+    registerTest("codegen", "Deep Expressions Run", testDeepExpressionsRun);
+    registerTest("codegen", "Memoized Fib", testMemoizedFib);
+    registerTest("codegen", "Memoized Float Fib", testMemoizedFloatFib);
+    registerTest("codegen", "Parallel Fib", testParallelFib);
+    registerTest("codegen", "Aliased Fib", testAliasedFib);
+    registerTest("codegen", "Pipelined Main Function", testPipelinedMainFunction);
+    registerTest("codegen", "Removable Modules", testRemovableModules);
+    registerTest("codegen", "Task Pool", testTaskPool);
+}
@@ -1,14 +1,19 @@
 #include "tribhasha/Lexer.h"
+#include "tribhasha/TokenBuffer.h"
+#include "tribhasha/Unicode.h"
 #include <iostream>
 #include <functional>
 #include <cassert>
+#include <algorithm>
+#include <cstdint>
 
 using namespace tribhasha;
 
 // Test helper - find a token of specific type in tokens
-bool hasToken(const std::vector<Token>& tokens, TokenType type, const std::string& lexeme = "") {
+bool hasToken(std::string_view source, const std::vector<Token>& tokens, TokenType type,
+              const std::string& lexeme = "") {
     for (const auto& token : tokens) {
-        if (token.type == type && (lexeme.empty() || token.lexeme == lexeme)) {
+        if (token.type == type && (lexeme.empty() || token.lexeme(source) == lexeme)) {
             return true;
         }
     }
@@ -21,23 +26,23 @@ bool testEnglishLexing() {
     Lexer lexer(source);
     std::vector<Token> tokens = lexer.scanTokens();
     
-    return hasToken(tokens, TokenType::VAR_EN, "var") &&
-           hasToken(tokens, TokenType::IDENTIFIER, "x") &&
-           hasToken(tokens, TokenType::ASSIGN, "=") &&
-           hasToken(tokens, TokenType::INT_LITERAL, "10") &&
-           hasToken(tokens, TokenType::SEMICOLON, ";") &&
-           hasToken(tokens, TokenType::FUNCTION_EN, "function") &&
-           hasToken(tokens, TokenType::IDENTIFIER, "test") &&
-           hasToken(tokens, TokenType::LEFT_PAREN, "(") &&
-           hasToken(tokens, TokenType::RIGHT_PAREN, ")") &&
-           hasToken(tokens, TokenType::LEFT_BRACE, "{") &&
-           hasToken(tokens, TokenType::RETURN_EN, "return") &&
-           hasToken(tokens, TokenType::IDENTIFIER, "x") &&
-           hasToken(tokens, TokenType::PLUS, "+") &&
-           hasToken(tokens, TokenType::INT_LITERAL, "5") &&
-           hasToken(tokens, TokenType::SEMICOLON, ";") &&
-           hasToken(tokens, TokenType::RIGHT_BRACE, "}") &&
-           hasToken(tokens, TokenType::END_OF_FILE);
+    return hasToken(source, tokens, TokenType::KW_VAR, "var") &&
+           hasToken(source, tokens, TokenType::IDENTIFIER, "x") &&
+           hasToken(source, tokens, TokenType::ASSIGN, "=") &&
+           hasToken(source, tokens, TokenType::INT_LITERAL, "10") &&
+           hasToken(source, tokens, TokenType::SEMICOLON, ";") &&
+           hasToken(source, tokens, TokenType::KW_FUNCTION, "function") &&
+           hasToken(source, tokens, TokenType::IDENTIFIER, "test") &&
+           hasToken(source, tokens, TokenType::LEFT_PAREN, "(") &&
+           hasToken(source, tokens, TokenType::RIGHT_PAREN, ")") &&
+           hasToken(source, tokens, TokenType::LEFT_BRACE, "{") &&
+           hasToken(source, tokens, TokenType::KW_RETURN, "return") &&
+           hasToken(source, tokens, TokenType::IDENTIFIER, "x") &&
+           hasToken(source, tokens, TokenType::PLUS, "+") &&
+           hasToken(source, tokens, TokenType::INT_LITERAL, "5") &&
+           hasToken(source, tokens, TokenType::SEMICOLON, ";") &&
+           hasToken(source, tokens, TokenType::RIGHT_BRACE, "}") &&
+           hasToken(source, tokens, TokenType::END_OF_FILE);
 }
 
 // Basic Hindi lexing test
@@ -46,23 +51,23 @@ bool testHindiLexing() {
     Lexer lexer(source);
     std::vector<Token> tokens = lexer.scanTokens();
     
-    return hasToken(tokens, TokenType::VAR_HI, "चर") &&
-           hasToken(tokens, TokenType::IDENTIFIER, "य") &&
-           hasToken(tokens, TokenType::ASSIGN, "=") &&
-           hasToken(tokens, TokenType::INT_LITERAL, "10") &&
-           hasToken(tokens, TokenType::SEMICOLON, ";") &&
-           hasToken(tokens, TokenType::FUNCTION_HI, "फलन") &&
-           hasToken(tokens, TokenType::IDENTIFIER, "परीक्षण") &&
-           hasToken(tokens, TokenType::LEFT_PAREN, "(") &&
-           hasToken(tokens, TokenType::RIGHT_PAREN, ")") &&
-           hasToken(tokens, TokenType::LEFT_BRACE, "{") &&
-           hasToken(tokens, TokenType::RETURN_HI, "वापस") &&
-           hasToken(tokens, TokenType::IDENTIFIER, "य") &&
-           hasToken(tokens, TokenType::PLUS, "+") &&
-           hasToken(tokens, TokenType::INT_LITERAL, "5") &&
-           hasToken(tokens, TokenType::SEMICOLON, ";") &&
-           hasToken(tokens, TokenType::RIGHT_BRACE, "}") &&
-           hasToken(tokens, TokenType::END_OF_FILE);
+    return hasToken(source, tokens, TokenType::KW_VAR, "चर") &&
+           hasToken(source, tokens, TokenType::IDENTIFIER, "य") &&
+           hasToken(source, tokens, TokenType::ASSIGN, "=") &&
+           hasToken(source, tokens, TokenType::INT_LITERAL, "10") &&
+           hasToken(source, tokens, TokenType::SEMICOLON, ";") &&
+           hasToken(source, tokens, TokenType::KW_FUNCTION, "फलन") &&
+           hasToken(source, tokens, TokenType::IDENTIFIER, "परीक्षण") &&
+           hasToken(source, tokens, TokenType::LEFT_PAREN, "(") &&
+           hasToken(source, tokens, TokenType::RIGHT_PAREN, ")") &&
+           hasToken(source, tokens, TokenType::LEFT_BRACE, "{") &&
+           hasToken(source, tokens, TokenType::KW_RETURN, "वापस") &&
+           hasToken(source, tokens, TokenType::IDENTIFIER, "य") &&
+           hasToken(source, tokens, TokenType::PLUS, "+") &&
+           hasToken(source, tokens, TokenType::INT_LITERAL, "5") &&
+           hasToken(source, tokens, TokenType::SEMICOLON, ";") &&
+           hasToken(source, tokens, TokenType::RIGHT_BRACE, "}") &&
+           hasToken(source, tokens, TokenType::END_OF_FILE);
 }
 
 // Basic Assamese lexing test
@@ -71,23 +76,23 @@ bool testAssameseLexing() {
     Lexer lexer(source);
     std::vector<Token> tokens = lexer.scanTokens();
     
-    return hasToken(tokens, TokenType::VAR_AS, "ভেৰিয়েবল") &&
-           hasToken(tokens, TokenType::IDENTIFIER, "জ") &&
-           hasToken(tokens, TokenType::ASSIGN, "=") &&
-           hasToken(tokens, TokenType::INT_LITERAL, "10") &&
-           hasToken(tokens, TokenType::SEMICOLON, ";") &&
-           hasToken(tokens, TokenType::FUNCTION_AS, "কাৰ্য্য") &&
-           hasToken(tokens, TokenType::IDENTIFIER, "পৰীক্ষা") &&
-           hasToken(tokens, TokenType::LEFT_PAREN, "(") &&
-           hasToken(tokens, TokenType::RIGHT_PAREN, ")") &&
-           hasToken(tokens, TokenType::LEFT_BRACE, "{") &&
-           hasToken(tokens, TokenType::RETURN_AS, "ঘূৰাই_দিয়ক") &&
-           hasToken(tokens, TokenType::IDENTIFIER, "জ") &&
-           hasToken(tokens, TokenType::PLUS, "+") &&
-           hasToken(tokens, TokenType::INT_LITERAL, "5") &&
-           hasToken(tokens, TokenType::SEMICOLON, ";") &&
-           hasToken(tokens, TokenType::RIGHT_BRACE, "}") &&
-           hasToken(tokens, TokenType::END_OF_FILE);
+    return hasToken(source, tokens, TokenType::KW_VAR, "ভেৰিয়েবল") &&
+           hasToken(source, tokens, TokenType::IDENTIFIER, "জ") &&
+           hasToken(source, tokens, TokenType::ASSIGN, "=") &&
+           hasToken(source, tokens, TokenType::INT_LITERAL, "10") &&
+           hasToken(source, tokens, TokenType::SEMICOLON, ";") &&
+           hasToken(source, tokens, TokenType::KW_FUNCTION, "কাৰ্য্য") &&
+           hasToken(source, tokens, TokenType::IDENTIFIER, "পৰীক্ষা") &&
+           hasToken(source, tokens, TokenType::LEFT_PAREN, "(") &&
+           hasToken(source, tokens, TokenType::RIGHT_PAREN, ")") &&
+           hasToken(source, tokens, TokenType::LEFT_BRACE, "{") &&
+           hasToken(source, tokens, TokenType::KW_RETURN, "ঘূৰাই_দিয়ক") &&
+           hasToken(source, tokens, TokenType::IDENTIFIER, "জ") &&
+           hasToken(source, tokens, TokenType::PLUS, "+") &&
+           hasToken(source, tokens, TokenType::INT_LITERAL, "5") &&
+           hasToken(source, tokens, TokenType::SEMICOLON, ";") &&
+           hasToken(source, tokens, TokenType::RIGHT_BRACE, "}") &&
+           hasToken(source, tokens, TokenType::END_OF_FILE);
 }
 
 // Mixed language lexing test
@@ -96,35 +101,307 @@ bool testMixedLanguageLexing() {
     Lexer lexer(source);
     std::vector<Token> tokens = lexer.scanTokens();
     
-    return hasToken(tokens, TokenType::FUNCTION_EN, "function") &&
-           hasToken(tokens, TokenType::IDENTIFIER, "factorial") &&
-           hasToken(tokens, TokenType::LEFT_PAREN, "(") &&
-           hasToken(tokens, TokenType::IDENTIFIER, "n") &&
-           hasToken(tokens, TokenType::RIGHT_PAREN, ")") &&
-           hasToken(tokens, TokenType::LEFT_BRACE, "{") &&
-           hasToken(tokens, TokenType::IF_HI, "अगर") &&
-           hasToken(tokens, TokenType::LEFT_PAREN, "(") &&
-           hasToken(tokens, TokenType::IDENTIFIER, "n") &&
-           hasToken(tokens, TokenType::LESS_EQUAL, "<=") &&
-           hasToken(tokens, TokenType::INT_LITERAL, "1") &&
-           hasToken(tokens, TokenType::RIGHT_PAREN, ")") &&
-           hasToken(tokens, TokenType::LEFT_BRACE, "{") &&
-           hasToken(tokens, TokenType::RETURN_AS, "ঘূৰাই_দিয়ক") &&
-           hasToken(tokens, TokenType::INT_LITERAL, "1") &&
-           hasToken(tokens, TokenType::SEMICOLON, ";") &&
-           hasToken(tokens, TokenType::RIGHT_BRACE, "}") &&
-           hasToken(tokens, TokenType::RETURN_EN, "return") &&
-           hasToken(tokens, TokenType::IDENTIFIER, "n") &&
-           hasToken(tokens, TokenType::STAR, "*") &&
-           hasToken(tokens, TokenType::IDENTIFIER, "factorial") &&
-           hasToken(tokens, TokenType::LEFT_PAREN, "(") &&
-           hasToken(tokens, TokenType::IDENTIFIER, "n") &&
-           hasToken(tokens, TokenType::MINUS, "-") &&
-           hasToken(tokens, TokenType::INT_LITERAL, "1") &&
-           hasToken(tokens, TokenType::RIGHT_PAREN, ")") &&
-           hasToken(tokens, TokenType::SEMICOLON, ";") &&
-           hasToken(tokens, TokenType::RIGHT_BRACE, "}") &&
-           hasToken(tokens, TokenType::END_OF_FILE);
+    return hasToken(source, tokens, TokenType::KW_FUNCTION, "function") &&
+           hasToken(source, tokens, TokenType::IDENTIFIER, "factorial") &&
+           hasToken(source, tokens, TokenType::LEFT_PAREN, "(") &&
+           hasToken(source, tokens, TokenType::IDENTIFIER, "n") &&
+           hasToken(source, tokens, TokenType::RIGHT_PAREN, ")") &&
+           hasToken(source, tokens, TokenType::LEFT_BRACE, "{") &&
+           hasToken(source, tokens, TokenType::KW_IF, "अगर") &&
+           hasToken(source, tokens, TokenType::LEFT_PAREN, "(") &&
+           hasToken(source, tokens, TokenType::IDENTIFIER, "n") &&
+           hasToken(source, tokens, TokenType::LESS_EQUAL, "<=") &&
+           hasToken(source, tokens, TokenType::INT_LITERAL, "1") &&
+           hasToken(source, tokens, TokenType::RIGHT_PAREN, ")") &&
+           hasToken(source, tokens, TokenType::LEFT_BRACE, "{") &&
+           hasToken(source, tokens, TokenType::KW_RETURN, "ঘূৰাই_দিয়ক") &&
+           hasToken(source, tokens, TokenType::INT_LITERAL, "1") &&
+           hasToken(source, tokens, TokenType::SEMICOLON, ";") &&
+           hasToken(source, tokens, TokenType::RIGHT_BRACE, "}") &&
+           hasToken(source, tokens, TokenType::KW_RETURN, "return") &&
+           hasToken(source, tokens, TokenType::IDENTIFIER, "n") &&
+           hasToken(source, tokens, TokenType::STAR, "*") &&
+           hasToken(source, tokens, TokenType::IDENTIFIER, "factorial") &&
+           hasToken(source, tokens, TokenType::LEFT_PAREN, "(") &&
+           hasToken(source, tokens, TokenType::IDENTIFIER, "n") &&
+           hasToken(source, tokens, TokenType::MINUS, "-") &&
+           hasToken(source, tokens, TokenType::INT_LITERAL, "1") &&
+           hasToken(source, tokens, TokenType::RIGHT_PAREN, ")") &&
+           hasToken(source, tokens, TokenType::SEMICOLON, ";") &&
+           hasToken(source, tokens, TokenType::RIGHT_BRACE, "}") &&
+           hasToken(source, tokens, TokenType::END_OF_FILE);
+}
+
+// Numeric literals are parsed at lex time and every token lies inside the source
+bool testLiteralValues() {
+    std::string source = "var x = 1234 + 2.5; var s = \"text\";";
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokens();
+    
+    bool sawInt = false;
+    bool sawFloat = false;
+    for (const auto& token : tokens) {
+        if (token.end() > source.size()) {
+            return false;
+        }
+        
+        if (token.type == TokenType::INT_LITERAL) {
+            sawInt = token.intValue == 1234;
+        } else if (token.type == TokenType::FLOAT_LITERAL) {
+            sawFloat = token.floatValue == 2.5;
+        }
+    }
+    
+    if (!sawInt || !sawFloat || !hasToken(source, tokens, TokenType::STRING_LITERAL, "\"text\"")) {
+        return false;
+    }
+    
+    // Literals of any length keep their value; ones that do not fit are
+    // errors rather than wrapped or cut short
+    std::string tiny = "0." + std::string(70, '0') + "1";
+    std::string wide = std::string(71, '9') + ".5";
+    std::string longSource = tiny + " " + wide + " 9223372036854775807";
+    Lexer longLexer(longSource);
+    std::vector<Token> longTokens = longLexer.scanTokens();
+    if (longLexer.hadError() || longTokens.size() != 4 ||
+        longTokens[0].floatValue != 1e-71 || longTokens[1].floatValue != 1e71 ||
+        longTokens[2].intValue != INT64_MAX) {
+        return false;
+    }
+    Lexer overflow("var big = 99999999999999999999;");
+    overflow.scanTokens();
+    return overflow.hadError();
+}
+
+// Long whitespace runs, comments, strings and identifiers take the
+// vectorized paths; positions must still come out right
+bool testLongRunsKeepLines() {
+    std::string source =
+        "// " + std::string(100, '-') + "\n" +
+        std::string(40, ' ') + "\n\n\t\t" + std::string(37, ' ') + "\n" +
+        "var " + std::string(70, 'a') + "_1 = \"" + std::string(50, 'x') + "\n" + std::string(50, 'y') + "\";\n" +
+        "return;";
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokens();
+    SourceFile file(source);
+    
+    if (tokens.size() != 8) return false;
+    return tokens[0].type == TokenType::KW_VAR && file.getLine(tokens[0].offset) == 5 &&
+           tokens[1].type == TokenType::IDENTIFIER && tokens[1].length == 72 &&
+           tokens[3].type == TokenType::STRING_LITERAL && tokens[3].length == 103 &&
+           file.getLineColumn(tokens[3].offset).line == 5 &&
+           file.getLineColumn(tokens[3].offset).column == 80 &&
+           tokens[5].type == TokenType::KW_RETURN && file.getLine(tokens[5].offset) == 7 &&
+           file.getLine(tokens[7].offset) == 7;
+}
+
+// Keywords come out as one kind per concept with a language tag, and
+// words that only resemble keywords stay identifiers
+bool testKeywordLanguages() {
+    std::string source = "if iff not ! notice";
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokens();
+    
+    if (tokens.size() != 6) return false;
+    return tokens[0].type == TokenType::KW_IF && tokens[0].language == Language::ENGLISH &&
+           tokens[1].type == TokenType::IDENTIFIER &&
+           tokens[2].type == TokenType::KW_NOT && tokens[2].language == Language::ENGLISH &&
+           tokens[3].type == TokenType::KW_NOT && tokens[3].language == Language::NONE &&
+           tokens[4].type == TokenType::IDENTIFIER &&
+           Keywords::lookup("अगर").type == TokenType::KW_IF &&
+           Keywords::lookup("अगर").language == Language::HINDI &&
+           Keywords::lookup("নহয়").type == TokenType::KW_NOT &&
+           Keywords::lookup("নহয়").language == Language::ASSAMESE &&
+           Keywords::lookup("पूर्णांक").type == TokenType::KW_INT &&
+           Keywords::lookup("বাক্য").type == TokenType::KW_STRING &&
+           Keywords::lookup("bool").language == Language::ENGLISH &&
+           Keywords::lookup("चरण").type == TokenType::IDENTIFIER &&
+           Keywords::lookup("variable").type == TokenType::IDENTIFIER &&
+           Keywords::spelling(TokenType::KW_RETURN, Language::ASSAMESE) == "ঘূৰাই_দিয়ক";
+}
+
+// Identifier boundaries follow the Unicode identifier classes: marks and
+// ZWJ continue an identifier, the danda and foreign symbols do not
+bool testUnicodeIdentifierBoundaries() {
+    // "क्\u200Dष" joins with ZWJ; "।" (danda) ends the identifier before it
+    std::string source = "चर क्\u200Dष = नाम।\nযদি ৰাম€";
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokens();
+    SourceFile file(source);
+    
+    // Columns count code points, so "ৰাম" starts in column 5 of its line
+    if (tokens.size() != 7) return false;
+    return tokens[0].type == TokenType::KW_VAR &&
+           tokens[1].type == TokenType::IDENTIFIER && tokens[1].lexeme(source) == "क्\u200Dष" &&
+           tokens[3].type == TokenType::IDENTIFIER && tokens[3].lexeme(source) == "नाम" &&
+           tokens[4].type == TokenType::KW_IF && file.getLine(tokens[4].offset) == 2 &&
+           tokens[5].type == TokenType::IDENTIFIER && tokens[5].lexeme(source) == "ৰাম" &&
+           file.getLineColumn(tokens[5].offset).line == 2 &&
+           file.getLineColumn(tokens[5].offset).column == 5;
+}
+
+// The decoder accepts well-formed UTF-8 and rejects malformed sequences
+bool testUtf8Decoding() {
+    auto decode = [](const std::string& bytes) {
+        return unicode::decode(bytes.data(), bytes.data() + bytes.size());
+    };
+    
+    return decode("A").codePoint == 'A' && decode("A").length == 1 &&
+           decode("\u0915").codePoint == 0x0915 && decode("\u0915").length == 3 &&
+           decode("\U0001F600").codePoint == 0x1F600 && decode("\U0001F600").length == 4 &&
+           decode("\xC0\x80").length == 0 &&          // overlong
+           decode("\xED\xA0\x80").length == 0 &&      // surrogate
+           decode("\xE0\xA4").length == 0 &&          // truncated
+           unicode::isIdentifierStart(0x0915) &&
+           !unicode::isIdentifierStart(0x094D) &&      // virama
+           unicode::isIdentifierContinue(0x094D) &&
+           unicode::isIdentifierContinue(0x09BC) &&    // Bengali nukta
+           !unicode::isIdentifierContinue(0x0964);     // danda
+}
+
+// Chunked lexing must give exactly the sequential token stream, even when
+// chunk boundaries fall inside multi-line strings and whitespace runs
+bool testParallelLexingMatchesSequential() {
+    std::string source;
+    for (int i = 0; i < 200; i++) {
+        source += "var x" + std::to_string(i) + " = " + std::to_string(i) + ".5; // note\n";
+        if (i % 7 == 0) {
+            source += "var s = \"line one\n    var not_a_token = 1;\n\";\n";
+        }
+        if (i % 11 == 0) {
+            source += "\n\n        अगर (x <= 10) { वापस सत्य; }\n";
+        }
+    }
+    
+    Lexer sequentialLexer(source);
+    std::vector<Token> expected = sequentialLexer.scanTokens();
+    
+    for (unsigned threads : {2u, 3u, 8u, 64u}) {
+        Lexer parallelLexer(source);
+        std::vector<Token> actual = parallelLexer.scanTokensParallel(threads, 64);
+        if (actual.size() != expected.size()) return false;
+        
+        for (size_t i = 0; i < expected.size(); i++) {
+            if (actual[i].type != expected[i].type ||
+                actual[i].language != expected[i].language ||
+                actual[i].offset != expected[i].offset ||
+                actual[i].length != expected[i].length ||
+                actual[i].intValue != expected[i].intValue) {
+                return false;
+            }
+        }
+    }
+    
+    return true;
+}
+
+// Every spelling of an identifier maps to one symbol, in any script
+bool testIdentifiersAreInterned() {
+    std::string source = "var total = total + गिनती;\nচৰ = गिनती; totals = total;";
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokens();
+    
+    if (tokens.size() != 16) return false;
+    Symbol total = tokens[1].symbol;
+    Symbol count = tokens[5].symbol;
+    return total != noSymbol && count != noSymbol && total != count &&
+           tokens[3].symbol == total &&
+           tokens[9].symbol == count &&
+           tokens[13].symbol == total &&
+           tokens[11].symbol != total &&
+           tokens[7].symbol != count &&
+           Interner::global().name(count) == "गिनती" &&
+           Interner::global().name(tokens[7].symbol) == "চৰ" &&
+           Interner::global().intern("totals") == tokens[11].symbol &&
+           Interner::global().limit() > tokens[11].symbol;
+}
+
+bool sameTokens(const std::vector<Token>& actual, const std::vector<Token>& expected) {
+    if (actual.size() != expected.size()) return false;
+    for (size_t i = 0; i < expected.size(); i++) {
+        if (actual[i].type != expected[i].type ||
+            actual[i].language != expected[i].language ||
+            actual[i].offset != expected[i].offset ||
+            actual[i].length != expected[i].length ||
+            actual[i].intValue != expected[i].intValue) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Re-lexing after each edit must give exactly what lexing the edited text
+// from scratch gives, including the offsets of the tokens after the edit
+bool testIncrementalRelex() {
+    struct Step {
+        std::string find;
+        size_t removed;
+        std::string inserted;
+    };
+    const Step steps[] = {
+        {"count", 0, "total_"},            // extend an identifier
+        {"1;", 1, "1."},                   // "1." before ';' is not a float yet
+        {".;", 1, ".5"},                   // now it is
+        {"var y", 0, "// "},               // comment out a line
+        {"// ", 3, ""},                    // and back
+        {"var y", 0, "\n\n"},              // shift every line below
+        {"while", 0, "var s = \"a\nb\";\n"}, // multi-line string
+        {"while", 5, "जबतक"},              // switch the keyword's language
+        {"जबतक", 0, "x"},                  // which turns it into an identifier
+        {"total_count", 11, "n"},          // shrink
+    };
+    
+    std::string text = "var total_count = 1;\nvar y = 2.0;\nwhile (y < 10) { y = y + 1; }\n";
+    Lexer lexer(text);
+    TokenBuffer tokens(lexer.scanTokens());
+    
+    for (const Step& step : steps) {
+        size_t offset = text.find(step.find);
+        if (offset == std::string::npos) return false;
+        
+        text.replace(offset, step.removed, step.inserted);
+        RelexRange range = Lexer::relex(tokens, text, {offset, step.removed, step.inserted});
+        
+        // Only the neighbourhood of the edit is lexed again
+        if (range.newEnd + 1 >= tokens.size()) return false;
+        
+        if (!sameTokens(tokens.toVector(), Lexer(text).scanTokens())) return false;
+    }
+    
+    return true;
+}
+
+// Edits of a buffer many chunks long: inside one chunk, across several,
+// large pastes and deletions, all still giving what a full lex gives
+bool testRelexAcrossChunks() {
+    std::string text;
+    for (int i = 0; i < 2000; i++) {
+        text += "var v" + std::to_string(i) + " = " + std::to_string(i) + " + 1.5;\n";
+    }
+    TokenBuffer tokens(Lexer(text).scanTokens());
+    
+    std::string paste;
+    for (int i = 0; i < 300; i++) paste += "x = x * 2;\n";
+    
+    uint32_t seed = 12345;
+    auto next = [&](size_t bound) {
+        seed = seed * 1103515245 + 12345;
+        return static_cast<size_t>(seed >> 8) % bound;
+    };
+    for (int step = 0; step < 200; step++) {
+        size_t offset = next(text.size());
+        size_t removed = std::min(text.size() - offset, step % 10 == 0 ? next(20000) : next(12));
+        std::string inserted = step % 17 == 0 ? paste : std::string("(){} ab 7.5", 0, next(12));
+        
+        text.replace(offset, removed, inserted);
+        Lexer::relex(tokens, text, {offset, removed, inserted});
+        
+        // The edited text is lexed again here only to check the result
+        if (step % 20 == 0 || step == 199) {
+            if (!sameTokens(tokens.toVector(), Lexer(text).scanTokens())) return false;
+        }
+    }
+    return true;
 }
 
 // Register all lexer tests
@@ -138,4 +415,13 @@ void registerLexerTests() {
     registerTest("lexer", "Hindi Lexing", testHindiLexing);
     registerTest("lexer", "Assamese Lexing", testAssameseLexing);
     registerTest("lexer", "Mixed Language Lexing", testMixedLanguageLexing);
+    registerTest("lexer", "Literal Values", testLiteralValues);
+    registerTest("lexer", "Long Runs Keep Lines", testLongRunsKeepLines);
+    registerTest("lexer", "Keyword Languages", testKeywordLanguages);
+    registerTest("lexer", "Unicode Identifier Boundaries", testUnicodeIdentifierBoundaries);
+    registerTest("lexer", "UTF-8 Decoding", testUtf8Decoding);
+    registerTest("lexer", "Parallel Lexing Matches Sequential", testParallelLexingMatchesSequential);
+    registerTest("lexer", "Identifiers Are Interned", testIdentifiersAreInterned);
+    registerTest("lexer", "Incremental Relex", testIncrementalRelex);
+    registerTest("lexer", "Relex Across Chunks", testRelexAcrossChunks);
 }
\ No newline at end of file
@@ -1,8 +1,21 @@
 #include "tribhasha/Lexer.h"
 #include "tribhasha/Parser.h"
+#include "tribhasha/ASTCache.h"
+#include "tribhasha/IncrementalParser.h"
+#include "tribhasha/DeclarationStream.h"
+#include "tribhasha/Resolver.h"
+#include "tribhasha/ConstantEvaluator.h"
+#include "tribhasha/ConstantFolder.h"
+#include "tribhasha/FunctionShape.h"
+#include "tribhasha/PurityAnalysis.h"
+#include "tribhasha/TypeInference.h"
 #include <iostream>
 #include <functional>
 #include <cassert>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 
 using namespace tribhasha;
 
@@ -12,7 +25,9 @@ bool testParsingSuccess(const std::string& source) {
         Lexer lexer(source);
         std::vector<Token> tokens = lexer.scanTokens();
         
-        Parser parser(tokens);
+        ASTContext astContext;
+        
+        Parser parser(tokens, source, astContext);
         auto statements = parser.parse();
         
         return !statements.empty();
@@ -94,6 +109,952 @@ bool testControlFlowParsing() {
     return testParsingSuccess(source);
 }
 
+// Nodes, child lists and literal text all live in the arena or the source,
+// and the context can be reused once the tree is dropped
+bool testArenaAllocatedAST() {
+    std::string source = "function add(a, b) { var s = \"sum\"; return a + b; } add(1, 2.5);";
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokens();
+    
+    ASTContext astContext;
+    Parser parser(tokens, source, astContext);
+    std::vector<Stmt*> statements = parser.parse();
+    if (statements.size() != 2 || astContext.getBytesAllocated() == 0) return false;
+    
+    auto* function = statements[0]->as<FunctionStmt>();
+    auto* call = statements[1]->as<ExpressionStmt>();
+    if (!function || !call || function->params.size() != 2 || function->body.size() != 2) return false;
+    
+    auto* var = function->body[0]->as<VarStmt>();
+    auto* text = var ? var->initializer->as<LiteralExpr>() : nullptr;
+    auto* callExpr = call->expression->as<CallExpr>();
+    if (!text || text->value != "sum" || text->value.data() != source.data() + source.find("sum")) return false;
+    if (!callExpr || callExpr->arguments.size() != 2) return false;
+    
+    astContext.reset();
+    return astContext.getBytesAllocated() == 0 &&
+           Parser(tokens, source, astContext).parse().size() == 2;
+}
+
+// Precedence and associativity come from the binding-power table; check
+// the shape of the tree rather than just that it parses
+bool testOperatorPrecedence() {
+    std::string source = "x = y = -a + b * c(d, e) < 2 and not f or g;";
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokens();
+    
+    ASTContext astContext;
+    std::vector<Stmt*> statements = Parser(tokens, source, astContext).parse();
+    auto* stmt = statements.size() == 1 ? statements[0]->as<ExpressionStmt>() : nullptr;
+    if (!stmt) return false;
+    
+    // x = (y = (((-a + (b * c(d, e))) < 2 and not f) or g))
+    auto* outer = stmt->expression->as<AssignExpr>();
+    auto* inner = outer ? outer->value->as<AssignExpr>() : nullptr;
+    auto* orExpr = inner ? inner->value->as<LogicalExpr>() : nullptr;
+    if (!orExpr || orExpr->op.type != TokenType::KW_OR) return false;
+    
+    auto* andExpr = orExpr->left->as<LogicalExpr>();
+    if (!andExpr || andExpr->op.type != TokenType::KW_AND) return false;
+    if (!andExpr->right->is<UnaryExpr>()) return false;
+    
+    auto* less = andExpr->left->as<BinaryExpr>();
+    auto* plus = less ? less->left->as<BinaryExpr>() : nullptr;
+    if (!plus || less->op.type != TokenType::LESS || plus->op.type != TokenType::PLUS) return false;
+    
+    auto* times = plus->right->as<BinaryExpr>();
+    auto* call = times ? times->right->as<CallExpr>() : nullptr;
+    return plus->left->is<UnaryExpr>() && call && call->arguments.size() == 2;
+}
+
+// Expressions are parsed without recursion, so their size is bounded by
+// memory rather than by the native stack
+bool testDeepExpressions() {
+    const int depth = 200000;
+    
+    std::string chain = "var x = 1";
+    for (int i = 0; i < depth; i++) chain += " + 1";
+    chain += ";";
+    
+    std::string nested = "var y = " + std::string(depth, '(') + "1" + std::string(depth, ')') + ";";
+    
+    std::string calls = "f(";
+    for (int i = 0; i < depth / 4; i++) calls += "g(";
+    calls += std::string(depth / 4, ')') + ");";
+    
+    std::string negations = "var z = " + std::string(depth, '-') + "1;";
+    
+    return testParsingSuccess(chain) && testParsingSuccess(nested) &&
+           testParsingSuccess(calls) && testParsingSuccess(negations);
+}
+
+// A pass with typed results: counts nodes (int) and reports the deepest
+// statement nesting (size_t), all without casts
+class NodeCounter : public ASTVisitor<NodeCounter, int, size_t> {
+public:
+    int visitBinaryExpr(BinaryExpr* expr) { return 1 + visit(expr->left) + visit(expr->right); }
+    int visitLogicalExpr(LogicalExpr* expr) { return 1 + visit(expr->left) + visit(expr->right); }
+    int visitGroupingExpr(GroupingExpr* expr) { return 1 + visit(expr->expression); }
+    int visitLiteralExpr(LiteralExpr*) { return 1; }
+    int visitUnaryExpr(UnaryExpr* expr) { return 1 + visit(expr->right); }
+    int visitVariableExpr(VariableExpr*) { return 1; }
+    int visitAssignExpr(AssignExpr* expr) { return 1 + visit(expr->value); }
+    int visitCallExpr(CallExpr* expr) {
+        int count = 1 + visit(expr->callee);
+        for (Expr* argument : expr->arguments) count += visit(argument);
+        return count;
+    }
+    
+    size_t visitExpressionStmt(ExpressionStmt* stmt) { expressions += visit(stmt->expression); return 1; }
+    size_t visitVarStmt(VarStmt* stmt) { if (stmt->initializer) expressions += visit(stmt->initializer); return 1; }
+    size_t visitBlockStmt(BlockStmt* stmt) { return 1 + deepest(stmt->statements); }
+    size_t visitIfStmt(IfStmt* stmt) {
+        expressions += visit(stmt->condition);
+        size_t depth = visit(stmt->thenBranch);
+        if (stmt->elseBranch) depth = std::max(depth, visit(stmt->elseBranch));
+        return 1 + depth;
+    }
+    size_t visitWhileStmt(WhileStmt* stmt) { expressions += visit(stmt->condition); return 1 + visit(stmt->body); }
+    size_t visitFunctionStmt(FunctionStmt* stmt) { return 1 + deepest(stmt->body); }
+    size_t visitReturnStmt(ReturnStmt* stmt) { if (stmt->value) expressions += visit(stmt->value); return 1; }
+    
+    size_t deepest(Span<Stmt*> statements) {
+        size_t depth = 0;
+        for (Stmt* statement : statements) depth = std::max(depth, visit(statement));
+        return depth;
+    }
+    
+    int expressions = 0;
+};
+
+bool testTypedVisitor() {
+    std::string source = "function f(n) { while (n > 0) { if (n == 3 or n == 5) { print(n); } n = n - 1; } return (n); }";
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokens();
+    
+    ASTContext astContext;
+    std::vector<Stmt*> statements = Parser(tokens, source, astContext).parse();
+    if (statements.size() != 1 || !statements[0]->is<FunctionStmt>()) return false;
+    
+    // function > while > block > if > block > print
+    NodeCounter counter;
+    size_t depth = counter.visit(statements[0]);
+    return depth == 6 && counter.expressions == 19;
+}
+
+// Errors are collected rather than thrown; each failed declaration is
+// reported once and dropped, and parsing picks up at the next statement
+bool testParseDiagnostics() {
+    std::string source = "var a = 1;\nvar = 2;\nprint(a +);\n1 = a;\nfunction f(a { }\nvar b = (a;\nvar c = 3;";
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokens();
+    
+    ASTContext astContext;
+    Parser parser(tokens, source, astContext);
+    std::vector<Stmt*> statements = parser.parse();
+    
+    // The invalid assignment is reported but keeps its statement
+    if (statements.size() != 3 || !parser.hadError()) return false;
+    
+    const std::vector<Diagnostic>& diagnostics = parser.getDiagnostics().all();
+    if (diagnostics.size() != 5) return false;
+    if (diagnostics[0].message != "Expected variable name." ||
+        diagnostics[0].offset != source.find("= 2")) return false;
+    if (diagnostics[1].message != "Expected expression." ||
+        diagnostics[1].offset != source.find(");")) return false;
+    if (diagnostics[2].message != "Invalid assignment target.") return false;
+    if (diagnostics[3].message != "Expected ')' after parameters.") return false;
+    if (diagnostics[4].message != "Expected ')' after expression.") return false;
+    
+    std::string text = parser.getDiagnostics().format(SourceFile(source));
+    return text.rfind("[line 2, column 5] Error at '=': Expected variable name.\n", 0) == 0 &&
+           text.find("[line 6, column 11] Error at ';': Expected ')' after expression.\n") != std::string::npos;
+}
+
+// Thousands of bad statements in a row, each recovered from at its ';'
+bool testManyParseErrors() {
+    const int count = 20000;
+    std::string source;
+    for (int i = 0; i < count; i++) source += "var = ) ; x = 1;\n";
+    source += "var y = (";
+    
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokens();
+    
+    ASTContext astContext;
+    Parser parser(tokens, source, astContext);
+    std::vector<Stmt*> statements = parser.parse();
+    
+    const std::vector<Diagnostic>& diagnostics = parser.getDiagnostics().all();
+    return statements.size() == count && diagnostics.size() == count + 1 &&
+           diagnostics.back().offset == source.size() && diagnostics.back().length == 0;
+}
+
+// Flattens a tree into node kinds and token offsets, for comparing parses
+class TreeShape : public ASTVisitor<TreeShape> {
+public:
+    // A top-level statement, whose token offsets count from its base
+    void statement(Stmt* stmt) {
+        base = stmt->base;
+        visit(stmt);
+    }
+    
+    void node(char kind, uint32_t offset = 0) {
+        shape += kind;
+        shape += std::to_string(offset);
+    }
+    void type(ValueType declared) { shape += ':'; shape += std::to_string(static_cast<int>(declared)); }
+    
+    void visitBinaryExpr(BinaryExpr* expr) { node('b', base + expr->op.offset); visit(expr->left); visit(expr->right); }
+    void visitLogicalExpr(LogicalExpr* expr) { node('l', base + expr->op.offset); visit(expr->left); visit(expr->right); }
+    void visitGroupingExpr(GroupingExpr* expr) { node('g'); visit(expr->expression); }
+    void visitLiteralExpr(LiteralExpr* expr) { node('#'); shape += expr->value; }
+    void visitUnaryExpr(UnaryExpr* expr) { node('u', base + expr->op.offset); visit(expr->right); }
+    void visitVariableExpr(VariableExpr* expr) { node('v', base + expr->name.offset); }
+    void visitAssignExpr(AssignExpr* expr) { node('a', base + expr->name.offset); visit(expr->value); }
+    void visitCallExpr(CallExpr* expr) {
+        node('c', base + expr->paren.offset);
+        visit(expr->callee);
+        for (Expr* argument : expr->arguments) visit(argument);
+    }
+    
+    void visitExpressionStmt(ExpressionStmt* stmt) { node('E'); visit(stmt->expression); }
+    void visitVarStmt(VarStmt* stmt) {
+        node('V', base + stmt->name.offset);
+        type(stmt->declaredType);
+        if (stmt->initializer) visit(stmt->initializer);
+    }
+    void visitBlockStmt(BlockStmt* stmt) { node('B'); for (Stmt* s : stmt->statements) visit(s); }
+    void visitIfStmt(IfStmt* stmt) {
+        node('I');
+        visit(stmt->condition);
+        visit(stmt->thenBranch);
+        if (stmt->elseBranch) visit(stmt->elseBranch);
+    }
+    void visitWhileStmt(WhileStmt* stmt) { node('W'); visit(stmt->condition); visit(stmt->body); }
+    void visitFunctionStmt(FunctionStmt* stmt) {
+        node('F', base + stmt->name.offset);
+        type(stmt->declaredReturnType);
+        for (size_t i = 0; i < stmt->params.size(); i++) {
+            node('p', base + stmt->params[i].offset);
+            type(stmt->declaredParamTypes[i]);
+        }
+        for (Stmt* s : stmt->body) visit(s);
+    }
+    void visitReturnStmt(ReturnStmt* stmt) { node('R'); if (stmt->value) visit(stmt->value); }
+    
+    uint32_t base = 0;
+    std::string shape;
+};
+
+// Parse on one thread and on several; the trees and the diagnostics must
+// come out the same
+bool sameParallelParse(const std::string& source) {
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokens();
+    
+    ASTContext sequentialContext;
+    Parser sequential(tokens, source, sequentialContext);
+    TreeShape expected;
+    for (Stmt* statement : sequential.parse()) expected.visit(statement);
+    
+    for (unsigned threads : {2u, 3u, 8u}) {
+        ASTContext context;
+        Parser parallel(tokens, source, context);
+        TreeShape actual;
+        for (Stmt* statement : parallel.parseParallel(threads, 16)) actual.visit(statement);
+        if (actual.shape != expected.shape) return false;
+        
+        const auto& want = sequential.getDiagnostics().all();
+        const auto& got = parallel.getDiagnostics().all();
+        if (want.size() != got.size()) return false;
+        for (size_t i = 0; i < want.size(); i++) {
+            if (want[i].offset != got[i].offset || want[i].message != got[i].message) return false;
+        }
+    }
+    return !expected.shape.empty();
+}
+
+bool testParallelParsing() {
+    std::string clean;
+    for (int i = 0; i < 300; i++) {
+        std::string n = std::to_string(i);
+        clean += "function f" + n + "(a, b) { if (a > b) { return a - b; } else { return b * " + n + "; } }\n";
+        clean += "फलन ग" + n + "(n) { जबतक (n > 0) { n = n - 1; } वापस n; }\n";
+        clean += "var v" + n + " = f" + n + "(" + n + ", 2) + 1;\n";
+        clean += "if (v" + n + " == 3) { print(v" + n + "); } else print(0);\n";
+        clean += "for (var i = 0; i < 3; i = i + 1) { print(i); }\n";
+    }
+    
+    // Errors inside chunks, on chunk boundaries and an unclosed brace that
+    // runs to the end; all must be reported as the sequential parser does
+    std::string broken = clean;
+    broken.insert(broken.find("var v17"), "var = 1;\n");
+    broken.insert(broken.find("function f120"), "print(1 +;\n");
+    broken.insert(broken.find("if (v200"), "function h( { }\n");
+    broken.insert(broken.find("function f250"), "function open() { var x = 1;\n");
+    
+    return sameParallelParse(clean) && sameParallelParse(broken);
+}
+
+// A cached AST decodes to the same tree and token stream, and a cache is
+// never used for different text or when its bytes are damaged
+bool testASTCacheRoundTrip() {
+    std::string source = R"(
+        function fib(n) { if (n < 2 and not (n < 0)) { return n; } return fib(n - 1) + fib(n - 2); }
+        फलन घटाव(a, b) { वापस a - b; }
+        फलन दशमलव आधा(पूर्णांक a) { वापस a / 2; }
+        bool flag = false; string name = "n";
+        var s = "text"; var f = 2.5; var big = 123456789012;
+        for (var i = 0; i < 10; i = i + 1) { print(fib(i), घटाव(i, 1)); }
+        if (true) s = f; else { return; }
+    )";
+    std::string path = (std::filesystem::temp_directory_path() / "tribhasha_test.tri.astcache").string();
+    
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokens();
+    ASTContext context;
+    std::vector<Stmt*> statements = Parser(tokens, source, context).parse();
+    if (!writeASTCache(path, source, tokens, statements)) return false;
+    
+    TreeShape expected;
+    for (Stmt* statement : statements) expected.visit(statement);
+    
+    auto cache = ASTCacheReader::open(path, source);
+    if (!cache || cache->getStatementCount() != statements.size()) return false;
+    
+    // Lazily, last statement first
+    ASTContext cachedContext;
+    Stmt* last = cache->decodeStatement(statements.size() - 1, cachedContext);
+    if (!last || !last->is<IfStmt>()) return false;
+    
+    std::vector<Stmt*> cached;
+    std::vector<Token> cachedTokens;
+    if (!cache->decodeStatements(cachedContext, cached) || !cache->decodeTokens(cachedTokens)) return false;
+    
+    TreeShape actual;
+    for (Stmt* statement : cached) actual.visit(statement);
+    if (actual.shape != expected.shape || cachedTokens.size() != tokens.size()) return false;
+    for (size_t i = 0; i < tokens.size(); i++) {
+        const Token& a = tokens[i];
+        const Token& b = cachedTokens[i];
+        if (a.type != b.type || a.language != b.language || a.offset != b.offset || a.length != b.length) return false;
+        if (a.type == TokenType::IDENTIFIER ? a.symbol != b.symbol : a.intValue != b.intValue) return false;
+    }
+    
+    // Any change to the text makes the cache stale
+    std::string edited = source;
+    edited[source.find("10")] = '2';
+    if (ASTCacheReader::open(path, edited)) return false;
+    
+    // A damaged byte anywhere in the file means it is not used at all
+    std::string bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    bool ok = true;
+    for (size_t i = 0; i < bytes.size() && ok; i++) {
+        std::string damaged = bytes;
+        damaged[i] = static_cast<char>(damaged[i] ^ (1 << i % 8));
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << damaged;
+        ok = !ASTCacheReader::open(path, source);
+    }
+    
+    std::remove(path.c_str());
+    return ok;
+}
+
+// After each edit the incremental parse must match a full parse of the new
+// text, offsets and diagnostics included, and only the edited declarations
+// may be parsed again
+bool testIncrementalReparse() {
+    struct Step {
+        std::string find;
+        size_t removed;
+        std::string inserted;
+        size_t changed;
+    };
+    const Step steps[] = {
+        {"a - b", 5, "a + b + 1", 1},               // edit inside a function
+        {"var total", 0, "\n\n// note\n", 0},      // shift everything below
+        {"फलन", 0, "var z = 3.5; ", 1},             // insert a declaration
+        {"print(\"x\")", 0, "(", 0},               // break one
+        {"(print", 1, "", 1},                        // and mend it
+        {"if (total", 0, "", 0},                     // reorder nothing, no-op
+        {"; } else", 0, " x", 0},                    // error inside an if
+        {" x; } else", 2, "", 1},
+        {"var z = 3.5; ", 13, "", 0},                // remove it again
+    };
+    
+    std::string text =
+        "function sub(a, b) { return a - b; }\n"
+        "फलन जोड़(a, b) { वापस a + b; }\n"
+        "var total = sub(5, 2);\n"
+        "if (total > 1) { print(\"x\"); } else { total = 0; }\n"
+        "for (var i = 0; i < 3; i = i + 1) { print(i); }\n"
+        "var w = missing;\n";
+    
+    // Each version is overwritten and freed once the next one is parsed,
+    // to show that reused nodes no longer look at the old text
+    auto version = std::make_unique<std::string>(text);
+    
+    IncrementalParser incremental;
+    {
+        Lexer lexer(*version);
+        std::vector<Token> tokens = lexer.scanTokens();
+        ParseUpdate update = incremental.update(*version, tokens);
+        if (update.changed.size() != incremental.getStatements().size()) return false;
+    }
+    
+    for (const Step& step : steps) {
+        size_t offset = text.find(step.find);
+        if (offset == std::string::npos) return false;
+        text.replace(offset, step.removed, step.inserted);
+        
+        std::fill(version->begin(), version->end(), '?');
+        version = std::make_unique<std::string>(text);
+        const std::string& source = *version;
+        
+        Lexer lexer(source);
+        std::vector<Token> tokens = lexer.scanTokens();
+        size_t before = incremental.getStatements().size();
+        ParseUpdate update = incremental.update(source, tokens);
+        
+        ASTContext context;
+        Parser full(tokens, source, context);
+        TreeShape expected;
+        std::vector<Stmt*> fullStatements = full.parse();
+        for (Stmt* statement : fullStatements) expected.visit(statement);
+        TreeShape actual;
+        for (Stmt* statement : incremental.getStatements()) actual.statement(statement);
+        if (actual.shape != expected.shape) return false;
+        
+        const auto& want = full.getDiagnostics().all();
+        const auto& got = incremental.getDiagnostics().all();
+        if (want.size() != got.size()) return false;
+        for (size_t i = 0; i < want.size(); i++) {
+            if (want[i].offset != got[i].offset || want[i].message != got[i].message) return false;
+        }
+        
+        // Later passes place their diagnostics by each statement's base
+        Resolver fullResolver;
+        fullResolver.resolve(fullStatements);
+        Resolver incrementalResolver;
+        incrementalResolver.resolve(incremental.getStatements());
+        const auto& unresolved = incrementalResolver.getDiagnostics().all();
+        if (unresolved.size() != 1 || unresolved[0].offset != fullResolver.getDiagnostics().all()[0].offset) {
+            return false;
+        }
+        
+        // Statements that were not reused are reported on both sides
+        size_t after = incremental.getStatements().size();
+        if (update.changed.size() != step.changed || before - update.removed.size() != after - update.changed.size()) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
+// Streaming one declaration at a time gives the statements of a whole-file
+// parse, and never holds more than one declaration's tokens
+bool testDeclarationStream() {
+    std::string source = R"(
+        function f(a, b) { if (a > b) { return a; } else { return b; } }
+        if (f(1, 2) == 2) print(1); else if (true) { print(2); } else print(3);
+        for (var i = 0; i < 3; i = i + 1) { print(i); }
+        चर x = (1 + 2) * 3; { var y = x; }
+        while (x > 0) x = x - 1;
+    )";
+    
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokens();
+    ASTContext context;
+    TreeShape expected;
+    for (Stmt* statement : Parser(tokens, source, context).parse()) expected.visit(statement);
+    
+    Lexer streamLexer(source);
+    DeclarationStream stream(streamLexer, source);
+    ASTContext streamContext;
+    std::vector<Stmt*> statements;
+    TreeShape actual;
+    size_t declarations = 0;
+    while (stream.next(streamContext, statements)) {
+        for (Stmt* statement : statements) actual.visit(statement);
+        statements.clear();
+        streamContext.reset();
+        declarations++;
+    }
+    
+    return !stream.hadError() && declarations == 6 && actual.shape == expected.shape &&
+           streamLexer.nextToken().type == TokenType::END_OF_FILE;
+}
+
+// Every variable gets a slot in its function's frame: shadowing takes a new
+// slot, a function starts from slot 0 with its parameters, and a name used
+// outside its scope is an error
+bool testResolverSlots() {
+    std::string source = R"(
+        var a = 1;
+        { var a = a + 1; print(a); }
+        print(a);
+        function f(x, y) { var z = x; return z + y; }
+    )";
+    
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokens();
+    ASTContext context;
+    std::vector<Stmt*> statements = Parser(tokens, source, context).parse();
+    Resolver resolver;
+    resolver.resolve(statements);
+    if (resolver.hadError() || statements.size() != 4) return false;
+    
+    auto printed = [](Stmt* statement) {
+        return statement->as<ExpressionStmt>()->expression->as<CallExpr>()->arguments[0]->as<VariableExpr>();
+    };
+    VarStmt* outer = statements[0]->as<VarStmt>();
+    BlockStmt* block = statements[1]->as<BlockStmt>();
+    VarStmt* inner = block->statements[0]->as<VarStmt>();
+    FunctionStmt* function = statements[3]->as<FunctionStmt>();
+    VarStmt* z = function->body[0]->as<VarStmt>();
+    BinaryExpr* sum = function->body[1]->as<ReturnStmt>()->value->as<BinaryExpr>();
+    
+    bool slots = outer->slot == 0 && inner->slot == 1 &&
+                 inner->initializer->as<BinaryExpr>()->left->as<VariableExpr>()->slot == 0 &&
+                 printed(block->statements[1])->slot == 1 && printed(statements[2])->slot == 0 &&
+                 resolver.getMainSlotCount() == 2;
+    bool frame = function->slotCount == 3 && z->slot == 2 &&
+                 z->initializer->as<VariableExpr>()->slot == 0 &&
+                 sum->left->as<VariableExpr>()->slot == 2 && sum->right->as<VariableExpr>()->slot == 1;
+    
+    // `a` is top-level, so not visible in g; `b` is out of scope after its block
+    std::string bad = "var a = 1; function g() { return a; } { var b = 2; } print(b);";
+    Lexer badLexer(bad);
+    std::vector<Token> badTokens = badLexer.scanTokens();
+    ASTContext badContext;
+    Resolver badResolver;
+    badResolver.resolve(Parser(badTokens, bad, badContext).parse());
+    
+    return slots && frame && badResolver.getDiagnostics().size() == 2;
+}
+
+// Integers stay integers through calls and loops, division gives a Float
+// (which `mixed` then passes back to half), and a parameter nothing is
+// known about is a Float
+bool testTypeInference() {
+    std::string source = R"(
+        function fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }
+        function half(x) { return x / 2; }
+        function unused(y) { return y; }
+        var total = 0;
+        for (var i = 0; i < 10; i = i + 1) { total = total + fib(i); }
+        var done = not (total > 1);
+        var mixed = 1;
+        mixed = half(mixed);
+    )";
+    
+    auto infer = [&](bool open, ASTContext& context) {
+        Lexer lexer(source);
+        std::vector<Token> tokens = lexer.scanTokens();
+        std::vector<Stmt*> statements = Parser(tokens, source, context).parse();
+        Resolver resolver;
+        resolver.resolve(statements);
+        TypeInference inference(open);
+        if (open) {
+            for (Stmt* statement : statements) inference.infer({statement});
+        } else {
+            inference.infer(statements);
+        }
+        return statements;
+    };
+    
+    ASTContext context;
+    std::vector<Stmt*> statements = infer(false, context);
+    FunctionStmt* fib = statements[0]->as<FunctionStmt>();
+    FunctionStmt* half = statements[1]->as<FunctionStmt>();
+    FunctionStmt* unused = statements[2]->as<FunctionStmt>();
+    VarStmt* counter = statements[4]->as<BlockStmt>()->statements[0]->as<VarStmt>();
+    
+    bool whole = fib->paramTypes[0] == ValueType::Int && fib->returnType == ValueType::Int &&
+                 half->paramTypes[0] == ValueType::Float && half->returnType == ValueType::Float &&
+                 unused->paramTypes[0] == ValueType::Float && unused->returnType == ValueType::Float &&
+                 statements[3]->as<VarStmt>()->valueType == ValueType::Int &&
+                 counter->valueType == ValueType::Int &&
+                 statements[5]->as<VarStmt>()->valueType == ValueType::Bool &&
+                 statements[6]->as<VarStmt>()->valueType == ValueType::Float;
+    
+    // Compiled a declaration at a time, later calls cannot change a
+    // signature, and top-level numbers stay Floats
+    ASTContext openContext;
+    statements = infer(true, openContext);
+    fib = statements[0]->as<FunctionStmt>();
+    counter = statements[4]->as<BlockStmt>()->statements[0]->as<VarStmt>();
+    bool open = fib->paramTypes[0] == ValueType::Float && fib->returnType == ValueType::Float &&
+                statements[3]->as<VarStmt>()->valueType == ValueType::Float &&
+                counter->valueType == ValueType::Int &&
+                statements[5]->as<VarStmt>()->valueType == ValueType::Float;
+    
+    return whole && open;
+}
+
+// Declared types are kept as written, in any of the languages, and whatever
+// does not fit one is reported
+bool testTypeAnnotations() {
+    std::string source = R"(
+        function int add(int a, b) { var c = b; return a + 1; }
+        পূৰ্ণসংখ্যা y = 20;
+        y = add(1, 2);
+        वाक्य s = "x";
+        float f = 1;
+    )";
+    
+    auto infer = [](const std::string& text, bool open, ASTContext& context, Diagnostics& diagnostics) {
+        Lexer lexer(text);
+        std::vector<Token> tokens = lexer.scanTokens();
+        std::vector<Stmt*> statements = Parser(tokens, text, context).parse();
+        Resolver resolver;
+        resolver.resolve(statements);
+        TypeInference inference(open);
+        if (open) {
+            for (Stmt* statement : statements) inference.infer({statement});
+        } else {
+            inference.infer(statements);
+        }
+        diagnostics = inference.getDiagnostics();
+        return statements;
+    };
+    
+    ASTContext context;
+    Diagnostics diagnostics;
+    std::vector<Stmt*> statements = infer(source, false, context, diagnostics);
+    if (statements.size() != 5) return false;
+    FunctionStmt* add = statements[0]->as<FunctionStmt>();
+    bool declared = add->declaredReturnType == ValueType::Int &&
+                    add->declaredParamTypes[0] == ValueType::Int &&
+                    add->declaredParamTypes[1] == ValueType::Unknown &&
+                    statements[1]->as<VarStmt>()->declaredType == ValueType::Int &&
+                    statements[3]->as<VarStmt>()->declaredType == ValueType::String;
+    
+    // b is inferred from the call; an Int fits the Float f
+    bool typed = diagnostics.size() == 0 && add->paramTypes[0] == ValueType::Int &&
+                 add->paramTypes[1] == ValueType::Int && add->returnType == ValueType::Int &&
+                 statements[4]->as<VarStmt>()->valueType == ValueType::Float;
+    
+    // Compiled a declaration at a time, only the undeclared b widens
+    ASTContext openContext;
+    statements = infer(source, true, openContext, diagnostics);
+    add = statements[0]->as<FunctionStmt>();
+    bool open = diagnostics.size() == 0 && add->paramTypes[0] == ValueType::Int &&
+                add->paramTypes[1] == ValueType::Float &&
+                statements[1]->as<VarStmt>()->valueType == ValueType::Int;
+    
+    std::string bad = R"(
+        int y = 20;
+        y = "world";
+        function bool positive(int n) { return n; }
+        positive(1.5);
+        var x = 10;
+        x = "hello";
+        function echo(a) { return a; }
+        echo(1);
+        echo("s");
+    )";
+    ASTContext badContext;
+    infer(bad, false, badContext, diagnostics);
+    
+    // Without a declared type, a string and a number still do not mix
+    bool reported = diagnostics.size() == 5 &&
+                    diagnostics.all()[0].message == "Expected int, got string." &&
+                    diagnostics.all()[3].message == "Cannot mix string and int values." &&
+                    diagnostics.all()[4].message == "Cannot mix string and int values.";
+    
+    // Nor when the number was compiled before the string was seen
+    ASTContext mixedContext;
+    infer("var x = 10;\nx = \"hello\";", true, mixedContext, diagnostics);
+    reported = reported && diagnostics.size() == 1 &&
+               diagnostics.all()[0].message == "Cannot mix float and string values.";
+    
+    return declared && typed && open && reported;
+}
+
+// Constants are folded and propagated and dead branches dropped, without
+// touching the parsed trees; a remainder by zero and a branch that defines
+// a function are left alone
+bool testConstantFolding() {
+    std::string source = R"(
+        var debug = false;
+        var base = 2 * 3 + 1;
+        var n = 0;
+        n = base * 2;
+        if (debug) { n = 1; } else { n = n + 1; }
+        while (debug and n > 0) { n = n - 1; }
+        print(9223372036854775807 + 1, -(7 / 2));
+        var trap = 5 % 0;
+        function g() { if (false) { function h() { return 1; } } return h(); }
+    )";
+    
+    auto fold = [&](bool open, ASTContext& context) {
+        Lexer lexer(source);
+        std::vector<Token> tokens = lexer.scanTokens();
+        std::vector<Stmt*> statements = Parser(tokens, source, context).parse();
+        Resolver resolver;
+        resolver.resolve(statements);
+        std::vector<Stmt*> parsed = statements;
+        TypeInference inference(open);
+        PurityAnalysis purity;
+        ConstantFolder folder(open);
+        if (open) {
+            std::vector<Stmt*> folded;
+            for (Stmt* statement : parsed) {
+                std::vector<Stmt*> declaration{statement};
+                inference.infer(declaration);
+                purity.analyze(declaration);
+                folder.fold(declaration, context);
+                folded.insert(folded.end(), declaration.begin(), declaration.end());
+            }
+            statements = folded;
+        } else {
+            inference.infer(statements);
+            purity.analyze(statements);
+            folder.fold(statements, context);
+        }
+        return std::make_pair(parsed, statements);
+    };
+    auto literal = [](Expr* expr) { return expr ? expr->as<LiteralExpr>() : nullptr; };
+    
+    ASTContext context;
+    auto [parsed, statements] = fold(false, context);
+    if (statements.size() != 6) return false;
+    
+    // debug and base are gone; n is assigned, so it stays
+    AssignExpr* assign = statements[1]->as<ExpressionStmt>()->expression->as<AssignExpr>();
+    BlockStmt* taken = statements[2]->as<BlockStmt>();
+    Span<Expr*> printed = statements[3]->as<ExpressionStmt>()->expression->as<CallExpr>()->arguments;
+    bool folded = statements[0]->is<VarStmt>() && literal(assign->value) &&
+                  literal(assign->value)->intValue == 14 &&
+                  taken && taken->statements.size() == 1 &&
+                  literal(printed[0]) && literal(printed[0])->intValue == INT64_MIN &&
+                  literal(printed[1]) && literal(printed[1])->type == TokenType::FLOAT_LITERAL &&
+                  literal(printed[1])->floatValue == -3.5 &&
+                  statements[4]->as<VarStmt>()->initializer->is<BinaryExpr>() &&
+                  statements[5]->as<FunctionStmt>()->body.size() == 2;
+    
+    // The parsed trees are as they were
+    bool untouched = parsed.size() == 9 &&
+                     parsed[3]->as<ExpressionStmt>()->expression->as<AssignExpr>()->value->is<BinaryExpr>() &&
+                     parsed[4]->is<IfStmt>();
+    
+    // A declaration at a time, top-level variables are kept and their
+    // values are Floats
+    ASTContext openContext;
+    auto [openParsed, openStatements] = fold(true, openContext);
+    assign = openStatements[3]->as<ExpressionStmt>()->expression->as<AssignExpr>();
+    bool open = openStatements.size() == 8 && openStatements[0]->is<VarStmt>() &&
+                literal(assign->value) && literal(assign->value)->type == TokenType::FLOAT_LITERAL &&
+                literal(assign->value)->floatValue == 14.0 && openStatements[4]->is<BlockStmt>();
+    
+    // Once n is assigned, later declarations read it again
+    BlockStmt* openTaken = openStatements[4]->as<BlockStmt>();
+    open = open && openTaken->statements[0]->as<ExpressionStmt>()->expression
+                       ->as<AssignExpr>()->value->is<BinaryExpr>();
+    
+    return folded && untouched && open;
+}
+
+// Calls to pure functions with constant arguments are replaced by their
+// results, computed in the program's types; calls that print, loop for
+// ever or get a variable are left alone
+bool testCompileTimeEvaluation() {
+    std::string source = R"(
+        function fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }
+        function fact(n) { var r = 1; while (n > 1) { r = r * n; n = n - 1; } return r; }
+        function half(x) { return x / 2; }
+        function shout(x) { print(x); return x; }
+        function spin(n) { while (true) { n = n + 1; } return n; }
+        var x = 1;
+        x = fib(40);
+        x = fact(25);
+        var h = 0.5;
+        h = half(5);
+        shout(1);
+        spin(0);
+        fib(x);
+    )";
+    
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokens();
+    ASTContext context;
+    std::vector<Stmt*> statements = Parser(tokens, source, context).parse();
+    Resolver resolver;
+    resolver.resolve(statements);
+    TypeInference inference;
+    inference.infer(statements);
+    PurityAnalysis().analyze(statements);
+    ConstantFolder().fold(statements, context);
+    
+    if (statements.size() != 13) return false;
+    auto value = [&](size_t i) {
+        return Constant::of(statements[i]->as<ExpressionStmt>()->expression->as<AssignExpr>()->value);
+    };
+    auto call = [&](size_t i) { return statements[i]->as<ExpressionStmt>()->expression->is<CallExpr>(); };
+    
+    // fact(25) wraps, as the i64 code does
+    bool evaluated = value(6).type == ValueType::Int && value(6).intValue == 102334155 &&
+                     value(7).type == ValueType::Int && value(7).intValue == 7034535277573963776 &&
+                     value(9).type == ValueType::Float && value(9).floatValue == 2.5;
+    bool left = call(10) && call(11) && call(12);
+    
+    return evaluated && left;
+}
+
+// Results stored for a script are read back for exactly its text, and the
+// calls they cover are not run again; a damaged file is not read at all
+bool testStoredEvaluationResults() {
+    std::string source = R"(
+        function fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }
+        var x = 0;
+        x = fib(30);
+        x = fib(31);
+    )";
+    std::string path = (std::filesystem::temp_directory_path() / "tribhasha_test.tri.evalcache").string();
+    std::remove(path.c_str());
+    
+    ASTContext context;
+    auto fold = [&](const std::string& text, ConstantFolder& folder) {
+        Lexer lexer(text);
+        std::vector<Token> tokens = lexer.scanTokens();
+        std::vector<Stmt*> statements = Parser(tokens, text, context).parse();
+        Resolver().resolve(statements);
+        TypeInference().infer(statements);
+        PurityAnalysis().analyze(statements);
+        folder.fold(statements, context);
+        return statements;
+    };
+    auto value = [](const std::vector<Stmt*>& statements, size_t i) {
+        return Constant::of(statements[i]->as<ExpressionStmt>()->expression->as<AssignExpr>()->value);
+    };
+    
+    ConstantFolder first;
+    bool none = !first.getEvaluator().loadResults(path, source);
+    fold(source, first);
+    if (!first.getEvaluator().saveResults(path, source)) return false;
+    
+    // Stale for any other text
+    std::string edited = source;
+    edited[source.find("30")] = '2';
+    bool stale = !ConstantEvaluator().loadResults(path, edited);
+    
+    // Read into a program whose fib works out 0, the stored values are the
+    // ones used
+    ConstantFolder second;
+    if (!second.getEvaluator().loadResults(path, source)) return false;
+    std::string stub = source;
+    stub.replace(stub.find("fib(n - 1) + fib(n - 2)"), std::string("fib(n - 1) + fib(n - 2)").size(), "fib(n - 1) * 0");
+    std::vector<Stmt*> statements = fold(stub, second);
+    bool used = value(statements, 2).intValue == 832040 && value(statements, 3).intValue == 1346269;
+    
+    std::string bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    bool rejected = true;
+    for (size_t i = 0; i < bytes.size() && rejected; i++) {
+        std::string damaged = bytes;
+        damaged[i] = static_cast<char>(damaged[i] ^ (1 << i % 8));
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << damaged;
+        rejected = !ConstantEvaluator().loadResults(path, source);
+    }
+    
+    std::remove(path.c_str());
+    return none && stale && used && rejected;
+}
+
+// Functions that only call pure functions are pure, whatever they do with
+// their own variables; printing, directly or not, is not. Recursion is
+// found through other functions too.
+bool testPurityAnalysis() {
+    std::string source = R"(
+        function fib(n) { if (n < 2) { return n; } return fib(n - 1) + fib(n - 2); }
+        function even(n) { if (n == 0) { return true; } return odd(n - 1); }
+        function odd(n) { if (n == 0) { return false; } return even(n - 1); }
+        function sum(n) { var s = 0; while (n > 0) { s = s + n; n = n - 1; } return s; }
+        function shout(x) { print(x); return x; }
+        function loud(n) { if (n > 0) { return loud(n - 1); } return shout(n); }
+        function twice(n) { return sum(n) + sum(n); }
+    )";
+    
+    auto analyze = [&](bool open, ASTContext& context) {
+        Lexer lexer(source);
+        std::vector<Token> tokens = lexer.scanTokens();
+        std::vector<Stmt*> statements = Parser(tokens, source, context).parse();
+        Resolver resolver;
+        resolver.resolve(statements);
+        PurityAnalysis purity;
+        if (open) {
+            for (Stmt* statement : statements) purity.analyze({statement});
+        } else {
+            purity.analyze(statements);
+        }
+        return statements;
+    };
+    auto flags = [](const std::vector<Stmt*>& statements) {
+        std::string found;
+        for (Stmt* statement : statements) {
+            FunctionStmt* function = statement->as<FunctionStmt>();
+            found += function->pure ? 'p' : '-';
+            found += function->recursive ? 'r' : '-';
+        }
+        return found;
+    };
+    
+    // even and odd are only analyzed together; alone, even calls a
+    // function that is not defined yet
+    ASTContext context;
+    ASTContext openContext;
+    return flags(analyze(false, context)) == "prprprp----rp-" &&
+           flags(analyze(true, openContext)) == "pr----p----rp-";
+}
+
+bool testFunctionShapes() {
+    std::string source = R"(
+        function int factorial(int n) { if (n <= 1) { return 1; } return n * factorial(n - 1); }
+        फलन पूर्णांक फैक्टोरियल(पूर्णांक न) { अगर (न <= 1) { वापस 1; } वापस न * फैक्टोरियल(न - 1); }
+        কাৰ্য্য পূৰ্ণসংখ্যা ফেক্টৰিয়েল(পূৰ্ণসংখ্যা ন) { যদি (ন <= 1) { ঘূৰাই_দিয়ক 1; } ঘূৰাই_দিয়ক ন * ফেক্টৰিয়েল(ন - 1); }
+        function int sum(int n) { if (n <= 1) { return 1; } return n + sum(n - 1); }
+        function int shifted(int n) { if (n <= 2) { return 1; } return n * shifted(n - 1); }
+        function int other(int n) { if (n <= 1) { return 1; } return n * factorial(n - 1); }
+        function float real(float n) { if (n <= 1) { return 1; } return n * real(n - 1); }
+    )";
+    
+    ASTContext context;
+    Lexer lexer(source);
+    std::vector<Token> tokens = lexer.scanTokens();
+    std::vector<Stmt*> statements = Parser(tokens, source, context).parse();
+    Resolver resolver;
+    resolver.resolve(statements);
+    TypeInference inference;
+    inference.infer(statements);
+    if (resolver.hadError() || inference.hadError()) return false;
+    
+    std::vector<FunctionShape> shapes;
+    for (Stmt* statement : statements) {
+        shapes.emplace_back(statement->as<FunctionStmt>());
+    }
+    
+    // The three factorials are one function; the rest differ in an
+    // operator, a literal, what they call or a type
+    FunctionShapes known;
+    known.add(shapes[0], "factorial");
+    const std::string* hindi = known.find(shapes[1]);
+    const std::string* assamese = known.find(shapes[2]);
+    return shapes[0] == shapes[1] && shapes[1] == shapes[2] &&
+           hindi && *hindi == "factorial" && assamese && *assamese == "factorial" &&
+           !known.find(shapes[3]) && !known.find(shapes[4]) &&
+           !known.find(shapes[5]) && !known.find(shapes[6]);
+}
+
 // Register all parser tests
 void registerParserTests() {
     // Initialize keyword maps
@@ -107,4 +1068,22 @@ void registerParserTests() {
     registerTest("parser", "Mixed Language Parsing", testMixedLanguageParsing);
     registerTest("parser", "Function Parsing", testFunctionParsing);
     registerTest("parser", "Control Flow Parsing", testControlFlowParsing);
+    registerTest("parser", "Arena Allocated AST", testArenaAllocatedAST);
+    registerTest("parser", "Operator Precedence", testOperatorPrecedence);
+    registerTest("parser", "Deep Expressions", testDeepExpressions);
+    registerTest("parser", "Typed Visitor", testTypedVisitor);
+    registerTest("parser", "Parse Diagnostics", testParseDiagnostics);
+    registerTest("parser", "Many Parse Errors", testManyParseErrors);
+    registerTest("parser", "Parallel Parsing", testParallelParsing);
+    registerTest("parser", "AST Cache Round Trip", testASTCacheRoundTrip);
+    registerTest("parser", "Incremental Reparse", testIncrementalReparse);
+    registerTest("parser", "Declaration Stream", testDeclarationStream);
+    registerTest("parser", "Resolver Slots", testResolverSlots);
+    registerTest("parser", "Type Inference", testTypeInference);
+    registerTest("parser", "Type Annotations", testTypeAnnotations);
+    registerTest("parser", "Constant Folding", testConstantFolding);
+    registerTest("parser", "Compile-Time Evaluation", testCompileTimeEvaluation);
+    registerTest("parser", "Stored Evaluation Results", testStoredEvaluationResults);
+    registerTest("parser", "Purity Analysis", testPurityAnalysis);
+    registerTest("parser", "Function Shapes", testFunctionShapes);
 }
\ No newline at end of file
@@ -18,11 +18,13 @@ void registerTest(const std::string& suite, const std::string& name, TestFunctio
 // Forward declarations for test suites
 void registerLexerTests();
 void registerParserTests();
+void registerCodeGenTests();
 
 int main(int argc, char* argv[]) {
     // Register all test suites
     registerLexerTests();
     registerParserTests();
+    registerCodeGenTests();
     
     // If a specific suite is requested, only run that suite
     if (argc > 1) {